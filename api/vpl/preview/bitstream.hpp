@@ -9,7 +9,10 @@
 #include <algorithm>
 #include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 #include "vpl/preview/defs.hpp"
 #include "vpl/preview/exception.hpp"
@@ -67,8 +70,13 @@ public:
         bits_.CodecId         = (uint32_t)codecID;
     }
 
-    /// @brief default ctor
-    virtual ~bitstream() {}
+    bitstream(const bitstream&)            = delete;
+    bitstream& operator=(const bitstream&) = delete;
+
+    /// @brief Dtor. Releases the internal buffer.
+    virtual ~bitstream() {
+        delete[] bits_.Data;
+    }
 
     /// @brief Reallocs internal buffer with the given buffer size increase value. Valid data is copied into new buffer
     /// @param[in] bufferinc Number of bytes to increase the buffer.
@@ -230,6 +238,19 @@ public:
         }
     }
 
+    /// @brief Resets data in the buffer and drops association with the previous operation, so the
+    /// object can be passed to the encoder again.
+    void reset() {
+        bitstream::reset();
+        bits_.TimeStamp       = MFX_TIMESTAMP_UNKNOWN;
+        bits_.DecodeTimeStamp = MFX_TIMESTAMP_UNKNOWN;
+        bits_.FrameType       = 0;
+        bits_.DataFlag        = 0;
+        sp_                   = nullptr;
+        session_              = nullptr;
+        valid_                = false;
+    }
+
     /// @brief Temporal method to assotiate externally allocated surface with sync point generated
     /// by the processing function.
     /// @param[in] context Pair of session handle and sync point.
@@ -297,5 +318,137 @@ protected:
     bool valid_;
 };
 
+/// @brief Pool of reusable bitstream_as_dst objects. Objects are handed out as shared pointers
+/// which return the object to the pool's free list when the last reference is released, so
+/// steady-state processing reuses the same buffers and does no heap allocation. Objects and the
+/// free list outlive the pool while any object is in use. Pool is thread safe.
+class bitstream_pool {
+public:
+    /// @brief Pool statistic
+    struct statistic {
+        /// Number of acquire() calls
+        uint64_t acquired;
+        /// Number of bitstream objects created by the pool
+        uint32_t allocated;
+        /// Number of buffer reallocations to the current buffer size
+        uint32_t grown;
+        /// Number of objects referenced outside of the pool
+        uint32_t in_use;
+        /// Current buffer size in bytes
+        uint32_t buffer_size;
+    };
+
+    /// @brief Constructs the pool
+    /// @param[in] codecID codec's fourCC code
+    /// @param[in] buffersize buffer size of new objects in bytes
+    explicit bitstream_pool(codec_format_fourcc codecID,
+                            uint32_t buffersize = bitstream::buffer_len::DEFAULT_LENGHT)
+            : state_(std::make_shared<state>(codecID, buffersize)) {}
+
+    bitstream_pool(const bitstream_pool&)            = delete;
+    bitstream_pool& operator=(const bitstream_pool&) = delete;
+
+    /// @brief Returns free object with the buffer of at least current buffer size. Creates new
+    /// object if all objects are in use.
+    /// @return Shared pointer to the bitstream object with empty data.
+    std::shared_ptr<bitstream_as_dst> acquire() {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        state_->stat_.acquired++;
+
+        bitstream_as_dst* bs = nullptr;
+        if (state_->free_.empty()) {
+            state_->objects_.push_back(
+                std::make_unique<bitstream_as_dst>(state_->codec_, state_->buffer_size_));
+            // Release never allocates: the free list has room for every object
+            state_->free_.reserve(state_->objects_.size());
+            state_->stat_.allocated++;
+            bs = state_->objects_.back().get();
+        }
+        else {
+            bs = state_->free_.back();
+            state_->free_.pop_back();
+            bs->reset();
+            if (bs->get_max_buffer_length() < state_->buffer_size_) {
+                bs->realloc(state_->buffer_size_ - bs->get_max_buffer_length());
+                state_->stat_.grown++;
+            }
+        }
+
+        std::shared_ptr<state> st = state_;
+        return std::shared_ptr<bitstream_as_dst>(bs, [st](bitstream_as_dst* released) {
+            std::lock_guard<std::mutex> lock(st->mtx_);
+            // Buffer grown by the user increases size of all buffers
+            st->buffer_size_ = std::max(st->buffer_size_, released->get_max_buffer_length());
+            st->free_.push_back(released);
+        });
+    }
+
+    /// @brief Sets buffer size. Free objects with smaller buffers are reallocated on acquire.
+    /// Buffer size never decreases.
+    /// @param[in] buffersize Buffer size in bytes.
+    void set_buffer_size(uint32_t buffersize) {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        state_->buffer_size_ = std::max(state_->buffer_size_, buffersize);
+    }
+
+    /// @brief Returns current buffer size.
+    /// @return Buffer size in bytes.
+    uint32_t get_buffer_size() const {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        return state_->buffer_size_;
+    }
+
+    /// @brief Returns pool statistic.
+    /// @return Pool statistic.
+    statistic get_stat() const {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        statistic out   = state_->stat_;
+        out.in_use      = (uint32_t)(state_->objects_.size() - state_->free_.size());
+        out.buffer_size = state_->buffer_size_;
+        return out;
+    }
+
+protected:
+    /// @brief Objects of the pool, shared with the release hooks of the objects in use
+    struct state {
+        /// @brief Constructs the state
+        /// @param[in] codecID codec's fourCC code
+        /// @param[in] buffersize buffer size of new objects in bytes
+        state(codec_format_fourcc codecID, uint32_t buffersize)
+                : codec_(codecID),
+                  buffer_size_(buffersize),
+                  objects_(),
+                  free_(),
+                  stat_(),
+                  mtx_() {}
+
+        /// @brief Codec ID of new objects
+        codec_format_fourcc codec_;
+        /// @brief Buffer size of new objects in bytes
+        uint32_t buffer_size_;
+        /// @brief All objects created by the pool
+        std::vector<std::unique_ptr<bitstream_as_dst>> objects_;
+        /// @brief Objects nobody references
+        std::vector<bitstream_as_dst*> free_;
+        /// @brief Pool statistic
+        statistic stat_;
+        /// @brief Guards the state
+        std::mutex mtx_;
+    };
+
+    /// @brief Pool state
+    std::shared_ptr<state> state_;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const bitstream_pool::statistic& s) {
+    out << detail::space(detail::INTENT, out, "Acquired   = ") << s.acquired << std::endl;
+    out << detail::space(detail::INTENT, out, "Allocated  = ") << s.allocated << std::endl;
+    out << detail::space(detail::INTENT, out, "Grown      = ") << s.grown << std::endl;
+    out << detail::space(detail::INTENT, out, "InUse      = ") << s.in_use << std::endl;
+    out << detail::space(detail::INTENT, out, "BufferSize = ") << s.buffer_size << std::endl;
+
+    return out;
+}
+
 } // namespace vpl
 } // namespace oneapi
@@ -0,0 +1,653 @@
+/*############################################################################
+  # Copyright Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#pragma once
+
+// Coroutine layer requires C++20. With older standards this header is empty.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+    #include <algorithm>
+    #include <chrono>
+    #include <coroutine>
+    #include <cstddef>
+    #include <deque>
+    #include <exception>
+    #include <functional>
+    #include <memory>
+    #include <optional>
+    #include <utility>
+    #include <vector>
+
+    #include "vpl/preview/defs.hpp"
+    #include "vpl/preview/exception.hpp"
+    #include "vpl/preview/future.hpp"
+    #include "vpl/preview/session.hpp"
+
+namespace oneapi {
+namespace vpl {
+/// @brief Awaitable layer on top of the future objects. All coroutines of an executor run on the
+/// thread which called executor::run(), so several sessions are kept busy by a single thread.
+///
+/// Inside of a task, co_await on std::shared_ptr<future<...>> suspends until the sync point of
+/// the future is completed and returns the same future, so get() doesn't block:
+/// @code
+/// vpl::coro::task write(std::shared_ptr<vpl::coro::channel<out_t>> frames, std::ofstream *f);
+///
+/// vpl::coro::executor exec;
+/// auto out = (vpl::coro::stage(decoder, 4) | vpl::coro::stage(vpp, 4) |
+///             vpl::coro::stage(encoder, 4)).spawn(exec);
+/// exec.spawn(write(out, &sink));
+/// exec.run();
+/// @endcode
+namespace coro {
+
+class executor;
+
+namespace detail {
+
+/// @brief Coroutine suspended on the sync point.
+struct sync_waiter {
+    /// @brief Checks if the sync point is completed.
+    /// @param[in] timeout Time to wait for the completion.
+    /// @return true if sync point is completed or failed.
+    virtual bool poll(std::chrono::milliseconds timeout) noexcept = 0;
+
+    /// @brief Suspended coroutine.
+    std::coroutine_handle<> handle_;
+};
+
+/// @brief Tag to reschedule current coroutine to the end of the executor's ready queue.
+struct yield_tag {};
+
+} // namespace detail
+
+/// @brief Awaiter for the future object.
+/// @tparam Future future_surface_t or future_bitstream_t
+template <typename Future>
+class sync_awaiter : public detail::sync_waiter {
+public:
+    /// @brief Ctor
+    /// @param[in] exec Executor which polls the sync point.
+    /// @param[in] f Future to wait for.
+    sync_awaiter(executor *exec, std::shared_ptr<Future> f)
+            : exec_(exec),
+              future_(std::move(f)),
+              error_() {}
+
+    /// @brief Checks if the sync point is completed. Futures without data or with failed
+    /// scheduling are completed immediately.
+    /// @param[in] timeout Time to wait for the completion.
+    /// @return true if sync point is completed or failed.
+    bool poll(std::chrono::milliseconds timeout) noexcept override {
+        try {
+            return future_->wait_for(timeout) != async_op_status::timeout;
+        }
+        catch (...) {
+            error_ = std::current_exception();
+            return true;
+        }
+    }
+
+    bool await_ready() noexcept {
+        return poll(std::chrono::milliseconds(0));
+    }
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    /// @brief Returns synchronized future or rethrows the synchronization error.
+    /// @return Synchronized future
+    std::shared_ptr<Future> await_resume() {
+        if (error_)
+            std::rethrow_exception(error_);
+        return std::move(future_);
+    }
+
+protected:
+    /// @brief Executor which polls the sync point.
+    executor *exec_;
+    /// @brief Future to wait for.
+    std::shared_ptr<Future> future_;
+    /// @brief Synchronization error.
+    std::exception_ptr error_;
+};
+
+/// @brief Coroutine run by the executor. Coroutine starts when it is spawned by the executor.
+class task {
+public:
+    /// @brief Coroutine promise.
+    struct promise_type {
+        task get_return_object() {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            error_ = std::current_exception();
+        }
+
+        /// @brief co_await on the future waits for its sync point.
+        template <typename T>
+        sync_awaiter<future<T>> await_transform(std::shared_ptr<future<T>> f) {
+            return sync_awaiter<future<T>>(exec_, std::move(f));
+        }
+
+        /// @brief co_await on the yield() reschedules the coroutine.
+        auto await_transform(detail::yield_tag);
+
+        /// @brief Other awaitables are used as is.
+        template <typename Awaitable>
+        Awaitable &&await_transform(Awaitable &&a) {
+            return std::forward<Awaitable>(a);
+        }
+
+        /// @brief Executor the coroutine is spawned to.
+        executor *exec_ = nullptr;
+        /// @brief Exception left the coroutine.
+        std::exception_ptr error_;
+    };
+
+    /// @brief Coroutine handle type.
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    task(task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    task &operator=(task &&other) noexcept {
+        if (this != &other) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    task(const task &)            = delete;
+    task &operator=(const task &) = delete;
+
+    /// @brief Dtor. Destroys coroutine which was not spawned.
+    ~task() {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    /// @brief Releases ownership of the coroutine.
+    /// @return Coroutine handle.
+    handle_type release() {
+        return std::exchange(handle_, nullptr);
+    }
+
+protected:
+    /// @brief Ctor
+    /// @param[in] h Coroutine handle.
+    explicit task(handle_type h) : handle_(h) {}
+
+    /// @brief Coroutine handle.
+    handle_type handle_;
+};
+
+/// @brief Reschedules current coroutine. Use it to retry the operation when the device is busy.
+/// @return Awaitable tag.
+inline detail::yield_tag yield() {
+    return {};
+}
+
+/// @brief Single threaded executor of the tasks. Suspended sync points are polled with zero
+/// timeout, when no coroutine is able to run executor blocks on the oldest sync point for 1 ms.
+class executor {
+public:
+    executor() : ready_(), waiting_(), tasks_() {}
+    executor(const executor &)            = delete;
+    executor &operator=(const executor &) = delete;
+
+    /// @brief Dtor. Destroys tasks which are not completed.
+    ~executor() {
+        ready_.clear();
+        waiting_.clear();
+        for (auto &t : tasks_)
+            t.destroy();
+    }
+
+    /// @brief Schedules the task for the execution.
+    /// @param[in] t Task to schedule.
+    void spawn(task t) {
+        task::handle_type h = t.release();
+        h.promise().exec_   = this;
+        tasks_.push_back(h);
+        ready_.push_back(h);
+    }
+
+    /// @brief Runs spawned tasks until all of them are completed. Exception left the task is
+    /// rethrown, other tasks remain suspended in this case.
+    void run() {
+        while (!tasks_.empty()) {
+            while (!ready_.empty()) {
+                std::coroutine_handle<> h = ready_.front();
+                ready_.pop_front();
+                resume(h);
+            }
+            if (tasks_.empty())
+                break;
+
+            if (!poll(std::chrono::milliseconds(0))) {
+                if (waiting_.empty())
+                    throw base_exception("coroutine executor: all tasks are blocked",
+                                         MFX_ERR_ABORTED);
+                // Nothing to do, block on the oldest sync point instead of busy polling
+                if (waiting_.front()->poll(std::chrono::milliseconds(1))) {
+                    ready_.push_back(waiting_.front()->handle_);
+                    waiting_.erase(waiting_.begin());
+                }
+            }
+        }
+    }
+
+    /// @brief Schedules suspended coroutine for the execution.
+    /// @param[in] h Coroutine handle.
+    void schedule(std::coroutine_handle<> h) {
+        ready_.push_back(h);
+    }
+
+    /// @brief Adds coroutine suspended on the sync point to the polling list.
+    /// @param[in] w Suspended coroutine.
+    void wait(detail::sync_waiter *w) {
+        waiting_.push_back(w);
+    }
+
+protected:
+    /// @brief Polls suspended sync points.
+    /// @param[in] timeout Time to wait for each sync point.
+    /// @return true if any coroutine became ready.
+    bool poll(std::chrono::milliseconds timeout) {
+        bool progress = false;
+        for (auto it = waiting_.begin(); it != waiting_.end();) {
+            if ((*it)->poll(timeout)) {
+                ready_.push_back((*it)->handle_);
+                it       = waiting_.erase(it);
+                progress = true;
+            }
+            else {
+                ++it;
+            }
+        }
+        return progress;
+    }
+
+    /// @brief Resumes coroutine and releases it once completed.
+    /// @param[in] h Coroutine handle.
+    void resume(std::coroutine_handle<> h) {
+        h.resume();
+        if (!h.done())
+            return;
+
+        auto t                   = task::handle_type::from_address(h.address());
+        std::exception_ptr error = t.promise().error_;
+        tasks_.erase(std::find(tasks_.begin(), tasks_.end(), t));
+        t.destroy();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    /// @brief Coroutines ready to run.
+    std::deque<std::coroutine_handle<>> ready_;
+    /// @brief Coroutines suspended on sync points.
+    std::vector<detail::sync_waiter *> waiting_;
+    /// @brief Spawned tasks which are not completed.
+    std::vector<task::handle_type> tasks_;
+};
+
+template <typename Future>
+void sync_awaiter<Future>::await_suspend(std::coroutine_handle<> h) {
+    handle_ = h;
+    exec_->wait(this);
+}
+
+inline auto task::promise_type::await_transform(detail::yield_tag) {
+    struct awaiter {
+        bool await_ready() noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            exec_->schedule(h);
+        }
+        void await_resume() noexcept {}
+
+        executor *exec_;
+    };
+    return awaiter{ exec_ };
+}
+
+/// @brief Bounded single producer, single consumer queue between two tasks of the same executor.
+/// @tparam T Type of the element
+template <typename T>
+class channel {
+public:
+    /// @brief Ctor
+    /// @param[in] exec Executor of the producer and the consumer tasks.
+    /// @param[in] capacity Maximum number of elements in the queue.
+    channel(executor &exec, size_t capacity)
+            : exec_(exec),
+              capacity_(capacity ? capacity : 1),
+              items_(),
+              closed_(false),
+              producer_(nullptr),
+              consumer_(nullptr) {}
+
+    channel(const channel &)            = delete;
+    channel &operator=(const channel &) = delete;
+
+    /// @brief Puts the element to the queue. Suspends the producer while the queue is full.
+    /// @param[in] value Element.
+    /// @return Awaitable.
+    auto push(T value) {
+        struct awaiter {
+            bool await_ready() noexcept {
+                return ch_->items_.size() < ch_->capacity_;
+            }
+            void await_suspend(std::coroutine_handle<> h) noexcept {
+                ch_->producer_ = h;
+            }
+            void await_resume() {
+                ch_->items_.push_back(std::move(value_));
+                ch_->wake(ch_->consumer_);
+            }
+
+            channel *ch_;
+            T value_;
+        };
+        return awaiter{ this, std::move(value) };
+    }
+
+    /// @brief Gets the element from the queue. Suspends the consumer while the queue is empty.
+    /// @return Awaitable with the element or std::nullopt if the channel is closed and empty.
+    auto pop() {
+        struct awaiter {
+            bool await_ready() noexcept {
+                return !ch_->items_.empty() || ch_->closed_;
+            }
+            void await_suspend(std::coroutine_handle<> h) noexcept {
+                ch_->consumer_ = h;
+            }
+            std::optional<T> await_resume() {
+                if (ch_->items_.empty())
+                    return std::nullopt;
+                std::optional<T> value(std::move(ch_->items_.front()));
+                ch_->items_.pop_front();
+                ch_->wake(ch_->producer_);
+                return value;
+            }
+
+            channel *ch_;
+        };
+        return awaiter{ this };
+    }
+
+    /// @brief Marks end of the data. Consumer gets std::nullopt once the queue is empty.
+    void close() {
+        closed_ = true;
+        wake(consumer_);
+    }
+
+    /// @brief Checks if there is no element to get right now.
+    /// @return true if queue is empty and channel isn't closed.
+    bool empty() const {
+        return items_.empty() && !closed_;
+    }
+
+protected:
+    /// @brief Schedules the suspended task.
+    /// @param[in] h Suspended task or nullptr.
+    void wake(std::coroutine_handle<> &h) {
+        if (h)
+            exec_.schedule(std::exchange(h, nullptr));
+    }
+
+    /// @brief Executor of the producer and the consumer tasks.
+    executor &exec_;
+    /// @brief Maximum number of elements in the queue.
+    size_t capacity_;
+    /// @brief Elements.
+    std::deque<T> items_;
+    /// @brief End of data flag.
+    bool closed_;
+    /// @brief Producer suspended on the full queue.
+    std::coroutine_handle<> producer_;
+    /// @brief Consumer suspended on the empty queue.
+    std::coroutine_handle<> consumer_;
+};
+
+namespace detail {
+
+/// @brief What pipeline stage does with the future returned by process().
+enum class step {
+    output, ///! Future has the data, pass it downstream once synchronized.
+    skip, ///! No data, input is consumed.
+    retry, ///! Device is busy, submit the same input again.
+    end, ///! All data is processed.
+};
+
+/// @brief Classifies the future returned by process(). Fatal errors are thrown.
+/// @param[in] f Future
+/// @return What to do with the future.
+template <typename Future>
+step classify(Future &f) {
+    status s = f->get_last_schedule_status();
+    if (f->had_fatal() || (s < status::Ok && s != status::NotEnoughData &&
+                           s != status::EndOfStreamReached)) {
+        mfxStatus sts = (s == status::Unknown) ? MFX_ERR_UNKNOWN : static_cast<mfxStatus>(s);
+        throw base_exception("pipeline stage failed", sts);
+    }
+    switch (s) {
+        case status::Ok:
+            return step::output;
+        case status::DeviceBusy:
+            return step::retry;
+        case status::EndOfStreamReached:
+            return step::end;
+        default:
+            return step::skip;
+    }
+}
+
+/// @brief Source stage. Keeps up to depth decoded frames in flight.
+/// @tparam Session decode_session or other source with process() returning future_surface_t
+template <typename Session>
+task decode_stage(Session *session,
+                  size_t depth,
+                  std::shared_ptr<channel<std::shared_ptr<future_surface_t>>> out) {
+    std::deque<std::shared_ptr<future_surface_t>> in_flight;
+    bool eos = false;
+
+    while (!eos || !in_flight.empty()) {
+        if (eos || in_flight.size() >= depth) {
+            std::shared_ptr<future_surface_t> f = co_await in_flight.front();
+            in_flight.pop_front();
+            co_await out->push(std::move(f));
+            continue;
+        }
+
+        std::shared_ptr<future_surface_t> f = session->process();
+        switch (classify(f)) {
+            case step::output:
+                in_flight.push_back(std::move(f));
+                break;
+            case step::retry:
+                co_await yield();
+                break;
+            case step::end:
+                eos = true;
+                break;
+            default:
+                break;
+        }
+    }
+    out->close();
+}
+
+/// @brief Processing stage. Keeps up to depth processed frames in flight. Once input is closed
+/// the session is drained.
+template <typename Session, typename In, typename Out>
+task process_stage(Session *session,
+                   size_t depth,
+                   std::shared_ptr<channel<In>> in,
+                   std::shared_ptr<channel<Out>> out) {
+    std::deque<Out> in_flight;
+    std::optional<In> input;
+    bool input_done = false;
+    bool eos        = false;
+
+    while (!eos || !in_flight.empty()) {
+        // Pass data downstream rather than wait for the input
+        if (!in_flight.empty() &&
+            (eos || in_flight.size() >= depth || (!input && !input_done && in->empty()))) {
+            Out f = co_await in_flight.front();
+            in_flight.pop_front();
+            co_await out->push(std::move(f));
+            continue;
+        }
+
+        if (!input && !input_done) {
+            input = co_await in->pop();
+            if (!input)
+                input_done = true;
+            continue;
+        }
+
+        if (!input) {
+            // Future without data makes the session to drain
+            auto drain = std::make_shared<typename In::element_type>(nullptr);
+            operation_status op(component::unknown, nullptr);
+            op.schedule_status_ = status::EndOfStreamReached;
+            drain->add_operation(op);
+            input = drain;
+        }
+
+        Out f = session->process(*input);
+        switch (classify(f)) {
+            case step::output:
+                in_flight.push_back(std::move(f));
+                input.reset();
+                break;
+            case step::retry:
+                co_await yield();
+                break;
+            case step::end:
+                eos = true;
+                input.reset();
+                break;
+            default:
+                input.reset();
+                break;
+        }
+    }
+    out->close();
+}
+
+/// @brief Calls the consumer for each synchronized future of the channel.
+template <typename Out>
+task consume_stage(std::shared_ptr<channel<Out>> in, std::function<void(Out)> consumer) {
+    while (std::optional<Out> f = co_await in->pop())
+        consumer(std::move(*f));
+}
+
+} // namespace detail
+
+/// @brief Chain of the pipeline stages. Each stage runs in its own task and passes synchronized
+/// futures to the next stage through the channel.
+/// @tparam Out Type of the future produced by the last stage.
+template <typename Out>
+class pipeline {
+public:
+    /// @brief Type of the function which spawns the stages and returns the output channel.
+    using builder_type = std::function<std::shared_ptr<channel<Out>>(executor &)>;
+
+    /// @brief Ctor
+    /// @param[in] builder Function which spawns the stages.
+    explicit pipeline(builder_type builder) : builder_(std::move(builder)) {}
+
+    /// @brief Spawns tasks of all stages.
+    /// @param[in] exec Executor to run the tasks.
+    /// @return Channel with synchronized futures of the last stage.
+    std::shared_ptr<channel<Out>> spawn(executor &exec) const {
+        return builder_(exec);
+    }
+
+    /// @brief Spawns tasks of all stages and the task calling the consumer for each future of the
+    /// last stage.
+    /// @param[in] exec Executor to run the tasks.
+    /// @param[in] consumer Function to call for each synchronized future.
+    void spawn(executor &exec, std::function<void(Out)> consumer) const {
+        exec.spawn(detail::consume_stage<Out>(builder_(exec), std::move(consumer)));
+    }
+
+    /// @brief Returns the builder of the pipeline.
+    /// @return Builder.
+    const builder_type &get_builder() const {
+        return builder_;
+    }
+
+protected:
+    /// @brief Function which spawns the stages and returns the output channel.
+    builder_type builder_;
+};
+
+/// @brief Stage of the pipeline which processes data of the previous stage.
+/// @tparam Session vpp_session or encode_session
+template <typename Session>
+struct processing_stage {
+    /// @brief Session to process the data.
+    Session *session_;
+    /// @brief Maximum number of frames in flight.
+    size_t depth_;
+};
+
+/// @brief Creates the first stage of the pipeline.
+/// @param[in] session Decoder session.
+/// @param[in] depth Maximum number of frames in flight.
+/// @return Pipeline with one stage.
+template <typename Reader>
+pipeline<std::shared_ptr<future_surface_t>> stage(decode_session<Reader> &session,
+                                                  size_t depth = 4) {
+    decode_session<Reader> *s = &session;
+    return pipeline<std::shared_ptr<future_surface_t>>([s, depth](executor &exec) {
+        auto out = std::make_shared<channel<std::shared_ptr<future_surface_t>>>(exec, depth);
+        exec.spawn(detail::decode_stage(s, depth, out));
+        return out;
+    });
+}
+
+/// @brief Creates the processing stage of the pipeline.
+/// @param[in] session VPP or encoder session.
+/// @param[in] depth Maximum number of frames in flight.
+/// @return Stage to attach to the pipeline with operator |.
+template <typename Session>
+processing_stage<Session> stage(Session &session, size_t depth = 4) {
+    return processing_stage<Session>{ &session, depth };
+}
+
+/// @brief Attaches processing stage to the pipeline.
+/// @param[in] p Pipeline.
+/// @param[in] s Stage.
+/// @return Pipeline with the stage attached.
+template <typename In, typename Session>
+auto operator|(const pipeline<In> &p, processing_stage<Session> s) {
+    using Out = decltype(s.session_->process(std::declval<In>()));
+
+    auto builder = p.get_builder();
+    return pipeline<Out>([builder, s](executor &exec) {
+        auto in  = builder(exec);
+        auto out = std::make_shared<channel<Out>>(exec, s.depth_);
+        exec.spawn(detail::process_stage<Session, In, Out>(s.session_, s.depth_, in, out));
+        return out;
+    });
+}
+
+} // namespace coro
+} // namespace vpl
+} // namespace oneapi
+
+#endif // __cpp_impl_coroutine
@@ -11,6 +11,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "vpl/preview/bitstream.hpp"
 #include "vpl/preview/defs.hpp"
@@ -58,6 +59,27 @@ inline std::ostream &operator<<(std::ostream &out, const operation_status &o) {
     return out;
 }
 
+namespace detail {
+
+/// @brief Node of the processing history. History is an immutable singly linked chain from the
+/// latest operation to the first one. Pipeline stages share the common part of the chain, so
+/// passing the history downstream costs one node regardless of the pipeline length.
+struct history_node {
+    /// @brief Ctor.
+    /// @param[in] op Operation's status.
+    /// @param[in] parent Node of the previous operation.
+    history_node(const operation_status &op, std::shared_ptr<const history_node> parent)
+            : op_(op),
+              parent_(std::move(parent)) {}
+
+    /// @brief Operation's status.
+    const operation_status op_;
+    /// @brief Node of the previous operation or nullptr for the first operation.
+    const std::shared_ptr<const history_node> parent_;
+};
+
+} // namespace detail
+
 /// @brief This class represent future data container and used to glue processing of the individual components
 /// into the pipeline. Once component which is down in the pipeline recieved that object, it must use it to wait for
 /// the data. States of the data in this object:
@@ -76,7 +98,10 @@ class future {
 public:
     /// @brief Default ctor
     /// @param[in] future_data Data object to take care about.
-    explicit future(data future_data) : data_(future_data), fatal_happened_(false) {}
+    explicit future(data future_data)
+            : data_(future_data),
+              fatal_happened_(false),
+              node_(nullptr) {}
 
     /// @brief Indefinitely waits for operation completion.
     void wait() {
@@ -106,20 +131,20 @@ public:
     /// @brief add current operation scheduling status into the history of the future.
     /// @param[in] op Operation's status
     void add_operation(operation_status op) {
-        history_.push_back(op);
+        node_           = std::make_shared<const detail::history_node>(op, std::move(node_));
         fatal_happened_ = op.fatal_;
     }
 
     /// @brief retrieve last operation scheduling status
     /// @return operation scheduling status
     status get_last_schedule_status() {
-        return history_.back().schedule_status_;
+        return node_ ? node_->op_.schedule_status_ : status::Unknown;
     }
 
     /// @brief retrieve last operation exec status
     /// @return operation exec status
     status get_last_exec_status() {
-        return history_.back().exec_status_;
+        return node_ ? node_->op_.exec_status_ : status::Unknown;
     }
 
     /// @brief Check if fatal error happened.
@@ -132,41 +157,77 @@ public:
     /// @return Components with fatal status.
     component get_fatal_component() {
         component c = component::unknown;
-        std::for_each(history_.rbegin(), history_.rend(), [&](operation_status s) {
+        for_each_operation([&](const operation_status &s) {
             if (s.fatal_)
-                return c = s.component_;
+                c = s.component_;
         });
         return c;
     }
 
-    /// @brief Propagate processing history from previous future object in the pipeline.
+    /// @brief Propagate processing history from previous future object in the pipeline. Called
+    /// before add_operation(), it shares the chain of the old future and allocates nothing. Own
+    /// history added before is copied on top of the old one.
     /// @param old Reference to the previouse future object in the pipeline
     /// @tparam T Type of the data container
     template <typename T>
     void propagate_history(const future<T> &old) {
-        std::for_each(old.history_.rbegin(), old.history_.rend(), [&](operation_status s) {
-            history_.push_front(s);
-        });
+        std::shared_ptr<const detail::history_node> chain = old.get_history_node();
+
+        std::vector<const operation_status *> own;
+        for (auto n = node_.get(); n; n = n->parent_.get())
+            own.push_back(&n->op_);
+        for (auto it = own.rbegin(); it != own.rend(); ++it)
+            chain = std::make_shared<const detail::history_node>(**it, chain);
+        node_ = std::move(chain);
     }
 
-    /// Processing history
-    std::deque<operation_status> history_;
+    /// @brief Returns processing history, the first operation goes first. Replaces the public
+    /// history_ member of the earlier versions.
+    /// @return Processing history.
+    std::deque<operation_status> get_history() const {
+        std::deque<operation_status> out;
+        for_each_operation([&](const operation_status &s) {
+            out.push_front(s);
+        });
+        return out;
+    }
 
 protected:
+    template <typename, typename>
+    friend class future;
+
     /// @brief Checks if we need to wait for the data or skip the processing.
     /// @return true if wait operation is required.
     bool have_to_wait() const {
-        if (history_.empty())
+        if (!node_)
             return false;
-        return ((status::Ok == history_.back().schedule_status_) &&
-                (false == history_.back().fatal_));
+        return ((status::Ok == node_->op_.schedule_status_) && (false == node_->op_.fatal_));
+    }
+
+    /// @brief Returns the history chain, shared by all downstream futures. Nodes are immutable,
+    /// so the chain can be read from several threads.
+    /// @return The latest node of the chain.
+    std::shared_ptr<const detail::history_node> get_history_node() const {
+        return node_;
     }
+
+    /// @brief Calls the function for each operation of the history from the latest to the first.
+    /// @param[in] fn Function to call.
+    template <typename Fn>
+    void for_each_operation(Fn fn) const {
+        for (auto n = node_.get(); n; n = n->parent_.get())
+            fn(n->op_);
+    }
+
     /// Data container
     data data_;
 
     /// Global fatal flag. Updated when first operation in the pipeline provided fatal status code.
     bool fatal_happened_;
 
+    /// Latest operation of the history, nullptr if there are no operations
+    std::shared_ptr<const detail::history_node> node_;
+
     /// @brief Friend operator to print out state of the class in human readable form.
     /// @param[inout] out Reference to the stream to write.
     /// @param[in] p Reference to the future instance to dump the state.
@@ -182,7 +243,7 @@ protected:
                 << "Frame" << std::endl;
         }
         out << detail::space(detail::INTENT, out, "History:") << std::endl;
-        for (auto it : p.history_) {
+        for (auto it : p.get_history()) {
             out << it << std::endl;
         }
         return out;
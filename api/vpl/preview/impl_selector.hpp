@@ -7,6 +7,9 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -19,6 +22,228 @@
 namespace oneapi {
 namespace vpl {
 
+namespace detail {
+
+/// @brief Loader configured with the properties together with the enumerated implementations.
+/// Object is shared by all sessions created from the same properties, loader is unloaded when
+/// the last session is destroyed.
+class shared_loader {
+public:
+    /// @brief Loads the dispatcher, applies properties and enumerates implementations.
+    /// @param[in] opts List of properties
+    /// @param[in] format Implementation capabilities report format
+    shared_loader(const std::vector<std::pair<std::string, variant>> &opts,
+                  mfxImplCapsDeliveryFormat format)
+            : loader_(MFXLoad()),
+              format_(format),
+              handles_(),
+              impls_(),
+              mtx_() {
+        if (!loader_)
+            throw base_exception(MFX_ERR_NOT_FOUND);
+
+        try {
+            // convert options to mfxConfig
+            std::for_each(opts.begin(), opts.end(), [&](auto opt) {
+                auto cfg = MFXCreateConfig(loader_);
+                [[maybe_unused]] c_api_invoker e(default_checker,
+                                                 MFXSetConfigFilterProperty,
+                                                 cfg,
+                                                 (const uint8_t *)opt.first.c_str(),
+                                                 opt.second.get_variant());
+            });
+
+            implementation_capabilities_factory factory;
+            for (uint32_t idx = 0;; idx++) {
+                void *h;
+                mfxStatus sts = MFXEnumImplementations(loader_, idx, format_, &h);
+                // break if no idx
+                if (sts == MFX_ERR_NOT_FOUND)
+                    break;
+                if (sts < 0)
+                    throw base_exception(sts);
+
+                // Descriptions stay valid while the capabilities objects are in use
+                handles_.push_back(h);
+                impls_.push_back(factory.create(format_, h));
+            }
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    shared_loader(const shared_loader &)            = delete;
+    shared_loader &operator=(const shared_loader &) = delete;
+
+    /// @brief Dtor. Releases implementation descriptions and unloads the dispatcher.
+    ~shared_loader() {
+        release();
+    }
+
+    /// @brief Returns capabilities of the implementations matching the properties.
+    /// @return Capabilities, position in the list is implementation index.
+    const std::vector<std::shared_ptr<base_implementation_capabilities>> &get_implementations()
+        const {
+        return impls_;
+    }
+
+    /// @brief Creates session on the implementation. Thread safe.
+    /// @param[in] idx Implementation index.
+    /// @return Session handle.
+    mfxSession create_session(uint32_t idx) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        mfxSession s;
+        c_api_invoker e(default_checker, MFXCreateSession, loader_, idx, &s);
+        return s;
+    }
+
+protected:
+    /// @brief Releases implementation descriptions and unloads the dispatcher.
+    void release() {
+        std::for_each(handles_.begin(), handles_.end(), [&](void *h) {
+            MFXDispReleaseImplDescription(loader_, h);
+        });
+        handles_.clear();
+        impls_.clear();
+        MFXUnload(loader_);
+    }
+
+    /// @brief Loader handle
+    mfxLoader loader_;
+    /// @brief Implementation capabilities report format
+    mfxImplCapsDeliveryFormat format_;
+    /// @brief Implementation description handles
+    std::vector<void *> handles_;
+    /// @brief Implementation capabilities
+    std::vector<std::shared_ptr<base_implementation_capabilities>> impls_;
+    /// @brief Serializes session creation
+    std::mutex mtx_;
+};
+
+} // namespace detail
+
+/// @brief Process-wide cache of the loaders. Sessions created with the same set of properties
+/// share the loader and the implementations enumerated once, so only MFXCreateSession is called
+/// for them. Cache holds weak references: loader is unloaded once the last session using it is
+/// destroyed. Properties with pointer values can't be compared, such sets bypass the cache.
+class loader_cache {
+public:
+    /// @brief Cache statistic
+    struct statistic {
+        /// Number of requests served by the cached loader
+        uint64_t hits;
+        /// Number of loaded loaders
+        uint64_t misses;
+    };
+
+    /// @brief Returns the cache instance.
+    /// @return Cache instance.
+    static loader_cache &instance() {
+        static loader_cache cache;
+        return cache;
+    }
+
+    loader_cache(const loader_cache &)            = delete;
+    loader_cache &operator=(const loader_cache &) = delete;
+
+    /// @brief Returns loader for the properties, loads it if there is no alive one.
+    /// @param[in] opts List of properties
+    /// @param[in] format Implementation capabilities report format
+    /// @return Loader.
+    std::shared_ptr<detail::shared_loader> get(
+        const std::vector<std::pair<std::string, detail::variant>> &opts,
+        mfxImplCapsDeliveryFormat format) {
+        std::string key;
+        if (!make_key(opts, format, key)) {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                stat_.misses++;
+            }
+            return std::make_shared<detail::shared_loader>(opts, format);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (auto it = loaders_.find(key); it != loaders_.end()) {
+            if (auto loader = it->second.lock()) {
+                stat_.hits++;
+                return loader;
+            }
+        }
+
+        // Forget the loaders unloaded already
+        for (auto it = loaders_.begin(); it != loaders_.end();) {
+            it = it->second.expired() ? loaders_.erase(it) : std::next(it);
+        }
+
+        auto loader   = std::make_shared<detail::shared_loader>(opts, format);
+        loaders_[key] = loader;
+        stat_.misses++;
+        return loader;
+    }
+
+    /// @brief Returns cache statistic.
+    /// @return Cache statistic.
+    statistic get_stat() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return stat_;
+    }
+
+protected:
+    /// @brief Default ctor
+    loader_cache() : loaders_(), stat_(), mtx_() {}
+
+    /// @brief Builds the cache key from the property values.
+    /// @param[in] opts List of properties
+    /// @param[in] format Implementation capabilities report format
+    /// @param[out] key Cache key
+    /// @return false if the properties can't be cached.
+    static bool make_key(const std::vector<std::pair<std::string, detail::variant>> &opts,
+                         mfxImplCapsDeliveryFormat format,
+                         std::string &key) {
+        key = std::to_string(format);
+        for (auto &opt : opts) {
+            mfxVariant v = opt.second.get_variant();
+            size_t size  = 0;
+            switch (v.Type) {
+                case MFX_VARIANT_TYPE_UNSET:
+                    break;
+                case MFX_VARIANT_TYPE_U8:
+                case MFX_VARIANT_TYPE_I8:
+                    size = 1;
+                    break;
+                case MFX_VARIANT_TYPE_U16:
+                case MFX_VARIANT_TYPE_I16:
+                    size = 2;
+                    break;
+                case MFX_VARIANT_TYPE_U32:
+                case MFX_VARIANT_TYPE_I32:
+                case MFX_VARIANT_TYPE_F32:
+                    size = 4;
+                    break;
+                case MFX_VARIANT_TYPE_U64:
+                case MFX_VARIANT_TYPE_I64:
+                case MFX_VARIANT_TYPE_F64:
+                    size = 8;
+                    break;
+                default:
+                    return false;
+            }
+            key += '\n' + opt.first + '=' + std::to_string(v.Type) + ':';
+            key.append(reinterpret_cast<const char *>(&v.Data), size);
+        }
+        return true;
+    }
+
+    /// @brief Loaders by the cache key
+    std::unordered_map<std::string, std::weak_ptr<detail::shared_loader>> loaders_;
+    /// @brief Cache statistic
+    statistic stat_;
+    /// @brief Guards the cache
+    mutable std::mutex mtx_;
+};
+
 /// @brief Selects oneVPL implementation according to the specified properties.
 /// @details This object iterates over the available implementations and selects an appropriate one
 /// based on the @p list of properties. API user can create an instance of that class. If user
@@ -38,50 +263,20 @@ public:
     virtual ~implementation_selector() {}
 
     /// @brief Creates session which has the requested properties. Session class object calls
-    /// this method at the ctor and takes care on deletion of loader and session handles.
-    /// @return Pair of loader handle and associated session handle.
+    /// this method at the ctor and keeps the loader until its deletion. Loader and the enumerated
+    /// implementations come from the loader_cache.
+    /// @return Pair of shared loader and associated session handle.
     auto session() const {
-        mfxStatus sts;
-        implementation_capabilities_factory factory;
-        auto loader = MFXLoad();
-
-        // convert options to mfxConfig
-        auto opts = get_properties();
-
-        std::for_each(opts.begin(), opts.end(), [&](auto opt) {
-            auto cfg = MFXCreateConfig(loader);
-            [[maybe_unused]] detail::c_api_invoker e(detail::default_checker,
-                                    MFXSetConfigFilterProperty,
-                                    cfg,
-                                    (const uint8_t *)opt.first.c_str(),
-                                    opt.second.get_variant());
-        });
-
-        uint32_t idx = 0;
-        while (true) {
-            void *h;
-            sts = MFXEnumImplementations(loader, idx, format_, &h);
-
-            std::shared_ptr<void> handle(h, [&] (void *p) {
-                MFXDispReleaseImplDescription(loader, p);
-            });
-
-            // break if no idx
-            if (sts == MFX_ERR_NOT_FOUND)
-                break;
-            if (sts < 0)
-                throw base_exception(sts);
-
-            std::shared_ptr<base_implementation_capabilities> caps = factory.create(format_, h);
+        std::shared_ptr<detail::shared_loader> loader =
+            loader_cache::instance().get(get_properties(), format_);
 
-            if (this->operator()(caps)) {
-                mfxSession s;
-                detail::c_api_invoker e(detail::default_checker, MFXCreateSession, loader, idx, &s);
+        const auto &impls = loader->get_implementations();
+        for (uint32_t idx = 0; idx < impls.size(); idx++) {
+            if (this->operator()(impls[idx])) {
+                mfxSession s = loader->create_session(idx);
                 return std::pair(loader, s);
             }
-            idx++;
         }
-        MFXUnload(loader);
         throw base_exception(MFX_ERR_NOT_INITIALIZED);
     }
 
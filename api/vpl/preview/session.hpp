@@ -79,7 +79,7 @@ public:
     virtual ~session() {
         c_api_callable_.close(session_);
         MFXClose(session_);
-        MFXUnload(loader_);
+        loader_.reset();
         free_accelerator_handle();
     }
 
@@ -270,7 +270,8 @@ protected:
     }
 
 private:
-    mfxLoader loader_;
+    /// @brief Loader shared with other sessions created from the same properties.
+    std::shared_ptr<detail::shared_loader> loader_;
 };
 
 /// @brief Manages decoder's sessions.
@@ -486,7 +487,8 @@ public:
     /// @param[in] sel Implementation selector
     explicit encode_session(const implementation_selector &sel)
             : session(sel, detail::CAPI<>::Encoder),
-              rdr_(nullptr) {
+              rdr_(nullptr),
+              bs_pool_(nullptr) {
         component_ = component::encoder;
     }
 
@@ -495,13 +497,62 @@ public:
     /// @param[in] rdr Pointer to the raw frame reader
     encode_session(const implementation_selector &sel, frame_source_reader *rdr)
             : session(sel, detail::CAPI<>::Encoder),
-              rdr_(rdr) {
+              rdr_(rdr),
+              bs_pool_(nullptr) {
         component_ = component::encoder;
     }
 
     /// @brief Dtor
     ~encode_session() {}
 
+    /// @brief Resets the session by using provided parameters. Bitstream pool is resized to the new
+    /// buffer size.
+    /// @param[in] par Reset parameters
+    /// @param[in] list List of extension buffers.
+    /// @return Status of the reset.
+    status Reset(encoder_video_param *par, encoder_reset_list list) {
+        status sts = session::Reset(par, list);
+        if (bs_pool_)
+            bs_pool_->set_buffer_size(working_buffer_size());
+        return sts;
+    }
+
+    /// @brief Returns bitstream from the session's pool. Pool is created on the first call and
+    /// sized from BufferSizeInKB of the encoder's working params, so the session must be
+    /// initialized. Bitstream returns to the pool once the last reference to it is released.
+    /// @return Shared pointer to the bitstream with empty data.
+    std::shared_ptr<bitstream_as_dst> alloc_output() {
+        if (!bs_pool_) {
+            std::shared_ptr<encoder_video_param> par = working_params();
+            bs_pool_ = std::make_shared<bitstream_pool>(par->get_CodecId(), working_buffer_size());
+        }
+        return bs_pool_->acquire();
+    }
+
+    /// @brief Maximum number of times the output buffer is doubled for one frame
+    static constexpr uint32_t max_output_grow_steps = 8;
+
+    /// @brief Doubles the output buffer after NotEnoughBuffer, so the same surface can be
+    /// submitted again. The encoder which still reports NotEnoughBuffer after
+    /// max_output_grow_steps doublings, or once the size reaches 32 bit limit, fails the frame.
+    /// @param[in] bs Output bitstream.
+    /// @param[in,out] steps Number of doublings done for the current frame.
+    /// @return true if the buffer was grown.
+    static bool grow_output(bitstream_as_dst &bs, uint32_t &steps) {
+        if (steps >= max_output_grow_steps ||
+            bs.get_max_buffer_length() > std::numeric_limits<uint32_t>::max() / 2)
+            return false;
+        bs.realloc(bs.get_max_buffer_length());
+        steps++;
+        return true;
+    }
+
+    /// @brief Returns session's bitstream pool statistic.
+    /// @return Bitstream pool statistic.
+    bitstream_pool::statistic get_bitstream_pool_stat() const {
+        return bs_pool_ ? bs_pool_->get_stat() : bitstream_pool::statistic{};
+    }
+
     /// @brief Allocate and return shared pointer to the surface
     /// @todo temporary method
     /// @return Shared pointer to the allocated surface
@@ -623,7 +674,7 @@ public:
                 case status::NotEnoughData:
                     break;
                 case status::NotEnoughBuffer: {
-                    bs->realloc();
+                    bs->realloc(bs->get_max_buffer_length());
                     // Assume that frame was cached so we need to increase buffer size only and send new frame to enc
                     break;
                 }
@@ -644,7 +695,6 @@ public:
     std::shared_ptr<future_bitstream_t> process(std::shared_ptr<future_surface_t> in_future,
                                                 encoder_process_list list = {}) {
         std::shared_ptr<bitstream_as_dst> bits;
-        std::shared_ptr<future_bitstream_t> f_out = std::make_shared<future_bitstream_t>(nullptr);
         operation_status op(component_, this);
 
         /// @todo add smart wait with status propagation
@@ -660,14 +710,21 @@ public:
                     try {
                         status schedule_status;
 
-                        bits            = std::make_shared<bitstream_as_dst>();
+                        uint32_t grow_steps = 0;
+
+                        bits            = alloc_output();
                         schedule_status = encode_frame(in_surface, bits, list);
-                        f_out           = std::make_shared<future_bitstream_t>(bits);
-                        f_out.reset(new future_bitstream_t(bits));
+                        // Buffer grows geometrically, the same surface is submitted again
+                        while (schedule_status == status::NotEnoughBuffer &&
+                               grow_output(*bits, grow_steps)) {
+                            schedule_status = encode_frame(in_surface, bits, list);
+                        }
                         op.schedule_status_ = schedule_status;
+                        op.fatal_           = (schedule_status == status::NotEnoughBuffer);
                     }
                     catch (base_exception &e) {
                         std::cout << "encoder gonna die" << std::endl << std::flush;
+                        bits.reset();
                         op.schedule_status_ = mfxstatus_to_onevplstatus(e.get_status());
                         op.fatal_           = true;
                     }
@@ -678,8 +735,10 @@ public:
             }
         }
 
-        f_out->add_operation(op);
+        // Single allocation per stage, the history adds one node to the chain of in_future
+        std::shared_ptr<future_bitstream_t> f_out = std::make_shared<future_bitstream_t>(bits);
         f_out->propagate_history(*(in_future.get()));
+        f_out->add_operation(op);
         return f_out;
     }
 
@@ -696,8 +755,21 @@ public:
     }
 
 protected:
+    /// @brief Returns output buffer size required by the encoder's working params.
+    /// @return Buffer size in bytes.
+    uint32_t working_buffer_size() {
+        std::shared_ptr<encoder_video_param> par = working_params();
+        uint64_t multiplier = std::max<uint64_t>(par->get_BRCParamMultiplier(), 1);
+        uint64_t size       = par->get_BufferSizeInKB() * multiplier * 1000;
+        if (!size)
+            return bitstream::buffer_len::DEFAULT_LENGHT;
+        return (uint32_t)std::min<uint64_t>(size, std::numeric_limits<uint32_t>::max());
+    }
+
     /// @brief Raw freames reader
     frame_source_reader *rdr_;
+    /// @brief Pool of output bitstreams
+    std::shared_ptr<bitstream_pool> bs_pool_;
 };
 
 /// @brief Manages VPP's sessions.
@@ -861,7 +933,6 @@ public:
     /// @return Future object with the surface.
     std::shared_ptr<future_surface_t> process(std::shared_ptr<future_surface_t> in_future) {
         std::shared_ptr<frame_surface> surface;
-        std::shared_ptr<future_surface_t> f_out = std::make_shared<future_surface_t>(nullptr);
         operation_status op(component_, this);
 
         /// @todo add smart wait with status propagation
@@ -876,11 +947,11 @@ public:
                 case status::EndOfStreamReached: {
                     try {
                         status schedule_status;
-                        schedule_status = process_frame(in_surface, surface);
-                        f_out.reset(new future_surface_t(surface));
+                        schedule_status     = process_frame(in_surface, surface);
                         op.schedule_status_ = schedule_status;
                     }
                     catch (base_exception &e) {
+                        surface.reset();
                         op.schedule_status_ = mfxstatus_to_onevplstatus(e.get_status());
                         op.fatal_           = true;
                     }
@@ -891,8 +962,9 @@ public:
             }
         }
 
-        f_out->add_operation(op);
+        std::shared_ptr<future_surface_t> f_out = std::make_shared<future_surface_t>(surface);
         f_out->propagate_history(*(in_future.get()));
+        f_out->add_operation(op);
 
         return f_out;
     }
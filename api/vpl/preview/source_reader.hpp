@@ -6,10 +6,16 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "vpl/preview/bitstream.hpp"
 #include "vpl/preview/defs.hpp"
@@ -48,70 +54,233 @@ public:
     virtual bool get_data(std::shared_ptr<frame_surface> frame) = 0;
 };
 
-/// @brief File based reader of uncomressed frames
-class raw_frame_file_reader : public frame_source_reader {
+namespace detail {
+
+/// @brief Layout of the uncompressed frame in a raw file: planes follow each other and rows of
+/// the planes have no padding.
+class raw_frame_layout {
+public:
+    /// @brief Maximum number of planes of the supported formats
+    static constexpr uint32_t max_planes = 3;
+
+    /// @brief Planes of the mapped surface
+    struct planes {
+        /// Pointers to the first row of the planes
+        uint8_t* ptr[max_planes];
+        /// Distance between the rows of the planes in bytes
+        uint32_t pitch[max_planes];
+    };
+
+    /// @brief Constructs layout of the frame
+    /// @param[in] width Width of the frame.
+    /// @param[in] height Height of the frame.
+    /// @param[in] format Color format of the frame: I420, I010, NV12, P010, YUY2 or BGRA.
+    raw_frame_layout(uint16_t width, uint16_t height, color_format_fourcc format)
+            : format_(format),
+              count_(0),
+              row_(),
+              rows_() {
+        uint32_t w  = width;
+        uint32_t h  = height;
+        uint32_t cw = (w + 1) / 2;
+        uint32_t ch = (h + 1) / 2;
+
+        switch (format) {
+            case color_format_fourcc::i420:
+                add_plane(w, h);
+                add_plane(cw, ch);
+                add_plane(cw, ch);
+                break;
+            case color_format_fourcc::i010:
+                add_plane(w * 2, h);
+                add_plane(cw * 2, ch);
+                add_plane(cw * 2, ch);
+                break;
+            case color_format_fourcc::nv12:
+                add_plane(w, h);
+                add_plane(cw * 2, ch);
+                break;
+            case color_format_fourcc::p010:
+                add_plane(w * 2, h);
+                add_plane(cw * 4, ch);
+                break;
+            case color_format_fourcc::yuy2:
+                add_plane(cw * 4, h);
+                break;
+            case color_format_fourcc::bgra:
+                add_plane(w * 4, h);
+                break;
+            default:
+                throw base_exception("raw_frame_layout unsupported format",
+                                     MFX_ERR_NOT_IMPLEMENTED);
+        }
+    }
+
+    /// @brief Returns number of planes
+    /// @return Number of planes
+    uint32_t get_planes_count() const {
+        return count_;
+    }
+
+    /// @brief Returns size of the plane in the file
+    /// @param[in] idx Index of the plane
+    /// @return Size of the plane in bytes
+    size_t get_plane_size(uint32_t idx) const {
+        return static_cast<size_t>(row_[idx]) * rows_[idx];
+    }
+
+    /// @brief Returns size of the frame in the file
+    /// @return Size of the frame in bytes
+    size_t get_frame_size() const {
+        size_t size = 0;
+        for (uint32_t i = 0; i < count_; i++)
+            size += get_plane_size(i);
+        return size;
+    }
+
+    /// @brief Returns planes of the mapped surface
+    /// @param[in] data Data of the mapped surface
+    /// @return Pointers and pitches of the planes
+    planes get_planes(const frame_data& data) const {
+        planes p       = {};
+        uint32_t pitch = data.get_pitch();
+
+        switch (format_) {
+            case color_format_fourcc::i420:
+            case color_format_fourcc::i010: {
+                auto [Y, U, V] = data.get_plane_ptrs_3();
+                p              = { { Y, U, V }, { pitch, pitch / 2, pitch / 2 } };
+                break;
+            }
+            case color_format_fourcc::nv12:
+            case color_format_fourcc::p010: {
+                auto [Y, UV] = data.get_plane_ptrs_2();
+                p            = { { Y, UV, nullptr }, { pitch, pitch, 0 } };
+                break;
+            }
+            case color_format_fourcc::yuy2:
+                p = { { data.get_plane_ptrs_1(), nullptr, nullptr }, { pitch, 0, 0 } };
+                break;
+            default: // bgra
+                p = { { data.get_plane_ptrs_1_BGRA(), nullptr, nullptr }, { pitch, 0, 0 } };
+                break;
+        }
+        return p;
+    }
+
+    /// @brief Checks that rows of the surface's planes have no padding, so planes can be read
+    /// directly from the file.
+    /// @param[in] p Planes of the mapped surface
+    /// @return True if pitch of every plane equals its row size
+    bool is_packed(const planes& p) const {
+        for (uint32_t i = 0; i < count_; i++) {
+            if (p.pitch[i] != row_[i])
+                return false;
+        }
+        return true;
+    }
+
+    /// @brief Copies the frame in the file layout into the surface's planes. Planes without
+    /// padding are copied at once, others row by row.
+    /// @param[in] src Pointer to the frame in the file layout
+    /// @param[in] dst Planes of the mapped surface
+    void scatter(const uint8_t* src, const planes& dst) const {
+        for (uint32_t i = 0; i < count_; i++) {
+            scatter_plane(i, src, dst);
+            src += get_plane_size(i);
+        }
+    }
+
+    /// @brief Copies one plane in the file layout into the surface's plane.
+    /// @param[in] idx Index of the plane
+    /// @param[in] src Pointer to the plane in the file layout
+    /// @param[in] dst Planes of the mapped surface
+    void scatter_plane(uint32_t idx, const uint8_t* src, const planes& dst) const {
+        if (dst.pitch[idx] == row_[idx]) {
+            std::memcpy(dst.ptr[idx], src, get_plane_size(idx));
+            return;
+        }
+        uint8_t* ptr = dst.ptr[idx];
+        for (uint32_t r = 0; r < rows_[idx]; r++) {
+            std::memcpy(ptr, src, row_[idx]);
+            ptr += dst.pitch[idx];
+            src += row_[idx];
+        }
+    }
+
+protected:
+    /// @brief Appends plane to the layout
+    /// @param[in] row Size of the plane's row in bytes
+    /// @param[in] rows Number of rows
+    void add_plane(uint32_t row, uint32_t rows) {
+        row_[count_]  = row;
+        rows_[count_] = rows;
+        count_++;
+    }
+
+    /// @brief Color format of frame.
+    color_format_fourcc format_;
+    /// @brief Number of planes.
+    uint32_t count_;
+    /// @brief Row sizes of the planes in bytes.
+    uint32_t row_[max_planes];
+    /// @brief Numbers of rows of the planes.
+    uint32_t rows_[max_planes];
+};
+
+} // namespace detail
+
+/// @brief Stream based reader of uncomressed frames. When rows of the surface have no padding
+/// the frame is read directly into the mapped surface, by one call for the planes which follow
+/// each other in memory. Otherwise the frame is read by one call into the staging buffer and
+/// scattered into the rows of the surface.
+class raw_frame_stream_reader : public frame_source_reader {
 public:
     /// @brief Default ctor
     /// @param[in] width Width of the frames.
     /// @param[in] heigth Heigh of the frames.
-    /// @param[in] format Color format of the frames.
-    /// @param[in] ifl Input stream to read from.
-    raw_frame_file_reader(uint16_t width,
-                          uint16_t heigth,
-                          color_format_fourcc format,
-                          std::ifstream& ifl)
+    /// @param[in] format Color format of the frames: I420, I010, NV12, P010, YUY2 or BGRA.
+    /// @param[in] is Input stream to read from.
+    raw_frame_stream_reader(uint16_t width,
+                            uint16_t heigth,
+                            color_format_fourcc format,
+                            std::istream& is)
             : frame_source_reader(),
               width_(width),
               heigth_(heigth),
               format_(format),
-              ifl_(ifl),
+              layout_(width, heigth, format),
+              is_(is),
+              staging_(),
               eof_(false) {}
 
     /// @brief Default dtor
-    virtual ~raw_frame_file_reader() {}
+    virtual ~raw_frame_stream_reader() {}
 
     /// @brief Read and store portion of data into the @p bitstream object
     /// @param[out] frame data storage
     /// @return True if data was read
     virtual bool get_data(std::shared_ptr<frame_surface> frame) {
-        auto data = frame->map_data(memory_access::write);
-
-        /// @todo verify buffer availability
-
-        uint32_t pitch = 0;
-        switch (format_) {
-            case oneapi::vpl::color_format_fourcc::i420: {
-                pitch = data.get_pitch();
-                auto [Y, U, V] = data.get_plane_ptrs_3();
-
-                // read luminance plane (Y)
-                read_blob(Y, pitch, width_, heigth_);
-
-                // read chrominance (U, V)
-                read_blob(U, pitch / 2, width_ / 2, heigth_ / 2);
-                read_blob(V, pitch / 2, width_ / 2, heigth_ / 2);
-                break;
-            }
-            case oneapi::vpl::color_format_fourcc::nv12: {
-                pitch = data.get_pitch();
-                auto [Y, UV]   = data.get_plane_ptrs_2();
-
-                // read luminance plane (Y)
-                read_blob(Y, pitch, width_, heigth_);
-
-                // read chrominance (UV)
-                read_blob(UV, pitch, width_, heigth_ / 2);
-                break;
+        auto data   = frame->map_data(memory_access::write);
+        auto planes = layout_.get_planes(data);
+
+        if (layout_.is_packed(planes)) {
+            uint32_t count = layout_.get_planes_count();
+            for (uint32_t i = 0; i < count;) {
+                uint8_t* ptr = planes.ptr[i];
+                size_t size  = 0;
+                do {
+                    size += layout_.get_plane_size(i);
+                    i++;
+                } while (i < count && planes.ptr[i] == ptr + size);
+                read_blob(ptr, size);
             }
-            case oneapi::vpl::color_format_fourcc::bgra: {
-                pitch    = data.get_pitch();
-                auto B = data.get_plane_ptrs_1_BGRA();
-
-                read_blob(B, pitch, width_ * 4, heigth_);
-            }
-            default:
-                throw base_exception("raw_frame_file_reader unsupported format",
-                                     MFX_ERR_NOT_IMPLEMENTED);
+        }
+        else {
+            staging_.resize(layout_.get_frame_size());
+            read_blob(staging_.data(), staging_.size());
+            if (!eof_)
+                layout_.scatter(staging_.data(), planes);
         }
         frame->unmap();
         return !eof_;
@@ -126,15 +295,11 @@ public:
 protected:
     /// @brief Read continuous chunk of data from the stream
     /// @param[in] ptr Pointer to the buffer to store the data
-    /// @param[in] pitch Pitch in the buffer
-    /// @param[in] b_width Width of the blob
-    /// @param[in] b_height Height of the blob
-    void read_blob(uint8_t* ptr, uint32_t pitch, uint16_t b_width, uint16_t b_height) {
-        for (uint16_t i = 0; i < b_height; i++) {
-            ifl_.read(reinterpret_cast<char*>(ptr + i * pitch), b_width);
-            if (ifl_.gcount() != b_width)
-                eof_ = true;
-        }
+    /// @param[in] size Size of the chunk
+    void read_blob(uint8_t* ptr, size_t size) {
+        is_.read(reinterpret_cast<char*>(ptr), size);
+        if (static_cast<size_t>(is_.gcount()) != size)
+            eof_ = true;
     }
     /// @brief Width of frame.
     uint16_t width_;
@@ -142,29 +307,49 @@ protected:
     uint16_t heigth_;
     /// @brief Color format of frame.
     color_format_fourcc format_;
-    /// @brief File handle.
-    std::ifstream& ifl_;
+    /// @brief Layout of frame in the stream.
+    detail::raw_frame_layout layout_;
+    /// @brief Input stream.
+    std::istream& is_;
+    /// @brief Frame read from the stream if the surface has padding.
+    std::vector<uint8_t> staging_;
     /// @brief End of stream flag.
     bool eof_;
 };
 
-/// @brief File based reder of uncomressed frames
-class raw_frame_file_reader_by_name : public frame_source_reader {
+/// @brief File based reader of uncomressed frames
+class raw_frame_file_reader : public raw_frame_stream_reader {
 public:
     /// @brief Default ctor
     /// @param[in] width Width of the frames.
     /// @param[in] heigth Heigh of the frames.
     /// @param[in] format Color format of the frames.
     /// @param[in] ifl Input stream to read from.
+    raw_frame_file_reader(uint16_t width,
+                          uint16_t heigth,
+                          color_format_fourcc format,
+                          std::ifstream& ifl)
+            : raw_frame_stream_reader(width, heigth, format, ifl) {}
+
+    /// @brief Default dtor
+    virtual ~raw_frame_file_reader() {}
+};
+
+/// @brief File based reder of uncomressed frames
+class raw_frame_file_reader_by_name : public raw_frame_stream_reader {
+public:
+    /// @brief Default ctor
+    /// @param[in] width Width of the frames.
+    /// @param[in] heigth Heigh of the frames.
+    /// @param[in] format Color format of the frames.
+    /// @param[in] name Name of the file to read from.
     raw_frame_file_reader_by_name(uint16_t width,
                                   uint16_t heigth,
                                   color_format_fourcc format,
                                   const std::string& name)
-            : frame_source_reader(),
-              width_(width),
-              heigth_(heigth),
-              format_(format),
-              eof_(false) {
+            // base class keeps reference to if_, it isn't used until the file is opened
+            : raw_frame_stream_reader(width, heigth, format, if_),
+              if_() {
         if_.open(name, std::ios_base::in | std::ios_base::binary);
         if (!if_) {
             throw file_exception(std::string("Couldn't open ") + name);
@@ -177,83 +362,188 @@ public:
     /// @brief Default dtor
     virtual ~raw_frame_file_reader_by_name() {}
 
-    /// @brief Read and store portion of data into the @p bitstream object
-    /// @param[out] frame data storage
-    /// @return True if data was read
-    virtual bool get_data(std::shared_ptr<frame_surface> frame) {
-        auto data = frame->map_data(memory_access::write);
+protected:
+    /// @brief File handle
+    std::ifstream if_;
+};
 
-        /// @todo verify buffer avialability
-        uint32_t pitch = 0;
-        switch (format_) {
-            case oneapi::vpl::color_format_fourcc::i420: {
-                pitch = data.get_pitch();
-                auto [Y, U, V] = data.get_plane_ptrs_3();
+/// @brief File based reader of uncomressed frames which reads ahead on the background thread.
+/// Up to @p depth frames are kept in memory, so get_data() waits for the file only if frames
+/// are consumed faster than they are read.
+class raw_frame_file_prefetch_reader : public frame_source_reader {
+public:
+    /// @brief Reader statistic
+    struct statistic {
+        /// Number of frames returned by get_data()
+        uint64_t frames;
+        /// Number of get_data() calls which waited for the file read
+        uint64_t waits;
+    };
+
+    /// @brief Default ctor. Starts the background read.
+    /// @param[in] width Width of the frames.
+    /// @param[in] heigth Heigh of the frames.
+    /// @param[in] format Color format of the frames: I420, I010, NV12, P010, YUY2 or BGRA.
+    /// @param[in] name Name of the file to read from.
+    /// @param[in] depth Number of frames to read ahead.
+    raw_frame_file_prefetch_reader(uint16_t width,
+                                   uint16_t heigth,
+                                   color_format_fourcc format,
+                                   const std::string& name,
+                                   uint32_t depth = 4)
+            : frame_source_reader(),
+              layout_(width, heigth, format),
+              if_(),
+              free_(),
+              ready_(),
+              stat_(),
+              read_done_(false),
+              stop_(false),
+              eof_(false),
+              mtx_(),
+              cv_(),
+              thread_() {
+        if (!depth)
+            throw base_exception("raw_frame_file_prefetch_reader zero depth",
+                                 MFX_ERR_INVALID_VIDEO_PARAM);
 
-                // read luminance plane (Y)
-                read_blob(Y, pitch, width_, heigth_);
+        if_.open(name, std::ios_base::in | std::ios_base::binary);
+        if (!if_) {
+            throw file_exception(std::string("Couldn't open ") + name);
+        }
+        if (if_.fail()) {
+            throw file_exception(std::string("Error opening ") + name);
+        }
 
-                // read chrominance (U, V)
-                read_blob(U, pitch / 2, width_ / 2, heigth_ / 2);
-                read_blob(V, pitch / 2, width_ / 2, heigth_ / 2);
-                break;
-            }
-            case oneapi::vpl::color_format_fourcc::nv12: {
-                pitch = data.get_pitch();
-                auto [Y, UV]   = data.get_plane_ptrs_2();
+        for (uint32_t i = 0; i < depth; i++)
+            free_.emplace_back(layout_.get_frame_size());
+        thread_ = std::thread(&raw_frame_file_prefetch_reader::prefetch, this);
+    }
 
-                // read luminance plane (Y)
-                read_blob(Y, pitch, width_, heigth_);
+    raw_frame_file_prefetch_reader(const raw_frame_file_prefetch_reader&)            = delete;
+    raw_frame_file_prefetch_reader& operator=(const raw_frame_file_prefetch_reader&) = delete;
 
-                // read chrominance (UV)
-                read_blob(UV, pitch, width_, heigth_ / 2);
-                break;
-            }
-            case oneapi::vpl::color_format_fourcc::bgra: {
-                pitch    = data.get_pitch();
-                auto B = data.get_plane_ptrs_1_BGRA();
+    /// @brief Dtor. Stops the background read.
+    virtual ~raw_frame_file_prefetch_reader() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
 
-                read_blob(B, pitch, width_ * 4, heigth_);
+    /// @brief Read and store portion of data into the @p bitstream object
+    /// @param[out] frame data storage
+    /// @return True if data was read
+    virtual bool get_data(std::shared_ptr<frame_surface> frame) {
+        std::vector<uint8_t> buffer;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (ready_.empty() && !read_done_)
+                stat_.waits++;
+            cv_.wait(lock, [this] {
+                return !ready_.empty() || read_done_;
+            });
+            if (ready_.empty()) {
+                eof_ = true;
+                return false;
             }
-            default:
-                throw base_exception("raw_frame_file_reader_by_name unsupported format",
-                                     MFX_ERR_NOT_IMPLEMENTED);
+            buffer = std::move(ready_.front());
+            ready_.pop_front();
         }
+
+        auto data = frame->map_data(memory_access::write);
+        layout_.scatter(buffer.data(), layout_.get_planes(data));
         frame->unmap();
-        return !eof_;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            free_.push_back(std::move(buffer));
+            stat_.frames++;
+        }
+        cv_.notify_all();
+        return true;
     }
 
     /// @brief Checks and retrieve end of stream status
     /// @return True if EOS reached
     bool is_EOS() const {
+        std::lock_guard<std::mutex> lock(mtx_);
         return eof_;
     }
 
+    /// @brief Returns reader statistic
+    /// @return Reader statistic
+    statistic get_stat() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return stat_;
+    }
+
 protected:
-    /// @brief Reads continiouse chunk of data from the stream
-    /// @param[in] ptr Pointer to the buffere to store the data
-    /// @param[in] pitch Pitch in the buffer
-    /// @param[in] b_width Width of the blob
-    /// @param[in] b_height Height of the blob
-    void read_blob(uint8_t* ptr, uint32_t pitch, uint16_t b_width, uint16_t b_height) {
-        for (uint16_t i = 0; i < b_height; i++) {
-            if_.read(reinterpret_cast<char*>(ptr + i * pitch), b_width);
-            if (if_.gcount() != b_width)
-                eof_ = true;
+    /// @brief Background thread: reads frames into the free buffers until end of file
+    void prefetch() {
+        while (1) {
+            std::vector<uint8_t> buffer;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] {
+                    return stop_ || !free_.empty();
+                });
+                if (stop_)
+                    return;
+                buffer = std::move(free_.front());
+                free_.pop_front();
+            }
+
+            if_.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+            bool full = static_cast<size_t>(if_.gcount()) == buffer.size();
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (full)
+                    ready_.push_back(std::move(buffer));
+                else
+                    read_done_ = true;
+            }
+            cv_.notify_all();
+            if (!full)
+                return;
         }
     }
-    /// @brief Width of frame.
-    uint16_t width_;
-    /// @brief Height of frame.
-    uint16_t heigth_;
-    /// @brief Color format of frame.
-    color_format_fourcc format_;
-    /// @brief File handle
+
+    /// @brief Layout of frame in the file.
+    detail::raw_frame_layout layout_;
+    /// @brief File handle, used by the background thread only.
     std::ifstream if_;
+    /// @brief Buffers to read frames into.
+    std::deque<std::vector<uint8_t>> free_;
+    /// @brief Frames read from the file in the order of reading.
+    std::deque<std::vector<uint8_t>> ready_;
+    /// @brief Reader statistic.
+    statistic stat_;
+    /// @brief True if the background thread reached end of file.
+    bool read_done_;
+    /// @brief Request to stop the background thread.
+    bool stop_;
     /// @brief End of stream flag.
     bool eof_;
+    /// @brief Protects the state shared with the background thread.
+    mutable std::mutex mtx_;
+    /// @brief Signals changes of the shared state.
+    std::condition_variable cv_;
+    /// @brief Background thread.
+    std::thread thread_;
 };
 
+inline std::ostream& operator<<(std::ostream& out,
+                                const raw_frame_file_prefetch_reader::statistic& s) {
+    out << detail::space(detail::INTENT, out, "Frames = ") << s.frames << std::endl;
+    out << detail::space(detail::INTENT, out, "Waits  = ") << s.waits << std::endl;
+
+    return out;
+}
+
 /// @brief Interface for the bitstream source data reader
 class bitstream_source_reader : public source_reader {
 public:
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "vpl/preview/bitstream.hpp"
+#include "vpl/preview/coroutine.hpp"
 #include "vpl/preview/defs.hpp"
 #include "vpl/preview/exception.hpp"
 #include "vpl/preview/extension_buffer.hpp"
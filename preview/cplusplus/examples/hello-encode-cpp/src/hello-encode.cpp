@@ -132,7 +132,7 @@ int main(int argc, char *argv[]) {
     while (is_stillgoing == true) {
         vpl::status wrn = vpl::status::Ok;
 
-        std::shared_ptr<vpl::bitstream_as_dst> b = std::make_shared<vpl::bitstream_as_dst>();
+        std::shared_ptr<vpl::bitstream_as_dst> b = encoder->alloc_output();
         try {
             wrn = encoder->encode_frame(b);
         }
@@ -167,6 +167,9 @@ int main(int argc, char *argv[]) {
 
     std::cout << "Encoded " << frame_num << " frames" << std::endl;
 
+    std::cout << "\n-- Bitstream pool --\n\n";
+    std::cout << encoder->get_bitstream_pool_stat() << std::endl;
+
     std::cout << "\n-- Encode information --\n\n";
     std::shared_ptr<vpl::encoder_video_param> p = encoder->working_params();
     std::cout << *(p.get()) << std::endl;
@@ -0,0 +1,142 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Measures construction time of many sessions alive at the same time: the
+/// loader per session way of the C API versus sessions of the C++ API which
+/// share the loader through oneapi::vpl::loader_cache.
+///
+/// @file
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vpl/preview/vpl.hpp"
+
+#include "vpl/mfxdispatcher.h"
+
+namespace vpl = oneapi::vpl;
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ElapsedMs(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static void Usage() {
+    std::cout << "Usage: bench-session-cpp [options]\n";
+    std::cout << "   -n <num> ......... number of sessions (default 30)\n";
+    std::cout << "   -sw .............. select software implementation\n";
+    std::cout << "   -hw .............. select hardware implementation\n";
+}
+
+// What every session did before the cache: own loader, configuration and full
+// enumeration with the capabilities query
+static mfxSession CreateUncached(
+    const std::vector<std::pair<std::string, vpl::detail::variant>> &opts,
+    mfxLoader &loader) {
+    loader = MFXLoad();
+    if (!loader)
+        return nullptr;
+
+    for (auto &opt : opts) {
+        mfxConfig cfg = MFXCreateConfig(loader);
+        MFXSetConfigFilterProperty(cfg, (const mfxU8 *)opt.first.c_str(), opt.second.get_variant());
+    }
+
+    uint32_t idx = 0;
+    mfxHDL h     = nullptr;
+    while (MFXEnumImplementations(loader, idx, MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &h) ==
+           MFX_ERR_NONE) {
+        MFXDispReleaseImplDescription(loader, h);
+        idx++;
+    }
+
+    mfxSession session = nullptr;
+    if (!idx || MFXCreateSession(loader, 0, &session) != MFX_ERR_NONE)
+        return nullptr;
+    return session;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t num = 30;
+    vpl::properties opts;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-n" && i + 1 < argc) {
+            num = std::stoul(argv[++i]);
+        }
+        else if (arg == "-sw") {
+            opts.impl = vpl::implementation_type::sw;
+        }
+        else if (arg == "-hw") {
+            opts.impl = vpl::implementation_type::hw;
+        }
+        else {
+            Usage();
+            return -1;
+        }
+    }
+    if (!num) {
+        Usage();
+        return -1;
+    }
+
+    vpl::default_selector impl_sel(opts);
+    auto props = opts.get_properties();
+
+    // C API, loader per session
+    std::vector<std::pair<mfxLoader, mfxSession>> raw(num, { nullptr, nullptr });
+    auto start = bench_clock::now();
+    for (auto &r : raw) {
+        r.second = CreateUncached(props, r.first);
+        if (!r.second) {
+            std::cout << "Session creation failed, no implementation found" << std::endl;
+            return -1;
+        }
+    }
+    double raw_ms = ElapsedMs(start);
+    for (auto &r : raw) {
+        MFXClose(r.second);
+        MFXUnload(r.first);
+    }
+
+    // C++ API, shared loader
+    std::vector<std::unique_ptr<vpl::encode_session>> sessions;
+    double first_ms = 0;
+    start           = bench_clock::now();
+    try {
+        for (uint32_t i = 0; i < num; i++) {
+            auto session_start = bench_clock::now();
+            sessions.push_back(std::make_unique<vpl::encode_session>(impl_sel));
+            if (!i)
+                first_ms = ElapsedMs(session_start);
+        }
+    }
+    catch (vpl::base_exception &e) {
+        std::cout << "Session creation failed: " << e.what() << std::endl;
+        return -1;
+    }
+    double cached_ms = ElapsedMs(start);
+    auto stat        = vpl::loader_cache::instance().get_stat();
+
+    std::cout << "Sessions:                    " << num << std::endl;
+    std::cout << "Loader per session, total:   " << raw_ms << " ms, " << raw_ms / num
+              << " ms per session" << std::endl;
+    std::cout << "Shared loader, total:        " << cached_ms << " ms, " << cached_ms / num
+              << " ms per session" << std::endl;
+    std::cout << "Shared loader, first:        " << first_ms << " ms" << std::endl;
+    if (num > 1)
+        std::cout << "Shared loader, next:         " << (cached_ms - first_ms) / (num - 1)
+                  << " ms per session" << std::endl;
+    std::cout << "Loader cache hits/misses:    " << stat.hits << "/" << stat.misses << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Checks reuse of oneapi::vpl::bitstream_pool objects, buffer growth, objects
+/// which outlive the pool, concurrent acquire and release, and the bounded
+/// growth of encoder's output buffers.
+///
+/// @file
+
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "vpl/preview/vpl.hpp"
+
+namespace vpl = oneapi::vpl;
+
+#define CHECK(cond)                                                                \
+    if (!(cond)) {                                                                 \
+        std::cout << "\n   Error! " << #cond << " (line " << __LINE__ << ")\n"; \
+        return false;                                                              \
+    }
+
+// Released object is handed out again instead of a new one
+static bool TestReuse() {
+    vpl::bitstream_pool pool(vpl::codec_format_fourcc::hevc, 1024);
+
+    vpl::bitstream_as_dst *first = nullptr;
+    {
+        auto bs = pool.acquire();
+        first   = bs.get();
+        CHECK(bs->get_max_buffer_length() == 1024);
+        CHECK(bs->get_CodecId() == vpl::codec_format_fourcc::hevc);
+        bs->set_DataLength(100);
+        CHECK(pool.get_stat().in_use == 1);
+    }
+    CHECK(pool.get_stat().in_use == 0);
+
+    auto bs = pool.acquire();
+    CHECK(bs.get() == first);
+    CHECK(bs->get_DataLength() == 0);
+
+    auto stat = pool.get_stat();
+    CHECK(stat.acquired == 2);
+    CHECK(stat.allocated == 1);
+    CHECK(stat.in_use == 1);
+    return true;
+}
+
+// Objects referenced outside of the pool are never handed out twice
+static bool TestInUse() {
+    vpl::bitstream_pool pool(vpl::codec_format_fourcc::avc, 1024);
+
+    std::vector<std::shared_ptr<vpl::bitstream_as_dst>> held;
+    std::set<vpl::bitstream_as_dst *> unique;
+    for (int i = 0; i < 4; i++) {
+        held.push_back(pool.acquire());
+        unique.insert(held.back().get());
+    }
+    CHECK(unique.size() == 4);
+    CHECK(pool.get_stat().in_use == 4);
+
+    // the copy keeps the object in use
+    auto copy = held[1];
+    held.clear();
+    CHECK(pool.get_stat().in_use == 1);
+    CHECK(pool.acquire().get() != copy.get());
+    CHECK(pool.get_stat().allocated == 4);
+    return true;
+}
+
+// Buffer grown by the user and set_buffer_size() increase buffers of the free objects
+static bool TestGrow() {
+    vpl::bitstream_pool pool(vpl::codec_format_fourcc::avc, 1024);
+    {
+        auto a = pool.acquire();
+        auto b = pool.acquire();
+        a->realloc(1024);
+    }
+    CHECK(pool.get_buffer_size() == 2048);
+
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    CHECK(a->get_max_buffer_length() == 2048);
+    CHECK(b->get_max_buffer_length() == 2048);
+    CHECK(pool.get_stat().grown == 1);
+
+    pool.set_buffer_size(1000);
+    CHECK(pool.get_buffer_size() == 2048);
+    pool.set_buffer_size(4096);
+    a.reset();
+    CHECK(pool.acquire()->get_max_buffer_length() == 4096);
+    CHECK(pool.get_stat().grown == 2);
+    CHECK(pool.get_stat().buffer_size == 4096);
+    return true;
+}
+
+// Object stays valid after the pool is destroyed
+static bool TestOutlivesPool() {
+    std::shared_ptr<vpl::bitstream_as_dst> bs;
+    {
+        vpl::bitstream_pool pool(vpl::codec_format_fourcc::avc, 1024);
+        bs = pool.acquire();
+    }
+    bs->get_buffer_ptr()[1023] = 1;
+    CHECK(bs->get_max_buffer_length() == 1024);
+    bs.reset();
+    return true;
+}
+
+// Threads acquire and release objects concurrently, no object is shared between two of them
+static bool TestThreads() {
+    const int threads    = 4;
+    const int iterations = 10000;
+    vpl::bitstream_pool pool(vpl::codec_format_fourcc::avc, 64);
+
+    std::vector<int> errors(threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&pool, &errors, t]() {
+            for (int i = 0; i < iterations; i++) {
+                auto bs = pool.acquire();
+                // data of another thread means the object was handed out twice
+                if (bs->get_DataLength() != 0)
+                    errors[t]++;
+                bs->set_DataLength((uint16_t)(t + 1));
+                bs->get_buffer_ptr()[0] = (uint8_t)t;
+                if (bs->get_buffer_ptr()[0] != (uint8_t)t ||
+                    bs->get_DataLength() != (uint16_t)(t + 1))
+                    errors[t]++;
+                bs->set_DataLength(0);
+            }
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+
+    for (int t = 0; t < threads; t++) {
+        CHECK(errors[t] == 0);
+    }
+    auto stat = pool.get_stat();
+    CHECK(stat.acquired == (uint64_t)threads * iterations);
+    CHECK(stat.allocated <= (uint32_t)threads);
+    CHECK(stat.in_use == 0);
+    return true;
+}
+
+// Encoder's output buffer is doubled a limited number of times per frame
+static bool TestOutputGrowLimit() {
+    vpl::bitstream_as_dst bs(vpl::codec_format_fourcc::avc, 16);
+    uint32_t steps = 0;
+    while (vpl::encode_session::grow_output(bs, steps))
+        ;
+    CHECK(steps == vpl::encode_session::max_output_grow_steps);
+    CHECK(bs.get_max_buffer_length() == (16u << vpl::encode_session::max_output_grow_steps));
+    CHECK(!vpl::encode_session::grow_output(bs, steps));
+    return true;
+}
+
+#define RUN_TEST(test)                 \
+    std::cout << "Test " << #test;     \
+    if (!test())                       \
+        return -1;                     \
+    std::cout << " passed" << std::endl;
+
+int main() {
+    RUN_TEST(TestReuse);
+    RUN_TEST(TestInUse);
+    RUN_TEST(TestGrow);
+    RUN_TEST(TestOutlivesPool);
+    RUN_TEST(TestThreads);
+    RUN_TEST(TestOutputGrowLimit);
+    return 0;
+}
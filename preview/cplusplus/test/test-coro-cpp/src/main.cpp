@@ -0,0 +1,386 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Runs decode | vpp | encode pipelines of oneapi::vpl::coro on fake sessions:
+/// device busy retries, drain of the buffered frames at the end of stream,
+/// fatal errors and the executor's "all tasks are blocked" check. Surfaces
+/// are completed after a few Synchronize calls, so frames really wait for
+/// their sync points.
+///
+/// @file
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "vpl/preview/vpl.hpp"
+
+namespace vpl  = oneapi::vpl;
+namespace coro = oneapi::vpl::coro;
+
+using surface_future   = std::shared_ptr<vpl::future_surface_t>;
+using bitstream_future = std::shared_ptr<vpl::future_bitstream_t>;
+
+#define CHECK(cond)                                                                \
+    if (!(cond)) {                                                                 \
+        std::cout << "\n   Error! " << #cond << " (line " << __LINE__ << ")\n"; \
+        return false;                                                              \
+    }
+
+// Frame surface with the reference counter. Synchronize reports the frame as
+// in execution for the first pending calls.
+class fake_surface {
+public:
+    fake_surface(uint32_t id, uint32_t pending)
+            : surface_(),
+              iface_(),
+              refs_(0),
+              pending_(pending) {
+        iface_.Context       = this;
+        iface_.AddRef        = AddRef;
+        iface_.Release       = Release;
+        iface_.GetRefCounter = GetRefCounter;
+        iface_.Synchronize   = Synchronize;
+
+        surface_.FrameInterface  = &iface_;
+        surface_.Data.FrameOrder = id;
+    }
+
+    mfxFrameSurface1 *get() {
+        return &surface_;
+    }
+
+    uint32_t get_refs() const {
+        return refs_;
+    }
+
+    // number of Synchronize calls which were allowed to block
+    static uint32_t blocking_syncs;
+
+private:
+    static fake_surface *self(mfxFrameSurface1 *s) {
+        return static_cast<fake_surface *>(s->FrameInterface->Context);
+    }
+
+    static mfxStatus AddRef(mfxFrameSurface1 *s) {
+        self(s)->refs_++;
+        return MFX_ERR_NONE;
+    }
+
+    static mfxStatus Release(mfxFrameSurface1 *s) {
+        if (!self(s)->refs_)
+            return MFX_ERR_UNDEFINED_BEHAVIOR;
+        self(s)->refs_--;
+        return MFX_ERR_NONE;
+    }
+
+    static mfxStatus GetRefCounter(mfxFrameSurface1 *s, mfxU32 *counter) {
+        *counter = self(s)->refs_;
+        return MFX_ERR_NONE;
+    }
+
+    static mfxStatus Synchronize(mfxFrameSurface1 *s, mfxU32 wait) {
+        if (wait)
+            blocking_syncs++;
+        if (!self(s)->pending_)
+            return MFX_ERR_NONE;
+        self(s)->pending_--;
+        return MFX_WRN_IN_EXECUTION;
+    }
+
+    mfxFrameSurface1 surface_;
+    mfxFrameSurfaceInterface iface_;
+    uint32_t refs_;
+    uint32_t pending_;
+};
+
+uint32_t fake_surface::blocking_syncs = 0;
+
+// Behaviour common to the fake components: every busy_period-th call reports
+// the device as busy, frame fail_at fails with fatal error.
+class fake_session {
+public:
+    fake_session(vpl::component c, uint32_t busy_period, uint32_t pending)
+            : calls_(0),
+              busy_(0),
+              drains_(0),
+              fail_at_(UINT32_MAX),
+              component_(c),
+              busy_period_(busy_period),
+              pending_(pending),
+              surfaces_() {}
+
+    uint32_t get_busy() const {
+        return busy_;
+    }
+
+    uint32_t get_drains() const {
+        return drains_;
+    }
+
+    void set_fail_at(uint32_t id) {
+        fail_at_ = id;
+    }
+
+    // Checks that every surface of the session is released
+    bool all_released() const {
+        for (auto &s : surfaces_) {
+            if (s->get_refs())
+                return false;
+        }
+        return true;
+    }
+
+protected:
+    bool is_busy() {
+        if (!busy_period_ || ++calls_ % busy_period_)
+            return false;
+        busy_++;
+        return true;
+    }
+
+    template <typename Future, typename Data>
+    std::shared_ptr<Future> make_future(Data data, vpl::status s) {
+        auto f = std::make_shared<Future>(std::move(data));
+        vpl::operation_status op(component_, this);
+        op.schedule_status_ = s;
+        op.fatal_           = (s < vpl::status::Ok && s != vpl::status::NotEnoughData &&
+                               s != vpl::status::EndOfStreamReached);
+        f->add_operation(op);
+        return f;
+    }
+
+    surface_future make_surface(uint32_t id) {
+        surfaces_.push_back(std::make_unique<fake_surface>(id, pending_));
+        return make_future<vpl::future_surface_t>(
+            std::make_shared<vpl::frame_surface>(surfaces_.back()->get()),
+            vpl::status::Ok);
+    }
+
+    surface_future make_surface_status(vpl::status s) {
+        return make_future<vpl::future_surface_t>(std::shared_ptr<vpl::frame_surface>(), s);
+    }
+
+    bitstream_future make_bitstream_status(vpl::status s) {
+        return make_future<vpl::future_bitstream_t>(std::shared_ptr<vpl::bitstream_as_dst>(), s);
+    }
+
+    static uint32_t get_id(surface_future &in) {
+        return in->get()->get_frame_data().get_FrameOrder();
+    }
+
+    static bool is_drain(surface_future &in) {
+        return in->get_last_schedule_status() == vpl::status::EndOfStreamReached;
+    }
+
+    uint32_t calls_;
+    uint32_t busy_;
+    uint32_t drains_;
+    uint32_t fail_at_;
+    vpl::component component_;
+    uint32_t busy_period_;
+    uint32_t pending_;
+    std::vector<std::unique_ptr<fake_surface>> surfaces_;
+};
+
+// Produces frames 0..frames-1, every 4th call asks for more data
+class fake_decoder : public fake_session {
+public:
+    fake_decoder(uint32_t frames, uint32_t busy_period, uint32_t pending)
+            : fake_session(vpl::component::decoder, busy_period, pending),
+              frames_(frames),
+              next_(0),
+              reads_(0) {}
+
+    surface_future process() {
+        if (is_busy())
+            return make_surface_status(vpl::status::DeviceBusy);
+        if (next_ == frames_)
+            return make_surface_status(vpl::status::EndOfStreamReached);
+        if (++reads_ % 4 == 0)
+            return make_surface_status(vpl::status::NotEnoughData);
+        return make_surface(next_++);
+    }
+
+private:
+    uint32_t frames_;
+    uint32_t next_;
+    uint32_t reads_;
+};
+
+// Copies the frame to the new surface
+class fake_vpp : public fake_session {
+public:
+    fake_vpp(uint32_t busy_period, uint32_t pending)
+            : fake_session(vpl::component::vpp, busy_period, pending) {}
+
+    surface_future process(surface_future in) {
+        if (is_busy())
+            return make_surface_status(vpl::status::DeviceBusy);
+        if (is_drain(in)) {
+            drains_++;
+            return make_surface_status(vpl::status::EndOfStreamReached);
+        }
+        uint32_t id = get_id(in);
+        if (id == fail_at_)
+            return make_surface_status(vpl::status::NotEnoughSurface);
+        return make_surface(id);
+    }
+};
+
+// Keeps latency input frames before the first output, outputs them one per
+// call once drained
+class fake_encoder : public fake_session {
+public:
+    fake_encoder(uint32_t latency, uint32_t busy_period)
+            : fake_session(vpl::component::encoder, busy_period, 0),
+              latency_(latency),
+              frames_(),
+              encoded_() {}
+
+    bitstream_future process(surface_future in) {
+        if (is_busy())
+            return make_bitstream_status(vpl::status::DeviceBusy);
+        if (is_drain(in)) {
+            drains_++;
+            if (frames_.empty())
+                return make_bitstream_status(vpl::status::EndOfStreamReached);
+            return encode();
+        }
+        frames_.push_back(in->get());
+        if (frames_.size() <= latency_)
+            return make_bitstream_status(vpl::status::NotEnoughData);
+        return encode();
+    }
+
+    const std::vector<uint32_t> &get_encoded() const {
+        return encoded_;
+    }
+
+private:
+    bitstream_future encode() {
+        encoded_.push_back(frames_.front()->get_frame_data().get_FrameOrder());
+        frames_.pop_front();
+        return make_bitstream_status(vpl::status::Ok);
+    }
+
+    uint32_t latency_;
+    std::deque<std::shared_ptr<vpl::frame_surface>> frames_;
+    std::vector<uint32_t> encoded_;
+};
+
+// Source stage of the pipeline on the fake decoder
+static coro::pipeline<surface_future> source(fake_decoder &dec, size_t depth) {
+    fake_decoder *d = &dec;
+    return coro::pipeline<surface_future>([d, depth](coro::executor &exec) {
+        auto out = std::make_shared<coro::channel<surface_future>>(exec, depth);
+        exec.spawn(coro::detail::decode_stage(d, depth, out));
+        return out;
+    });
+}
+
+// All frames go through in order, busy devices are retried, both processing
+// stages are drained and the encoder flushes its buffered frames
+static bool TestPipeline() {
+    const uint32_t frames = 50;
+    fake_decoder dec(frames, 3, 2);
+    fake_vpp vpp(4, 1);
+    fake_encoder enc(3, 5);
+    uint32_t outputs = 0;
+    {
+        coro::executor exec;
+        fake_surface::blocking_syncs = 0;
+        (source(dec, 4) | coro::stage(vpp, 3) | coro::stage(enc, 2))
+            .spawn(exec, [&outputs](bitstream_future f) {
+                if (f->get_last_schedule_status() == vpl::status::Ok)
+                    outputs++;
+            });
+        exec.run();
+    }
+
+    CHECK(outputs == frames);
+    CHECK(enc.get_encoded().size() == frames);
+    for (uint32_t i = 0; i < frames; i++) {
+        CHECK(enc.get_encoded()[i] == i);
+    }
+    CHECK(dec.get_busy() > 0);
+    CHECK(vpp.get_busy() > 0);
+    CHECK(enc.get_busy() > 0);
+    CHECK(vpp.get_drains() == 1);
+    CHECK(enc.get_drains() == 4);
+    CHECK(fake_surface::blocking_syncs > 0);
+    CHECK(dec.all_released());
+    CHECK(vpp.all_released());
+    return true;
+}
+
+// Fatal error of a stage stops the executor
+static bool TestFatalError() {
+    fake_decoder dec(20, 0, 0);
+    fake_vpp vpp(0, 0);
+    fake_encoder enc(0, 0);
+    vpp.set_fail_at(7);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    {
+        coro::executor exec;
+        (source(dec, 2) | coro::stage(vpp, 2) | coro::stage(enc, 2))
+            .spawn(exec, [](bitstream_future) {});
+        try {
+            exec.run();
+        }
+        catch (vpl::base_exception &e) {
+            sts = e.get_status();
+        }
+    }
+
+    CHECK(sts == MFX_ERR_MORE_SURFACE);
+    CHECK(enc.get_encoded().size() < 20);
+    CHECK(dec.all_released());
+    CHECK(vpp.all_released());
+    return true;
+}
+
+// Pipeline output which nobody reads fills the channels, then every task
+// waits for another one
+static bool TestBlocked() {
+    fake_decoder dec(20, 0, 0);
+    fake_vpp vpp(0, 0);
+    fake_encoder enc(0, 0);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    {
+        coro::executor exec;
+        auto out = (source(dec, 2) | coro::stage(vpp, 2) | coro::stage(enc, 2)).spawn(exec);
+        try {
+            exec.run();
+        }
+        catch (vpl::base_exception &e) {
+            sts = e.get_status();
+        }
+        CHECK(!out->empty());
+    }
+
+    CHECK(sts == MFX_ERR_ABORTED);
+    CHECK(dec.all_released());
+    CHECK(vpp.all_released());
+    return true;
+}
+
+#define RUN_TEST(test)                 \
+    std::cout << "Test " << #test;     \
+    if (!test())                       \
+        return -1;                     \
+    std::cout << " passed" << std::endl;
+
+int main() {
+    RUN_TEST(TestPipeline);
+    RUN_TEST(TestFatalError);
+    RUN_TEST(TestBlocked);
+    return 0;
+}
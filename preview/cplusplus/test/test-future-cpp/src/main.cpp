@@ -0,0 +1,173 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Checks processing history of oneapi::vpl::future objects chained the way
+/// pipeline stages chain them: history order, branches sharing the common
+/// part of the chain, concurrent readers and the fatal component lookup.
+///
+/// @file
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "vpl/preview/vpl.hpp"
+
+namespace vpl = oneapi::vpl;
+
+#define CHECK(cond)                                                                \
+    if (!(cond)) {                                                                 \
+        std::cout << "\n   Error! " << #cond << " (line " << __LINE__ << ")\n"; \
+        return false;                                                              \
+    }
+
+static vpl::operation_status make_op(vpl::component c, vpl::status s, bool fatal = false) {
+    vpl::operation_status op(c, nullptr);
+    op.schedule_status_ = s;
+    op.fatal_           = fatal;
+    return op;
+}
+
+// Next stage of the pipeline: takes the history of the previous future, adds own operation
+static std::shared_ptr<vpl::future_surface_t> chain(const vpl::future_surface_t &in,
+                                                    vpl::operation_status op) {
+    auto out = std::make_shared<vpl::future_surface_t>(nullptr);
+    out->propagate_history(in);
+    out->add_operation(op);
+    return out;
+}
+
+static bool check_history(const vpl::future_surface_t &f,
+                          const std::vector<vpl::component> &expected) {
+    auto history = f.get_history();
+    CHECK(history.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        CHECK(history[i].component_ == expected[i]);
+    }
+    return true;
+}
+
+// Operations go first to last, upstream futures keep their own history
+static bool TestHistoryOrder() {
+    vpl::future_surface_t dec(nullptr);
+    CHECK(dec.get_history().empty());
+    CHECK(dec.get_last_schedule_status() == vpl::status::Unknown);
+
+    dec.add_operation(make_op(vpl::component::decoder, vpl::status::Ok));
+    auto vpp = chain(dec, make_op(vpl::component::vpp, vpl::status::NotEnoughData));
+    auto enc = chain(*vpp, make_op(vpl::component::encoder, vpl::status::Ok));
+
+    CHECK(check_history(dec, { vpl::component::decoder }));
+    CHECK(check_history(*vpp, { vpl::component::decoder, vpl::component::vpp }));
+    CHECK(check_history(
+        *enc,
+        { vpl::component::decoder, vpl::component::vpp, vpl::component::encoder }));
+    CHECK(vpp->get_last_schedule_status() == vpl::status::NotEnoughData);
+    CHECK(enc->get_last_schedule_status() == vpl::status::Ok);
+    return true;
+}
+
+// Own operations added before propagate_history() stay on top of the old history
+static bool TestOwnHistoryOnTop() {
+    vpl::future_surface_t dec(nullptr);
+    dec.add_operation(make_op(vpl::component::decoder, vpl::status::Ok));
+
+    vpl::future_surface_t vpp(nullptr);
+    vpp.add_operation(make_op(vpl::component::vpp, vpl::status::Ok));
+    vpp.add_operation(make_op(vpl::component::vpp, vpl::status::EndOfStreamReached));
+    vpp.propagate_history(dec);
+
+    CHECK(check_history(vpp,
+                        { vpl::component::decoder, vpl::component::vpp, vpl::component::vpp }));
+    CHECK(vpp.get_last_schedule_status() == vpl::status::EndOfStreamReached);
+    CHECK(check_history(dec, { vpl::component::decoder }));
+    return true;
+}
+
+// Two stages fed by the same future share its history, but not each other's
+static bool TestBranches() {
+    vpl::future_surface_t dec(nullptr);
+    dec.add_operation(make_op(vpl::component::decoder, vpl::status::Ok));
+
+    auto a = chain(dec, make_op(vpl::component::vpp, vpl::status::Ok));
+    auto b = chain(dec, make_op(vpl::component::encoder, vpl::status::Ok));
+    auto c = chain(*a, make_op(vpl::component::encoder, vpl::status::Ok));
+
+    CHECK(check_history(*a, { vpl::component::decoder, vpl::component::vpp }));
+    CHECK(check_history(*b, { vpl::component::decoder, vpl::component::encoder }));
+    CHECK(check_history(
+        *c,
+        { vpl::component::decoder, vpl::component::vpp, vpl::component::encoder }));
+    return true;
+}
+
+// Downstream stages on several threads read the history of the same future
+static bool TestConcurrentReaders() {
+    vpl::future_surface_t dec(nullptr);
+    dec.add_operation(make_op(vpl::component::decoder, vpl::status::Ok));
+    const vpl::future_surface_t &in = dec;
+
+    const int threads = 4;
+    std::vector<int> errors(threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&in, &errors, t]() {
+            for (int i = 0; i < 1000; i++) {
+                auto out = chain(in, make_op(vpl::component::vpp, vpl::status::Ok));
+                if (out->get_history().size() != 2)
+                    errors[t]++;
+            }
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+
+    for (int t = 0; t < threads; t++) {
+        CHECK(errors[t] == 0);
+    }
+    CHECK(check_history(dec, { vpl::component::decoder }));
+    return true;
+}
+
+// The first fatal operation of the chain is reported
+static bool TestFatalComponent() {
+    vpl::future_surface_t dec(nullptr);
+    dec.add_operation(make_op(vpl::component::decoder, vpl::status::Ok));
+    auto vpp = chain(dec, make_op(vpl::component::vpp, vpl::status::Ok));
+    auto enc = chain(*vpp, make_op(vpl::component::encoder, vpl::status::Ok));
+    CHECK(!enc->had_fatal());
+    CHECK(enc->get_fatal_component() == vpl::component::unknown);
+
+    auto vpp_fatal = chain(dec, make_op(vpl::component::vpp, vpl::status::NotEnoughSurface, true));
+    auto enc_after = chain(*vpp_fatal, make_op(vpl::component::encoder, vpl::status::Ok));
+    CHECK(vpp_fatal->had_fatal());
+    CHECK(vpp_fatal->get_fatal_component() == vpl::component::vpp);
+    CHECK(enc_after->get_fatal_component() == vpl::component::vpp);
+
+    vpl::future_surface_t dec_fatal(nullptr);
+    dec_fatal.add_operation(make_op(vpl::component::decoder, vpl::status::Unknown, true));
+    auto vpp2 = chain(dec_fatal, make_op(vpl::component::vpp, vpl::status::NotEnoughSurface, true));
+    auto enc2 = chain(*vpp2, make_op(vpl::component::encoder, vpl::status::Unknown, true));
+    CHECK(enc2->get_fatal_component() == vpl::component::decoder);
+    return true;
+}
+
+#define RUN_TEST(test)                 \
+    std::cout << "Test " << #test;     \
+    if (!test())                       \
+        return -1;                     \
+    std::cout << " passed" << std::endl;
+
+int main() {
+    RUN_TEST(TestHistoryOrder);
+    RUN_TEST(TestOwnHistoryOnTop);
+    RUN_TEST(TestBranches);
+    RUN_TEST(TestConcurrentReaders);
+    RUN_TEST(TestFatalComponent);
+    return 0;
+}
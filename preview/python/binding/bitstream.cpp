@@ -103,20 +103,23 @@ void init_bitstream(const py::module &m) {
                                           self->get_max_buffer_length(),
                                           sizeof(uint8_t));
                 },
+                py::keep_alive<0, 1>(),
                 "Get buffer")
             .def_property_readonly("max_buffer_length",
                                    &vpl::bitstream::get_max_buffer_length,
                                    "Max Buffer Length")
             .def_property_readonly(
                 "valid_data",
-                [](vpl::bitstream *self) {
-                    auto [ptr, len] = self->get_valid_data();
-                    return bitstream_data(ptr,
-                                          sizeof(uint8_t),
-                                          py::format_descriptor<uint8_t>::format(),
-                                          len,
-                                          sizeof(uint8_t));
-                },
+                py::cpp_function(
+                    [](vpl::bitstream *self) {
+                        auto [ptr, len] = self->get_valid_data();
+                        return bitstream_data(ptr,
+                                              sizeof(uint8_t),
+                                              py::format_descriptor<uint8_t>::format(),
+                                              len,
+                                              sizeof(uint8_t));
+                    },
+                    py::keep_alive<0, 1>()),
                 "Valid Data")
             .def_buffer([](vpl::bitstream *self) {
                 auto [ptr, len] = self->get_valid_data();
@@ -158,4 +161,19 @@ void init_bitstream(const py::module &m) {
                     return (unsigned int)(s.wait_for(waitduration));
                 },
                 "Waits for the operation completion. Waits for the result to become available. Blocks until specified timeout_duration has elapsed or the result becomes available, whichever comes first. Returns value identifying the state of the result.");
+
+    py::class_<vpl::bitstream_pool::statistic>(m, "bitstream_pool_statistic")
+        .def_readonly("acquired", &vpl::bitstream_pool::statistic::acquired, "Number of acquires")
+        .def_readonly("allocated",
+                      &vpl::bitstream_pool::statistic::allocated,
+                      "Number of bitstream objects created by the pool")
+        .def_readonly("grown",
+                      &vpl::bitstream_pool::statistic::grown,
+                      "Number of buffer reallocations to the current buffer size")
+        .def_readonly("in_use",
+                      &vpl::bitstream_pool::statistic::in_use,
+                      "Number of objects referenced outside of the pool")
+        .def_readonly("buffer_size",
+                      &vpl::bitstream_pool::statistic::buffer_size,
+                      "Current buffer size in bytes");
 }
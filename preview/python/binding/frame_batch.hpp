@@ -0,0 +1,250 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vpl/preview/frame_surface.hpp"
+#include "vpl/preview/source_reader.hpp"
+#include "vpl/preview/video_param.hpp"
+#include "vpl_python.hpp"
+
+// Converts 8-bit BGR (Channels = 3) or BGRA (Channels = 4) pixels into 4:2:0 Y and chroma planes,
+// BT.601 limited range. Chroma is computed from the average of 2x2 pixels. Inner loops have no
+// dependencies between iterations and constant strides, so compilers can vectorize them.
+template <uint32_t Channels>
+void bgr_to_yuv420(const uint8_t *src,
+                   uint32_t width,
+                   uint32_t height,
+                   uint8_t *y,
+                   uint32_t y_pitch,
+                   uint8_t *u,
+                   uint8_t *v,
+                   uint32_t uv_pitch,
+                   uint32_t uv_step) {
+    constexpr size_t channels = Channels;
+    size_t src_pitch          = width * channels;
+
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *s = src + row * src_pitch;
+        uint8_t *d       = y + static_cast<size_t>(row) * y_pitch;
+        for (uint32_t x = 0; x < width; x++) {
+            int32_t b = s[x * channels];
+            int32_t g = s[x * channels + 1];
+            int32_t r = s[x * channels + 2];
+            d[x]      = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    // sums of 2x2 pixels are scaled down by 4 together with the coefficients
+    auto put_uv = [&](uint8_t *du, uint8_t *dv, int32_t r, int32_t g, int32_t b) {
+        *du = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+        *dv = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+    };
+
+    for (uint32_t row = 0; row < (height + 1) / 2; row++) {
+        const uint8_t *s0 = src + 2 * row * src_pitch;
+        const uint8_t *s1 = (2 * row + 1 < height) ? s0 + src_pitch : s0;
+        uint8_t *du       = u + static_cast<size_t>(row) * uv_pitch;
+        uint8_t *dv       = v + static_cast<size_t>(row) * uv_pitch;
+
+        uint32_t x = 0;
+        for (; x < width / 2; x++) {
+            size_t p0 = 2 * x * channels;
+            size_t p1 = p0 + channels;
+            int32_t b = s0[p0] + s0[p1] + s1[p0] + s1[p1];
+            int32_t g = s0[p0 + 1] + s0[p1 + 1] + s1[p0 + 1] + s1[p1 + 1];
+            int32_t r = s0[p0 + 2] + s0[p1 + 2] + s1[p0 + 2] + s1[p1 + 2];
+            put_uv(du + x * uv_step, dv + x * uv_step, r, g, b);
+        }
+        if (width & 1) {
+            size_t p0 = 2 * x * channels;
+            int32_t b = 2 * (s0[p0] + s1[p0]);
+            int32_t g = 2 * (s0[p0 + 1] + s1[p0 + 1]);
+            int32_t r = 2 * (s0[p0 + 2] + s1[p0 + 2]);
+            put_uv(du + x * uv_step, dv + x * uv_step, r, g, b);
+        }
+    }
+}
+
+// Expands 8-bit BGR pixels into BGRA with opaque alpha
+inline void bgr_to_bgra(const uint8_t *src,
+                        uint32_t width,
+                        uint32_t height,
+                        uint8_t *dst,
+                        uint32_t dst_pitch) {
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *s = src + static_cast<size_t>(row) * width * 3;
+        uint8_t *d       = dst + static_cast<size_t>(row) * dst_pitch;
+        for (uint32_t x = 0; x < width; x++) {
+            d[4 * x]     = s[3 * x];
+            d[4 * x + 1] = s[3 * x + 1];
+            d[4 * x + 2] = s[3 * x + 2];
+            d[4 * x + 3] = 255;
+        }
+    }
+}
+
+// Batch of frames submitted from Python. Accepted layouts, N is the number of frames:
+//  - one array of N raw frames in the layout of the surface format, e.g. (N, H * 3 / 2, W)
+//    for NV12 or I420, (N, H, W, 4) for BGRA;
+//  - tuple or list of planes in the layout of the surface format, each of them an array of N
+//    planes, e.g. (Y, UV) for NV12 or (Y, U, V) for I420;
+//  - array (N, H, W, 3) or (N, H, W, 4) of BGR or BGRA pixels converted into NV12, I420 or BGRA
+//    surfaces.
+// Arrays are validated and referenced while GIL is held. copy_to() doesn't touch Python objects
+// and is called without GIL.
+class frame_batch {
+public:
+    frame_batch(const py::object &frames, const vpl::frame_info &info)
+            : format_(info.get_FourCC()),
+              width_(visible_size(info).first),
+              height_(visible_size(info).second),
+              layout_(width_, height_, format_),
+              mode_(mode::raw),
+              count_(0),
+              channels_(0),
+              arrays_(),
+              data_(),
+              frame_bytes_() {
+        bool wide = format_ == vpl::color_format_fourcc::p010 ||
+                    format_ == vpl::color_format_fourcc::i010;
+
+        if (py::isinstance<py::tuple>(frames) || py::isinstance<py::list>(frames)) {
+            auto seq = frames.cast<py::sequence>();
+            if (seq.size() != layout_.get_planes_count())
+                throw py::value_error("Expected " + std::to_string(layout_.get_planes_count()) +
+                                      " planes");
+            mode_ = mode::planar;
+            for (uint32_t i = 0; i < layout_.get_planes_count(); i++) {
+                add_array(seq[i], wide);
+                if (arrays_[i].shape(0) != arrays_[0].shape(0))
+                    throw py::value_error("Planes have different number of frames");
+                if (frame_bytes_[i] != layout_.get_plane_size(i))
+                    throw py::value_error("Plane " + std::to_string(i) + " is expected to have " +
+                                          std::to_string(layout_.get_plane_size(i)) +
+                                          " bytes per frame");
+            }
+            return;
+        }
+
+        add_array(frames, wide);
+        const py::array &a = arrays_[0];
+        if (!count_ || frame_bytes_[0] == layout_.get_frame_size())
+            return;
+
+        bool convertible = format_ == vpl::color_format_fourcc::nv12 ||
+                           format_ == vpl::color_format_fourcc::i420 ||
+                           format_ == vpl::color_format_fourcc::bgra;
+        if (convertible && a.ndim() == 4 && a.shape(1) == height_ && a.shape(2) == width_ &&
+            (a.shape(3) == 3 || a.shape(3) == 4)) {
+            mode_     = mode::bgr;
+            channels_ = static_cast<uint32_t>(a.shape(3));
+            return;
+        }
+        throw py::value_error("Frame is expected to have " +
+                              std::to_string(layout_.get_frame_size()) +
+                              " bytes or (H, W, 3|4) BGR(A) pixels of " + std::to_string(width_) +
+                              "x" + std::to_string(height_) + " frame");
+    }
+
+    // Number of frames
+    size_t size() const {
+        return count_;
+    }
+
+    // Copies or converts frame into the surface
+    void copy_to(size_t idx, vpl::frame_surface &surface) const {
+        auto data   = surface.map_data(vpl::memory_access::write);
+        auto planes = layout_.get_planes(data);
+
+        switch (mode_) {
+            case mode::raw:
+                layout_.scatter(data_[0] + idx * frame_bytes_[0], planes);
+                break;
+            case mode::planar:
+                for (uint32_t i = 0; i < layout_.get_planes_count(); i++)
+                    layout_.scatter_plane(i, data_[i] + idx * frame_bytes_[i], planes);
+                break;
+            case mode::bgr: {
+                const uint8_t *src = data_[0] + idx * frame_bytes_[0];
+                if (format_ == vpl::color_format_fourcc::bgra) {
+                    // BGRA input has the raw layout of the surface
+                    bgr_to_bgra(src, width_, height_, planes.ptr[0], planes.pitch[0]);
+                    break;
+                }
+                // NV12 chroma is interleaved, I420 one is in separate planes
+                bool nv12    = format_ == vpl::color_format_fourcc::nv12;
+                uint8_t *u   = planes.ptr[1];
+                uint8_t *v   = nv12 ? planes.ptr[1] + 1 : planes.ptr[2];
+                uint32_t uvs = nv12 ? 2 : 1;
+                if (channels_ == 3)
+                    bgr_to_yuv420<3>(src,
+                                     width_,
+                                     height_,
+                                     planes.ptr[0],
+                                     planes.pitch[0],
+                                     u,
+                                     v,
+                                     planes.pitch[1],
+                                     uvs);
+                else
+                    bgr_to_yuv420<4>(src,
+                                     width_,
+                                     height_,
+                                     planes.ptr[0],
+                                     planes.pitch[0],
+                                     u,
+                                     v,
+                                     planes.pitch[1],
+                                     uvs);
+                break;
+            }
+        }
+        surface.unmap();
+    }
+
+private:
+    enum class mode { raw, planar, bgr };
+
+    // Size of the frame without padding: ROI if it is set
+    static std::pair<uint16_t, uint16_t> visible_size(const vpl::frame_info &info) {
+        auto [pos, size] = info.get_ROI();
+        if (size.first && size.second)
+            return size;
+        return info.get_frame_size();
+    }
+
+    void add_array(py::handle obj, bool wide) {
+        py::array a;
+        if (wide)
+            a = py::array_t<uint16_t, py::array::c_style | py::array::forcecast>::ensure(obj);
+        else
+            a = py::array_t<uint8_t, py::array::c_style | py::array::forcecast>::ensure(obj);
+        if (!a || a.ndim() < 2)
+            throw py::value_error("Expected array of frames");
+        if (!count_)
+            count_ = static_cast<size_t>(a.shape(0));
+        arrays_.push_back(a);
+        data_.push_back(static_cast<const uint8_t *>(a.data()));
+        frame_bytes_.push_back(a.shape(0) ? static_cast<size_t>(a.nbytes()) / a.shape(0) : 0);
+    }
+
+    vpl::color_format_fourcc format_;
+    uint16_t width_;
+    uint16_t height_;
+    vpl::detail::raw_frame_layout layout_;
+    mode mode_;
+    size_t count_;
+    uint32_t channels_;
+    // arrays keep the data alive, possibly converted copies of the arguments
+    std::vector<py::array> arrays_;
+    std::vector<const uint8_t *> data_;
+    std::vector<size_t> frame_bytes_;
+};
@@ -7,6 +7,149 @@
 #include "vpl_python.hpp"
 namespace vpl = oneapi::vpl;
 
+// Keeps the surface mapped while any of the plane arrays refers to it
+class surface_mapping {
+public:
+    surface_mapping(std::shared_ptr<vpl::frame_surface> surface, vpl::memory_access access)
+            : surface_(surface),
+              info_(),
+              data_() {
+        py::gil_scoped_release release;
+        auto [info, data] = surface_->map(access);
+        info_             = info;
+        data_             = data;
+    }
+
+    ~surface_mapping() {
+        try {
+            surface_->unmap();
+        }
+        catch (...) {
+        }
+    }
+
+    const vpl::frame_info &info() const {
+        return info_;
+    }
+
+    const vpl::frame_data &data() const {
+        return data_;
+    }
+
+private:
+    std::shared_ptr<vpl::frame_surface> surface_;
+    vpl::frame_info info_;
+    vpl::frame_data data_;
+};
+
+// Lowest address of the components of a packed format is the start of the pixel
+static uint8_t *packed_base(const vpl::frame_data &data) {
+    auto [R, G, B, A] = data.get_plane_ptrs_4();
+    uint8_t *base     = nullptr;
+    for (uint8_t *ptr : { R, G, B, A }) {
+        if (ptr && (!base || ptr < base))
+            base = ptr;
+    }
+    return base;
+}
+
+// Returns planes of the mapped surface as NumPy arrays indexed by [row, column(, component)].
+// Arrays share the memory of the surface and keep it mapped until the last of them is released.
+static std::vector<py::array> map_planes(std::shared_ptr<vpl::frame_surface> surface,
+                                         vpl::memory_access access) {
+    auto mapping = std::make_shared<surface_mapping>(surface, access);
+    auto base    = py::capsule(new std::shared_ptr<surface_mapping>(mapping), [](void *p) {
+        delete static_cast<std::shared_ptr<surface_mapping> *>(p);
+    });
+
+    const vpl::frame_data &data = mapping->data();
+    py::ssize_t w               = mapping->info().get_width();
+    py::ssize_t h               = mapping->info().get_height();
+    py::ssize_t pitch           = data.get_pitch();
+
+    std::vector<py::array> planes;
+    auto add = [&](py::dtype dtype,
+                   void *ptr,
+                   std::vector<py::ssize_t> shape,
+                   std::vector<py::ssize_t> strides) {
+        // NumPy allocates new memory for null pointer
+        if (!ptr)
+            throw std::runtime_error("Plane isn't mapped");
+        planes.emplace_back(dtype, shape, strides, ptr, base);
+        if (access == vpl::memory_access::read)
+            planes.back().attr("setflags")(py::arg("write") = false);
+    };
+    auto u8  = py::dtype::of<uint8_t>();
+    auto u16 = py::dtype::of<uint16_t>();
+    auto u32 = py::dtype::of<uint32_t>();
+
+    switch (mapping->info().get_FourCC()) {
+        case vpl::color_format_fourcc::nv12:
+        case vpl::color_format_fourcc::nv16: {
+            auto [Y, UV] = data.get_plane_ptrs_2();
+            py::ssize_t ch =
+                (mapping->info().get_FourCC() == vpl::color_format_fourcc::nv12) ? h / 2 : h;
+            add(u8, Y, { h, w }, { pitch, 1 });
+            add(u8, UV, { ch, w / 2, 2 }, { pitch, 2, 1 });
+            break;
+        }
+        case vpl::color_format_fourcc::p010:
+        case vpl::color_format_fourcc::p016:
+        case vpl::color_format_fourcc::p210: {
+            auto [Y, UV] = data.get_plane_ptrs_2();
+            py::ssize_t ch =
+                (mapping->info().get_FourCC() == vpl::color_format_fourcc::p210) ? h : h / 2;
+            add(u16, Y, { h, w }, { pitch, 2 });
+            add(u16, UV, { ch, w / 2, 2 }, { pitch, 4, 2 });
+            break;
+        }
+        case vpl::color_format_fourcc::i420:
+        case vpl::color_format_fourcc::yv12:
+        case vpl::color_format_fourcc::i422: {
+            auto [Y, U, V] = data.get_plane_ptrs_3();
+            py::ssize_t ch =
+                (mapping->info().get_FourCC() == vpl::color_format_fourcc::i422) ? h : h / 2;
+            add(u8, Y, { h, w }, { pitch, 1 });
+            add(u8, U, { ch, w / 2 }, { pitch / 2, 1 });
+            add(u8, V, { ch, w / 2 }, { pitch / 2, 1 });
+            break;
+        }
+        case vpl::color_format_fourcc::i010:
+        case vpl::color_format_fourcc::i210: {
+            auto [Y, U, V] = data.get_plane_ptrs_3();
+            py::ssize_t ch =
+                (mapping->info().get_FourCC() == vpl::color_format_fourcc::i210) ? h : h / 2;
+            add(u16, Y, { h, w }, { pitch, 2 });
+            add(u16, U, { ch, w / 2 }, { pitch / 2, 2 });
+            add(u16, V, { ch, w / 2 }, { pitch / 2, 2 });
+            break;
+        }
+        case vpl::color_format_fourcc::yuy2:
+        case vpl::color_format_fourcc::uyvy:
+            add(u8, packed_base(data), { h, w, 2 }, { pitch, 2, 1 });
+            break;
+        case vpl::color_format_fourcc::y210:
+        case vpl::color_format_fourcc::y216:
+            add(u16, packed_base(data), { h, w, 2 }, { pitch, 4, 2 });
+            break;
+        case vpl::color_format_fourcc::bgra:
+        case vpl::color_format_fourcc::bgr4:
+        case vpl::color_format_fourcc::ayuv:
+            add(u8, packed_base(data), { h, w, 4 }, { pitch, 4, 1 });
+            break;
+        case vpl::color_format_fourcc::y410:
+        case vpl::color_format_fourcc::a2rgb10:
+            add(u32, packed_base(data), { h, w }, { pitch, 4 });
+            break;
+        case vpl::color_format_fourcc::y416:
+            add(u16, packed_base(data), { h, w, 4 }, { pitch, 8, 2 });
+            break;
+        default:
+            throw std::range_error("Format not known");
+    }
+    return planes;
+}
+
 void init_frame_surface(const py::module &m) {
     py::class_<vpl::frame_surface, std::shared_ptr<vpl::frame_surface>>(m, "frame_surface")
         .def(py::init<>())
@@ -14,22 +157,37 @@ void init_frame_surface(const py::module &m) {
             "inject",
             &vpl::frame_surface::inject,
             "Inject mfxFrameSurface1 object to take care of it. This is temporal method until VPL RT will support all functions for the internal memory allocation")
-        .def("wait", &vpl::frame_surface::wait, "Indefinitely wait for operation completion.")
+        .def("wait",
+             &vpl::frame_surface::wait,
+             "Indefinitely wait for operation completion.",
+             py::call_guard<py::gil_scoped_release>())
         .def(
             "wait_for",
             [](vpl::frame_surface &s, int milliseconds) {
                 std::chrono::duration<int, std::milli> waitduration(milliseconds);
                 return s.wait_for(waitduration);
             },
-            "Waits for the operation completion. Waits for the result to become available. Blocks until specified timeout_duration has elapsed or the result becomes available, whichever comes first. Returns value identifying the state of the result.")
+            "Waits for the operation completion. Waits for the result to become available. Blocks until specified timeout_duration has elapsed or the result becomes available, whichever comes first. Returns value identifying the state of the result.",
+            py::call_guard<py::gil_scoped_release>())
         .def_property_readonly("frame_info",
                                &vpl::frame_surface::get_frame_info,
                                "Provide frame information.")
         .def_property_readonly("frame_data",
                                &vpl::frame_surface::get_frame_data,
                                "Provide frame data information.")
-        .def("map", &vpl::frame_surface::map, "Maps data to the system memory.")
-        .def("unmap", &vpl::frame_surface::unmap, "Unmaps data to the system memory.")
+        .def("map",
+             &vpl::frame_surface::map,
+             "Maps data to the system memory.",
+             py::call_guard<py::gil_scoped_release>())
+        .def("unmap",
+             &vpl::frame_surface::unmap,
+             "Unmaps data to the system memory.",
+             py::call_guard<py::gil_scoped_release>())
+        .def(
+            "planes",
+            &map_planes,
+            py::arg("access") = vpl::memory_access::read,
+            "Maps data to the system memory and returns list of NumPy arrays sharing memory with the surface planes, indexed by [row, column] or [row, column, component] for interleaved planes. Arrays cover the whole allocated frame, crop them by ROI if needed. Surface stays mapped until all arrays are released, read only arrays are returned for read access.")
         .def_property_readonly("native_handle",
                                &vpl::frame_surface::get_native_handle,
                                "native surface handle of the surface.")
@@ -3,10 +3,281 @@
 //
 // SPDX-License-Identifier: MIT
 //==============================================================================
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "frame_batch.hpp"
 #include "vpl/preview/session.hpp"
 #include "vpl_python.hpp"
 namespace vpl = oneapi::vpl;
 
+// Helpers below don't touch Python objects and are called without GIL
+
+// Decodes next frame and waits for it, returns nullptr at the end of stream
+template <typename Reader>
+std::shared_ptr<vpl::frame_surface> decode_next(vpl::decode_session<Reader> *self) {
+    bool is_stillgoing = true;
+    while (is_stillgoing == true) {
+        std::shared_ptr<vpl::frame_surface> dec_surface_out =
+            std::make_shared<vpl::frame_surface>();
+        vpl::status ret = self->decode_frame(dec_surface_out);
+        vpl::async_op_status st;
+        switch (ret) {
+            case vpl::status::Ok:
+                do {
+                    std::chrono::duration<int, std::milli> waitduration(100);
+                    st = dec_surface_out->wait_for(waitduration);
+                    if (vpl::async_op_status::ready == st) {
+                        return dec_surface_out;
+                    }
+                } while (st == vpl::async_op_status::timeout);
+                break;
+            case vpl::status::EndOfStreamReached:
+                is_stillgoing = false;
+                break;
+            case vpl::status::NotEnoughData:
+                break;
+            case vpl::status::DeviceBusy:
+                break;
+            default:
+                is_stillgoing = false;
+                break;
+        }
+    }
+    return nullptr;
+}
+
+// Encodes next frame from the session's reader, returns nullptr at the end of stream
+static std::shared_ptr<vpl::bitstream_as_dst> encode_next(vpl::encode_session *self) {
+    std::shared_ptr<vpl::bitstream_as_dst> bits = self->alloc_output();
+    while (true) {
+        vpl::status wrn = vpl::status::Ok;
+        wrn             = self->encode_frame(bits);
+        switch (wrn) {
+            case vpl::status::Ok: {
+                std::chrono::duration<int, std::milli> waitduration(100);
+                bits->wait_for(waitduration);
+                return bits;
+            } break;
+            case vpl::status::EndOfStreamReached:
+                return nullptr;
+            case vpl::status::DeviceBusy:
+                continue;
+            default:
+                return nullptr;
+        }
+    }
+}
+
+// Processes next frame from the session's reader, returns nullptr at the end of stream
+static std::shared_ptr<vpl::frame_surface> vpp_next(vpl::vpp_session *self) {
+    std::shared_ptr<vpl::frame_surface> proc_surface_out = std::make_shared<vpl::frame_surface>();
+    oneapi::vpl::status wrn                              = oneapi::vpl::status::Ok;
+    bool is_stillgoing                                   = true;
+    while (is_stillgoing == true) {
+        wrn = self->process_frame(proc_surface_out);
+        switch (wrn) {
+            case oneapi::vpl::status::Ok: {
+                oneapi::vpl::async_op_status st;
+                do {
+                    std::chrono::duration<int, std::milli> waitduration(100);
+                    st = proc_surface_out->wait_for(waitduration);
+                    if (oneapi::vpl::async_op_status::ready == st) {
+                        return proc_surface_out;
+                    }
+                } while (st == oneapi::vpl::async_op_status::timeout);
+            } break;
+            case oneapi::vpl::status::NotEnoughBuffer:
+                break;
+            case oneapi::vpl::status::NotEnoughData:
+                return nullptr;
+            case oneapi::vpl::status::DeviceBusy:
+                break;
+            default:
+                return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Copies frames of the batch into input surfaces and submits them to the encoder. Returns
+// bitstreams of the submissions which produced output, so there can be fewer than frames in the
+// batch: frames buffered by the encoder come out with the following submissions or with draining.
+static std::vector<std::shared_ptr<vpl::bitstream_as_dst>> encode_batch(vpl::encode_session *self,
+                                                                        const frame_batch &batch) {
+    std::vector<std::shared_ptr<vpl::bitstream_as_dst>> out;
+    out.reserve(batch.size());
+    for (size_t n = 0; n < batch.size(); n++) {
+        std::shared_ptr<vpl::frame_surface> surface = self->alloc_input();
+        batch.copy_to(n, *surface);
+
+        std::shared_ptr<vpl::bitstream_as_dst> bits = self->alloc_output();
+        uint32_t grow_steps                         = 0;
+        while (true) {
+            vpl::status wrn = self->encode_frame(surface, bits);
+            if (wrn == vpl::status::NotEnoughBuffer) {
+                // the same surface is submitted again
+                if (!vpl::encode_session::grow_output(*bits, grow_steps))
+                    throw vpl::base_exception("Output buffer can't fit the frame",
+                                              MFX_ERR_NOT_ENOUGH_BUFFER);
+                continue;
+            }
+            if (wrn == vpl::status::DeviceBusy) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            if (wrn == vpl::status::Ok)
+                out.push_back(bits);
+            break;
+        }
+    }
+    return out;
+}
+
+// Copies frames of the batch into input surfaces and submits them to VPP. Returns output
+// surfaces, their number differs from the batch size if frame rate is converted.
+static std::vector<std::shared_ptr<vpl::frame_surface>> vpp_batch(vpl::vpp_session *self,
+                                                                  const frame_batch &batch) {
+    std::vector<std::shared_ptr<vpl::frame_surface>> out;
+    out.reserve(batch.size());
+    for (size_t n = 0; n < batch.size(); n++) {
+        std::shared_ptr<vpl::frame_surface> surface = self->alloc_input();
+        batch.copy_to(n, *surface);
+
+        while (true) {
+            auto proc_surface_out = std::make_shared<vpl::frame_surface>();
+            vpl::status wrn       = self->process_frame(surface, proc_surface_out);
+            if (wrn == vpl::status::DeviceBusy) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            if (wrn == vpl::status::Ok || wrn == vpl::status::NotEnoughSurface)
+                out.push_back(proc_surface_out);
+            // VPP has more output for the same input, e.g. with frame rate conversion
+            if (wrn == vpl::status::NotEnoughSurface)
+                continue;
+            break;
+        }
+    }
+    return out;
+}
+
+// Decodes frames ahead on a native thread, up to depth frames are kept ready. Python code
+// processing the current frame runs in parallel with decoding of the next ones. Session must not
+// be used directly while the iterator is running.
+template <typename Reader>
+class decode_prefetch_iterator {
+public:
+    using Session = vpl::decode_session<Reader>;
+
+    decode_prefetch_iterator(std::shared_ptr<Session> session, uint32_t depth)
+            : session_(session),
+              depth_(depth ? depth : 1),
+              ready_(),
+              error_(),
+              done_(false),
+              stop_(false),
+              mtx_(),
+              cv_(),
+              thread_() {
+        thread_ = std::thread(&decode_prefetch_iterator::run, this);
+    }
+
+    ~decode_prefetch_iterator() {
+        close();
+    }
+
+    // Returns next decoded frame, throws StopIteration at the end of stream
+    std::shared_ptr<vpl::frame_surface> next() {
+        std::shared_ptr<vpl::frame_surface> surface;
+        std::exception_ptr error;
+        {
+            py::gil_scoped_release release;
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] {
+                return !ready_.empty() || done_;
+            });
+            if (!ready_.empty()) {
+                surface = ready_.front();
+                ready_.pop_front();
+            }
+            else {
+                std::swap(error, error_);
+            }
+        }
+        cv_.notify_all();
+
+        if (error)
+            std::rethrow_exception(error);
+        if (!surface)
+            throw py::stop_iteration();
+        return surface;
+    }
+
+    // Stops decoding and drops the frames which weren't returned yet
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+            ready_.clear();
+        }
+        cv_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+private:
+    void run() {
+        try {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    cv_.wait(lock, [this] {
+                        return stop_ || ready_.size() < depth_;
+                    });
+                    if (stop_)
+                        break;
+                }
+
+                std::shared_ptr<vpl::frame_surface> surface = decode_next(session_.get());
+                if (!surface)
+                    break;
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    if (!stop_)
+                        ready_.push_back(surface);
+                }
+                cv_.notify_all();
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            error_ = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            done_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    std::shared_ptr<Session> session_;
+    size_t depth_;
+    std::deque<std::shared_ptr<vpl::frame_surface>> ready_;
+    std::exception_ptr error_;
+    bool done_;
+    bool stop_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
 template <typename VideoParams, typename InitList, typename ResetList>
 class session_template {
 public:
@@ -45,7 +316,8 @@ public:
                               vpl::decoder_init_reset_list,
                               vpl::decoder_init_reset_list>;
     using Class   = vpl::decode_session<Reader>;
-    using PyClass = py::class_<Class, Base, std::shared_ptr<Class>>;
+    using PyClass  = py::class_<Class, Base, std::shared_ptr<Class>>;
+    using Iterator = decode_prefetch_iterator<Reader>;
     PyClass pyclass;
     decode_session_template(const py::module &m, const std::string &typestr)
             : pyclass(m, typestr.c_str()) {
@@ -57,46 +329,51 @@ public:
             .def(
                 "init_by_header",
                 &Class::init_by_header,
-                "Initialize the session by using bitream portion. This step can be omitted if the codec ID is known or we don't need to get SSP or PPS data from the bitstream.")
-            .def("decode_frame", &Class::decode_frame, "Decodes frame")
-            .def("process", &Class::process, "Decodes frame")
+                "Initialize the session by using bitream portion. This step can be omitted if the codec ID is known or we don't need to get SSP or PPS data from the bitstream.",
+                py::call_guard<py::gil_scoped_release>())
+            .def("decode_frame",
+                 &Class::decode_frame,
+                 "Decodes frame",
+                 py::call_guard<py::gil_scoped_release>())
+            .def("process",
+                 &Class::process,
+                 "Decodes frame",
+                 py::call_guard<py::gil_scoped_release>())
             .def_property_readonly("Stat", &Class::getStat, "Retrieve decoder statistic")
             .def_property_readonly("Params", &Class::getParams, "Get video params")
             .def("__iter__",
                  [](Class *self) -> Class & {
                      return *self;
                  })
-            .def("__next__", [](Class *self) {
-                bool is_stillgoing = true;
-                while (is_stillgoing == true) {
-                    std::shared_ptr<vpl::frame_surface> dec_surface_out =
-                        std::make_shared<vpl::frame_surface>();
-                    vpl::status ret = self->decode_frame(dec_surface_out);
-                    vpl::async_op_status st;
-                    switch (ret) {
-                        case vpl::status::Ok:
-                            do {
-                                std::chrono::duration<int, std::milli> waitduration(100);
-                                st = dec_surface_out->wait_for(waitduration);
-                                if (vpl::async_op_status::ready == st) {
-                                    return dec_surface_out;
-                                }
-                            } while (st == vpl::async_op_status::timeout);
-                            break;
-                        case vpl::status::EndOfStreamReached:
-                            is_stillgoing = false;
-                            break;
-                        case vpl::status::NotEnoughData:
-                            break;
-                        case vpl::status::DeviceBusy:
-                            break;
-                        default:
-                            is_stillgoing = false;
-                            break;
-                    }
-                }
-                throw py::stop_iteration();
-            });
+            .def("__next__",
+                 [](Class *self) {
+                     std::shared_ptr<vpl::frame_surface> surface;
+                     {
+                         py::gil_scoped_release release;
+                         surface = decode_next(self);
+                     }
+                     if (!surface)
+                         throw py::stop_iteration();
+                     return surface;
+                 })
+            .def(
+                "prefetch",
+                [](std::shared_ptr<Class> self, uint32_t depth) {
+                    return std::make_shared<Iterator>(self, depth);
+                },
+                py::arg("depth") = 4,
+                "Returns iterator which decodes up to depth frames ahead on a native thread without GIL. The session must not be used directly until the iterator is closed. It is a plain iterator, not an asynchronous one: it has no __aiter__/__anext__ and can't be used with async for. Waiting in __next__ releases GIL, so asyncio code can call it through asyncio.to_thread(next, frames, None), which returns None at the end of stream.");
+
+        py::class_<Iterator, std::shared_ptr<Iterator>>(m, (typestr + "_prefetch_iterator").c_str())
+            .def("__iter__",
+                 [](py::object self) {
+                     return self;
+                 })
+            .def("__next__", &Iterator::next, "Returns next decoded frame")
+            .def("close",
+                 &Iterator::close,
+                 "Stops decoding and drops the frames which weren't returned yet",
+                 py::call_guard<py::gil_scoped_release>());
     }
 };
 
@@ -120,44 +397,56 @@ void init_session(const py::module &m) {
         .def("alloc_input",
              &vpl::encode_session::alloc_input,
              "Allocate and return shared pointer to the surface")
+        .def("alloc_output",
+             &vpl::encode_session::alloc_output,
+             "Return bitstream from the session's pool. It returns to the pool once released")
+        .def_property_readonly("BitstreamPoolStat",
+                               &vpl::encode_session::get_bitstream_pool_stat,
+                               "Retrieve bitstream pool statistic")
         //.def("sync", &vpl::encode_session::sync)
         .def("encode_frame",
              py::overload_cast<std::shared_ptr<vpl::frame_surface>,
                                std::shared_ptr<vpl::bitstream_as_dst>,
                                vpl::encoder_process_list>(&vpl::encode_session::encode_frame),
-             "Encodes frame")
+             "Encodes frame",
+             py::call_guard<py::gil_scoped_release>())
         .def("encode_frame",
              py::overload_cast<std::shared_ptr<vpl::bitstream_as_dst>, vpl::encoder_process_list>(
                  &vpl::encode_session::encode_frame),
-             "Encodes frame by using provided source reader to get data to encode")
+             "Encodes frame by using provided source reader to get data to encode",
+             py::call_guard<py::gil_scoped_release>())
         .def(
             "process",
             &vpl::encode_session::process,
-            "Encode frame. Function returns the future object with the bitstream which will hold processed data. User needs to sync up the future object before accessing.")
+            "Encode frame. Function returns the future object with the bitstream which will hold processed data. User needs to sync up the future object before accessing.",
+            py::call_guard<py::gil_scoped_release>())
+        .def(
+            "encode_batch",
+            [](vpl::encode_session *self, py::object frames) {
+                frame_batch batch(frames, self->working_params()->get_frame_info());
+                std::vector<std::shared_ptr<vpl::bitstream_as_dst>> out;
+                {
+                    py::gil_scoped_release release;
+                    out = encode_batch(self, batch);
+                }
+                return out;
+            },
+            py::arg("frames"),
+            "Copies or converts N frames into input surfaces and submits them to the encoder without GIL. Frames are an array of N raw frames in the layout of the input format, a tuple of N-frame arrays per plane, or an (N, H, W, 3|4) array of BGR(A) pixels for NV12, I420 or BGRA input. Returns bitstreams of the submissions which produced output, to be synced before accessing. The list can be shorter than N: frames buffered by the encoder come out with the next batches or with draining by encode_frame(None, bitstream).")
         .def_property_readonly("Stat", &vpl::encode_session::getStat, "Retrieve encoder statistic")
         .def("__iter__",
              [](vpl::encode_session *self) -> vpl::encode_session & {
                  return *self;
              })
-        .def("__next__", [](vpl::encode_session *self) -> std::shared_ptr<vpl::bitstream_as_dst> {
-            std::shared_ptr<vpl::bitstream_as_dst> bits = std::make_shared<vpl::bitstream_as_dst>();
-            while (true) {
-                vpl::status wrn = vpl::status::Ok;
-                wrn             = self->encode_frame(bits);
-                switch (wrn) {
-                    case vpl::status::Ok: {
-                        std::chrono::duration<int, std::milli> waitduration(100);
-                        bits->wait_for(waitduration);
-                        return bits;
-                    } break;
-                    case vpl::status::EndOfStreamReached:
-                        throw py::stop_iteration();
-                    case vpl::status::DeviceBusy:
-                        continue;
-                    default:
-                        throw py::stop_iteration();
-                }
+        .def("__next__", [](vpl::encode_session *self) {
+            std::shared_ptr<vpl::bitstream_as_dst> bits;
+            {
+                py::gil_scoped_release release;
+                bits = encode_next(self);
             }
+            if (!bits)
+                throw py::stop_iteration();
+            return bits;
         });
 
     session_template<vpl::vpp_video_param, vpl::vpp_init_reset_list, vpl::vpp_init_reset_list>(
@@ -185,49 +474,45 @@ void init_session(const py::module &m) {
             py::overload_cast<std::shared_ptr<vpl::frame_surface>,
                               std::shared_ptr<vpl::frame_surface> &>(
                 &vpl::vpp_session::process_frame),
-            "Process frame. Function returns the surface which will hold processed data. User need to sync up the surface data before accessing.")
+            "Process frame. Function returns the surface which will hold processed data. User need to sync up the surface data before accessing.",
+            py::call_guard<py::gil_scoped_release>())
         .def(
             "process_frame",
             py::overload_cast<std::shared_ptr<vpl::frame_surface> &>(
                 &vpl::vpp_session::process_frame),
-            "Process frame. Function returns the surface which will hold processed data. User need to sync up the surface data before accessing.")
+            "Process frame. Function returns the surface which will hold processed data. User need to sync up the surface data before accessing.",
+            py::call_guard<py::gil_scoped_release>())
         .def(
             "process",
             &vpl::vpp_session::process,
-            "Process frame. Function returns the future object with the surface which will hold processed data. User need to sync up the future object before accessing.")
+            "Process frame. Function returns the future object with the surface which will hold processed data. User need to sync up the future object before accessing.",
+            py::call_guard<py::gil_scoped_release>())
+        .def(
+            "process_batch",
+            [](vpl::vpp_session *self, py::object frames) {
+                frame_batch batch(frames, self->working_params()->get_in_frame_info());
+                std::vector<std::shared_ptr<vpl::frame_surface>> out;
+                {
+                    py::gil_scoped_release release;
+                    out = vpp_batch(self, batch);
+                }
+                return out;
+            },
+            py::arg("frames"),
+            "Copies or converts N frames into input surfaces and submits them to VPP without GIL. Frames are an array of N raw frames in the layout of the input format, a tuple of N-frame arrays per plane, or an (N, H, W, 3|4) array of BGR(A) pixels for NV12, I420 or BGRA input. Returns output surfaces, to be synced before accessing. The list length differs from N when VPP converts frame rate: more surfaces are returned when VPP asks for more output (NotEnoughSurface), fewer when it needs more input. Frames VPP keeps come out with draining by process_frame(None, surface).")
         .def_property_readonly("Stat", &vpl::vpp_session::getStat, "Retrieve vpp statistic")
         .def("__iter__",
              [](vpl::vpp_session *self) -> vpl::vpp_session & {
                  return *self;
              })
-        .def("__next__", [](vpl::vpp_session *self) -> std::shared_ptr<vpl::frame_surface> {
-            std::shared_ptr<vpl::frame_surface> proc_surface_out =
-                std::make_shared<vpl::frame_surface>();
-            oneapi::vpl::status wrn = oneapi::vpl::status::Ok;
-            bool is_stillgoing      = true;
-            while (is_stillgoing == true) {
-                wrn = self->process_frame(proc_surface_out);
-                switch (wrn) {
-                    case oneapi::vpl::status::Ok: {
-                        oneapi::vpl::async_op_status st;
-                        do {
-                            std::chrono::duration<int, std::milli> waitduration(100);
-                            st = proc_surface_out->wait_for(waitduration);
-                            if (oneapi::vpl::async_op_status::ready == st) {
-                                return proc_surface_out;
-                            }
-                        } while (st == oneapi::vpl::async_op_status::timeout);
-                    } break;
-                    case oneapi::vpl::status::NotEnoughBuffer:
-                        break;
-                    case oneapi::vpl::status::NotEnoughData:
-                        throw py::stop_iteration();
-                    case oneapi::vpl::status::DeviceBusy:
-                        break;
-                    default:
-                        throw py::stop_iteration();
-                }
+        .def("__next__", [](vpl::vpp_session *self) {
+            std::shared_ptr<vpl::frame_surface> surface;
+            {
+                py::gil_scoped_release release;
+                surface = vpp_next(self);
             }
-            throw py::stop_iteration();
+            if (!surface)
+                throw py::stop_iteration();
+            return surface;
         });
 }
\ No newline at end of file
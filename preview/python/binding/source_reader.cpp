@@ -110,6 +110,32 @@ void init_source_reader(const py::module &m) {
                                &vpl::raw_frame_file_reader_by_name::get_data,
                                "Read and store portion of data into the @p bitstream object");
 
+    py::class_<vpl::raw_frame_file_prefetch_reader::statistic>(m, "frame_prefetch_statistic")
+        .def_readonly("frames",
+                      &vpl::raw_frame_file_prefetch_reader::statistic::frames,
+                      "Number of frames returned by the reader")
+        .def_readonly("waits",
+                      &vpl::raw_frame_file_prefetch_reader::statistic::waits,
+                      "Number of reads which waited for the file");
+
+    py::class_<vpl::raw_frame_file_prefetch_reader,
+               vpl::frame_source_reader,
+               std::shared_ptr<vpl::raw_frame_file_prefetch_reader>>(
+        m,
+        "raw_frame_file_prefetch_reader")
+        .def(py::init<uint16_t, uint16_t, vpl::color_format_fourcc, std::string &, uint32_t>(),
+             py::arg("width"),
+             py::arg("height"),
+             py::arg("format"),
+             py::arg("name"),
+             py::arg("depth") = 4)
+        .def_property_readonly("data",
+                               &vpl::raw_frame_file_prefetch_reader::get_data,
+                               "Read and store portion of data into the @p bitstream object")
+        .def_property_readonly("stat",
+                               &vpl::raw_frame_file_prefetch_reader::get_stat,
+                               "Returns reader statistic");
+
     py::class_<vpl::bitstream_source_reader,
                vpl::source_reader,
                std::shared_ptr<vpl::bitstream_source_reader>>(m, "bitstream_source_reader")
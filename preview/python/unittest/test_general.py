@@ -10,6 +10,7 @@ Test basic use cases
 import unittest
 import os
 import math
+import numpy
 import pyvpl
 
 # Folder this script is in
@@ -77,6 +78,41 @@ class TestUseCases(unittest.TestCase):
                     frame = None
         self.assertEqual(frame_count, 60)
 
+    def test_decode_prefetch(self):
+        """Test Decode with prefetch and NumPy plane views"""
+        frame_count = 0
+        with pyvpl.bitstream_file_reader_name(HEVC_CLIP) as source:
+            opts = pyvpl.properties()
+            opts.impl = pyvpl.implementation_type.sw
+            opts.api_version = (2, 5)
+            opts.decoder.codec_id = [pyvpl.codec_format_fourcc.hevc]
+            sel_default = pyvpl.default_selector(opts)
+
+            params = pyvpl.decoder_video_param()
+            params.IOPattern = pyvpl.io_pattern.out_system_memory
+            params.CodecId = pyvpl.codec_format_fourcc.hevc
+            decoder = pyvpl.decode_session(sel_default, params, source)
+            init_header_list = pyvpl.decoder_init_header_list()
+            init_reset_list = pyvpl.decoder_init_reset_list()
+            decoder.init_by_header(init_header_list, init_reset_list)
+
+            frames = decoder.prefetch(4)
+            try:
+                for frame in frames:
+                    frame_count += 1
+                    y, u, v = frame.planes(pyvpl.memory_access.read)
+                    self.assertGreaterEqual(y.shape[0], 96)
+                    self.assertGreaterEqual(y.shape[1], 128)
+                    self.assertEqual(u.shape, v.shape)
+                    self.assertEqual(u.shape[0] * 2, y.shape[0])
+                    self.assertFalse(y.flags.writeable)
+                    # surface stays mapped while views are alive
+                    y = u = v = None
+                    frame = None
+            finally:
+                frames.close()
+        self.assertEqual(frame_count, 60)
+
     def test_encode(self):
         """Test Encode"""
         frame_count = 0
@@ -126,6 +162,126 @@ class TestUseCases(unittest.TestCase):
 
         self.assertEqual(frame_count, 60)
 
+    def test_encode_batch(self):
+        """Test Encode of NumPy frame batches"""
+        frame_size = 128 * 96 * 3 // 2
+        frames = numpy.fromfile(I420_CLIP, dtype=numpy.uint8)
+        frames = frames[:len(frames) // frame_size * frame_size]
+        frames = frames.reshape(-1, 96 * 3 // 2, 128)
+
+        opts = []
+        opts.append(pyvpl.dprops.impl(pyvpl.implementation_type.sw))
+        opts.append(
+            pyvpl.dprops.encoder(
+                [pyvpl.dprops.codec_id(pyvpl.codec_format_fourcc.hevc)]))
+        props = pyvpl.property_list(opts)
+        sel_default = pyvpl.default_selector(props)
+        session = pyvpl.encode_session(sel_default)
+
+        params = pyvpl.encoder_video_param()
+        info = pyvpl.frame_info()
+        info.frame_rate = (30, 1)
+        info.frame_size = (roundup(128, 16), roundup(96, 16))
+        info.FourCC = pyvpl.color_format_fourcc.i420
+        info.ChromaFormat = pyvpl.chroma_format_idc.yuv420
+        info.ROI = ((0, 0), (128, 96))
+        params.RateControlMethod = pyvpl.rate_control_method.cqp
+        params.frame_info = info
+        params.CodecId = pyvpl.codec_format_fourcc.hevc
+        params.IOPattern = pyvpl.io_pattern.in_system_memory
+        session.Init(params, pyvpl.encoder_init_list())
+
+        frame_count = 0
+        for first in range(0, len(frames), 16):
+            for bits in session.encode_batch(frames[first:first + 16]):
+                bits.wait()
+                frame_count += 1
+
+        while True:
+            bits = session.alloc_output()
+            wrn = session.encode_frame(None, bits,
+                                       pyvpl.encoder_process_list())
+            if wrn == pyvpl.status.EndOfStreamReached:
+                break
+            if wrn == pyvpl.status.Ok:
+                bits.wait()
+                frame_count += 1
+
+        self.assertEqual(frame_count, len(frames))
+
+        with self.assertRaises(ValueError):
+            session.encode_batch(numpy.zeros((1, 10, 10), numpy.uint8))
+
+    def _vpp_batch_session(self, out_rate):
+        """Create VPP session for I420 frames of the clip, output rate is out_rate"""
+        opts = []
+        opts.append(pyvpl.dprops.impl(pyvpl.implementation_type.sw))
+        sel_default = pyvpl.default_selector(pyvpl.property_list(opts))
+        params = pyvpl.vpp_video_param()
+        in_frame = pyvpl.frame_info()
+        in_frame.FourCC = pyvpl.color_format_fourcc.i420
+        in_frame.ChromaFormat = pyvpl.chroma_format_idc.yuv420
+        in_frame.PicStruct = pyvpl.pic_struct.progressive
+        in_frame.frame_rate = (30, 1)
+        in_frame.ROI = ((0, 0), (128, 96))
+        in_frame.frame_size = (roundup(128, 16), roundup(96, 16))
+        params.in_frame_info = in_frame
+        out_frame = pyvpl.frame_info()
+        out_frame.FourCC = pyvpl.color_format_fourcc.i420
+        out_frame.ChromaFormat = pyvpl.chroma_format_idc.yuv420
+        out_frame.PicStruct = pyvpl.pic_struct.progressive
+        out_frame.frame_rate = out_rate
+        out_frame.ROI = ((0, 0), (128, 96))
+        out_frame.frame_size = (roundup(128, 16), roundup(96, 16))
+        params.out_frame_info = out_frame
+        params.IOPattern = pyvpl.io_pattern.io_system_memory
+        session = pyvpl.vpp_session(sel_default)
+        session.Init(params, pyvpl.vpp_init_reset_list())
+        return session
+
+    def _process_batches(self, session, frames, batch_size):
+        """Submit frames by batches, drain VPP, return numbers of outputs"""
+        batch_outputs = []
+        for first in range(0, len(frames), batch_size):
+            surfaces = session.process_batch(frames[first:first + batch_size])
+            for surface in surfaces:
+                surface.wait()
+            batch_outputs.append(len(surfaces))
+
+        drained = 0
+        while True:
+            surface = pyvpl.frame_surface()
+            wrn = session.process_frame(None, surface)
+            if wrn == pyvpl.status.EndOfStreamReached:
+                break
+            if wrn in (pyvpl.status.Ok, pyvpl.status.NotEnoughSurface):
+                surface.wait()
+                drained += 1
+        return batch_outputs, drained
+
+    def test_process_batch(self):
+        """Test VPP of NumPy frame batches"""
+        frame_size = 128 * 96 * 3 // 2
+        frames = numpy.fromfile(I420_CLIP, dtype=numpy.uint8)
+        frames = frames[:len(frames) // frame_size * frame_size]
+        frames = frames.reshape(-1, 96 * 3 // 2, 128)
+
+        # same rate: one output per input frame
+        session = self._vpp_batch_session((30, 1))
+        batch_outputs, drained = self._process_batches(session, frames, 16)
+        self.assertEqual(sum(batch_outputs) + drained, len(frames))
+
+        # doubled rate: VPP asks for more output surfaces for the same input
+        # (NotEnoughSurface), so a batch returns more surfaces than frames
+        session = self._vpp_batch_session((60, 1))
+        batch_outputs, drained = self._process_batches(session, frames, 16)
+        self.assertGreater(max(batch_outputs), 16)
+        self.assertGreaterEqual(sum(batch_outputs) + drained,
+                                2 * len(frames) - 1)
+
+        with self.assertRaises(ValueError):
+            session.process_batch(numpy.zeros((1, 10, 10), numpy.uint8))
+
     def test_vpp(self):
         """Test VPP"""
         frame_count = 0
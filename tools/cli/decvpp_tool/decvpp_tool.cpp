@@ -10,6 +10,8 @@
 ///
 /// @file
 
+#include "multi_stream.hpp"
+#include "pipeline.hpp"
 #include "util.hpp"
 
 #define BITSTREAM_BUFFER_SIZE 2000000
@@ -29,6 +31,25 @@ void Usage(void) {
     printf("     -vpp_out       file name for each vpp out\n");
     printf("                    ',' separator for each vpp channel\n\n");
     printf("     -vmem          use video memory\n\n");
+    printf("     -hash          file name for xxh64 hashes of all output frames,\n");
+    printf("                    frames are verified without writing them to disk\n\n");
+    printf("     -hash_golden   golden hash log to compare output frames with,\n");
+    printf("                    processing stops on the first mismatch\n\n");
+    printf("     -async         pipelined mode, number of frames each channel can be\n");
+    printf("                    submitted ahead of its writer thread (max %d)\n\n",
+           MAX_ASYNC_DEPTH);
+    printf("     -benchmark     skip output files, report fps and latency of each channel\n\n");
+    printf("     -streams       multi-stream benchmark, number of concurrent sessions (max %d)\n",
+           MAX_STREAMS);
+    printf("                    -i takes ',' separated inputs, they are assigned to sessions\n");
+    printf("                    in turn and looped for the duration of the run\n\n");
+    printf("     -duration      multi-stream run time in seconds (default 10)\n\n");
+    printf("     -target_fps    find maximum number of streams sustaining this fps in each\n");
+    printf("                    session, -streams is the upper limit of the search\n\n");
+    printf("     -cpus          CPU sets to pin sessions to, e.g. 0-3:4-7,12\n");
+    printf("                    ':' separator for each set, sessions take them in turn\n\n");
+    printf("     -json          file name of the multi-stream JSON report (default stdout)\n");
+    printf("                    progress of the runs goes to stderr\n\n");
     printf("   Example: \n");
     printf(
         "     decvpp_tool h265 -sw -i cars_128x96.h265 -o dec.raw -vpp_num 2 -vpp_params 320x240_i420,640x480_bgra -vpp_out o1.raw,o2.raw\n");
@@ -38,7 +59,10 @@ void Usage(void) {
     printf("     this will generate 1 decode output file and 2 vpp output files\n");
     printf("     dec.raw : decode output  : 128 x 96,  (-sw: i420, -hw: nv12)\n");
     printf("     o1.raw  : 1st vpp output : 320 x 240, (-sw: i420, -hw: nv12)\n");
-    printf("     o2.raw  : 2st vpp output : 640 x 480, bgra\n");
+    printf("     o2.raw  : 2st vpp output : 640 x 480, bgra\n\n");
+    printf(
+        "     decvpp_tool h265 -hw -i a.h265,b.h265 -vpp_num 2 -vpp_params 1280x720_nv12,640x360_nv12 -target_fps 30 -json report.json\n\n");
+    printf("     this will find how many decode and 2 channel VPP streams sustain 30 fps\n");
 
     return;
 }
@@ -50,6 +74,9 @@ int main(int argc, char *argv[]) {
     FILE *sinkDec                         = NULL; // for decoded frames
     FILE **sinkVPP                        = NULL; // for vpp output
     FILE *source                          = NULL;
+    FILE *hashLog                         = NULL; // for frame hashes
+    FILE *hashGolden                      = NULL;
+    bool isHashMismatch                   = false;
     int accel_fd                          = 0;
     mfxBitstream bitstream                = {};
     mfxSession session                    = NULL;
@@ -62,6 +89,11 @@ int main(int argc, char *argv[]) {
     mfxVideoParam mfxDecParams            = {};
     mfxVersion version                    = { 0, 1 };
     mfxFrameSurface1 *aSurf               = nullptr;
+    ChannelWriter **writers               = nullptr; // for pipelined output
+    ChannelStats *stats                   = nullptr; // for benchmark
+    mfxU16 numChannels                    = 0;
+    PipelineClock::time_point startTime   = {};
+    PipelineClock::time_point submitTime  = {};
 
     //variables used only in 2.x version
     mfxConfig cfg      = NULL;
@@ -75,10 +107,20 @@ int main(int argc, char *argv[]) {
         return 1; // return 1 as error code
     }
 
+    if (cliParams.numStreams || cliParams.targetFps > 0) {
+        int ret = RunMultiStream(&cliParams);
+        delete[] cliParams.vppOutConfigs;
+        return ret;
+    }
+
     source = fopen(cliParams.inFileName, "rb");
     VERIFY(source, "ERROR - Could not open input file");
 
-    if (cliParams.decOutFileName) {
+    if (cliParams.bBenchmark) {
+        printf("Benchmark mode, output files are not written\n");
+        cliParams.decOutFileName = NULL;
+    }
+    else if (cliParams.decOutFileName) {
         sinkDec = fopen(cliParams.decOutFileName, "wb");
         VERIFY(sinkDec, "ERROR - Could not create decode output file");
     }
@@ -87,7 +129,21 @@ int main(int argc, char *argv[]) {
             "WARNING - No decode output filename assigned, will skip writing decode output file\n");
     }
 
-    if (cliParams.bIsAvailableVPPOutFileName) {
+    if (cliParams.hashFileName) {
+        hashLog = fopen(cliParams.hashFileName, "w");
+        VERIFY(hashLog, "ERROR - Could not create hash log file");
+        fprintf(hashLog, "# xxh64: frame channel fourcc size frame_hash plane_hashes\n");
+    }
+
+    if (cliParams.goldenHashFileName) {
+        hashGolden = fopen(cliParams.goldenHashFileName, "r");
+        VERIFY(hashGolden, "ERROR - Could not open golden hash log file");
+    }
+
+    if (cliParams.bBenchmark) {
+        cliParams.bIsAvailableVPPOutFileName = false;
+    }
+    else if (cliParams.bIsAvailableVPPOutFileName) {
         sinkVPP = new FILE *[cliParams.vppNum];
         VERIFY(sinkVPP, "ERROR - Could not create vpp list");
 
@@ -178,36 +234,31 @@ int main(int argc, char *argv[]) {
     mfxVPPChParams = new mfxVideoChannelParam *[cliParams.vppNum];
     for (mfxU16 i = 0; i < cliParams.vppNum; i++) {
         mfxVPPChParams[i] = new mfxVideoChannelParam;
-        memset(mfxVPPChParams[i], 0, sizeof(mfxVideoChannelParam));
-
-        // scaled output to 320x240
-        mfxVPPChParams[i]->VPP.FourCC        = cliParams.vppOutConfigs[i].fourcc;
-        mfxVPPChParams[i]->VPP.ChromaFormat  = MFX_CHROMAFORMAT_YUV420;
-        mfxVPPChParams[i]->VPP.PicStruct     = MFX_PICSTRUCT_PROGRESSIVE;
-        mfxVPPChParams[i]->VPP.FrameRateExtN = mfxDecParams.mfx.FrameInfo.FrameRateExtN;
-        mfxVPPChParams[i]->VPP.FrameRateExtD = mfxDecParams.mfx.FrameInfo.FrameRateExtD;
-        mfxVPPChParams[i]->VPP.CropW         = cliParams.vppOutConfigs[i].w;
-        mfxVPPChParams[i]->VPP.CropH         = cliParams.vppOutConfigs[i].h;
-        mfxVPPChParams[i]->VPP.Width         = ALIGN16(mfxVPPChParams[i]->VPP.CropW);
-        mfxVPPChParams[i]->VPP.Height        = ALIGN16(mfxVPPChParams[i]->VPP.CropH);
-        mfxVPPChParams[i]->VPP.ChannelId     = i + 1;
-        mfxVPPChParams[i]->Protected         = 0;
-        if (cliParams.bUseVideoMemory) {
-            mfxVPPChParams[i]->IOPattern =
-                MFX_IOPATTERN_IN_VIDEO_MEMORY | MFX_IOPATTERN_OUT_VIDEO_MEMORY;
-        }
-        else {
-            mfxVPPChParams[i]->IOPattern =
-                MFX_IOPATTERN_IN_SYSTEM_MEMORY | MFX_IOPATTERN_OUT_SYSTEM_MEMORY;
-        }
-        mfxVPPChParams[i]->ExtParam    = NULL;
-        mfxVPPChParams[i]->NumExtParam = 0;
+        PrepareVPPChannelParams(&cliParams, &mfxDecParams.mfx.FrameInfo, i, mfxVPPChParams[i]);
     }
 
     sts = MFXVideoDECODE_VPP_Init(session, &mfxDecParams, mfxVPPChParams, cliParams.vppNum);
     VERIFY(MFX_ERR_NONE == sts, "ERROR - Initializing decodevpp\n");
 
+    // channel 0 is decode output, channels 1..vppNum are VPP outputs
+    numChannels = static_cast<mfxU16>(cliParams.vppNum + 1);
+    if (cliParams.bBenchmark)
+        stats = new ChannelStats[numChannels];
+
+    if (cliParams.asyncDepth) {
+        writers = new ChannelWriter *[numChannels];
+        for (mfxU16 i = 0; i < numChannels; i++) {
+            FILE *sink = (i == 0) ? sinkDec : (sinkVPP ? sinkVPP[i - 1] : NULL);
+            writers[i] = new ChannelWriter(sink,
+                                           stats ? &stats[i] : NULL,
+                                           cliParams.asyncDepth,
+                                           SYNC_TIMEOUT);
+        }
+        printf("Pipelined mode, async depth %d\n", cliParams.asyncDepth);
+    }
+
     printf("Start decoding and VPP ..\n");
+    startTime = PipelineClock::now();
 
     // output frames will be delivered in outSurfaces->Surfaces[]
     // outSurfaces->Surfaces[0]    : decode output
@@ -220,11 +271,12 @@ int main(int argc, char *argv[]) {
                 isDraining = true;
         }
 
-        sts = MFXVideoDECODE_VPP_DecodeFrameAsync(session,
-                                                  (isDraining) ? NULL : &bitstream,
-                                                  NULL,
-                                                  0,
-                                                  &outSurfaces);
+        submitTime = PipelineClock::now();
+        sts        = MFXVideoDECODE_VPP_DecodeFrameAsync(session,
+                                                         (isDraining) ? NULL : &bitstream,
+                                                         NULL,
+                                                         0,
+                                                         &outSurfaces);
 
         switch (sts) {
             case MFX_ERR_NONE:
@@ -235,14 +287,42 @@ int main(int argc, char *argv[]) {
                     continue;
                 }
 
-                for (mfxU32 i = 0; i < outSurfaces->NumSurfaces; i++) {
+                if (writers) {
+                    // writers take over references of the surfaces
+                    for (mfxU32 i = 0; i < outSurfaces->NumSurfaces; i++) {
+                        aSurf = outSurfaces->Surfaces[i];
+                        if (aSurf->Info.ChannelId < numChannels) {
+                            writers[aSurf->Info.ChannelId]->Push(aSurf, submitTime);
+                        }
+                        else {
+                            sts = aSurf->FrameInterface->Release(aSurf);
+                            VERIFY(MFX_ERR_NONE == sts,
+                                   "ERROR - mfxFrameSurfaceInterface->Release failed");
+                        }
+                    }
+                    for (mfxU16 i = 0; i < numChannels; i++) {
+                        sts = writers[i]->GetStatus();
+                        VERIFY(MFX_ERR_NONE == sts, "ERROR - Pipelined output failed");
+                    }
+                }
+
+                for (mfxU32 i = 0; !writers && i < outSurfaces->NumSurfaces; i++) {
                     aSurf = outSurfaces->Surfaces[i];
 
                     sts = aSurf->FrameInterface->Synchronize(aSurf, SYNC_TIMEOUT);
                     VERIFY(MFX_ERR_NONE == sts, "ERROR - FrameInterface->Synchronizee failed");
 
+                    if (stats && aSurf->Info.ChannelId < numChannels)
+                        stats[aSurf->Info.ChannelId].Add(submitTime, PipelineClock::now());
+
+                    if (hashLog || hashGolden) {
+                        sts = HashRawFrame_InternalMem(aSurf, framenum, hashLog, hashGolden);
+                        isHashMismatch = (MFX_ERR_ABORTED == sts);
+                        VERIFY(MFX_ERR_NONE == sts, "ERROR - Could not verify output hash");
+                    }
+
                     if (aSurf->Info.ChannelId == 0) { // decoder output
-                        if (cliParams.decOutFileName) {
+                        if (sinkDec) {
                             sts = WriteRawFrame_InternalMem(aSurf, sinkDec);
                             VERIFY(MFX_ERR_NONE == sts, "ERROR - Could not write decode output");
                         }
@@ -310,9 +390,34 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (writers) {
+        // wait for the output of queued frames
+        for (mfxU16 i = 0; i < numChannels; i++) {
+            writers[i]->Close();
+            if (sts == MFX_ERR_NONE)
+                sts = writers[i]->GetStatus();
+        }
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Pipelined output failed");
+    }
+
+    if (sts == MFX_ERR_NONE && hashGolden) {
+        char extra[256];
+        // golden log must not have more frames
+        while (fgets(extra, sizeof(extra), hashGolden)) {
+            if (extra[0] != '#' && extra[strspn(extra, " \r\n")] != 0) {
+                printf("ERROR - Hash mismatch, golden log has more than %d frames\n", framenum);
+                isHashMismatch = true;
+                goto end;
+            }
+        }
+        printf("Hash check passed: %d frames match the golden log\n", framenum);
+    }
+
     if (sts == MFX_ERR_NONE) {
         printf("Decode and VPP processed %d frames\n", framenum);
         DisplayDecVPPSummary(&cliParams);
+        if (stats)
+            DisplayChannelStats(stats, numChannels, startTime);
     }
 
 end:
@@ -320,6 +425,16 @@ end:
     // Clean up resources - It is recommended to close components first, before
     // releasing allocated surfaces, since some surfaces may still be locked by
     // internal resources.
+    if (writers) {
+        // writers release the rest of queued surfaces
+        for (mfxU16 i = 0; i < numChannels; i++)
+            delete writers[i];
+        delete[] writers;
+    }
+
+    if (stats)
+        delete[] stats;
+
     if (mfxVPPChParams) {
         for (mfxU16 i = 0; i < cliParams.vppNum; i++) {
             if (mfxVPPChParams[i])
@@ -334,6 +449,12 @@ end:
     if (sinkDec)
         fclose(sinkDec);
 
+    if (hashLog)
+        fclose(hashLog);
+
+    if (hashGolden)
+        fclose(hashGolden);
+
     if (cliParams.bIsAvailableVPPOutFileName && sinkVPP) {
         for (mfxU16 i = 0; i < cliParams.vppNum; i++) {
             if (sinkVPP[i])
@@ -353,5 +474,5 @@ end:
     if (loader)
         MFXUnload(loader);
     delete[] cliParams.vppOutConfigs;
-    return 0;
+    return isHashMismatch ? 1 : 0;
 }
@@ -0,0 +1,603 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Multi-stream benchmark: concurrent decode and VPP sessions created from one
+/// loader, JSON report and search of the sustainable number of streams
+///
+/// @file
+
+#ifndef TOOLS_CLI_DECVPP_TOOL_MULTI_STREAM_HPP_
+#define TOOLS_CLI_DECVPP_TOOL_MULTI_STREAM_HPP_
+
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "util.hpp"
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#define STREAM_BITSTREAM_BUFFER_SIZE 2000000
+#define STREAM_SYNC_TIMEOUT          60000
+
+// Parses CPU list like "0-3,8" into CPU numbers
+bool ParseCPUList(const std::string &list, std::vector<int> *cpus) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+
+        std::string range = list.substr(pos, end - pos);
+        size_t dash       = range.find('-');
+        char *tail        = NULL;
+        long first        = strtol(range.c_str(), &tail, 10);
+        long last         = first;
+        if (dash != std::string::npos)
+            last = strtol(range.c_str() + dash + 1, &tail, 10);
+        if (range.empty() || *tail != 0 || first < 0 || last < first)
+            return false;
+
+        for (long cpu = first; cpu <= last; cpu++)
+            cpus->push_back(static_cast<int>(cpu));
+        pos = end + 1;
+    }
+    return !cpus->empty();
+}
+
+// Pins the calling thread, threads created by it afterwards inherit the affinity
+bool PinThreadToCPUs(const std::vector<int> &cpus) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32) || defined(_WIN64)
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+        if (cpu >= static_cast<int>(sizeof(mask) * 8))
+            return false;
+        mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    return false;
+#endif
+}
+
+// Splits str by separator, empty items are skipped
+std::vector<std::string> SplitList(const char *str, char separator) {
+    std::vector<std::string> items;
+    std::string s(str ? str : "");
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(separator, pos);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > pos)
+            items.push_back(s.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return items;
+}
+
+std::string JsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        }
+        else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Starts all sessions of a run at the same time, after every one of them is
+// initialized
+class StreamStartGate {
+public:
+    explicit StreamStartGate(mfxU32 count)
+            : count_(count),
+              ready_(0),
+              start_(),
+              loaderMtx_(),
+              mtx_(),
+              cv_() {}
+
+    // Serializes MFXCreateSession calls of the session threads on the loader
+    // they share
+    std::mutex &GetLoaderMutex() {
+        return loaderMtx_;
+    }
+
+    // Returns the common start time
+    PipelineClock::time_point Arrive() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (++ready_ == count_) {
+            start_ = PipelineClock::now();
+            cv_.notify_all();
+        }
+        cv_.wait(lock, [this]() {
+            return ready_ == count_;
+        });
+        return start_;
+    }
+
+private:
+    mfxU32 count_;
+    mfxU32 ready_;
+    PipelineClock::time_point start_;
+    std::mutex loaderMtx_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+// One decode and VPP session of the benchmark, it runs on its own thread
+class StreamSession {
+public:
+    StreamSession(mfxU32 id, const std::string &inFileName, const std::string &cpus)
+            : id_(id),
+              inFileName_(inFileName),
+              cpus_(cpus),
+              sts_(MFX_ERR_NONE),
+              loops_(0),
+              start_(),
+              stats_() {}
+
+    void Run(mfxLoader loader, Params *params, StreamStartGate *gate) {
+        FILE *source                          = NULL;
+        int accel_fd                          = 0;
+        mfxBitstream bitstream                = {};
+        mfxSession session                    = NULL;
+        mfxStatus sts                         = MFX_ERR_NONE;
+        mfxStatus syncSts                     = MFX_ERR_NONE;
+        mfxStatus releaseSts                  = MFX_ERR_NONE;
+        mfxSurfaceArray *outSurfaces          = nullptr;
+        mfxVideoChannelParam **mfxVPPChParams = nullptr;
+        mfxVideoParam mfxDecParams            = {};
+        mfxFrameSurface1 *aSurf               = nullptr;
+        ChannelWriter **writers               = nullptr;
+        mfxU16 numChannels                    = static_cast<mfxU16>(params->vppNum + 1);
+        bool isDraining                       = false;
+        bool isStillGoing                     = true;
+        bool isGateArrived                    = false;
+        std::vector<int> cpuList;
+        PipelineClock::time_point deadline;
+        PipelineClock::time_point submitTime;
+
+        stats_.resize(numChannels);
+
+        if (!cpus_.empty()) {
+            sts = MFX_ERR_UNSUPPORTED;
+            VERIFY(ParseCPUList(cpus_, &cpuList) && PinThreadToCPUs(cpuList),
+                   "ERROR - Could not pin session to CPU set");
+        }
+
+        sts    = MFX_ERR_NOT_FOUND;
+        source = fopen(inFileName_.c_str(), "rb");
+        VERIFY(source, "ERROR - Could not open input file");
+
+        {
+            std::lock_guard<std::mutex> lock(gate->GetLoaderMutex());
+            sts = MFXCreateSession(loader, 0, &session);
+        }
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Not able to create VPL session");
+
+        sts = InitAcceleratorHandle(session, &accel_fd);
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Not able to create hw device");
+
+        sts                 = MFX_ERR_MEMORY_ALLOC;
+        bitstream.MaxLength = STREAM_BITSTREAM_BUFFER_SIZE;
+        bitstream.Data = reinterpret_cast<mfxU8 *>(calloc(bitstream.MaxLength, sizeof(mfxU8)));
+        VERIFY(bitstream.Data, "ERROR - Not able to allocate input buffer");
+        bitstream.CodecId = params->inCodec;
+
+        sts = ReadEncodedStream(bitstream, source);
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Reading bitstream");
+
+        mfxDecParams.mfx.CodecId = params->inCodec;
+        mfxDecParams.IOPattern   = (params->bUseVideoMemory) ? MFX_IOPATTERN_OUT_VIDEO_MEMORY
+                                                             : MFX_IOPATTERN_OUT_SYSTEM_MEMORY;
+        sts = MFXVideoDECODE_DecodeHeader(session, &bitstream, &mfxDecParams);
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Decoding header");
+
+        // VPP requires non zero frame rate
+        if (0 == mfxDecParams.mfx.FrameInfo.FrameRateExtN &&
+            0 == mfxDecParams.mfx.FrameInfo.FrameRateExtD) {
+            mfxDecParams.mfx.FrameInfo.FrameRateExtN = 30;
+            mfxDecParams.mfx.FrameInfo.FrameRateExtD = 1;
+        }
+
+        mfxVPPChParams = new mfxVideoChannelParam *[params->vppNum];
+        for (mfxU16 i = 0; i < params->vppNum; i++) {
+            mfxVPPChParams[i] = new mfxVideoChannelParam;
+            PrepareVPPChannelParams(params, &mfxDecParams.mfx.FrameInfo, i, mfxVPPChParams[i]);
+        }
+
+        sts = MFXVideoDECODE_VPP_Init(session, &mfxDecParams, mfxVPPChParams, params->vppNum);
+        VERIFY(MFX_ERR_NONE == sts, "ERROR - Initializing decodevpp");
+
+        if (params->asyncDepth) {
+            writers = new ChannelWriter *[numChannels];
+            for (mfxU16 i = 0; i < numChannels; i++)
+                writers[i] =
+                    new ChannelWriter(NULL, &stats_[i], params->asyncDepth, STREAM_SYNC_TIMEOUT);
+        }
+
+        isGateArrived = true;
+        start_        = gate->Arrive();
+        deadline      = start_ + std::chrono::seconds(params->duration);
+
+        while (isStillGoing == true) {
+            // input is looped until the end of the run, then decoder is drained
+            if (isDraining == false) {
+                if (PipelineClock::now() >= deadline) {
+                    isDraining = true;
+                }
+                else {
+                    sts = ReadEncodedStream(bitstream, source);
+                    VERIFY(MFX_ERR_NONE == sts, "ERROR - Reading bitstream");
+                    if (feof(source)) {
+                        rewind(source);
+                        loops_++;
+                    }
+                }
+            }
+
+            submitTime = PipelineClock::now();
+            sts        = MFXVideoDECODE_VPP_DecodeFrameAsync(session,
+                                                             (isDraining) ? NULL : &bitstream,
+                                                             NULL,
+                                                             0,
+                                                             &outSurfaces);
+
+            switch (sts) {
+                case MFX_ERR_NONE:
+                    sts = MFX_ERR_NULL_PTR;
+                    VERIFY(outSurfaces, "ERROR - empty array of surfaces");
+
+                    for (mfxU32 i = 0; i < outSurfaces->NumSurfaces; i++) {
+                        aSurf         = outSurfaces->Surfaces[i];
+                        mfxU16 chanId = aSurf->Info.ChannelId;
+                        if (writers && chanId < numChannels) {
+                            writers[chanId]->Push(aSurf, submitTime);
+                            continue;
+                        }
+
+                        // once a surface fails, the rest are only released
+                        if (MFX_ERR_NONE == syncSts) {
+                            syncSts = aSurf->FrameInterface->Synchronize(aSurf,
+                                                                         STREAM_SYNC_TIMEOUT);
+                            if (MFX_ERR_NONE == syncSts && chanId < numChannels)
+                                stats_[chanId].Add(submitTime, PipelineClock::now());
+                        }
+                        aSurf->FrameInterface->Release(aSurf);
+                    }
+
+                    releaseSts  = outSurfaces->Release(outSurfaces);
+                    outSurfaces = nullptr;
+
+                    sts = syncSts;
+                    VERIFY(MFX_ERR_NONE == sts, "ERROR - FrameInterface->Synchronize failed");
+                    sts = releaseSts;
+                    VERIFY(MFX_ERR_NONE == sts, "ERROR - mfxSurfaceArray->Release failed");
+
+                    for (mfxU16 i = 0; writers && i < numChannels; i++) {
+                        sts = writers[i]->GetStatus();
+                        VERIFY(MFX_ERR_NONE == sts, "ERROR - Pipelined output failed");
+                    }
+                    break;
+                case MFX_ERR_MORE_DATA:
+                    if (isDraining) {
+                        isStillGoing = false;
+                        sts          = MFX_ERR_NONE;
+                    }
+                    break;
+                case MFX_WRN_DEVICE_BUSY:
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    break;
+                case MFX_ERR_MORE_SURFACE:
+                case MFX_WRN_VIDEO_PARAM_CHANGED:
+                    break;
+                default:
+                    printf("ERROR - Unknown status %d\n", sts);
+                    VERIFY(MFX_ERR_NONE == sts, "ERROR - Decoding failed");
+                    break;
+            }
+        }
+
+        for (mfxU16 i = 0; writers && i < numChannels; i++) {
+            writers[i]->Close();
+            if (sts == MFX_ERR_NONE)
+                sts = writers[i]->GetStatus();
+        }
+
+    end:
+        // other sessions must not wait for the failed one
+        if (!isGateArrived)
+            start_ = gate->Arrive();
+
+        sts_ = sts;
+
+        if (writers) {
+            for (mfxU16 i = 0; i < numChannels; i++)
+                delete writers[i];
+            delete[] writers;
+        }
+
+        if (session) {
+            MFXVideoDECODE_VPP_Close(session);
+            MFXClose(session);
+        }
+
+        if (mfxVPPChParams) {
+            for (mfxU16 i = 0; i < params->vppNum; i++)
+                delete mfxVPPChParams[i];
+            delete[] mfxVPPChParams;
+        }
+
+        if (source)
+            fclose(source);
+
+        if (bitstream.Data)
+            free(bitstream.Data);
+
+        FreeAcceleratorHandle(NULL, accel_fd);
+    }
+
+    mfxStatus GetStatus() const {
+        return sts_;
+    }
+
+    // Frame rate of the decoder output
+    double GetFps() const {
+        return GetFps(0);
+    }
+
+    double GetFps(mfxU16 channel) const {
+        double sec = std::chrono::duration<double>(stats_[channel].GetLast() - start_).count();
+        return (sec > 0) ? stats_[channel].GetFrames() / sec : 0.0;
+    }
+
+    const std::vector<ChannelStats> &GetStats() const {
+        return stats_;
+    }
+
+    void WriteJson(std::string &out, const char *indent) const {
+        char buf[256];
+        snprintf(buf,
+                 sizeof(buf),
+                 "%s{ \"id\": %u, \"status\": %d, \"cpus\": %s, \"loops\": %u, \"fps\": %.2f,\n",
+                 indent,
+                 id_,
+                 sts_,
+                 JsonString(cpus_).c_str(),
+                 loops_,
+                 GetFps());
+        out += buf;
+        out += std::string(indent) + "  \"input\": " + JsonString(inFileName_) + ",\n";
+        out += std::string(indent) + "  \"channels\": [\n";
+        for (mfxU16 i = 0; i < stats_.size(); i++) {
+            snprintf(buf,
+                     sizeof(buf),
+                     "%s    { \"channel\": %d, \"frames\": %u, \"fps\": %.2f, "
+                     "\"latency_ms\": { \"p50\": %.3f, \"p99\": %.3f } }%s\n",
+                     indent,
+                     i,
+                     stats_[i].GetFrames(),
+                     GetFps(i),
+                     stats_[i].GetPercentile(50),
+                     stats_[i].GetPercentile(99),
+                     (i + 1u < stats_.size()) ? "," : "");
+            out += buf;
+        }
+        out += std::string(indent) + "  ] }";
+    }
+
+private:
+    mfxU32 id_;
+    std::string inFileName_;
+    std::string cpus_;
+    mfxStatus sts_;
+    mfxU32 loops_;
+    PipelineClock::time_point start_;
+    std::vector<ChannelStats> stats_;
+};
+
+// Runs count sessions for the configured duration. Returns true when every
+// session succeeded and, if target fps is set, sustained it. Report is
+// appended to json.
+bool RunStreams(mfxLoader loader, Params *params, mfxU16 count, std::string &json) {
+    std::vector<std::string> inputs = SplitList(params->inFileName, ',');
+    std::vector<std::string> cpus   = SplitList(params->cpuSets, ':');
+    std::vector<StreamSession> sessions;
+    std::vector<std::thread> threads;
+    StreamStartGate gate(count);
+
+    for (mfxU16 i = 0; i < count; i++)
+        sessions.emplace_back(i,
+                              inputs[i % inputs.size()],
+                              cpus.empty() ? std::string() : cpus[i % cpus.size()]);
+    for (mfxU16 i = 0; i < count; i++)
+        threads.emplace_back(&StreamSession::Run, &sessions[i], loader, params, &gate);
+    for (auto &t : threads)
+        t.join();
+
+    mfxU16 numChannels = static_cast<mfxU16>(params->vppNum + 1);
+    std::vector<ChannelStats> total(numChannels);
+    std::vector<double> channelFps(numChannels, 0.0);
+    double fps     = 0;
+    double minFps  = -1;
+    bool succeeded = true;
+    for (auto &s : sessions) {
+        succeeded = succeeded && (s.GetStatus() == MFX_ERR_NONE);
+        fps += s.GetFps();
+        minFps = (minFps < 0 || s.GetFps() < minFps) ? s.GetFps() : minFps;
+        for (mfxU16 i = 0; i < numChannels; i++) {
+            total[i].Merge(s.GetStats()[i]);
+            channelFps[i] += s.GetFps(i);
+        }
+    }
+    bool sustained = succeeded && (params->targetFps <= 0 || minFps >= params->targetFps);
+
+    char buf[256];
+    snprintf(buf,
+             sizeof(buf),
+             "{\n  \"streams\": %d,\n  \"duration_sec\": %d,\n  \"async_depth\": %d,\n"
+             "  \"succeeded\": %s,\n  \"sustained\": %s,\n",
+             count,
+             params->duration,
+             params->asyncDepth,
+             succeeded ? "true" : "false",
+             sustained ? "true" : "false");
+    json += buf;
+    snprintf(buf,
+             sizeof(buf),
+             "  \"aggregate\": { \"fps\": %.2f, \"min_session_fps\": %.2f,\n    \"channels\": [\n",
+             fps,
+             (minFps < 0) ? 0.0 : minFps);
+    json += buf;
+    for (mfxU16 i = 0; i < numChannels; i++) {
+        snprintf(buf,
+                 sizeof(buf),
+                 "      { \"channel\": %d, \"frames\": %u, \"fps\": %.2f, "
+                 "\"latency_ms\": { \"p50\": %.3f, \"p99\": %.3f } }%s\n",
+                 i,
+                 total[i].GetFrames(),
+                 channelFps[i],
+                 total[i].GetPercentile(50),
+                 total[i].GetPercentile(99),
+                 (i + 1 < numChannels) ? "," : "");
+        json += buf;
+    }
+    json += "    ] },\n  \"sessions\": [\n";
+    for (size_t i = 0; i < sessions.size(); i++) {
+        sessions[i].WriteJson(json, "    ");
+        json += (i + 1 < sessions.size()) ? ",\n" : "\n";
+    }
+    json += "  ]\n}";
+
+    // progress goes to stderr, stdout may carry the JSON report
+    fprintf(stderr,
+            "%d streams: %.2f fps total, %.2f fps min per stream%s\n",
+            count,
+            fps,
+            (minFps < 0) ? 0.0 : minFps,
+            succeeded ? "" : ", failed");
+    return sustained;
+}
+
+// Multi-stream benchmark entry, returns exit code of the tool
+int RunMultiStream(Params *params) {
+    mfxLoader loader   = NULL;
+    mfxConfig cfg      = NULL;
+    mfxVariant inCodec = {};
+    mfxStatus sts      = MFX_ERR_NONE;
+    FILE *report       = NULL;
+    std::string json;
+    std::string trials;
+    mfxU16 maxStreams = 0;
+    mfxU16 lo         = 0;
+    mfxU16 hi         = 0;
+    mfxU16 count      = 0;
+    int ret           = 1;
+
+    // Sessions share one loader, implementations are loaded and queried once
+    loader = MFXLoad();
+    VERIFY(NULL != loader, "ERROR - MFXLoad failed -- is implementation in path?");
+
+    cfg = MFXCreateConfig(loader);
+    VERIFY(NULL != cfg, "ERROR - MFXCreateConfig failed");
+
+    sts = MFXSetConfigFilterProperty(cfg,
+                                     reinterpret_cast<const mfxU8 *>("mfxImplDescription.Impl"),
+                                     params->implValue);
+    VERIFY(MFX_ERR_NONE == sts, "ERROR - MFXSetConfigFilterProperty failed for Impl");
+
+    inCodec.Type     = MFX_VARIANT_TYPE_U32;
+    inCodec.Data.U32 = params->inCodec;
+    sts              = MFXSetConfigFilterProperty(
+        cfg,
+        reinterpret_cast<const mfxU8 *>("mfxImplDescription.mfxDecoderDescription.decoder.CodecID"),
+        inCodec);
+    VERIFY(MFX_ERR_NONE == sts, "ERROR - MFXSetConfigFilterProperty failed for decoder CodecID");
+
+    if (params->targetFps <= 0) {
+        ret = RunStreams(loader, params, params->numStreams, json) ? 0 : 1;
+    }
+    else {
+        // Doubles the number of streams while target fps is sustained, then
+        // bisects between the last sustained and the first failed count
+        maxStreams = params->numStreams ? params->numStreams : MAX_STREAMS;
+        hi         = static_cast<mfxU16>(maxStreams + 1);
+        count      = 1;
+        while (count < hi) {
+            std::string trial;
+            bool sustained = RunStreams(loader, params, count, trial);
+            trials += (trials.empty() ? "" : ",\n") + trial;
+            if (!sustained) {
+                hi = count;
+                break;
+            }
+            lo    = count;
+            count = static_cast<mfxU16>((count * 2 > maxStreams) ? maxStreams : count * 2);
+            if (count == lo)
+                break;
+        }
+        while (hi - lo > 1 && lo < maxStreams) {
+            std::string trial;
+            count = static_cast<mfxU16>((lo + hi) / 2);
+            if (RunStreams(loader, params, count, trial))
+                lo = count;
+            else
+                hi = count;
+            trials += ",\n" + trial;
+        }
+
+        char buf[128];
+        snprintf(buf,
+                 sizeof(buf),
+                 "{\n\"target_fps\": %.2f,\n\"max_streams\": %d,\n\"trials\": [\n",
+                 params->targetFps,
+                 lo);
+        json = buf + trials + "\n]\n}";
+        fprintf(stderr, "Maximum sustainable streams at %.2f fps: %d\n", params->targetFps, lo);
+        ret = 0;
+    }
+
+    if (params->jsonFileName) {
+        report = fopen(params->jsonFileName, "w");
+        VERIFY(report, "ERROR - Could not create JSON report file");
+        fprintf(report, "%s\n", json.c_str());
+        fclose(report);
+    }
+    else {
+        printf("%s\n", json.c_str());
+    }
+
+end:
+    if (loader)
+        MFXUnload(loader);
+    return ret;
+}
+
+#endif // TOOLS_CLI_DECVPP_TOOL_MULTI_STREAM_HPP_
@@ -0,0 +1,203 @@
+//==============================================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+//==============================================================================
+
+///
+/// Pipelined output of decode and VPP channels: per-channel writer threads
+/// and latency statistic of the benchmark mode
+///
+/// @file
+
+#ifndef TOOLS_CLI_DECVPP_TOOL_PIPELINE_HPP_
+#define TOOLS_CLI_DECVPP_TOOL_PIPELINE_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util.hpp"
+
+typedef std::chrono::steady_clock PipelineClock;
+
+// Output statistic of a channel, latency is the time from the decode call
+// which returned the frame to the end of its processing
+class ChannelStats {
+public:
+    ChannelStats() : frames_(0), last_(), latencyMs_() {}
+
+    void Add(PipelineClock::time_point submitted, PipelineClock::time_point done) {
+        frames_++;
+        last_ = done;
+        latencyMs_.push_back(std::chrono::duration<double, std::milli>(done - submitted).count());
+    }
+
+    // Adds frames and latencies of another channel, e.g. of the same channel of other session
+    void Merge(const ChannelStats &other) {
+        frames_ += other.frames_;
+        latencyMs_.insert(latencyMs_.end(), other.latencyMs_.begin(), other.latencyMs_.end());
+        last_ = std::max(last_, other.last_);
+    }
+
+    mfxU32 GetFrames() const {
+        return frames_;
+    }
+
+    PipelineClock::time_point GetLast() const {
+        return last_;
+    }
+
+    // Nearest rank percentile, p is in range [0, 100]
+    double GetPercentile(double p) const {
+        if (latencyMs_.empty())
+            return 0;
+
+        std::vector<double> sorted(latencyMs_);
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.5);
+        return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+    }
+
+private:
+    mfxU32 frames_;
+    PipelineClock::time_point last_;
+    std::vector<double> latencyMs_;
+};
+
+void DisplayChannelStats(const ChannelStats *stats, mfxU16 num, PipelineClock::time_point start) {
+    printf("\n> Benchmark summary\n");
+    for (mfxU16 i = 0; i < num; i++) {
+        double sec = std::chrono::duration<double>(stats[i].GetLast() - start).count();
+
+        if (i == 0)
+            printf("  - Decode output\n");
+        else
+            printf("  - VPP output %d\n", i);
+        printf("    . frames:     %d\n", stats[i].GetFrames());
+        printf("    . fps:        %.2f\n", (sec > 0) ? stats[i].GetFrames() / sec : 0.0);
+        printf("    . latency ms: p50 %.3f, p90 %.3f, p99 %.3f\n\n",
+               stats[i].GetPercentile(50),
+               stats[i].GetPercentile(90),
+               stats[i].GetPercentile(99));
+    }
+}
+
+// Synchronizes, writes and releases surfaces of one channel on its own thread.
+// Push() blocks while depth surfaces are queued, this bounds how far decoding
+// runs ahead of the output.
+class ChannelWriter {
+public:
+    ChannelWriter(FILE *sink, ChannelStats *stats, mfxU32 depth, mfxU32 timeout)
+            : sink_(sink),
+              stats_(stats),
+              depth_(depth ? depth : 1),
+              timeout_(timeout),
+              sts_(MFX_ERR_NONE),
+              closed_(false),
+              queue_(),
+              mtx_(),
+              cv_(),
+              thread_() {
+        thread_ = std::thread([this]() {
+            Run();
+        });
+    }
+
+    ~ChannelWriter() {
+        Close();
+    }
+
+    // Queues the surface, the writer takes over its reference
+    void Push(mfxFrameSurface1 *surface, PipelineClock::time_point submitted) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this]() {
+            return queue_.size() < depth_;
+        });
+        queue_.push_back({ surface, submitted });
+        cv_.notify_all();
+    }
+
+    // Processes queued surfaces and stops the thread
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // First error of the channel, surfaces are only released after it
+    mfxStatus GetStatus() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return sts_;
+    }
+
+private:
+    struct Pending {
+        mfxFrameSurface1 *surface;
+        PipelineClock::time_point submitted;
+    };
+
+    void Run() {
+        for (;;) {
+            Pending item;
+            mfxStatus sts;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this]() {
+                    return closed_ || !queue_.empty();
+                });
+                if (queue_.empty())
+                    return;
+                item = queue_.front();
+                queue_.pop_front();
+                sts = sts_;
+            }
+            cv_.notify_all();
+
+            mfxFrameSurface1 *surface = item.surface;
+            if (sts == MFX_ERR_NONE) {
+                sts = surface->FrameInterface->Synchronize(surface, timeout_);
+                if (sts != MFX_ERR_NONE)
+                    printf("ERROR - FrameInterface->Synchronize failed (%d)\n", sts);
+            }
+            if (sts == MFX_ERR_NONE && sink_)
+                sts = WriteRawFrame_InternalMem(surface, sink_);
+            if (sts == MFX_ERR_NONE && stats_)
+                stats_->Add(item.submitted, PipelineClock::now());
+
+            mfxStatus rel = surface->FrameInterface->Release(surface);
+            if (rel != MFX_ERR_NONE) {
+                printf("ERROR - mfxFrameSurfaceInterface->Release failed (%d)\n", rel);
+                if (sts == MFX_ERR_NONE)
+                    sts = rel;
+            }
+
+            if (sts != MFX_ERR_NONE) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (sts_ == MFX_ERR_NONE)
+                    sts_ = sts;
+            }
+        }
+    }
+
+    FILE *sink_;
+    ChannelStats *stats_;
+    size_t depth_;
+    mfxU32 timeout_;
+    mfxStatus sts_;
+    bool closed_;
+    std::deque<Pending> queue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+#endif // TOOLS_CLI_DECVPP_TOOL_PIPELINE_HPP_
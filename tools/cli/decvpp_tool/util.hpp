@@ -12,11 +12,14 @@
 #ifndef TOOLS_CLI_DECVPP_TOOL_UTIL_HPP_
 #define TOOLS_CLI_DECVPP_TOOL_UTIL_HPP_
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "xxhash64.h"
+
 #ifdef USE_MEDIASDK1
     #include "mfxvideo.h"
 enum {
@@ -75,8 +78,10 @@ const struct {
 #define MAX_HEIGHT            2160
 #define IS_ARG_EQ(a, b)       (!strcmp((a), (b)))
 
-#define MAX_VPP_NUM   1024
-#define MAX_VPP_PARAM 4096
+#define MAX_VPP_NUM     1024
+#define MAX_VPP_PARAM   4096
+#define MAX_ASYNC_DEPTH 64
+#define MAX_STREAMS     256
 
 #define VERIFY(x, y)       \
     if (!(x)) {            \
@@ -145,6 +150,19 @@ typedef struct _Params {
     bool bIsAvailableVPPOutFileName;
     VPPOutConfigs *vppOutConfigs;
     bool bUseVideoMemory;
+
+    const char *hashFileName;
+    const char *goldenHashFileName;
+
+    mfxU16 asyncDepth;
+    bool bBenchmark;
+
+    // multi-stream benchmark
+    mfxU16 numStreams;
+    mfxU16 duration;
+    double targetFps;
+    const char *cpuSets;
+    const char *jsonFileName;
 } Params;
 
 const char *ValidateFileName(const char *in) {
@@ -391,6 +409,34 @@ bool GetVPPOutputFileName(Params *params) {
     return (i != params->vppNum) ? false : true;
 }
 
+// Fills parameters of VPP channel i, input is the decoder output described by decInfo
+void PrepareVPPChannelParams(Params *params,
+                             const mfxFrameInfo *decInfo,
+                             mfxU16 i,
+                             mfxVideoChannelParam *chParam) {
+    memset(chParam, 0, sizeof(mfxVideoChannelParam));
+
+    chParam->VPP.FourCC        = params->vppOutConfigs[i].fourcc;
+    chParam->VPP.ChromaFormat  = MFX_CHROMAFORMAT_YUV420;
+    chParam->VPP.PicStruct     = MFX_PICSTRUCT_PROGRESSIVE;
+    chParam->VPP.FrameRateExtN = decInfo->FrameRateExtN;
+    chParam->VPP.FrameRateExtD = decInfo->FrameRateExtD;
+    chParam->VPP.CropW         = params->vppOutConfigs[i].w;
+    chParam->VPP.CropH         = params->vppOutConfigs[i].h;
+    chParam->VPP.Width         = ALIGN16(chParam->VPP.CropW);
+    chParam->VPP.Height        = ALIGN16(chParam->VPP.CropH);
+    chParam->VPP.ChannelId     = i + 1;
+    chParam->Protected         = 0;
+    if (params->bUseVideoMemory) {
+        chParam->IOPattern = MFX_IOPATTERN_IN_VIDEO_MEMORY | MFX_IOPATTERN_OUT_VIDEO_MEMORY;
+    }
+    else {
+        chParam->IOPattern = MFX_IOPATTERN_IN_SYSTEM_MEMORY | MFX_IOPATTERN_OUT_SYSTEM_MEMORY;
+    }
+    chParam->ExtParam    = NULL;
+    chParam->NumExtParam = 0;
+}
+
 bool ParseArgsAndValidate(int argc, char *argv[], Params *params, ParamGroup group) {
     // need to improve more for checking cmd line options
     if (group == PARAMS_DECVPP) {
@@ -487,6 +533,69 @@ bool ParseArgsAndValidate(int argc, char *argv[], Params *params, ParamGroup gro
         else if (IS_ARG_EQ(s, "vmem")) {
             params->bUseVideoMemory = true;
         }
+        else if (IS_ARG_EQ(s, "hash")) {
+            params->hashFileName = ValidateFileName(argv[idx++]);
+            if (!params->hashFileName) {
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "hash_golden")) {
+            params->goldenHashFileName = ValidateFileName(argv[idx++]);
+            if (!params->goldenHashFileName) {
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "async")) {
+            if (!ValidateSize(argv[idx++], &params->asyncDepth, MAX_ASYNC_DEPTH)) {
+                printf("ERROR - async depth is over the limit (%d)\n", MAX_ASYNC_DEPTH);
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "benchmark")) {
+            params->bBenchmark = true;
+        }
+        else if (IS_ARG_EQ(s, "streams")) {
+            if (!ValidateSize(argv[idx++], &params->numStreams, MAX_STREAMS)) {
+                printf("ERROR - number of streams is over the limit (%d)\n", MAX_STREAMS);
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "duration")) {
+            if (!ValidateSize(argv[idx++], &params->duration, 0xFFFF) || !params->duration) {
+                printf("ERROR - duration must be positive number of seconds\n");
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "target_fps")) {
+            params->targetFps = (idx < argc) ? strtod(argv[idx++], NULL) : 0;
+            if (params->targetFps <= 0) {
+                printf("ERROR - target fps must be positive\n");
+                return false;
+            }
+        }
+        else if (IS_ARG_EQ(s, "cpus")) {
+            params->cpuSets = argv[idx++];
+        }
+        else if (IS_ARG_EQ(s, "json")) {
+            params->jsonFileName = ValidateFileName(argv[idx++]);
+            if (!params->jsonFileName) {
+                return false;
+            }
+        }
+    }
+
+    // multi-stream mode only measures, outputs are not written
+    if (params->numStreams || params->targetFps > 0) {
+        params->bBenchmark = true;
+        if (!params->duration)
+            params->duration = 10;
+    }
+
+    // hashes are logged and compared in the order of frames and channels
+    if ((params->hashFileName || params->goldenHashFileName) &&
+        (params->asyncDepth || params->bBenchmark)) {
+        printf("ERROR - -hash and -hash_golden can't be used with -async or -benchmark\n");
+        return false;
     }
 
     // input file required by all except createsession
@@ -1019,4 +1128,109 @@ mfxStatus WriteRawFrame_InternalMem(mfxFrameSurface1 *surface, FILE *f) {
 }
 #endif
 
+// Hash visible area of a plane row by row, pitch padding is skipped
+uint64_t HashPlane(const mfxU8 *ptr, mfxU32 rowBytes, mfxU32 rows, mfxU32 pitch) {
+    CXXHash64 hash;
+    for (mfxU32 i = 0; i < rows; i++)
+        hash.Update(ptr + (size_t)i * pitch, rowBytes);
+    return hash.Digest();
+}
+
+// Format hash log line of a mapped frame:
+// <frame> <channel> <fourcc> <width>x<height> <frame hash> <plane hashes>
+mfxStatus HashRawFrame(mfxFrameSurface1 *surface, mfxU32 frameNum, char *line, size_t size) {
+    mfxFrameInfo *info = &surface->Info;
+    mfxFrameData *data = &surface->Data;
+    mfxU32 pitch       = data->Pitch;
+    mfxU32 w = info->CropW, h = info->CropH, x = info->CropX, y = info->CropY;
+    uint64_t planes[3];
+    int numPlanes = 0;
+
+    switch (info->FourCC) {
+        case MFX_FOURCC_I420:
+            planes[numPlanes++] = HashPlane(data->Y + y * pitch + x, w, h, pitch);
+            planes[numPlanes++] = HashPlane(data->U + y / 2 * pitch / 2 + x / 2,
+                                            (w + 1) / 2,
+                                            (h + 1) / 2,
+                                            pitch / 2);
+            planes[numPlanes++] = HashPlane(data->V + y / 2 * pitch / 2 + x / 2,
+                                            (w + 1) / 2,
+                                            (h + 1) / 2,
+                                            pitch / 2);
+            break;
+        case MFX_FOURCC_NV12:
+            planes[numPlanes++] = HashPlane(data->Y + y * pitch + x, w, h, pitch);
+            planes[numPlanes++] =
+                // interleaved UV pairs start at even bytes, odd CropX is rounded down
+                HashPlane(data->UV + y / 2 * pitch + (x & ~1), (w + 1) / 2 * 2, (h + 1) / 2, pitch);
+            break;
+        case MFX_FOURCC_RGB4:
+            planes[numPlanes++] = HashPlane(data->B + y * pitch + x * 4, w * 4, h, pitch);
+            break;
+        default:
+            return MFX_ERR_UNSUPPORTED;
+    }
+
+    CXXHash64 frame;
+    frame.Update(planes, numPlanes * sizeof(planes[0]));
+
+    int len = snprintf(line,
+                       size,
+                       "%u %u %s %ux%u %016" PRIx64,
+                       frameNum,
+                       info->ChannelId,
+                       FourCC2Str(info->FourCC),
+                       w,
+                       h,
+                       frame.Digest());
+    for (int i = 0; i < numPlanes && len > 0 && (size_t)len < size; i++)
+        len += snprintf(line + len, size - len, " %016" PRIx64, planes[i]);
+
+    return MFX_ERR_NONE;
+}
+
+#if (MFX_VERSION >= 2000)
+// Hash raw frame and write its line to the hash log, compare it with the golden log
+mfxStatus HashRawFrame_InternalMem(mfxFrameSurface1 *surface,
+                                   mfxU32 frameNum,
+                                   FILE *log,
+                                   FILE *golden) {
+    char line[256];
+    mfxStatus sts = surface->FrameInterface->Map(surface, MFX_MAP_READ);
+    if (sts != MFX_ERR_NONE) {
+        printf("mfxFrameSurfaceInterface->Map failed (%d)\n", sts);
+        return sts;
+    }
+
+    sts = HashRawFrame(surface, frameNum, line, sizeof(line));
+    surface->FrameInterface->Unmap(surface);
+    if (sts != MFX_ERR_NONE) {
+        printf("Error in HashRawFrame\n");
+        return sts;
+    }
+
+    if (log)
+        fprintf(log, "%s\n", line);
+
+    if (golden) {
+        char expected[256];
+        // skip comments and empty lines
+        do {
+            if (!fgets(expected, sizeof(expected), golden)) {
+                printf("ERROR - Hash mismatch, golden log ends before: %s\n", line);
+                return MFX_ERR_ABORTED;
+            }
+            expected[strcspn(expected, "\r\n")] = 0;
+        } while (expected[0] == '#' || expected[0] == 0);
+
+        if (strcmp(expected, line)) {
+            printf("ERROR - Hash mismatch\n  expected: %s\n  actual:   %s\n", expected, line);
+            return MFX_ERR_ABORTED;
+        }
+    }
+
+    return MFX_ERR_NONE;
+}
+#endif
+
 #endif //TOOLS_CLI_DECVPP_TOOL_UTIL_HPP_
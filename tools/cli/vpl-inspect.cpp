@@ -9,10 +9,20 @@
 #include <string.h>
 
 #include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h>
+#else
+    #include <dlfcn.h>
+#endif
 
 #include "vpl/mfxdispatcher.h"
 #include "vpl/mfxjpeg.h"
 #include "vpl/mfxstructures.h"
+#include "vpl/mfxvideo.h"
 #include "vpl/mfxvp8.h"
 
 #define DECODE_FOURCC(ch) ch & 0xff, ch >> 8 & 0xff, ch >> 16 & 0xff, ch >> 24 & 0xff
@@ -26,6 +36,8 @@
 #define MAKEFOURCC(ch0, ch1, ch2, ch3)                                                   \
     ((mfxU32)(mfxU8)(ch0) | ((mfxU32)(mfxU8)(ch1) << 8) | ((mfxU32)(mfxU8)(ch2) << 16) | \
      ((mfxU32)(mfxU8)(ch3) << 24))
+#define EXPORT_SCHEMA_VERSION 1
+
 #define STRING_OPTION(x) \
     case x:              \
         return #x
@@ -223,59 +235,982 @@ const char *_print_ProfileType(mfxU32 fourcc, mfxU32 type) {
     return "<unknown codec format>";
 }
 
-int main(int argc, char *argv[]) {
+// Codec ID or color format as text, e.g. "AVC", "HEVC", "NV12"
+std::string _fourcc_string(mfxU32 fourcc) {
+    // not made of characters
+    if (fourcc == MFX_FOURCC_P8)
+        return "P8";
+
+    std::string str;
+    for (int shift = 0; shift < 32; shift += 8) {
+        char c = static_cast<char>((fourcc >> shift) & 0xff);
+        if (c != 0)
+            str += c;
+    }
+    while (!str.empty() && str.back() == ' ')
+        str.pop_back();
+    return str;
+}
+
+// Receives the export schema, serialized as JSON text or as CBOR (RFC 8949).
+// Both encodings share the data model, so consumers may switch between them.
+class ExportWriter {
+public:
+    virtual ~ExportWriter() {}
+
+    virtual void BeginObject()                = 0;
+    virtual void EndObject()                  = 0;
+    virtual void BeginArray()                 = 0;
+    virtual void EndArray()                   = 0;
+    virtual void Key(const char *key)         = 0;
+    virtual void String(const std::string &s) = 0;
+    virtual void Uint(uint64_t value)         = 0;
+    virtual void Int(int64_t value)           = 0;
+    virtual void Double(double value)         = 0;
+    virtual void Bool(bool value)             = 0;
+    virtual void Null()                       = 0;
+    virtual bool Save(FILE *f)                = 0;
+
+    void Field(const char *key, const std::string &value) {
+        Key(key);
+        String(value);
+    }
+
+    void Field(const char *key, uint64_t value) {
+        Key(key);
+        Uint(value);
+    }
+
+    void Version(const char *key, mfxStructVersion version) {
+        Key(key);
+        String(std::to_string(version.Major) + "." + std::to_string(version.Minor));
+    }
+};
+
+class JsonWriter : public ExportWriter {
+public:
+    JsonWriter() : out_(), first_(), afterKey_(false) {}
+
+    void BeginObject() override {
+        Value("{");
+        first_.push_back(true);
+    }
+
+    void EndObject() override {
+        Close("}");
+    }
+
+    void BeginArray() override {
+        Value("[");
+        first_.push_back(true);
+    }
+
+    void EndArray() override {
+        Close("]");
+    }
+
+    void Key(const char *key) override {
+        Separate();
+        out_ += Quote(key) + ": ";
+        afterKey_ = true;
+    }
+
+    void String(const std::string &s) override {
+        Value(Quote(s));
+    }
+
+    void Uint(uint64_t value) override {
+        Value(std::to_string(value));
+    }
+
+    void Int(int64_t value) override {
+        Value(std::to_string(value));
+    }
+
+    void Double(double value) override {
+        char str[32];
+        snprintf(str, sizeof(str), "%.3f", value);
+        Value(str);
+    }
+
+    void Bool(bool value) override {
+        Value(value ? "true" : "false");
+    }
+
+    void Null() override {
+        Value("null");
+    }
+
+    bool Save(FILE *f) override {
+        return fprintf(f, "%s\n", out_.c_str()) > 0;
+    }
+
+private:
+    static std::string Quote(const std::string &s) {
+        std::string str = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                str += '\\';
+                str += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                str += esc;
+            }
+            else {
+                str += c;
+            }
+        }
+        return str + "\"";
+    }
+
+    // Starts an element of array or object on its own line
+    void Separate() {
+        if (first_.empty())
+            return;
+        if (!first_.back())
+            out_ += ",";
+        first_.back() = false;
+        out_ += "\n" + std::string(2 * first_.size(), ' ');
+    }
+
+    void Value(const std::string &value) {
+        if (!afterKey_)
+            Separate();
+        afterKey_ = false;
+        out_ += value;
+    }
+
+    void Close(const char *bracket) {
+        bool empty = first_.back();
+        first_.pop_back();
+        if (!empty)
+            out_ += "\n" + std::string(2 * first_.size(), ' ');
+        out_ += bracket;
+    }
+
+    std::string out_;
+    std::vector<bool> first_;
+    bool afterKey_;
+};
+
+class CborWriter : public ExportWriter {
+public:
+    CborWriter() : out_() {
+        // self-described CBOR tag, lets readers detect the format
+        out_.push_back(0xd9);
+        out_.push_back(0xd9);
+        out_.push_back(0xf7);
+    }
+
+    void BeginObject() override {
+        out_.push_back(0xbf); // map of indefinite length
+    }
+
+    void EndObject() override {
+        out_.push_back(0xff);
+    }
+
+    void BeginArray() override {
+        out_.push_back(0x9f); // array of indefinite length
+    }
+
+    void EndArray() override {
+        out_.push_back(0xff);
+    }
+
+    void Key(const char *key) override {
+        String(key);
+    }
+
+    void String(const std::string &s) override {
+        Head(3, s.size());
+        out_.insert(out_.end(), s.begin(), s.end());
+    }
+
+    void Uint(uint64_t value) override {
+        Head(0, value);
+    }
+
+    void Int(int64_t value) override {
+        if (value < 0)
+            Head(1, static_cast<uint64_t>(-(value + 1)));
+        else
+            Head(0, static_cast<uint64_t>(value));
+    }
+
+    void Double(double value) override {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        out_.push_back(0xfb);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            out_.push_back(static_cast<uint8_t>(bits >> shift));
+    }
+
+    void Bool(bool value) override {
+        out_.push_back(value ? 0xf5 : 0xf4);
+    }
+
+    void Null() override {
+        out_.push_back(0xf6);
+    }
+
+    bool Save(FILE *f) override {
+        return fwrite(out_.data(), 1, out_.size(), f) == out_.size();
+    }
+
+private:
+    // Major type and argument in the shortest form
+    void Head(uint8_t major, uint64_t value) {
+        major = static_cast<uint8_t>(major << 5);
+        if (value < 24) {
+            out_.push_back(static_cast<uint8_t>(major | value));
+            return;
+        }
+
+        // additional information 24..27 is followed by 1, 2, 4 or 8 bytes
+        int info = 27;
+        if (value <= 0xff)
+            info = 24;
+        else if (value <= 0xffff)
+            info = 25;
+        else if (value <= 0xffffffff)
+            info = 26;
+        out_.push_back(static_cast<uint8_t>(major | info));
+        for (int shift = 8 * ((1 << (info - 24)) - 1); shift >= 0; shift -= 8)
+            out_.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    std::vector<uint8_t> out_;
+};
+
+// Startup costs of an implementation measured by -timing, negative time means
+// not measured
+typedef struct {
+    double loadMs;
+    double queryMs;
+    double createSessionMs;
+    mfxStatus createSessionSts;
+    double decodeInitMs;
+    mfxStatus decodeInitSts;
+    double encodeInitMs;
+    mfxStatus encodeInitSts;
+} ImplTiming;
+
+typedef struct {
+    mfxU32 codecId;
+    mfxU16 width;
+    mfxU16 height;
+} TimingParams;
+
+typedef mfxHDL *(MFX_CDECL *QueryImplsDescriptionFunc)(mfxImplCapsDeliveryFormat, mfxU32 *);
+typedef mfxStatus(MFX_CDECL *ReleaseImplDescriptionFunc)(mfxHDL);
+
+using inspect_clock = std::chrono::steady_clock;
+
+static double _elapsed_ms(inspect_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(inspect_clock::now() - start).count();
+}
+
+mfxLoader CreateLoader(bool bRequireD3D9) {
     mfxLoader loader = MFXLoad();
     if (loader == NULL) {
         printf("Error - MFXLoad() returned null - no libraries found\n");
-        return -1;
+        return NULL;
+    }
+
+    if (bRequireD3D9) {
+        mfxConfig cfg = MFXCreateConfig(loader);
+        if (!cfg) {
+            printf("Error - MFXCreateConfig() returned null\n");
+            MFXUnload(loader);
+            return NULL;
+        }
+
+        mfxVariant var      = {};
+        var.Version.Version = MFX_VARIANT_VERSION;
+        var.Type            = MFX_VARIANT_TYPE_U32;
+        var.Data.U32        = MFX_ACCEL_MODE_VIA_D3D9;
+
+        mfxStatus sts =
+            MFXSetConfigFilterProperty(cfg,
+                                       (const mfxU8 *)"mfxImplDescription.AccelerationMode",
+                                       var);
+        if (sts) {
+            printf("Error - MFXSetConfigFilterProperty() returned %d\n", sts);
+            MFXUnload(loader);
+            return NULL;
+        }
     }
 
+    return loader;
+}
+
+// Times load and capabilities query of the runtime library, the way the
+// dispatcher does them
+static void _time_library(const char *path, ImplTiming *timing) {
+    auto start = inspect_clock::now();
+#if defined(_WIN32) || defined(_WIN64)
+    HMODULE lib = LoadLibraryExA(path, NULL, 0);
+#else
+    void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+    if (!lib)
+        return;
+    timing->loadMs = _elapsed_ms(start);
+
+#if defined(_WIN32) || defined(_WIN64)
+    auto query   = (QueryImplsDescriptionFunc)GetProcAddress(lib, "MFXQueryImplsDescription");
+    auto release = (ReleaseImplDescriptionFunc)GetProcAddress(lib, "MFXReleaseImplDescription");
+#else
+    auto query   = (QueryImplsDescriptionFunc)dlsym(lib, "MFXQueryImplsDescription");
+    auto release = (ReleaseImplDescriptionFunc)dlsym(lib, "MFXReleaseImplDescription");
+#endif
+    // 1.x runtimes don't report capabilities
+    if (query && release) {
+        mfxU32 num  = 0;
+        start       = inspect_clock::now();
+        mfxHDL *hdl = query(MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &num);
+        if (hdl) {
+            timing->queryMs = _elapsed_ms(start);
+            for (mfxU32 i = 0; i < num; i++)
+                release(hdl[i]);
+        }
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    FreeLibrary(lib);
+#else
+    dlclose(lib);
+#endif
+}
+
+// Frame parameters of the codec, color format is the first one the implementation lists
+static bool _prepare_frame_info(mfxU32 codecId,
+                                mfxU16 numCodecs,
+                                const mfxU32 *codecIds,
+                                const mfxU32 *colorFormats,
+                                const TimingParams *params,
+                                mfxFrameInfo *fi) {
+    for (mfxU16 codec = 0; codec < numCodecs; codec++) {
+        if (codecIds[codec] != codecId)
+            continue;
+
+        fi->FourCC        = colorFormats[codec] ? colorFormats[codec] : MFX_FOURCC_NV12;
+        fi->ChromaFormat  = MFX_CHROMAFORMAT_YUV420;
+        fi->PicStruct     = MFX_PICSTRUCT_PROGRESSIVE;
+        fi->FrameRateExtN = 30;
+        fi->FrameRateExtD = 1;
+        fi->CropW         = params->width;
+        fi->CropH         = params->height;
+        fi->Width         = static_cast<mfxU16>((params->width + 15) & ~15);
+        fi->Height        = static_cast<mfxU16>((params->height + 15) & ~15);
+        if (fi->FourCC == MFX_FOURCC_P010 || fi->FourCC == MFX_FOURCC_I010) {
+            fi->BitDepthLuma   = 10;
+            fi->BitDepthChroma = 10;
+            fi->Shift          = (fi->FourCC == MFX_FOURCC_P010) ? 1 : 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Codecs of decoder or encoder description with the first color format of each
+template <typename T>
+static void _get_codecs(const T &desc, std::vector<mfxU32> *codecs, std::vector<mfxU32> *formats) {
+    for (int codec = 0; codec < desc.NumCodecs; codec++) {
+        mfxU32 format = 0;
+        if (desc.Codecs[codec].NumProfiles && desc.Codecs[codec].Profiles[0].NumMemTypes &&
+            desc.Codecs[codec].Profiles[0].MemDesc[0].NumColorFormats)
+            format = desc.Codecs[codec].Profiles[0].MemDesc[0].ColorFormats[0];
+        codecs->push_back(desc.Codecs[codec].CodecID);
+        formats->push_back(format);
+    }
+}
+
+// Measures startup costs of every implementation. Library load is timed after
+// the first enumeration, files of libraries are in page cache then.
+std::vector<ImplTiming> MeasureTimings(bool bRequireD3D9, const TimingParams *params) {
+    std::vector<ImplTiming> timings;
+    std::vector<std::string> paths;
+    std::vector<std::vector<mfxU32>> decCodecs, decFormats, encCodecs, encFormats;
+
+    mfxLoader loader = CreateLoader(bRequireD3D9);
+    if (!loader)
+        return timings;
+
+    mfxU32 i = 0;
+    mfxImplDescription *idesc;
+    while (MFX_ERR_NONE == MFXEnumImplementations(loader,
+                                                  i,
+                                                  MFX_IMPLCAPS_IMPLDESCSTRUCTURE,
+                                                  reinterpret_cast<mfxHDL *>(&idesc))) {
+        mfxHDL hImplPath = nullptr;
+        std::string path;
+        if (MFX_ERR_NONE == MFXEnumImplementations(loader, i, MFX_IMPLCAPS_IMPLPATH, &hImplPath) &&
+            hImplPath) {
+            path = reinterpret_cast<mfxChar *>(hImplPath);
+            MFXDispReleaseImplDescription(loader, hImplPath);
+        }
+        paths.push_back(path);
+
+        decCodecs.emplace_back();
+        decFormats.emplace_back();
+        encCodecs.emplace_back();
+        encFormats.emplace_back();
+        _get_codecs(idesc->Dec, &decCodecs.back(), &decFormats.back());
+        _get_codecs(idesc->Enc, &encCodecs.back(), &encFormats.back());
+        MFXDispReleaseImplDescription(loader, idesc);
+        i++;
+    }
+    // unloads the libraries
+    MFXUnload(loader);
+
+    timings.resize(paths.size(), { -1, -1, -1, MFX_ERR_NONE, -1, MFX_ERR_NONE, -1, MFX_ERR_NONE });
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!paths[i].empty())
+            _time_library(paths[i].c_str(), &timings[i]);
+    }
+
+    loader = CreateLoader(bRequireD3D9);
+    if (!loader)
+        return timings;
+
+    // loads libraries and queries their capabilities, as applications do before session creation
+    mfxHDL hdl;
+    if (MFX_ERR_NONE == MFXEnumImplementations(loader, 0, MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &hdl))
+        MFXDispReleaseImplDescription(loader, hdl);
+
+    for (i = 0; i < timings.size(); i++) {
+        ImplTiming *timing = &timings[i];
+        mfxSession session = nullptr;
+        auto start         = inspect_clock::now();
+
+        timing->createSessionSts = MFXCreateSession(loader, i, &session);
+        if (timing->createSessionSts != MFX_ERR_NONE)
+            continue;
+        timing->createSessionMs = _elapsed_ms(start);
+
+        mfxVideoParam par = {};
+        if (_prepare_frame_info(params->codecId,
+                                static_cast<mfxU16>(decCodecs[i].size()),
+                                decCodecs[i].data(),
+                                decFormats[i].data(),
+                                params,
+                                &par.mfx.FrameInfo)) {
+            par.mfx.CodecId = params->codecId;
+            par.IOPattern   = MFX_IOPATTERN_OUT_SYSTEM_MEMORY;
+
+            start                 = inspect_clock::now();
+            timing->decodeInitSts = MFXVideoDECODE_Init(session, &par);
+            if (timing->decodeInitSts >= MFX_ERR_NONE) {
+                timing->decodeInitMs = _elapsed_ms(start);
+                MFXVideoDECODE_Close(session);
+            }
+        }
+
+        par = {};
+        if (_prepare_frame_info(params->codecId,
+                                static_cast<mfxU16>(encCodecs[i].size()),
+                                encCodecs[i].data(),
+                                encFormats[i].data(),
+                                params,
+                                &par.mfx.FrameInfo)) {
+            par.mfx.CodecId = params->codecId;
+            par.IOPattern   = MFX_IOPATTERN_IN_SYSTEM_MEMORY;
+            if (params->codecId == MFX_CODEC_JPEG) {
+                par.mfx.Interleaved = 1;
+                par.mfx.Quality     = 80;
+            }
+            else {
+                par.mfx.TargetUsage       = MFX_TARGETUSAGE_BALANCED;
+                par.mfx.RateControlMethod = MFX_RATECONTROL_CQP;
+                par.mfx.QPI               = 26;
+                par.mfx.QPP               = 26;
+                par.mfx.QPB               = 26;
+            }
+
+            start                 = inspect_clock::now();
+            timing->encodeInitSts = MFXVideoENCODE_Init(session, &par);
+            if (timing->encodeInitSts >= MFX_ERR_NONE) {
+                timing->encodeInitMs = _elapsed_ms(start);
+                MFXVideoENCODE_Close(session);
+            }
+        }
+
+        MFXClose(session);
+    }
+
+    MFXUnload(loader);
+    return timings;
+}
+
+static void _export_range(ExportWriter &w, const char *key, const mfxRange32U &range) {
+    w.Key(key);
+    w.BeginObject();
+    w.Field("min", range.Min);
+    w.Field("max", range.Max);
+    w.Field("step", range.Step);
+    w.EndObject();
+}
+
+template <typename T>
+static void _export_mem_size(ExportWriter &w, const T &mem) {
+    w.Field("mem_handle_type", _print_ResourceType(mem.MemHandleType));
+    _export_range(w, "width", mem.Width);
+    _export_range(w, "height", mem.Height);
+}
+
+static void _export_codec_fields(ExportWriter &w, const mfxDecoderDescription::decoder &c) {}
+
+static void _export_codec_fields(ExportWriter &w, const mfxEncoderDescription::encoder &c) {
+    w.Field("bidirectional_prediction", c.BiDirectionalPrediction);
+}
+
+// Decoder and encoder descriptions have the same layout except encoder specific fields
+template <typename T>
+static void _export_codecs(ExportWriter &w, const T &desc) {
+    w.Version("version", desc.Version);
+    w.Key("codecs");
+    w.BeginArray();
+    for (int codec = 0; codec < desc.NumCodecs; codec++) {
+        const auto &c = desc.Codecs[codec];
+        w.BeginObject();
+        w.Field("codec_id", _fourcc_string(c.CodecID));
+        w.Field("max_codec_level", c.MaxcodecLevel);
+        _export_codec_fields(w, c);
+        w.Key("profiles");
+        w.BeginArray();
+        for (int profile = 0; profile < c.NumProfiles; profile++) {
+            const auto &p = c.Profiles[profile];
+            w.BeginObject();
+            w.Field("profile", p.Profile);
+            w.Field("profile_name", _print_ProfileType(c.CodecID, p.Profile));
+            w.Key("mem_types");
+            w.BeginArray();
+            for (int memtype = 0; memtype < p.NumMemTypes; memtype++) {
+                w.BeginObject();
+                _export_mem_size(w, p.MemDesc[memtype]);
+                w.Key("color_formats");
+                w.BeginArray();
+                for (int fmt = 0; fmt < p.MemDesc[memtype].NumColorFormats; fmt++)
+                    w.String(_fourcc_string(p.MemDesc[memtype].ColorFormats[fmt]));
+                w.EndArray();
+                w.EndObject();
+            }
+            w.EndArray();
+            w.EndObject();
+        }
+        w.EndArray();
+        w.EndObject();
+    }
+    w.EndArray();
+}
+
+static void _export_vpp(ExportWriter &w, const mfxVPPDescription &vpp) {
+    w.Version("version", vpp.Version);
+    w.Key("filters");
+    w.BeginArray();
+    for (int filter = 0; filter < vpp.NumFilters; filter++) {
+        const auto &f = vpp.Filters[filter];
+        w.BeginObject();
+        w.Field("filter_fourcc", _fourcc_string(f.FilterFourCC));
+        w.Field("max_delay_in_frames", f.MaxDelayInFrames);
+        w.Key("mem_types");
+        w.BeginArray();
+        for (int memtype = 0; memtype < f.NumMemTypes; memtype++) {
+            const auto &m = f.MemDesc[memtype];
+            w.BeginObject();
+            _export_mem_size(w, m);
+            w.Key("formats");
+            w.BeginArray();
+            for (int informat = 0; informat < m.NumInFormats; informat++) {
+                w.BeginObject();
+                w.Field("in_format", _fourcc_string(m.Formats[informat].InFormat));
+                w.Key("out_formats");
+                w.BeginArray();
+                for (int outformat = 0; outformat < m.Formats[informat].NumOutFormat; outformat++)
+                    w.String(_fourcc_string(m.Formats[informat].OutFormats[outformat]));
+                w.EndArray();
+                w.EndObject();
+            }
+            w.EndArray();
+            w.EndObject();
+        }
+        w.EndArray();
+        w.EndObject();
+    }
+    w.EndArray();
+}
+
+static void _export_impl_description(ExportWriter &w, const mfxImplDescription *idesc) {
+    w.Version("version", idesc->Version);
+    w.Field("impl", _print_Impl(idesc->Impl));
+    w.Field("acceleration_mode", _print_AccelMode(idesc->AccelerationMode));
+    w.Key("api_version");
+    w.String(std::to_string(idesc->ApiVersion.Major) + "." +
+             std::to_string(idesc->ApiVersion.Minor));
+    w.Field("impl_name", idesc->ImplName);
+    w.Field("license", idesc->License);
+    w.Field("keywords", idesc->Keywords);
+    w.Field("vendor_id", idesc->VendorID);
+    w.Field("vendor_impl_id", idesc->VendorImplID);
+
+    w.Key("acceleration_mode_description");
+    w.BeginObject();
+    w.Version("version", idesc->AccelerationModeDescription.Version);
+    w.Key("modes");
+    w.BeginArray();
+    for (int mode = 0; mode < idesc->AccelerationModeDescription.NumAccelerationModes; mode++)
+        w.String(_print_AccelMode(idesc->AccelerationModeDescription.Mode[mode]));
+    w.EndArray();
+    w.EndObject();
+
+    w.Key("pool_policies");
+    if (idesc->Version.Version >= MFX_STRUCT_VERSION(1, 2)) {
+        w.BeginObject();
+        w.Version("version", idesc->PoolPolicies.Version);
+        w.Key("policies");
+        w.BeginArray();
+        for (int policy = 0; policy < idesc->PoolPolicies.NumPoolPolicies; policy++)
+            w.String(_print_PoolPolicy(idesc->PoolPolicies.Policy[policy]));
+        w.EndArray();
+        w.EndObject();
+    }
+    else {
+        w.Null();
+    }
+
+    const mfxDeviceDescription *dev = &idesc->Dev;
+    w.Key("device");
+    w.BeginObject();
+    w.Version("version", dev->Version);
+    w.Key("media_adapter_type");
+    if (dev->Version.Version >= MFX_STRUCT_VERSION(1, 1))
+        w.String(_print_MediaAdapterType((mfxMediaAdapterType)dev->MediaAdapterType));
+    else
+        w.Null();
+    w.Field("device_id", dev->DeviceID);
+    w.Key("sub_devices");
+    w.BeginArray();
+    for (int subdevice = 0; subdevice < dev->NumSubDevices; subdevice++) {
+        w.BeginObject();
+        w.Field("index", dev->SubDevices[subdevice].Index);
+        w.Field("sub_device_id", dev->SubDevices[subdevice].SubDeviceID);
+        w.EndObject();
+    }
+    w.EndArray();
+    w.EndObject();
+
+    w.Key("decoder");
+    w.BeginObject();
+    _export_codecs(w, idesc->Dec);
+    w.EndObject();
+
+    w.Key("encoder");
+    w.BeginObject();
+    _export_codecs(w, idesc->Enc);
+    w.EndObject();
+
+    w.Key("vpp");
+    w.BeginObject();
+    _export_vpp(w, idesc->VPP);
+    w.EndObject();
+
+    w.Field("num_ext_param", idesc->NumExtParam);
+}
+
+static void _export_time(ExportWriter &w, const char *key, double ms) {
+    w.Key(key);
+    if (ms < 0)
+        w.Null();
+    else
+        w.Double(ms);
+}
+
+static void _export_timing(ExportWriter &w, const ImplTiming &t) {
+    w.BeginObject();
+    _export_time(w, "library_load_ms", t.loadMs);
+    _export_time(w, "query_ms", t.queryMs);
+    _export_time(w, "create_session_ms", t.createSessionMs);
+    w.Key("create_session_status");
+    w.Int(t.createSessionSts);
+    _export_time(w, "decode_init_ms", t.decodeInitMs);
+    w.Key("decode_init_status");
+    w.Int(t.decodeInitSts);
+    _export_time(w, "encode_init_ms", t.encodeInitMs);
+    w.Key("encode_init_status");
+    w.Int(t.encodeInitSts);
+    w.EndObject();
+}
+
+// Writes all implementations in the export schema. The same keys are always
+// present, missing information is null.
+int ExportImplementations(mfxLoader loader,
+                          ExportWriter &w,
+                          const std::vector<ImplTiming> &timings,
+                          const TimingParams *timingParams) {
+    w.BeginObject();
+    w.Field("schema_version", EXPORT_SCHEMA_VERSION);
+
+    w.Key("timing_params");
+    if (timingParams) {
+        w.BeginObject();
+        w.Field("codec_id", _fourcc_string(timingParams->codecId));
+        w.Field("width", timingParams->width);
+        w.Field("height", timingParams->height);
+        w.EndObject();
+    }
+    else {
+        w.Null();
+    }
+
+    w.Key("implementations");
+    w.BeginArray();
+
+    mfxU32 i = 0;
+    mfxImplDescription *idesc;
+    while (MFX_ERR_NONE == MFXEnumImplementations(loader,
+                                                  i,
+                                                  MFX_IMPLCAPS_IMPLDESCSTRUCTURE,
+                                                  reinterpret_cast<mfxHDL *>(&idesc))) {
+        w.BeginObject();
+        w.Field("index", i);
+
+        mfxHDL hImplPath = nullptr;
+        w.Key("library_path");
+        if (MFX_ERR_NONE == MFXEnumImplementations(loader, i, MFX_IMPLCAPS_IMPLPATH, &hImplPath) &&
+            hImplPath) {
+            w.String(reinterpret_cast<mfxChar *>(hImplPath));
+            MFXDispReleaseImplDescription(loader, hImplPath);
+        }
+        else {
+            w.Null();
+        }
+
+        _export_impl_description(w, idesc);
+        MFXDispReleaseImplDescription(loader, idesc);
+
+        mfxImplementedFunctions *fdesc;
+        w.Key("implemented_functions");
+        if (MFX_ERR_NONE == MFXEnumImplementations(loader,
+                                                   i,
+                                                   MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS,
+                                                   reinterpret_cast<mfxHDL *>(&fdesc))) {
+            w.BeginArray();
+            for (mfxU32 f = 0; f < fdesc->NumFunctions; f++)
+                w.String(fdesc->FunctionsName[f]);
+            w.EndArray();
+            MFXDispReleaseImplDescription(loader, fdesc);
+        }
+        else {
+            w.Null();
+        }
+
+        w.Key("extended_device_id");
+#ifdef ONEVPL_EXPERIMENTAL
+        mfxExtendedDeviceId *idescDevice;
+        if (MFX_ERR_NONE == MFXEnumImplementations(loader,
+                                                   i,
+                                                   MFX_IMPLCAPS_DEVICE_ID_EXTENDED,
+                                                   reinterpret_cast<mfxHDL *>(&idescDevice))) {
+            w.BeginObject();
+            w.Field("vendor_id", idescDevice->VendorID);
+            w.Field("device_id", idescDevice->DeviceID);
+            w.Field("pci_domain", idescDevice->PCIDomain);
+            w.Field("pci_bus", idescDevice->PCIBus);
+            w.Field("pci_device", idescDevice->PCIDevice);
+            w.Field("pci_function", idescDevice->PCIFunction);
+            w.Key("device_luid");
+            if (idescDevice->LUIDValid) {
+                char luid[17];
+                for (mfxU32 idx = 0; idx < 8; idx++)
+                    snprintf(luid + 2 * idx, 3, "%02x", idescDevice->DeviceLUID[7 - idx]);
+                w.String(luid);
+            }
+            else {
+                w.Null();
+            }
+            w.Field("luid_device_node_mask", idescDevice->LUIDDeviceNodeMask);
+            w.Key("luid_valid");
+            w.Bool(idescDevice->LUIDValid != 0);
+            w.Field("drm_render_node_num", idescDevice->DRMRenderNodeNum);
+            w.Field("drm_primary_node_num", idescDevice->DRMPrimaryNodeNum);
+            w.Field("device_name", idescDevice->DeviceName);
+            w.EndObject();
+            MFXDispReleaseImplDescription(loader, idescDevice);
+        }
+        else {
+            w.Null();
+        }
+#else
+        w.Null();
+#endif
+
+        w.Key("timing");
+        if (i < timings.size())
+            _export_timing(w, timings[i]);
+        else
+            w.Null();
+
+        w.EndObject();
+        i++;
+    }
+
+    w.EndArray();
+    w.EndObject();
+    return i;
+}
+
+void PrintTiming(const ImplTiming &t, const TimingParams *params) {
+    // time is missing when the step failed or wasn't possible, e.g. 1.x runtime or codec isn't
+    // listed by the implementation
+    auto print = [](const char *name, double ms, mfxStatus sts) {
+        if (ms >= 0)
+            printf("%4s%s: %.3f ms\n", "", name, ms);
+        else if (sts != MFX_ERR_NONE)
+            printf("%4s%s: failed (%d)\n", "", name, sts);
+        else
+            printf("%4s%s: not available\n", "", name);
+    };
+
+    printf("%2sTiming (%s %ux%u):\n",
+           "",
+           _fourcc_string(params->codecId).c_str(),
+           params->width,
+           params->height);
+    print("Library load", t.loadMs, MFX_ERR_NONE);
+    print("Capabilities query", t.queryMs, MFX_ERR_NONE);
+    print("MFXCreateSession", t.createSessionMs, t.createSessionSts);
+    print("Decode Init", t.decodeInitMs, t.decodeInitSts);
+    print("Encode Init", t.encodeInitMs, t.encodeInitSts);
+}
+
+static bool _parse_codec(const char *str, mfxU32 *codecId) {
+    static const struct {
+        const char *name;
+        mfxU32 codecId;
+    } codecs[] = { { "h264", MFX_CODEC_AVC },  { "avc", MFX_CODEC_AVC },
+                   { "h265", MFX_CODEC_HEVC }, { "hevc", MFX_CODEC_HEVC },
+                   { "av1", MFX_CODEC_AV1 },   { "vp9", MFX_CODEC_VP9 },
+                   { "vp8", MFX_CODEC_VP8 },   { "mpeg2", MFX_CODEC_MPEG2 },
+                   { "jpeg", MFX_CODEC_JPEG } };
+
+    for (const auto &codec : codecs) {
+        if (!strcmp(str, codec.name)) {
+            *codecId = codec.codecId;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _usage() {
+    printf("Usage: vpl-inspect [options]\n");
+    printf("   -f ............................ print implemented functions\n");
+#ifdef ONEVPL_EXPERIMENTAL
+    printf("   -ex ........................... print extended device IDs\n");
+#endif
+    printf("   -b ............................ print brief info\n");
+    printf("   -d3d9 ......................... enumerate D3D9 implementations only\n");
+    printf("   -json ......................... export everything as JSON to stdout\n");
+    printf("   -cbor <file> .................. export everything as CBOR to file\n");
+    printf("   -timing <codec> <W>x<H> ....... measure library load, query, session\n");
+    printf("                                   creation and first Init time of every\n");
+    printf("                                   implementation, codec is one of h264,\n");
+    printf("                                   h265, av1, vp9, vp8, mpeg2, jpeg\n");
+}
+
+int main(int argc, char *argv[]) {
     bool bPrintImplementedFunctions = false;
     bool bFullInfo                  = true;
     bool bPrintExtendedDeviceID     = false;
     bool bRequireD3D9               = false;
-    if (argc == 2) {
-        if (!strncmp(argv[1], "-f", 2)) {
+    bool bExportJson                = false;
+    bool bTiming                    = false;
+    const char *cborFileName        = nullptr;
+    TimingParams timingParams       = {};
+    std::vector<ImplTiming> timings;
+
+    for (int arg = 1; arg < argc; arg++) {
+        // options are accepted with both - and -- prefix
+        const char *opt = (!strncmp(argv[arg], "--", 2)) ? argv[arg] + 1 : argv[arg];
+
+        if (!strcmp(opt, "-json")) {
+            bExportJson = true;
+        }
+        else if (!strcmp(opt, "-cbor") && arg + 1 < argc) {
+            cborFileName = argv[++arg];
+        }
+        else if (!strcmp(opt, "-timing") && arg + 2 < argc) {
+            unsigned int width = 0, height = 0;
+            char tail;
+            bool bValid = _parse_codec(argv[++arg], &timingParams.codecId);
+            bValid      = bValid && sscanf(argv[++arg], "%ux%u%c", &width, &height, &tail) == 2;
+            if (!bValid || !width || !height || width > 0xffff || height > 0xffff) {
+                printf("Error - invalid -timing arguments\n");
+                _usage();
+                return -1;
+            }
+            timingParams.width  = static_cast<mfxU16>(width);
+            timingParams.height = static_cast<mfxU16>(height);
+            bTiming             = true;
+        }
+        else if (!strncmp(opt, "-f", 2)) {
             bPrintImplementedFunctions = true;
         }
 #ifdef ONEVPL_EXPERIMENTAL
-        else if (!strncmp(argv[1], "-ex", 3)) {
+        else if (!strncmp(opt, "-ex", 3)) {
             bPrintExtendedDeviceID = true;
         }
 #endif
-        else if (!strncmp(argv[1], "-b", 2)) {
+        else if (!strncmp(opt, "-b", 2)) {
             bFullInfo = false;
         }
-        else if (!strncmp(argv[1], "-d3d9", 5)) {
+        else if (!strncmp(opt, "-d3d9", 5)) {
             bRequireD3D9 = true;
         }
         else {
-            printf("Error - unknown option %s\n", argv[1]);
+            printf("Error - unknown option %s\n", argv[arg]);
+            _usage();
             return -1;
         }
     }
 
-    if (bRequireD3D9) {
+    // exported data must not be mixed with messages
+    if (bRequireD3D9 && !bExportJson) {
         printf("Warning - Enumerating D3D9 implementations ONLY\n");
-        mfxConfig cfg = MFXCreateConfig(loader);
-        if (!cfg) {
-            printf("Error - MFXCreateConfig() returned null\n");
-            return -1;
-        }
+    }
 
-        mfxVariant var      = {};
-        var.Version.Version = MFX_VARIANT_VERSION;
-        var.Type            = MFX_VARIANT_TYPE_U32;
-        var.Data.U32        = MFX_ACCEL_MODE_VIA_D3D9;
+    // runs on its own loaders, libraries have to be unloaded to time their load
+    if (bTiming)
+        timings = MeasureTimings(bRequireD3D9, &timingParams);
 
-        mfxStatus sts =
-            MFXSetConfigFilterProperty(cfg,
-                                       (const mfxU8 *)"mfxImplDescription.AccelerationMode",
-                                       var);
-        if (sts) {
-            printf("Error - MFXSetConfigFilterProperty() returned %d\n", sts);
-            return -1;
+    mfxLoader loader = CreateLoader(bRequireD3D9);
+    if (loader == NULL)
+        return -1;
+
+    if (bExportJson || cborFileName) {
+        int ret = 0;
+        if (bExportJson) {
+            JsonWriter json;
+            ExportImplementations(loader, json, timings, bTiming ? &timingParams : nullptr);
+            json.Save(stdout);
+        }
+        if (cborFileName) {
+            CborWriter cbor;
+            ExportImplementations(loader, cbor, timings, bTiming ? &timingParams : nullptr);
+            FILE *f = fopen(cborFileName, "wb");
+            if (!f || !cbor.Save(f)) {
+                printf("Error - could not write %s\n", cborFileName);
+                ret = -1;
+            }
+            if (f)
+                fclose(f);
         }
+        MFXUnload(loader);
+        return ret;
     }
 
     int i = 0;
@@ -588,6 +1523,9 @@ int main(int argc, char *argv[]) {
         }
 #endif
 
+        if (bTiming && i < static_cast<int>(timings.size()))
+            PrintTiming(timings[i], &timingParams);
+
         i++;
     }
 
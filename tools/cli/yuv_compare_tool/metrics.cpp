@@ -0,0 +1,509 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "metrics.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <type_traits>
+
+// rows of luma per band, a multiple of the SSIM block size
+#define BAND_HEIGHT 64
+#define SSIM_BLOCK  4
+
+mfxStatus GetComponentViews(const mfxFrameInfo &info,
+                            const mfxFrameData &data,
+                            ComponentView views[MAX_COMPONENTS],
+                            mfxU32 *pNumComponents) {
+    MSDK_CHECK_POINTER(pNumComponents, MFX_ERR_NULL_PTR);
+
+    mfxU32 w     = info.CropW ? info.CropW : info.Width;
+    mfxU32 h     = info.CropH ? info.CropH : info.Height;
+    mfxU32 pitch = data.PitchLow + ((mfxU32)data.PitchHigh << 16);
+
+    auto set = [&](mfxU32 idx, const mfxU8 *ptr, mfxU32 p, mfxU32 step, mfxU32 cw, mfxU32 ch) {
+        views[idx].pData   = ptr;
+        views[idx].nPitch  = p;
+        views[idx].nStep   = step;
+        views[idx].nWidth  = cw;
+        views[idx].nHeight = ch;
+    };
+
+    *pNumComponents = MAX_COMPONENTS;
+
+    switch (info.FourCC) {
+        case MFX_FOURCC_NV12:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.UV, MFX_ERR_NULL_PTR);
+            set(0, data.Y, pitch, 1, w, h);
+            set(1, data.UV, pitch, 2, w / 2, h / 2);
+            set(2, data.UV + 1, pitch, 2, w / 2, h / 2);
+            break;
+        case MFX_FOURCC_P010:
+        case MFX_FOURCC_P016:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.UV, MFX_ERR_NULL_PTR);
+            set(0, data.Y, pitch, 1, w, h);
+            set(1, data.UV, pitch, 2, w / 2, h / 2);
+            set(2, data.UV + 2, pitch, 2, w / 2, h / 2);
+            break;
+        case MFX_FOURCC_I420:
+        case MFX_FOURCC_YV12:
+        case MFX_FOURCC_I010:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.U, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.V, MFX_ERR_NULL_PTR);
+            set(0, data.Y, pitch, 1, w, h);
+            set(1, data.U, pitch / 2, 1, w / 2, h / 2);
+            set(2, data.V, pitch / 2, 1, w / 2, h / 2);
+            break;
+        case MFX_FOURCC_YUY2:
+        case MFX_FOURCC_UYVY:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.U, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.V, MFX_ERR_NULL_PTR);
+            set(0, data.Y, pitch, 2, w, h);
+            set(1, data.U, pitch, 4, w / 2, h);
+            set(2, data.V, pitch, 4, w / 2, h);
+            break;
+        case MFX_FOURCC_AYUV:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.U, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.V, MFX_ERR_NULL_PTR);
+            set(0, data.Y, pitch, 4, w, h);
+            set(1, data.U, pitch, 4, w, h);
+            set(2, data.V, pitch, 4, w, h);
+            break;
+        case MFX_FOURCC_RGB4:
+            MSDK_CHECK_POINTER(data.R, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.G, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.B, MFX_ERR_NULL_PTR);
+            set(0, data.R, pitch, 4, w, h);
+            set(1, data.G, pitch, 4, w, h);
+            set(2, data.B, pitch, 4, w, h);
+            break;
+        default:
+            return MFX_ERR_UNSUPPORTED;
+    }
+
+    // components start at the crop offset
+    mfxU32 bytesPerSample =
+        (MFX_FOURCC_P010 == info.FourCC || MFX_FOURCC_P016 == info.FourCC ||
+         MFX_FOURCC_I010 == info.FourCC)
+            ? 2
+            : 1;
+    for (mfxU32 i = 0; i < *pNumComponents; i++) {
+        mfxU32 subX = (w / views[i].nWidth);
+        mfxU32 subY = (h / views[i].nHeight);
+        views[i].pData += (info.CropY / subY) * views[i].nPitch +
+                          (info.CropX / subX) * views[i].nStep * bytesPerSample;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+const char *const *GetComponentNames(mfxU32 fourcc) {
+    static const char *const yuv[MAX_COMPONENTS] = { "y", "u", "v" };
+    static const char *const rgb[MAX_COMPONENTS] = { "r", "g", "b" };
+
+    return (MFX_FOURCC_RGB4 == fourcc) ? rgb : yuv;
+}
+
+BandWorkerPool::BandWorkerPool(mfxU32 numThreads)
+        : m_threads(),
+          m_mutex(),
+          m_wake(),
+          m_done(),
+          m_pTask(NULL),
+          m_numTasks(0),
+          m_nextTask(0),
+          m_numBusy(0),
+          m_generation(0),
+          m_bStop(false) {
+    // the calling thread is a worker too
+    for (mfxU32 i = 1; i < numThreads; i++)
+        m_threads.emplace_back(&BandWorkerPool::WorkerLoop, this);
+}
+
+BandWorkerPool::~BandWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bStop = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+void BandWorkerPool::Run(mfxU32 numTasks, const std::function<void(mfxU32)> &task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pTask    = &task;
+        m_numTasks = numTasks;
+        m_nextTask = 0;
+        m_numBusy  = (mfxU32)m_threads.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    Drain();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] {
+        return 0 == m_numBusy;
+    });
+    m_pTask = NULL;
+}
+
+void BandWorkerPool::WorkerLoop() {
+    mfxU64 generation = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] {
+                return m_bStop || generation != m_generation;
+            });
+            if (m_bStop)
+                return;
+            generation = m_generation;
+        }
+
+        Drain();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (0 == --m_numBusy)
+            m_done.notify_one();
+    }
+}
+
+void BandWorkerPool::Drain() {
+    for (;;) {
+        mfxU32 idx = m_nextTask++;
+        if (idx >= m_numTasks)
+            break;
+        (*m_pTask)(idx);
+    }
+}
+
+template <typename T>
+static inline const T *GetRow(const ComponentView &view, mfxU32 y) {
+    return (const T *)(view.pData + (size_t)y * view.nPitch);
+}
+
+/* Sum of squared differences of a row. Differences of 8-bit samples are accumulated in 32 bits
+   which is enough for any row and lets the compiler vectorize the unit-stride loop wider. */
+template <typename T>
+static mfxU64 RowSSE(const T *a, const T *b, mfxU32 width, mfxU32 step) {
+    typedef typename std::conditional<sizeof(T) == 1, mfxI32, mfxI64>::type Diff;
+    typedef typename std::conditional<sizeof(T) == 1, mfxU32, mfxU64>::type Acc;
+
+    Acc sum = 0;
+    if (1 == step) {
+        for (mfxU32 x = 0; x < width; x++) {
+            Diff d = (Diff)a[x] - (Diff)b[x];
+            sum += (Acc)(d * d);
+        }
+    }
+    else {
+        for (mfxU32 x = 0; x < width; x++) {
+            Diff d = (Diff)a[x * step] - (Diff)b[x * step];
+            sum += (Acc)(d * d);
+        }
+    }
+    return sum;
+}
+
+/* Sums of 4x4 blocks (or of 4-row columns) along a row, kept as separate arrays so that the
+   loops over them are unit-stride. 32 bits are enough for blocks of 8-bit samples. */
+template <typename Acc>
+struct BlockRowSums {
+    std::vector<Acc> s1; // sum of reference samples
+    std::vector<Acc> s2; // sum of distorted samples
+    std::vector<Acc> ss; // sum of squares of both
+    std::vector<Acc> s12; // sum of products
+
+    explicit BlockRowSums(size_t n) : s1(n), s2(n), ss(n), s12(n) {}
+
+    void Swap(BlockRowSums &other) {
+        s1.swap(other.s1);
+        s2.swap(other.s2);
+        ss.swap(other.ss);
+        s12.swap(other.s12);
+    }
+};
+
+// Sums of each column over the 4 rows of a row of blocks, every sum is written once
+template <typename T, typename Acc>
+static inline void GetColumnSums(const T *const a[SSIM_BLOCK],
+                                 const T *const b[SSIM_BLOCK],
+                                 mfxU32 width,
+                                 mfxU32 step,
+                                 BlockRowSums<Acc> *pCols) {
+    Acc *s1  = pCols->s1.data();
+    Acc *s2  = pCols->s2.data();
+    Acc *ss  = pCols->ss.data();
+    Acc *s12 = pCols->s12.data();
+
+    for (mfxU32 x = 0; x < width; x++) {
+        mfxU32 i = x * step;
+
+        Acc a0 = a[0][i], a1 = a[1][i], a2 = a[2][i], a3 = a[3][i];
+        Acc b0 = b[0][i], b1 = b[1][i], b2 = b[2][i], b3 = b[3][i];
+
+        s1[x]  = a0 + a1 + a2 + a3;
+        s2[x]  = b0 + b1 + b2 + b3;
+        ss[x]  = a0 * a0 + a1 * a1 + a2 * a2 + a3 * a3 + b0 * b0 + b1 * b1 + b2 * b2 + b3 * b3;
+        s12[x] = a0 * b0 + a1 * b1 + a2 * b2 + a3 * b3;
+    }
+}
+
+// Sums over 4x4 blocks of a row of blocks, columns are summed first to keep loops unit-stride
+template <typename T, typename Acc>
+static void GetBlockRowSums(const ComponentView &ref,
+                            const ComponentView &dist,
+                            mfxU32 blockRow,
+                            BlockRowSums<Acc> *pCols,
+                            BlockRowSums<Acc> *pBlocks) {
+    mfxU32 blocksW = ref.nWidth / SSIM_BLOCK;
+    mfxU32 width   = blocksW * SSIM_BLOCK;
+
+    const T *a[SSIM_BLOCK], *b[SSIM_BLOCK];
+    for (mfxU32 r = 0; r < SSIM_BLOCK; r++) {
+        a[r] = GetRow<T>(ref, blockRow * SSIM_BLOCK + r);
+        b[r] = GetRow<T>(dist, blockRow * SSIM_BLOCK + r);
+    }
+    // unit stride is the common case, a separate instance lets the compiler vectorize it
+    if (1 == ref.nStep)
+        GetColumnSums(a, b, width, 1, pCols);
+    else
+        GetColumnSums(a, b, width, ref.nStep, pCols);
+
+    for (mfxU32 bx = 0; bx < blocksW; bx++) {
+        mfxU32 x         = bx * SSIM_BLOCK;
+        pBlocks->s1[bx]  = pCols->s1[x] + pCols->s1[x + 1] + pCols->s1[x + 2] + pCols->s1[x + 3];
+        pBlocks->s2[bx]  = pCols->s2[x] + pCols->s2[x + 1] + pCols->s2[x + 2] + pCols->s2[x + 3];
+        pBlocks->ss[bx]  = pCols->ss[x] + pCols->ss[x + 1] + pCols->ss[x + 2] + pCols->ss[x + 3];
+        pBlocks->s12[bx] = pCols->s12[x] + pCols->s12[x + 1] + pCols->s12[x + 2] +
+                           pCols->s12[x + 3];
+    }
+}
+
+// SSIM of an 8x8 window made of 2x2 blocks, constants are scaled to sums over 64 samples
+static inline mfxF64 WindowSSIM(mfxF64 s1, mfxF64 s2, mfxF64 ss, mfxF64 s12, mfxF64 c1, mfxF64 c2) {
+    mfxF64 vars = ss * 64 - s1 * s1 - s2 * s2;
+    mfxF64 cov  = s12 * 64 - s1 * s2;
+
+    return (2 * s1 * s2 + c1) * (2 * cov + c2) / ((s1 * s1 + s2 * s2 + c1) * (vars + c2));
+}
+
+template <typename T>
+static void ProcessComponentBand(const ComponentView &ref,
+                                 const ComponentView &dist,
+                                 mfxU32 firstRow,
+                                 mfxU32 lastRow,
+                                 bool bSsim,
+                                 mfxF64 maxValue,
+                                 mfxU64 *pSse,
+                                 mfxF64 *pSsimSum,
+                                 mfxU64 *pWindows) {
+    typedef typename std::conditional<sizeof(T) == 1, mfxU32, mfxU64>::type Acc;
+
+    mfxU64 sse = 0;
+    for (mfxU32 y = firstRow; y < lastRow; y++)
+        sse += RowSSE(GetRow<T>(ref, y), GetRow<T>(dist, y), ref.nWidth, ref.nStep);
+    *pSse = sse;
+
+    *pSsimSum = 0;
+    *pWindows = 0;
+    if (!bSsim)
+        return;
+
+    // windows whose top row of blocks lies in the band, the last one is left out
+    mfxU32 blocksW  = ref.nWidth / SSIM_BLOCK;
+    mfxU32 blocksH  = ref.nHeight / SSIM_BLOCK;
+    mfxU32 firstWin = firstRow / SSIM_BLOCK;
+    mfxU32 lastWin  = std::min(lastRow / SSIM_BLOCK, blocksH - 1);
+    if (firstWin >= lastWin)
+        return;
+
+    const mfxF64 c1 = 0.01 * 0.01 * maxValue * maxValue * 64 * 64;
+    const mfxF64 c2 = 0.03 * 0.03 * maxValue * maxValue * 64 * 63;
+
+    BlockRowSums<Acc> cols(blocksW * SSIM_BLOCK);
+    BlockRowSums<Acc> top(blocksW), bottom(blocksW);
+    std::vector<mfxF64> ssimRow(blocksW - 1);
+
+    mfxF64 sum = 0;
+    GetBlockRowSums<T>(ref, dist, firstWin, &cols, &top);
+    for (mfxU32 by = firstWin; by < lastWin; by++) {
+        GetBlockRowSums<T>(ref, dist, by + 1, &cols, &bottom);
+
+        // windows of a row are independent and vectorize, the sum is taken afterwards in order
+        for (mfxU32 bx = 0; bx + 1 < blocksW; bx++) {
+            // 64-bit sums of a window of 16-bit samples stay exact in a double
+            mfxF64 s1  = (mfxF64)top.s1[bx] + top.s1[bx + 1] + bottom.s1[bx] + bottom.s1[bx + 1];
+            mfxF64 s2  = (mfxF64)top.s2[bx] + top.s2[bx + 1] + bottom.s2[bx] + bottom.s2[bx + 1];
+            mfxF64 ss  = (mfxF64)top.ss[bx] + top.ss[bx + 1] + bottom.ss[bx] + bottom.ss[bx + 1];
+            mfxF64 s12 =
+                (mfxF64)top.s12[bx] + top.s12[bx + 1] + bottom.s12[bx] + bottom.s12[bx + 1];
+            ssimRow[bx] = WindowSSIM(s1, s2, ss, s12, c1, c2);
+        }
+        for (mfxU32 bx = 0; bx + 1 < blocksW; bx++)
+            sum += ssimRow[bx];
+        top.Swap(bottom);
+    }
+
+    *pSsimSum = sum;
+    *pWindows = (mfxU64)(lastWin - firstWin) * (blocksW - 1);
+}
+
+FrameComparer::FrameComparer()
+        : m_fourcc(0),
+          m_bHighBitDepth(false),
+          m_bSsim(true),
+          m_maxValue(255),
+          m_pPool(NULL),
+          m_bands(),
+          m_results(),
+          m_nComponents(0),
+          m_ref(),
+          m_dist() {}
+
+mfxStatus FrameComparer::Init(const mfxFrameInfo &info,
+                              mfxU32 bitDepth,
+                              bool bSsim,
+                              BandWorkerPool *pPool) {
+    MSDK_CHECK_POINTER(pPool, MFX_ERR_NULL_PTR);
+
+    m_fourcc        = info.FourCC;
+    m_bHighBitDepth = (MFX_FOURCC_P010 == info.FourCC || MFX_FOURCC_P016 == info.FourCC ||
+                       MFX_FOURCC_I010 == info.FourCC);
+    if (!bitDepth || bitDepth > (m_bHighBitDepth ? 16u : 8u))
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+
+    m_bSsim    = bSsim;
+    m_maxValue = (mfxF64)((1u << bitDepth) - 1);
+    m_pPool    = pPool;
+
+    // fake data to get the geometry of components
+    mfxFrameData data = {};
+    mfxU8 dummy[4]    = {};
+    data.Y = data.U = data.V = dummy;
+    data.Pitch               = info.Width;
+
+    mfxStatus sts = GetComponentViews(info, data, m_ref, &m_nComponents);
+    MSDK_CHECK_STATUS(sts, "GetComponentViews failed");
+
+    m_bands.clear();
+    for (mfxU32 c = 0; c < m_nComponents; c++) {
+        // SSIM needs at least one window
+        if (m_ref[c].nWidth < 2 * SSIM_BLOCK || m_ref[c].nHeight < 2 * SSIM_BLOCK)
+            return MFX_ERR_INVALID_VIDEO_PARAM;
+
+        // chroma bands keep the same number of bands as luma
+        mfxU32 bandHeight = BAND_HEIGHT * m_ref[c].nHeight / m_ref[0].nHeight;
+        for (mfxU32 y = 0; y < m_ref[c].nHeight; y += bandHeight) {
+            Band band;
+            band.component = c;
+            band.firstRow  = y;
+            band.lastRow   = std::min(y + bandHeight, m_ref[c].nHeight);
+            // a short tail is merged into the previous band
+            if (m_ref[c].nHeight - band.lastRow < bandHeight / 2)
+                band.lastRow = m_ref[c].nHeight;
+            m_bands.push_back(band);
+            if (band.lastRow == m_ref[c].nHeight)
+                break;
+        }
+    }
+    m_results.resize(m_bands.size());
+
+    return MFX_ERR_NONE;
+}
+
+void FrameComparer::ProcessBand(mfxU32 idx) {
+    const Band &band   = m_bands[idx];
+    BandResult &result = m_results[idx];
+    const auto &ref    = m_ref[band.component];
+    const auto &dist   = m_dist[band.component];
+
+    if (m_bHighBitDepth) {
+        ProcessComponentBand<mfxU16>(ref,
+                                     dist,
+                                     band.firstRow,
+                                     band.lastRow,
+                                     m_bSsim,
+                                     m_maxValue,
+                                     &result.sse,
+                                     &result.ssimSum,
+                                     &result.nWindows);
+    }
+    else {
+        ProcessComponentBand<mfxU8>(ref,
+                                    dist,
+                                    band.firstRow,
+                                    band.lastRow,
+                                    m_bSsim,
+                                    m_maxValue,
+                                    &result.sse,
+                                    &result.ssimSum,
+                                    &result.nWindows);
+    }
+}
+
+static mfxF64 GetPSNR(mfxU64 sse, mfxU64 nSamples, mfxF64 maxValue) {
+    if (!sse)
+        return PSNR_IDENTICAL;
+    return std::min(PSNR_IDENTICAL, 10 * log10(maxValue * maxValue * nSamples / sse));
+}
+
+mfxStatus FrameComparer::Compare(const mfxFrameSurface1 &ref,
+                                 const mfxFrameSurface1 &dist,
+                                 FrameMetrics *pMetrics) {
+    MSDK_CHECK_POINTER(pMetrics, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(m_pPool, MFX_ERR_NOT_INITIALIZED);
+
+    mfxU32 nComponents = 0;
+    mfxStatus sts      = GetComponentViews(ref.Info, ref.Data, m_ref, &nComponents);
+    MSDK_CHECK_STATUS(sts, "GetComponentViews failed");
+    sts = GetComponentViews(dist.Info, dist.Data, m_dist, &nComponents);
+    MSDK_CHECK_STATUS(sts, "GetComponentViews failed");
+
+    std::function<void(mfxU32)> task = [this](mfxU32 idx) {
+        ProcessBand(idx);
+    };
+    m_pPool->Run((mfxU32)m_bands.size(), task);
+
+    // bands are reduced in a fixed order so the result doesn't depend on the number of threads
+    mfxF64 ssimSum[MAX_COMPONENTS]  = {};
+    mfxU64 nWindows[MAX_COMPONENTS] = {};
+    *pMetrics                       = FrameMetrics();
+    pMetrics->nComponents           = m_nComponents;
+    for (size_t i = 0; i < m_bands.size(); i++) {
+        mfxU32 c = m_bands[i].component;
+        pMetrics->sse[c] += m_results[i].sse;
+        ssimSum[c] += m_results[i].ssimSum;
+        nWindows[c] += m_results[i].nWindows;
+    }
+
+    mfxU64 totalSse = 0, totalSamples = 0, totalWindows = 0;
+    mfxF64 totalSsim = 0;
+    for (mfxU32 c = 0; c < m_nComponents; c++) {
+        pMetrics->nSamples[c] = (mfxU64)m_ref[c].nWidth * m_ref[c].nHeight;
+        pMetrics->psnr[c]     = GetPSNR(pMetrics->sse[c], pMetrics->nSamples[c], m_maxValue);
+        pMetrics->ssim[c]     = nWindows[c] ? ssimSum[c] / nWindows[c] : 1.0;
+
+        totalSse += pMetrics->sse[c];
+        totalSamples += pMetrics->nSamples[c];
+        totalSsim += ssimSum[c];
+        totalWindows += nWindows[c];
+    }
+    pMetrics->psnr[m_nComponents] = GetPSNR(totalSse, totalSamples, m_maxValue);
+    pMetrics->ssim[m_nComponents] = totalWindows ? totalSsim / totalWindows : 1.0;
+
+    return MFX_ERR_NONE;
+}
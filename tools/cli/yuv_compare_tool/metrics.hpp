@@ -0,0 +1,121 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef TOOLS_CLI_YUV_COMPARE_TOOL_METRICS_HPP_
+#define TOOLS_CLI_YUV_COMPARE_TOOL_METRICS_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sample_defs.h"
+
+#define MAX_COMPONENTS 3
+
+// PSNR reported for identical planes, keeps the output finite
+#define PSNR_IDENTICAL 100.0
+
+// Visible area of one colour component of a mapped surface
+struct ComponentView {
+    const mfxU8 *pData; // first sample
+    mfxU32 nPitch; // bytes between rows
+    mfxU32 nStep; // samples between neighbouring samples of the component in a row
+    mfxU32 nWidth;
+    mfxU32 nHeight;
+};
+
+struct FrameMetrics {
+    mfxU32 nComponents;
+    mfxF64 psnr[MAX_COMPONENTS + 1]; // per component, the last one is for all components
+    mfxF64 ssim[MAX_COMPONENTS + 1];
+    mfxU64 sse[MAX_COMPONENTS];
+    mfxU64 nSamples[MAX_COMPONENTS];
+};
+
+// Fills views of Y, U, V (or R, G, B) components of a surface locked in system memory
+mfxStatus GetComponentViews(const mfxFrameInfo &info,
+                            const mfxFrameData &data,
+                            ComponentView views[MAX_COMPONENTS],
+                            mfxU32 *pNumComponents);
+
+// Names of components in the order returned by GetComponentViews
+const char *const *GetComponentNames(mfxU32 fourcc);
+
+/* Fixed set of threads running the tasks of one job at a time. Tasks are picked from a shared
+   counter, the calling thread takes tasks too and Run returns when all of them are done. */
+class BandWorkerPool {
+public:
+    explicit BandWorkerPool(mfxU32 numThreads);
+    ~BandWorkerPool();
+
+    void Run(mfxU32 numTasks, const std::function<void(mfxU32)> &task);
+
+    mfxU32 GetNumThreads() const {
+        return (mfxU32)m_threads.size() + 1;
+    }
+
+private:
+    void WorkerLoop();
+    void Drain();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(mfxU32)> *m_pTask;
+    mfxU32 m_numTasks;
+    std::atomic<mfxU32> m_nextTask;
+    mfxU32 m_numBusy;
+    mfxU64 m_generation;
+    bool m_bStop;
+
+    BandWorkerPool(const BandWorkerPool &)            = delete;
+    BandWorkerPool &operator=(const BandWorkerPool &) = delete;
+};
+
+/* Computes PSNR and SSIM of a distorted frame against the reference one. Every component is
+   cut into horizontal bands which are processed in parallel; SSIM is the mean over 8x8 windows
+   stepping by 4 samples, built from sums of 4x4 blocks. */
+class FrameComparer {
+public:
+    FrameComparer();
+
+    mfxStatus Init(const mfxFrameInfo &info, mfxU32 bitDepth, bool bSsim, BandWorkerPool *pPool);
+    mfxStatus Compare(const mfxFrameSurface1 &ref,
+                      const mfxFrameSurface1 &dist,
+                      FrameMetrics *pMetrics);
+
+private:
+    struct BandResult {
+        mfxU64 sse;
+        mfxF64 ssimSum;
+        mfxU64 nWindows;
+    };
+
+    struct Band {
+        mfxU32 component;
+        mfxU32 firstRow;
+        mfxU32 lastRow; // exclusive
+    };
+
+    void ProcessBand(mfxU32 idx);
+
+    mfxU32 m_fourcc;
+    bool m_bHighBitDepth;
+    bool m_bSsim;
+    mfxF64 m_maxValue;
+    BandWorkerPool *m_pPool;
+    std::vector<Band> m_bands;
+    std::vector<BandResult> m_results;
+    mfxU32 m_nComponents;
+    ComponentView m_ref[MAX_COMPONENTS];
+    ComponentView m_dist[MAX_COMPONENTS];
+};
+
+#endif // TOOLS_CLI_YUV_COMPARE_TOOL_METRICS_HPP_
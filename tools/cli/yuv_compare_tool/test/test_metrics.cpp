@@ -0,0 +1,308 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+///
+/// Checks PSNR and SSIM of FrameComparer: closed-form values of frames with a constant
+/// difference, and a straightforward per-window computation on noisy frames of sizes which
+/// leave partial bands and blocks
+///
+/// @file
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "metrics.hpp"
+
+#define CHECK(cond)                                            \
+    if (!(cond)) {                                             \
+        printf("\n   Error! %s (line %d)\n", #cond, __LINE__); \
+        return false;                                          \
+    }
+
+#define CHECK_NEAR(a, b, eps) CHECK(fabs((a) - (b)) < (eps))
+
+// Samples of the Y, U and V planes, chroma has half the width and height of luma
+struct Planes {
+    mfxU32 width;
+    mfxU32 height;
+    std::vector<mfxU32> comp[MAX_COMPONENTS];
+
+    Planes(mfxU32 w, mfxU32 h) : width(w), height(h) {
+        comp[0].resize(w * h);
+        comp[1].resize(w / 2 * h / 2);
+        comp[2].resize(w / 2 * h / 2);
+    }
+
+    mfxU32 GetWidth(mfxU32 c) const {
+        return c ? width / 2 : width;
+    }
+
+    mfxU32 GetHeight(mfxU32 c) const {
+        return c ? height / 2 : height;
+    }
+};
+
+// NV12 or P010 frame in system memory with the visible area at the top left corner
+class TestFrame {
+public:
+    TestFrame(const Planes &planes, mfxU32 fourcc) : m_buffer(), m_surface() {
+        mfxU32 bytes  = (MFX_FOURCC_P010 == fourcc) ? 2 : 1;
+        mfxU32 width  = MSDK_ALIGN16(planes.width);
+        mfxU32 height = MSDK_ALIGN16(planes.height);
+        mfxU32 pitch  = width * bytes;
+
+        m_buffer.resize(pitch * height * 3 / 2);
+        mfxU8 *y  = m_buffer.data();
+        mfxU8 *uv = y + pitch * height;
+        for (mfxU32 r = 0; r < planes.height; r++) {
+            for (mfxU32 x = 0; x < planes.width; x++)
+                Put(y + r * pitch, x, bytes, planes.comp[0][r * planes.width + x]);
+        }
+        for (mfxU32 r = 0; r < planes.height / 2; r++) {
+            for (mfxU32 x = 0; x < planes.width / 2; x++) {
+                Put(uv + r * pitch, 2 * x, bytes, planes.comp[1][r * planes.width / 2 + x]);
+                Put(uv + r * pitch, 2 * x + 1, bytes, planes.comp[2][r * planes.width / 2 + x]);
+            }
+        }
+
+        m_surface.Info.FourCC       = fourcc;
+        m_surface.Info.ChromaFormat = MFX_CHROMAFORMAT_YUV420;
+        m_surface.Info.Width        = (mfxU16)width;
+        m_surface.Info.Height       = (mfxU16)height;
+        m_surface.Info.CropW        = (mfxU16)planes.width;
+        m_surface.Info.CropH        = (mfxU16)planes.height;
+        m_surface.Data.Y            = y;
+        m_surface.Data.UV           = uv;
+        m_surface.Data.Pitch        = (mfxU16)pitch;
+    }
+
+    const mfxFrameSurface1 &Get() const {
+        return m_surface;
+    }
+
+private:
+    static void Put(mfxU8 *row, mfxU32 idx, mfxU32 bytes, mfxU32 value) {
+        if (2 == bytes)
+            ((mfxU16 *)row)[idx] = (mfxU16)value;
+        else
+            row[idx] = (mfxU8)value;
+    }
+
+    std::vector<mfxU8> m_buffer;
+    mfxFrameSurface1 m_surface;
+};
+
+// SSIM of 8x8 windows stepping by 4 samples over the whole 4x4 blocks of the component,
+// with the variances and the covariance normalized by 63
+static mfxF64 ReferenceSSIM(const std::vector<mfxU32> &a,
+                            const std::vector<mfxU32> &b,
+                            mfxU32 width,
+                            mfxU32 height,
+                            mfxF64 maxValue,
+                            mfxU64 *pWindows) {
+    const mfxF64 c1 = 0.01 * 0.01 * maxValue * maxValue;
+    const mfxF64 c2 = 0.03 * 0.03 * maxValue * maxValue;
+
+    mfxF64 sum      = 0;
+    mfxU64 nWindows = 0;
+    for (mfxU32 wy = 0; wy + 8 <= height / 4 * 4; wy += 4) {
+        for (mfxU32 wx = 0; wx + 8 <= width / 4 * 4; wx += 4) {
+            mfxF64 meanA = 0, meanB = 0;
+            for (mfxU32 y = wy; y < wy + 8; y++) {
+                for (mfxU32 x = wx; x < wx + 8; x++) {
+                    meanA += a[y * width + x];
+                    meanB += b[y * width + x];
+                }
+            }
+            meanA /= 64;
+            meanB /= 64;
+
+            mfxF64 varA = 0, varB = 0, cov = 0;
+            for (mfxU32 y = wy; y < wy + 8; y++) {
+                for (mfxU32 x = wx; x < wx + 8; x++) {
+                    mfxF64 da = a[y * width + x] - meanA;
+                    mfxF64 db = b[y * width + x] - meanB;
+                    varA += da * da;
+                    varB += db * db;
+                    cov += da * db;
+                }
+            }
+            varA /= 63;
+            varB /= 63;
+            cov /= 63;
+
+            sum += (2 * meanA * meanB + c1) * (2 * cov + c2) /
+                   ((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+            nWindows++;
+        }
+    }
+    *pWindows = nWindows;
+    return sum / nWindows;
+}
+
+static mfxF64 ReferencePSNR(mfxF64 sse, mfxF64 nSamples, mfxF64 maxValue) {
+    return 10 * log10(maxValue * maxValue * nSamples / sse);
+}
+
+static mfxStatus Compare(const Planes &ref,
+                         const Planes &dist,
+                         mfxU32 fourcc,
+                         mfxU32 bitDepth,
+                         mfxU32 numThreads,
+                         FrameMetrics *pMetrics) {
+    TestFrame refFrame(ref, fourcc), distFrame(dist, fourcc);
+
+    BandWorkerPool pool(numThreads);
+    FrameComparer comparer;
+    mfxStatus sts = comparer.Init(refFrame.Get().Info, bitDepth, true, &pool);
+    if (MFX_ERR_NONE != sts)
+        return sts;
+    return comparer.Compare(refFrame.Get(), distFrame.Get(), pMetrics);
+}
+
+// Noise of up to +-amplitude, the same sequence on every run
+static void MakeNoisy(const Planes &ref, mfxU32 amplitude, mfxU32 maxValue, Planes *pDist) {
+    mfxU32 state = 12345;
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++) {
+        for (size_t i = 0; i < ref.comp[c].size(); i++) {
+            state        = state * 1103515245 + 12345;
+            mfxI32 noise = (mfxI32)((state >> 16) % (2 * amplitude + 1)) - (mfxI32)amplitude;
+            mfxI32 value = (mfxI32)ref.comp[c][i] + noise;
+
+            pDist->comp[c][i] = (mfxU32)std::min(std::max(value, 0), (mfxI32)maxValue);
+        }
+    }
+}
+
+// Smooth gradients with some texture, so windows have different means and variances
+static void MakePattern(Planes *pPlanes, mfxU32 maxValue) {
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++) {
+        mfxU32 w = pPlanes->GetWidth(c), h = pPlanes->GetHeight(c);
+        for (mfxU32 y = 0; y < h; y++) {
+            for (mfxU32 x = 0; x < w; x++) {
+                mfxU32 v = (x * 7 + y * 3 + c * 50 + ((x ^ y) & 15) * 4) % (maxValue / 2);
+                pPlanes->comp[c][y * w + x] = v + maxValue / 4;
+            }
+        }
+    }
+}
+
+static void Fill(Planes *pPlanes, mfxU32 luma, mfxU32 chroma) {
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++) {
+        for (auto &v : pPlanes->comp[c])
+            v = c ? chroma : luma;
+    }
+}
+
+static bool TestIdentical() {
+    Planes ref(64, 48);
+    MakePattern(&ref, 255);
+
+    FrameMetrics metrics = {};
+    CHECK(MFX_ERR_NONE == Compare(ref, ref, MFX_FOURCC_NV12, 8, 2, &metrics));
+    CHECK(MAX_COMPONENTS == metrics.nComponents);
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++) {
+        CHECK(PSNR_IDENTICAL == metrics.psnr[c]);
+        CHECK_NEAR(metrics.ssim[c], 1.0, 1e-12);
+    }
+    return true;
+}
+
+// Flat frames: MSE is the squared offset and SSIM is the luminance term only,
+// (2 * a * b + c1) / (a * a + b * b + c1)
+static bool TestConstantOffset() {
+    Planes ref(64, 64), dist(64, 64);
+    Fill(&ref, 100, 128);
+    Fill(&dist, 110, 133);
+
+    FrameMetrics metrics = {};
+    CHECK(MFX_ERR_NONE == Compare(ref, dist, MFX_FOURCC_NV12, 8, 4, &metrics));
+
+    CHECK_NEAR(metrics.psnr[0], 28.130804, 1e-5); // MSE 100
+    CHECK_NEAR(metrics.psnr[1], 34.151404, 1e-5); // MSE 25
+    CHECK_NEAR(metrics.psnr[2], 34.151404, 1e-5);
+    CHECK_NEAR(metrics.psnr[3], 29.380191, 1e-5); // MSE (4 * 100 + 2 * 25) / 6
+
+    CHECK_NEAR(metrics.ssim[0], 0.995476444, 1e-8);
+    CHECK_NEAR(metrics.ssim[1], 0.999266421, 1e-8);
+    CHECK_NEAR(metrics.ssim[2], 0.999266421, 1e-8);
+    // 15 x 15 luma windows and 7 x 7 windows of each chroma component
+    CHECK_NEAR(metrics.ssim[3], (225 * 0.995476444 + 98 * 0.999266421) / 323, 1e-8);
+
+    CHECK(100 * 64 * 64 == metrics.sse[0]);
+    CHECK(25 * 32 * 32 == metrics.sse[1]);
+    return true;
+}
+
+// Noisy frame against the direct computation, the result doesn't depend on the threads
+static bool CheckNoisy(mfxU32 fourcc, mfxU32 bitDepth, mfxU32 width, mfxU32 height) {
+    mfxU32 maxValue = (1u << bitDepth) - 1;
+    Planes ref(width, height), dist(width, height);
+    MakePattern(&ref, maxValue);
+    MakeNoisy(ref, maxValue / 16, maxValue, &dist);
+
+    FrameMetrics metrics = {}, threaded = {};
+    CHECK(MFX_ERR_NONE == Compare(ref, dist, fourcc, bitDepth, 1, &metrics));
+    CHECK(MFX_ERR_NONE == Compare(ref, dist, fourcc, bitDepth, 5, &threaded));
+
+    mfxF64 totalSse = 0, totalSamples = 0, totalSsim = 0;
+    mfxU64 totalWindows = 0;
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++) {
+        mfxU32 w = ref.GetWidth(c), h = ref.GetHeight(c);
+
+        mfxF64 sse = 0;
+        for (size_t i = 0; i < ref.comp[c].size(); i++) {
+            mfxF64 d = (mfxF64)ref.comp[c][i] - dist.comp[c][i];
+            sse += d * d;
+        }
+        mfxU64 nWindows = 0;
+        mfxF64 ssim = ReferenceSSIM(ref.comp[c], dist.comp[c], w, h, maxValue, &nWindows);
+
+        CHECK((mfxF64)metrics.sse[c] == sse);
+        CHECK(metrics.nSamples[c] == (mfxU64)w * h);
+        CHECK_NEAR(metrics.psnr[c], ReferencePSNR(sse, (mfxF64)w * h, maxValue), 1e-9);
+        CHECK_NEAR(metrics.ssim[c], ssim, 1e-9);
+
+        totalSse += sse;
+        totalSamples += (mfxF64)w * h;
+        totalSsim += ssim * nWindows;
+        totalWindows += nWindows;
+    }
+    CHECK_NEAR(metrics.psnr[3], ReferencePSNR(totalSse, totalSamples, maxValue), 1e-9);
+    CHECK_NEAR(metrics.ssim[3], totalSsim / totalWindows, 1e-9);
+
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++) {
+        CHECK(metrics.psnr[c] == threaded.psnr[c]);
+        CHECK(metrics.ssim[c] == threaded.ssim[c]);
+    }
+    return true;
+}
+
+// Sizes which are not multiples of the band height and of the SSIM block
+static bool TestNoisyNV12() {
+    return CheckNoisy(MFX_FOURCC_NV12, 8, 198, 150);
+}
+
+static bool TestNoisyP010() {
+    return CheckNoisy(MFX_FOURCC_P010, 10, 134, 90);
+}
+
+#define RUN_TEST(test)        \
+    printf("Test %s", #test); \
+    if (!test())              \
+        return -1;            \
+    printf(" passed\n");
+
+int main() {
+    RUN_TEST(TestIdentical);
+    RUN_TEST(TestConstantOffset);
+    RUN_TEST(TestNoisyNV12);
+    RUN_TEST(TestNoisyP010);
+    return 0;
+}
@@ -0,0 +1,491 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+///
+/// Objective quality of raw video: per-frame and average PSNR and SSIM of a distorted
+/// stream against the reference one, read through the sample YUV reader
+///
+/// @file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <list>
+#include <string>
+#include <thread>
+
+#include "metrics.hpp"
+#include "sample_utils.h"
+#include "sysmem_allocator.h"
+
+// frame pairs in flight: one is compared while the next one is read
+#define NUM_FRAME_PAIRS 2
+
+struct Params {
+    std::string refFile;
+    std::string distFile;
+    std::string outFile;
+    mfxU32 fourcc;
+    mfxU16 width;
+    mfxU16 height;
+    mfxU32 bitDepth; // 0 - default for the colour format
+    mfxU32 numFrames; // 0 - until the end of the shortest input
+    mfxU32 numThreads; // 0 - number of logical CPUs
+    mfxF64 frameRate; // frame rate of the video, the speed is reported relative to it
+    bool bJson;
+    bool bSsim;
+};
+
+struct SequenceStats {
+    mfxU32 nFrames;
+    mfxF64 psnrSum[MAX_COMPONENTS + 1];
+    mfxF64 ssimSum[MAX_COMPONENTS + 1];
+    mfxF64 psnrMin[MAX_COMPONENTS + 1];
+    mfxF64 ssimMin[MAX_COMPONENTS + 1];
+};
+
+static void Usage(void) {
+    printf("\n");
+    printf("   Usage  :  yuv_compare_tool -ref <file> -dist <file> -w <width> -h <height> [options]\n\n");
+    printf("     -ref           reference raw video file\n\n");
+    printf("     -dist          distorted raw video file, same format and resolution\n\n");
+    printf("     -w, -h         frame width and height\n\n");
+    printf("     -fourcc        colour format of both inputs, default nv12:\n");
+    printf("                    nv12, i420, yv12, p010, p016, i010, yuy2, uyvy, ayuv, rgb4\n\n");
+    printf("     -bitdepth      significant bits of samples, default 8, 10 for p010/i010,\n");
+    printf("                    16 for p016; use 16 for MSB-aligned p010\n\n");
+    printf("     -n             number of frames to compare, default all\n\n");
+    printf("     -threads       number of threads, default number of logical CPUs\n\n");
+    printf("     -fps           frame rate of the inputs, default 30; the speed is also\n");
+    printf("                    reported as a multiple of real time at this rate\n\n");
+    printf("     -format        csv or json, default csv\n\n");
+    printf("     -o             output file for per-frame metrics, default stdout\n\n");
+    printf("     -no_ssim       compute PSNR only\n\n");
+    printf("   PSNR of identical planes is reported as %.0f dB.\n", PSNR_IDENTICAL);
+    printf("   The summary, the processing speed and errors are printed to stderr.\n\n");
+    printf("   Example: \n");
+    printf("     yuv_compare_tool -ref src.nv12 -dist dec.nv12 -w 3840 -h 2160 -format json -o q.json\n\n");
+}
+
+static bool ParseFourCC(const char *str, mfxU32 *pFourcc) {
+    static const struct {
+        const char *name;
+        mfxU32 fourcc;
+    } formats[] = {
+        { "nv12", MFX_FOURCC_NV12 }, { "i420", MFX_FOURCC_I420 }, { "yv12", MFX_FOURCC_YV12 },
+        { "p010", MFX_FOURCC_P010 }, { "p016", MFX_FOURCC_P016 }, { "i010", MFX_FOURCC_I010 },
+        { "yuy2", MFX_FOURCC_YUY2 }, { "uyvy", MFX_FOURCC_UYVY }, { "ayuv", MFX_FOURCC_AYUV },
+        { "rgb4", MFX_FOURCC_RGB4 },
+    };
+
+    for (const auto &format : formats) {
+        if (0 == strcmp(str, format.name)) {
+            *pFourcc = format.fourcc;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseArgs(int argc, char *argv[], Params *pParams) {
+    Params &params    = *pParams;
+    params.fourcc     = MFX_FOURCC_NV12;
+    params.width      = 0;
+    params.height     = 0;
+    params.bitDepth   = 0;
+    params.numFrames  = 0;
+    params.numThreads = 0;
+    params.frameRate  = 30;
+    params.bJson      = false;
+    params.bSsim      = true;
+
+    for (int i = 1; i < argc; i++) {
+        // all options but -no_ssim have a value
+        bool bHasValue = (i + 1 < argc);
+
+        if (0 == strcmp(argv[i], "-no_ssim")) {
+            params.bSsim = false;
+        }
+        else if (0 == strcmp(argv[i], "-ref") && bHasValue) {
+            params.refFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-dist") && bHasValue) {
+            params.distFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-o") && bHasValue) {
+            params.outFile = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "-w") && bHasValue) {
+            params.width = (mfxU16)atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-h") && bHasValue) {
+            params.height = (mfxU16)atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-fourcc") && bHasValue) {
+            if (!ParseFourCC(argv[++i], &params.fourcc)) {
+                fprintf(stderr, "error: unsupported colour format %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (0 == strcmp(argv[i], "-bitdepth") && bHasValue) {
+            params.bitDepth = (mfxU32)atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-n") && bHasValue) {
+            params.numFrames = (mfxU32)atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-threads") && bHasValue) {
+            params.numThreads = (mfxU32)atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-fps") && bHasValue) {
+            params.frameRate = atof(argv[++i]);
+            if (params.frameRate <= 0) {
+                fprintf(stderr, "error: invalid frame rate %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (0 == strcmp(argv[i], "-format") && bHasValue) {
+            i++;
+            if (0 == strcmp(argv[i], "json")) {
+                params.bJson = true;
+            }
+            else if (0 != strcmp(argv[i], "csv")) {
+                fprintf(stderr, "error: unsupported output format %s\n", argv[i]);
+                return false;
+            }
+        }
+        else {
+            fprintf(stderr, "error: unknown or incomplete option %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (params.refFile.empty() || params.distFile.empty()) {
+        fprintf(stderr, "error: both -ref and -dist must be set\n");
+        return false;
+    }
+    if (!params.width || !params.height) {
+        fprintf(stderr, "error: frame size must be set\n");
+        return false;
+    }
+
+    if (!params.bitDepth) {
+        if (MFX_FOURCC_P016 == params.fourcc)
+            params.bitDepth = 16;
+        else if (MFX_FOURCC_P010 == params.fourcc || MFX_FOURCC_I010 == params.fourcc)
+            params.bitDepth = 10;
+        else
+            params.bitDepth = 8;
+    }
+    if (!params.numThreads)
+        params.numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+static mfxStatus InitReader(CSmplYUVReader *pReader, const std::string &file, mfxU32 fourcc) {
+    std::list<msdk_string> inputs;
+    inputs.push_back(msdk_string(file.begin(), file.end()));
+
+    mfxStatus sts = pReader->Init(inputs, fourcc);
+    if (MFX_ERR_NONE != sts)
+        fprintf(stderr, "error: failed to open %s\n", file.c_str());
+    return sts;
+}
+
+// Reads the next frame of both inputs, MFX_ERR_MORE_DATA means the end of either of them
+static mfxStatus LoadFramePair(CSmplYUVReader *pRef,
+                               CSmplYUVReader *pDist,
+                               mfxFrameSurface1 *pRefSurface,
+                               mfxFrameSurface1 *pDistSurface) {
+    mfxStatus stsRef  = pRef->LoadNextFrame(pRefSurface);
+    mfxStatus stsDist = pDist->LoadNextFrame(pDistSurface);
+
+    if (stsRef == stsDist)
+        return stsRef;
+    if (MFX_ERR_MORE_DATA == stsRef || MFX_ERR_MORE_DATA == stsDist) {
+        fprintf(stderr,
+                "warning: %s input is shorter, the rest of the other one is ignored\n",
+                MFX_ERR_MORE_DATA == stsRef ? "reference" : "distorted");
+        return MFX_ERR_MORE_DATA;
+    }
+    return (MFX_ERR_NONE != stsRef) ? stsRef : stsDist;
+}
+
+static void WriteHeader(FILE *out, const Params &params, const char *const *names) {
+    if (params.bJson) {
+        fprintf(out, "{\n  \"frames\": [\n");
+        return;
+    }
+
+    fprintf(out, "frame");
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++)
+        fprintf(out, ",psnr_%s", names[c]);
+    fprintf(out, ",psnr_all");
+    if (params.bSsim) {
+        for (mfxU32 c = 0; c < MAX_COMPONENTS; c++)
+            fprintf(out, ",ssim_%s", names[c]);
+        fprintf(out, ",ssim_all");
+    }
+    fprintf(out, "\n");
+}
+
+static void WriteJsonValues(FILE *out,
+                            const char *key,
+                            const mfxF64 *values,
+                            const char *const *names,
+                            const char *valueFormat) {
+    fprintf(out, "\"%s\": {", key);
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++) {
+        fprintf(out, "%s\"%s\": ", c ? ", " : "", c < MAX_COMPONENTS ? names[c] : "all");
+        fprintf(out, valueFormat, values[c]);
+    }
+    fprintf(out, "}");
+}
+
+static void WriteFrame(FILE *out,
+                       const Params &params,
+                       const char *const *names,
+                       mfxU32 frame,
+                       const FrameMetrics &metrics) {
+    if (params.bJson) {
+        fprintf(out, "%s    {\"frame\": %u, ", frame ? ",\n" : "", frame);
+        WriteJsonValues(out, "psnr", metrics.psnr, names, "%.4f");
+        if (params.bSsim) {
+            fprintf(out, ", ");
+            WriteJsonValues(out, "ssim", metrics.ssim, names, "%.6f");
+        }
+        fprintf(out, "}");
+    }
+    else {
+        fprintf(out, "%u", frame);
+        for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+            fprintf(out, ",%.4f", metrics.psnr[c]);
+        if (params.bSsim) {
+            for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+                fprintf(out, ",%.6f", metrics.ssim[c]);
+        }
+        fprintf(out, "\n");
+    }
+    // results are streamed, a consumer can follow the output while frames are processed
+    fflush(out);
+}
+
+static void WriteSummary(FILE *out,
+                         const Params &params,
+                         const char *const *names,
+                         const SequenceStats &stats) {
+    mfxF64 psnrAvg[MAX_COMPONENTS + 1] = {}, ssimAvg[MAX_COMPONENTS + 1] = {};
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS && stats.nFrames; c++) {
+        psnrAvg[c] = stats.psnrSum[c] / stats.nFrames;
+        ssimAvg[c] = stats.ssimSum[c] / stats.nFrames;
+    }
+
+    if (params.bJson) {
+        fprintf(out,
+                "%s  ],\n  \"summary\": {\"frames\": %u",
+                stats.nFrames ? "\n" : "",
+                stats.nFrames);
+        if (stats.nFrames) {
+            fprintf(out, ",\n    \"average\": {");
+            WriteJsonValues(out, "psnr", psnrAvg, names, "%.4f");
+            if (params.bSsim) {
+                fprintf(out, ", ");
+                WriteJsonValues(out, "ssim", ssimAvg, names, "%.6f");
+            }
+            fprintf(out, "},\n    \"min\": {");
+            WriteJsonValues(out, "psnr", stats.psnrMin, names, "%.4f");
+            if (params.bSsim) {
+                fprintf(out, ", ");
+                WriteJsonValues(out, "ssim", stats.ssimMin, names, "%.6f");
+            }
+            fprintf(out, "}\n  ");
+        }
+        fprintf(out, "}\n}\n");
+    }
+
+    fprintf(stderr, "Frames compared: %u\n", stats.nFrames);
+    if (!stats.nFrames)
+        return;
+
+    fprintf(stderr, "            ");
+    for (mfxU32 c = 0; c < MAX_COMPONENTS; c++)
+        fprintf(stderr, "%10s", names[c]);
+    fprintf(stderr, "%10s\n", "all");
+    fprintf(stderr, "PSNR avg:   ");
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+        fprintf(stderr, "%10.4f", psnrAvg[c]);
+    fprintf(stderr, "\nPSNR min:   ");
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+        fprintf(stderr, "%10.4f", stats.psnrMin[c]);
+    if (params.bSsim) {
+        fprintf(stderr, "\nSSIM avg:   ");
+        for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+            fprintf(stderr, "%10.6f", ssimAvg[c]);
+        fprintf(stderr, "\nSSIM min:   ");
+        for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++)
+            fprintf(stderr, "%10.6f", stats.ssimMin[c]);
+    }
+    fprintf(stderr, "\n");
+}
+
+static void AccumulateStats(const FrameMetrics &metrics, SequenceStats *pStats) {
+    for (mfxU32 c = 0; c <= MAX_COMPONENTS; c++) {
+        pStats->psnrSum[c] += metrics.psnr[c];
+        pStats->ssimSum[c] += metrics.ssim[c];
+        pStats->psnrMin[c] = pStats->nFrames ? std::min(pStats->psnrMin[c], metrics.psnr[c])
+                                             : metrics.psnr[c];
+        pStats->ssimMin[c] = pStats->nFrames ? std::min(pStats->ssimMin[c], metrics.ssim[c])
+                                             : metrics.ssim[c];
+    }
+    pStats->nFrames++;
+}
+
+static mfxStatus Compare(const Params &params, FILE *out) {
+    CSmplYUVReader refReader, distReader;
+    mfxStatus sts = InitReader(&refReader, params.refFile, params.fourcc);
+    MSDK_CHECK_STATUS(sts, "InitReader failed");
+    sts = InitReader(&distReader, params.distFile, params.fourcc);
+    MSDK_CHECK_STATUS(sts, "InitReader failed");
+
+    mfxFrameInfo info = {};
+    info.FourCC       = params.fourcc;
+    info.ChromaFormat = FourCCToChroma(params.fourcc);
+    info.Width        = (mfxU16)MSDK_ALIGN16(params.width);
+    info.Height       = (mfxU16)MSDK_ALIGN16(params.height);
+    info.CropW        = params.width;
+    info.CropH        = params.height;
+    info.PicStruct    = MFX_PICSTRUCT_PROGRESSIVE;
+    if (params.bitDepth > 8)
+        info.BitDepthLuma = info.BitDepthChroma = (mfxU16)params.bitDepth;
+
+    BandWorkerPool pool(params.numThreads);
+    FrameComparer comparer;
+    sts = comparer.Init(info, params.bitDepth, params.bSsim, &pool);
+    if (MFX_ERR_NONE != sts) {
+        fprintf(stderr,
+                "error: unsupported combination of colour format, bit depth and frame size\n");
+        return sts;
+    }
+
+    SysMemFrameAllocator allocator;
+    sts = allocator.Init(NULL);
+    MSDK_CHECK_STATUS(sts, "allocator.Init failed");
+
+    mfxFrameAllocRequest request   = {};
+    mfxFrameAllocResponse response = {};
+
+    request.Info              = info;
+    request.Type              = MFX_MEMTYPE_SYSTEM_MEMORY | MFX_MEMTYPE_FROM_VPPIN;
+    request.NumFrameMin       = 2 * NUM_FRAME_PAIRS;
+    request.NumFrameSuggested = 2 * NUM_FRAME_PAIRS;
+
+    sts = allocator.AllocFrames(&request, &response);
+    MSDK_CHECK_STATUS(sts, "allocator.AllocFrames failed");
+
+    // surfaces 2 * i and 2 * i + 1 are the reference and the distorted frames of pair i
+    mfxFrameSurface1 surfaces[2 * NUM_FRAME_PAIRS] = {};
+    for (mfxU32 i = 0; i < 2 * NUM_FRAME_PAIRS && MFX_ERR_NONE == sts; i++) {
+        surfaces[i].Info = info;
+        sts              = allocator.LockFrame(response.mids[i], &surfaces[i].Data);
+    }
+
+    const char *const *names = GetComponentNames(params.fourcc);
+    SequenceStats stats      = {};
+    FrameMetrics metrics     = {};
+    auto start               = std::chrono::steady_clock::now();
+
+    if (MFX_ERR_NONE == sts) {
+        WriteHeader(out, params, names);
+        sts = LoadFramePair(&refReader, &distReader, &surfaces[0], &surfaces[1]);
+    }
+
+    for (mfxU32 pair = 0; MFX_ERR_NONE == sts; pair = (pair + 1) % NUM_FRAME_PAIRS) {
+        mfxFrameSurface1 *pRef  = &surfaces[2 * pair];
+        mfxFrameSurface1 *pDist = &surfaces[2 * pair + 1];
+
+        // the next pair is read while this one is compared
+        std::future<mfxStatus> next;
+        bool bLast = params.numFrames && stats.nFrames + 1 >= params.numFrames;
+        if (!bLast) {
+            mfxU32 nextPair = (pair + 1) % NUM_FRAME_PAIRS;
+
+            next = std::async(std::launch::async,
+                              LoadFramePair,
+                              &refReader,
+                              &distReader,
+                              &surfaces[2 * nextPair],
+                              &surfaces[2 * nextPair + 1]);
+        }
+
+        sts = comparer.Compare(*pRef, *pDist, &metrics);
+        if (MFX_ERR_NONE == sts) {
+            WriteFrame(out, params, names, stats.nFrames, metrics);
+            AccumulateStats(metrics, &stats);
+        }
+
+        mfxStatus stsNext = next.valid() ? next.get() : MFX_ERR_MORE_DATA;
+        if (MFX_ERR_NONE == sts)
+            sts = stsNext;
+    }
+
+    mfxF64 seconds =
+        std::chrono::duration<mfxF64>(std::chrono::steady_clock::now() - start).count();
+
+    for (mfxU32 i = 0; i < 2 * NUM_FRAME_PAIRS; i++) {
+        if (surfaces[i].Data.Y)
+            allocator.UnlockFrame(response.mids[i], &surfaces[i].Data);
+    }
+    allocator.FreeFrames(&response);
+
+    // the end of an input is the normal way to stop
+    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+    MSDK_CHECK_STATUS(sts, "comparison failed");
+
+    WriteSummary(out, params, names, stats);
+
+    // reading the inputs is included, so the speed is what a sweep over the files really gets
+    mfxF64 fps = seconds > 0 ? stats.nFrames / seconds : 0.0;
+    fprintf(stderr,
+            "Processing time: %.3f sec, %.2f fps, %u threads\n",
+            seconds,
+            fps,
+            pool.GetNumThreads());
+    fprintf(stderr,
+            "Speed: %.2fx real time at %.2f fps (%s)\n",
+            fps / params.frameRate,
+            params.frameRate,
+            fps >= params.frameRate ? "faster than real time" : "slower than real time");
+
+    return MFX_ERR_NONE;
+}
+
+int main(int argc, char *argv[]) {
+    Params params;
+    if (!ParseArgs(argc, argv, &params)) {
+        Usage();
+        return 1; // return 1 as error code
+    }
+
+    FILE *out = stdout;
+    if (!params.outFile.empty()) {
+        out = fopen(params.outFile.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "error: failed to create %s\n", params.outFile.c_str());
+            return 1;
+        }
+    }
+
+    mfxStatus sts = Compare(params, out);
+
+    if (out != stdout)
+        fclose(out);
+
+    return (MFX_ERR_NONE == sts) ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __FRAME_HASH_H__
+#define __FRAME_HASH_H__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "sample_defs.h"
+#include "xxhash64.h"
+
+// Visible (cropped) area of one plane of a mapped surface
+struct sFramePlane {
+    const mfxU8* pData; // first visible byte
+    mfxU32 nRowBytes; // visible bytes in a row
+    mfxU32 nRows;
+    mfxU32 nPitch;
+};
+
+// Fills planes of the surface in the order they are written into a raw file
+mfxStatus GetFramePlanes(const mfxFrameInfo& info,
+                         const mfxFrameData& data,
+                         std::vector<sFramePlane>& planes);
+
+/* Output sink which replaces dumping of raw frames for verification: every frame is hashed
+   per plane straight from the mapped surface and a line
+       <frame number> <fourcc> <width>x<height> <frame hash> <plane hashes>
+   is appended to the hash log. If a golden log is given, lines are compared on the fly and
+   the first mismatch aborts processing. Raw surface data is hashed as is, i.e. MSB-aligned
+   (Shift) formats aren't converted like CSmplYUVWriter does. */
+class CSmplHashWriter {
+public:
+    CSmplHashWriter();
+    virtual ~CSmplHashWriter();
+
+    // either of file names can be empty: no log is written or nothing is compared
+    virtual mfxStatus Init(const msdk_char* strLogFile, const msdk_char* strGoldenFile);
+    // surface data must be mapped
+    virtual mfxStatus WriteNextFrame(mfxFrameSurface1* pSurface);
+    virtual mfxStatus WriteNextFrame(const mfxFrameData& data, const mfxFrameInfo& info);
+    // checks that the golden log doesn't have more frames, prints the result of comparison
+    virtual mfxStatus Finish();
+    virtual void Close();
+
+    bool IsInited() const {
+        return m_bInited;
+    }
+    mfxU32 GetFrameCount() const {
+        return m_nFrames;
+    }
+
+protected:
+    bool ReadGoldenLine(std::string& line);
+
+    FILE* m_fLog;
+    FILE* m_fGolden;
+    bool m_bInited;
+    bool m_bFinished;
+    mfxU32 m_nFrames;
+    std::vector<sFramePlane> m_Planes;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CSmplHashWriter);
+};
+
+#endif //__FRAME_HASH_H__
@@ -12,6 +12,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 
 class SysMemFrameAllocator;
 
@@ -25,6 +26,11 @@ public:
     virtual mfxStatus Init(mfxAllocatorParams* pParams);
     virtual mfxStatus Close();
 
+    // Binds system memory surfaces to the NUMA node, must be called before Init
+    void SetSystemMemoryNumaNode(mfxI32 node) {
+        m_SysMemNumaNode = node;
+    }
+
 protected:
     virtual mfxStatus LockFrame(mfxMemId mid, mfxFrameData* ptr);
     virtual mfxStatus UnlockFrame(mfxMemId mid, mfxFrameData* ptr);
@@ -40,9 +46,12 @@ protected:
     void StoreFrameMids(bool isD3DFrames, mfxFrameAllocResponse* response);
     bool isD3DMid(mfxHDL mid);
 
+    // the allocator may be shared by sessions running in different threads
+    std::mutex m_MidsMutex;
     std::map<mfxHDL, bool> m_Mids;
     std::unique_ptr<BaseFrameAllocator> m_D3DAllocator;
     std::unique_ptr<SysMemFrameAllocator> m_SYSAllocator;
+    mfxI32 m_SysMemNumaNode = -1;
 
 private:
     DISALLOW_COPY_AND_ASSIGN(GeneralAllocator);
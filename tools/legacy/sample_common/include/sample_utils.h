@@ -684,6 +684,16 @@ private:
     std::vector<mfxU8> m_data;
 };
 
+/* Raw input files loaded into memory once per process. All readers of a file share one
+   read-only copy, so sessions fed by the same clip need memory for one clip only. The copy
+   is released with the last reader. */
+class CSmplInputCache {
+public:
+    typedef std::vector<mfxU8> FileData;
+
+    static mfxStatus GetFile(const msdk_string& fileName, std::shared_ptr<const FileData>& data);
+};
+
 class CSmplYUVReader {
 public:
     typedef std::list<msdk_string>::iterator ls_iterator;
@@ -697,11 +707,23 @@ public:
     virtual mfxStatus SkipNframesFromBeginning(mfxU16 w, mfxU16 h, mfxU32 viewId, mfxU32 nframes);
     virtual mfxStatus LoadNextFrame(mfxFrameSurface1* pSurface);
     virtual void Reset();
+
+    // frames are copied from CSmplInputCache instead of read from files, set before Init
+    void SetUseInputCache(bool bUseCache) {
+        m_bUseCache = bUseCache;
+    }
+
     mfxU32 m_ColorFormat; // color format of input YUV data, YUV420 or NV12
 
 protected:
+    size_t ReadItems(void* pDst, size_t size, size_t count, mfxU32 vid);
+
     std::vector<FILE*> m_files;
 
+    bool m_bUseCache;
+    std::vector<std::shared_ptr<const CSmplInputCache::FileData>> m_cachedFiles;
+    std::vector<size_t> m_cachePos; // read position in every cached file
+
     bool shouldShift10BitsHigh;
     bool m_bInited;
 };
@@ -1229,27 +1251,47 @@ void WaitForDeviceToBecomeFree(MFXVideoSession& session,
 
 mfxU16 FourCCToChroma(mfxU32 fourCC);
 
+// What FPSLimiter does with frames which come later than one frame period past their deadline
+enum FPSLimiterPolicy {
+    FPS_POLICY_CATCHUP, // keep the schedule, late frames are released at once until it is caught up
+    FPS_POLICY_DROP, // skip the missed slots, next frame is due at the next slot of the schedule
+    FPS_POLICY_REBASE // restart the schedule from the late frame
+};
+
+mfxStatus StrToFPSLimiterPolicy(const msdk_char* str, FPSLimiterPolicy& policy);
+
+/* Paces a pipeline to a given frame rate. Frame n is due at t0 + n / fps, where t0 is the time
+   of the first Work() call, so sleep inaccuracy does not accumulate over the stream. Work()
+   sleeps until the deadline of the next frame on an absolute clock and spins for the last
+   microseconds. Lateness of every frame against its deadline is collected into a histogram. */
 class FPSLimiter {
 public:
     FPSLimiter()  = default;
     ~FPSLimiter() = default;
-    void Reset(mfxU32 fps) {
-        m_delayTicks = fps ? msdk_time_get_frequency() / fps : 0;
-    }
-    void Work() {
-        msdk_tick current_tick = msdk_time_get_tick();
-        while (m_delayTicks && (m_startTick + m_delayTicks > current_tick)) {
-            msdk_tick left_tick = m_startTick + m_delayTicks - current_tick;
-            uint32_t sleepTime  = (uint32_t)(left_tick * 1000 / msdk_time_get_frequency());
-            MSDK_SLEEP(sleepTime);
-            current_tick = msdk_time_get_tick();
-        };
-        m_startTick = msdk_time_get_tick();
-    }
+
+    void Reset(mfxF64 fps, FPSLimiterPolicy policy = FPS_POLICY_CATCHUP);
+    // slots dropped by FPS_POLICY_DROP are reported by PrintStatistics
+    void Work();
+    void PrintStatistics() const;
 
 protected:
-    msdk_tick m_startTick  = 0;
-    msdk_tick m_delayTicks = 0;
+    // bucket i counts frames with lateness below 2^i * 16 us, the last one counts all the rest
+    static const mfxU32 HISTOGRAM_SIZE = 14;
+
+    mfxI64 m_periodNs         = 0; // 0 - the limiter is disabled
+    mfxF64 m_fps              = 0;
+    FPSLimiterPolicy m_policy = FPS_POLICY_CATCHUP;
+    mfxI64 m_startNs          = 0;
+    mfxU64 m_nextFrame        = 0; // index of the next frame in the current schedule
+    bool m_bStarted           = false;
+
+    mfxU64 m_nFrames                   = 0;
+    mfxU64 m_nLate                     = 0; // frames which came later than one period
+    mfxU64 m_nDropped                  = 0;
+    mfxU32 m_nRebased                  = 0;
+    mfxI64 m_maxLatenessNs             = 0;
+    mfxF64 m_sumLatenessNs             = 0;
+    mfxU64 m_histogram[HISTOGRAM_SIZE] = {};
 };
 
 #if defined(_WIN32) || defined(_WIN64)
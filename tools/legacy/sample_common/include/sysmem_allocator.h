@@ -23,8 +23,10 @@ struct sFrame {
 };
 
 struct SysMemAllocatorParams : mfxAllocatorParams {
-    SysMemAllocatorParams() : mfxAllocatorParams(), pBufferAllocator(NULL) {}
+    SysMemAllocatorParams() : mfxAllocatorParams(), pBufferAllocator(NULL), NumaNode(-1) {}
     MFXBufferAllocator* pBufferAllocator;
+    // NUMA node for the internally created buffer allocator, -1 means default policy
+    mfxI32 NumaNode;
 };
 
 class SysMemFrameAllocator : public BaseFrameAllocator {
@@ -57,12 +59,15 @@ protected:
 
 class SysMemBufferAllocator : public MFXBufferAllocator {
 public:
-    SysMemBufferAllocator();
+    SysMemBufferAllocator(mfxI32 numaNode = -1);
     virtual ~SysMemBufferAllocator();
     virtual mfxStatus AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemId* mid);
     virtual mfxStatus LockBuffer(mfxMemId mid, mfxU8** ptr);
     virtual mfxStatus UnlockBuffer(mfxMemId mid);
     virtual mfxStatus FreeBuffer(mfxMemId mid);
+
+protected:
+    mfxI32 m_NumaNode;
 };
 
 #endif // __SYSMEM_ALLOCATOR_H__
\ No newline at end of file
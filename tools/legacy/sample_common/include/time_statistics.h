@@ -7,12 +7,148 @@
 #pragma once
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include "math.h"
 #include "vm/strings_defs.h"
 #include "vm/time_defs.h"
 #include "vpl/mfxstructures.h"
 
+/* Fixed-size latency histogram in the HDR histogram manner. Values below SUB_BUCKETS nanoseconds
+   are counted exactly, every following power of two range is split into SUB_BUCKETS / 2 linear
+   buckets, so a value is known within 1/32 of itself. Counters are atomic: several threads can
+   record into one histogram, and histograms of different threads or sessions can be merged. */
+class CLatencyHistogram {
+public:
+    CLatencyHistogram() {
+        Reset();
+    }
+
+    CLatencyHistogram(const CLatencyHistogram& other) {
+        Reset();
+        Merge(other);
+    }
+
+    CLatencyHistogram& operator=(const CLatencyHistogram& other) {
+        if (this != &other) {
+            Reset();
+            Merge(other);
+        }
+        return *this;
+    }
+
+    inline void Record(mfxU64 ns) {
+        m_counts[GetBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        m_total.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(ns, std::memory_order_relaxed);
+        UpdateMax(ns);
+    }
+
+    inline void Merge(const CLatencyHistogram& other) {
+        for (mfxU32 i = 0; i < NUM_BUCKETS; i++) {
+            mfxU64 count = other.m_counts[i].load(std::memory_order_relaxed);
+            if (count)
+                m_counts[i].fetch_add(count, std::memory_order_relaxed);
+        }
+        m_total.fetch_add(other.m_total.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+        m_sum.fetch_add(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        UpdateMax(other.m_max.load(std::memory_order_relaxed));
+    }
+
+    inline mfxU64 GetCount() const {
+        return m_total.load(std::memory_order_relaxed);
+    }
+
+    // exact sum and maximum of the recorded values in nanoseconds
+    inline mfxU64 GetSum() const {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+    inline mfxU64 GetMax() const {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    inline mfxF64 GetAverage() const {
+        mfxU64 total = GetCount();
+        return total ? (mfxF64)GetSum() / total : 0;
+    }
+
+    // returns the value in nanoseconds at the given percentile, within the bucket precision
+    inline mfxF64 GetPercentile(mfxF64 percent) const {
+        mfxU64 total = GetCount();
+        if (!total)
+            return 0;
+
+        mfxU64 rank = (mfxU64)ceil(percent / 100 * total);
+        rank        = rank ? rank : 1;
+
+        mfxU64 count = 0;
+        for (mfxU32 i = 0; i < NUM_BUCKETS; i++) {
+            count += m_counts[i].load(std::memory_order_relaxed);
+            if (count >= rank) {
+                mfxU64 width = 1;
+                mfxU64 value = GetBucketStart(i, width);
+                return std::min(value + (width - 1) / 2.0, (mfxF64)GetMax());
+            }
+        }
+        return (mfxF64)GetMax();
+    }
+
+    inline void Reset() {
+        for (mfxU32 i = 0; i < NUM_BUCKETS; i++)
+            m_counts[i].store(0, std::memory_order_relaxed);
+        m_total.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+protected:
+    static const mfxU32 SUB_BUCKET_BITS = 6;
+    static const mfxU32 SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+    static const mfxU32 HALF_BUCKETS    = SUB_BUCKETS / 2;
+    // values from 2^48 ns (~78 hours) on are counted in the last bucket
+    static const mfxU32 MAX_VALUE_BITS = 48;
+    static const mfxU64 MAX_VALUE      = ((mfxU64)1 << MAX_VALUE_BITS) - 1;
+    static const mfxU32 NUM_BUCKETS =
+        SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_BUCKETS;
+
+    static inline mfxU32 GetBucket(mfxU64 value) {
+        if (value > MAX_VALUE)
+            value = MAX_VALUE;
+        if (value < SUB_BUCKETS)
+            return (mfxU32)value;
+
+        // shift which brings the value into [HALF_BUCKETS, SUB_BUCKETS)
+        mfxU32 shift = 0;
+        for (mfxU64 v = value >> SUB_BUCKET_BITS; v; v >>= 1)
+            shift++;
+        return SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + (mfxU32)(value >> shift) - HALF_BUCKETS;
+    }
+
+    static inline mfxU64 GetBucketStart(mfxU32 bucket, mfxU64& width) {
+        if (bucket < SUB_BUCKETS) {
+            width = 1;
+            return bucket;
+        }
+        mfxU32 shift = (bucket - SUB_BUCKETS) / HALF_BUCKETS + 1;
+        width        = (mfxU64)1 << shift;
+        return (mfxU64)((bucket - SUB_BUCKETS) % HALF_BUCKETS + HALF_BUCKETS) << shift;
+    }
+
+    inline void UpdateMax(mfxU64 value) {
+        mfxU64 max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            ;
+    }
+
+    std::atomic<mfxU64> m_counts[NUM_BUCKETS];
+    std::atomic<mfxU64> m_total;
+    std::atomic<mfxU64> m_sum;
+    std::atomic<mfxU64> m_max;
+};
+
 class CTimeStatisticsReal {
 public:
     CTimeStatisticsReal() {
@@ -21,25 +157,32 @@ public:
         m_bNeedDumping = false;
     }
 
+    // the invariant TSC is read in a few cycles, the system clock is used where there is none
     static msdk_tick GetFrequency() {
         if (!frequency) {
-            frequency = msdk_time_get_frequency();
+            msdk_tick tscFrequency = msdk_time_get_tsc_frequency();
+            frequency              = tscFrequency ? tscFrequency : msdk_time_get_frequency();
         }
         return frequency;
     }
 
+    static msdk_tick GetTick() {
+        return msdk_time_get_tsc_frequency() ? (msdk_tick)rdtsc() : msdk_time_get_tick();
+    }
+
     static mfxF64 ConvertToSeconds(msdk_tick elapsed) {
         return MSDK_GET_TIME(elapsed, 0, GetFrequency());
     }
 
     inline void StartTimeMeasurement() {
-        start = msdk_time_get_tick();
+        start = GetTick();
     }
 
     inline void StopTimeMeasurement() {
         mfxF64 delta = GetDeltaTime();
         totalTime += delta;
         totalTimeSquares += delta * delta;
+        m_histogram.Record(delta > 0 ? (mfxU64)(delta * 1e9) : 0);
         // dump in ms:
         if (m_bNeedDumping)
             m_time_deltas.push_back(delta * 1000);
@@ -61,7 +204,7 @@ public:
     }
 
     inline mfxF64 GetDeltaTime() {
-        return MSDK_GET_TIME(msdk_time_get_tick(), start, GetFrequency());
+        return MSDK_GET_TIME(GetTick(), start, GetFrequency());
     }
 
     inline mfxF64 GetDeltaTimeInMiliSeconds() {
@@ -87,6 +230,16 @@ public:
             (double)GetTimeStdDev(false),
             (double)GetMinTime(false),
             (double)GetMaxTime(false));
+        PrintPercentiles(prefix);
+    }
+
+    inline void PrintPercentiles(const msdk_char* prefix) {
+        msdk_printf(MSDK_STRING("%s P50:%.3lfms,P90:%.3lfms,P99:%.3lfms,P99.9:%.3lfms\n"),
+                    prefix,
+                    (double)GetPercentile(50, false),
+                    (double)GetPercentile(90, false),
+                    (double)GetPercentile(99, false),
+                    (double)GetPercentile(99.9, false));
     }
 
     inline mfxU64 GetNumMeasurements() {
@@ -121,12 +274,32 @@ public:
         return inSeconds ? totalTime : totalTime * 1000;
     }
 
+    inline mfxF64 GetPercentile(mfxF64 percent, bool inSeconds = true) {
+        mfxF64 ns = m_histogram.GetPercentile(percent);
+        return inSeconds ? ns / 1e9 : ns / 1e6;
+    }
+
+    inline const CLatencyHistogram& GetHistogram() const {
+        return m_histogram;
+    }
+
+    // adds measurements of another thread or session, dumped deltas are not merged
+    inline void Merge(const CTimeStatisticsReal& other) {
+        totalTime += other.totalTime;
+        totalTimeSquares += other.totalTimeSquares;
+        minTime = (std::min)(minTime, other.minTime);
+        maxTime = (std::max)(maxTime, other.maxTime);
+        numMeasurements += other.numMeasurements;
+        m_histogram.Merge(other.m_histogram);
+    }
+
     inline void ResetStatistics() {
         totalTime        = 0;
         totalTimeSquares = 0;
         minTime          = 1E100;
         maxTime          = -1;
         numMeasurements  = 0;
+        m_histogram.Reset();
         m_time_deltas.clear();
         TurnOffDumping();
     }
@@ -140,6 +313,7 @@ protected:
     mfxF64 minTime;
     mfxF64 maxTime;
     mfxU64 numMeasurements;
+    CLatencyHistogram m_histogram;
     std::vector<mfxF64> m_time_deltas;
     bool m_bNeedDumping;
 };
@@ -177,6 +351,8 @@ public:
 
     inline void PrintStatistics(const msdk_char* /*prefix*/) {}
 
+    inline void PrintPercentiles(const msdk_char* /*prefix*/) {}
+
     inline mfxU64 GetNumMeasurements() {
         return 0;
     }
@@ -201,6 +377,12 @@ public:
         return 0;
     }
 
+    inline mfxF64 GetPercentile(mfxF64, bool) {
+        return 0;
+    }
+
+    inline void Merge(const CTimeStatisticsDummy&) {}
+
     inline void ResetStatistics() {}
 
 protected:
@@ -14,12 +14,16 @@
 #if defined(_WIN32) || defined(_WIN64)
 
     #define MSDK_FOPEN(file, name, mode) _tfopen_s(&file, name, mode)
+    #define MSDK_FSEEK64                 _fseeki64
+    #define MSDK_FTELL64                 _ftelli64
 
     #define msdk_fgets _fgetts
 #else // #if defined(_WIN32) || defined(_WIN64)
     #include <unistd.h>
 
     #define MSDK_FOPEN(file, name, mode) (file = fopen(name, mode))
+    #define MSDK_FSEEK64                 fseeko
+    #define MSDK_FTELL64                 ftello
 
     #define msdk_fgets fgets
 #endif // #if defined(_WIN32) || defined(_WIN64)
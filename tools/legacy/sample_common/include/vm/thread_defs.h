@@ -7,6 +7,7 @@
 #ifndef __THREAD_DEFS_H__
 #define __THREAD_DEFS_H__
 
+#include <vector>
 #include "vm/strings_defs.h"
 #include "vpl/mfxdefs.h"
 
@@ -121,4 +122,15 @@ mfxStatus msdk_setrlimit_vmem(mfxU64 size);
 mfxStatus msdk_thread_get_schedtype(const msdk_char*, mfxI32& type);
 void msdk_thread_printf_scheduling_help();
 
+// Pins calling thread to the given set of logical CPUs
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32>& cpus);
+// Returns number of NUMA nodes in the system (1 if NUMA is not available)
+mfxU32 msdk_numa_get_node_count();
+// Returns logical CPUs belonging to the NUMA node
+mfxStatus msdk_numa_get_node_cpus(mfxU32 node, std::vector<mfxU32>& cpus);
+// Sets preferred NUMA node for memory allocated by calling thread, -1 restores default policy
+mfxStatus msdk_numa_set_preferred_node(mfxI32 node);
+// Moves pages of the buffer to the NUMA node, partially covered pages are left intact
+mfxStatus msdk_numa_bind_memory(void* ptr, size_t size, mfxU32 node);
+
 #endif //__THREAD_DEFS_H__
@@ -51,5 +51,7 @@ typedef mfxI64 msdk_tick;
 msdk_tick msdk_time_get_tick(void);
 msdk_tick msdk_time_get_frequency(void);
 mfxU64 rdtsc(void);
+// frequency of rdtsc() ticks, 0 if the TSC is not invariant and cannot be used as a clock
+msdk_tick msdk_time_get_tsc_frequency(void);
 
 #endif // #ifndef __TIME_DEFS_H__
@@ -0,0 +1,148 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __XXHASH64_H__
+#define __XXHASH64_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Streaming xxHash64, the digest equals the one of the whole data hashed at once.
+   Header-only and free of mfx types, so decvpp_tool, which doesn't link sample_common and can
+   be built with Media SDK headers, hashes frames the same way. */
+class CXXHash64 {
+public:
+    explicit CXXHash64(uint64_t seed = 0) {
+        Reset(seed);
+    }
+
+    void Reset(uint64_t seed = 0) {
+        m_acc[0]     = seed + PRIME64_1 + PRIME64_2;
+        m_acc[1]     = seed + PRIME64_2;
+        m_acc[2]     = seed;
+        m_acc[3]     = seed - PRIME64_1;
+        m_seed       = seed;
+        m_totalSize  = 0;
+        m_bufferSize = 0;
+    }
+
+    void Update(const void* data, size_t size) {
+        const uint8_t* p = (const uint8_t*)data;
+        m_totalSize += size;
+
+        if (m_bufferSize + size < sizeof(m_buffer)) {
+            if (size)
+                memcpy(m_buffer + m_bufferSize, p, size);
+            m_bufferSize += (uint32_t)size;
+            return;
+        }
+
+        if (m_bufferSize) {
+            size_t fill = sizeof(m_buffer) - m_bufferSize;
+            memcpy(m_buffer + m_bufferSize, p, fill);
+            ProcessStripe(m_buffer);
+            p += fill;
+            size -= fill;
+            m_bufferSize = 0;
+        }
+
+        for (; size >= sizeof(m_buffer); p += sizeof(m_buffer), size -= sizeof(m_buffer))
+            ProcessStripe(p);
+
+        if (size) {
+            memcpy(m_buffer, p, size);
+            m_bufferSize = (uint32_t)size;
+        }
+    }
+
+    uint64_t Digest() const {
+        uint64_t h;
+        if (m_totalSize >= sizeof(m_buffer)) {
+            h = Rotl64(m_acc[0], 1) + Rotl64(m_acc[1], 7) + Rotl64(m_acc[2], 12) +
+                Rotl64(m_acc[3], 18);
+            for (int i = 0; i < 4; i++)
+                h = MergeRound(h, m_acc[i]);
+        }
+        else {
+            h = m_seed + PRIME64_5;
+        }
+        h += m_totalSize;
+
+        const uint8_t* p   = m_buffer;
+        const uint8_t* end = m_buffer + m_bufferSize;
+        for (; p + 8 <= end; p += 8) {
+            h ^= Round(0, Read64(p));
+            h = Rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        }
+        if (p + 4 <= end) {
+            h ^= (uint64_t)Read32(p) * PRIME64_1;
+            h = Rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= (*p) * PRIME64_5;
+            h = Rotl64(h, 11) * PRIME64_1;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+protected:
+    static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t Rotl64(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // data is read in the host byte order which is little-endian on supported platforms
+    static uint64_t Read64(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t Read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t Round(uint64_t acc, uint64_t input) {
+        acc += input * PRIME64_2;
+        acc = Rotl64(acc, 31);
+        return acc * PRIME64_1;
+    }
+
+    static uint64_t MergeRound(uint64_t acc, uint64_t val) {
+        acc ^= Round(0, val);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+
+    void ProcessStripe(const uint8_t* p) {
+        m_acc[0] = Round(m_acc[0], Read64(p));
+        m_acc[1] = Round(m_acc[1], Read64(p + 8));
+        m_acc[2] = Round(m_acc[2], Read64(p + 16));
+        m_acc[3] = Round(m_acc[3], Read64(p + 24));
+    }
+
+    uint64_t m_acc[4];
+    uint64_t m_seed;
+    uint64_t m_totalSize;
+    uint8_t m_buffer[32];
+    uint32_t m_bufferSize;
+};
+
+#endif // __XXHASH64_H__
@@ -0,0 +1,275 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "mfx_samples_config.h"
+
+#include "frame_hash.h"
+
+#include <string.h>
+
+namespace {
+
+msdk_string ToMsdkString(const std::string& str) {
+    return msdk_string(str.begin(), str.end());
+}
+
+} // namespace
+
+mfxStatus GetFramePlanes(const mfxFrameInfo& info,
+                         const mfxFrameData& data,
+                         std::vector<sFramePlane>& planes) {
+    mfxU32 pitch = ((mfxU32)data.PitchHigh << 16) + data.PitchLow;
+    mfxU32 w = info.CropW, h = info.CropH, x = info.CropX, y = info.CropY;
+
+    // chroma of 4:2:x formats, odd sizes are rounded up
+    mfxU32 halfW = (w + 1) / 2, halfH = (h + 1) / 2;
+
+    planes.clear();
+    auto addPlane = [&planes, pitch](const mfxU8* ptr, mfxU32 rowBytes, mfxU32 rows, mfxU32 p) {
+        planes.push_back({ ptr, rowBytes, rows, p ? p : pitch });
+    };
+
+    switch (info.FourCC) {
+        case MFX_FOURCC_NV12:
+        case MFX_FOURCC_NV16:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.UV, MFX_ERR_NULL_PTR);
+            addPlane(data.Y + y * pitch + x, w, h, 0);
+            if (info.FourCC == MFX_FOURCC_NV12)
+                addPlane(data.UV + y / 2 * pitch + x, halfW * 2, halfH, 0);
+            else
+                addPlane(data.UV + y * pitch + x, halfW * 2, h, 0);
+            break;
+        case MFX_FOURCC_P010:
+#if (MFX_VERSION >= MFX_VERSION_NEXT)
+        case MFX_FOURCC_P016:
+#endif
+        case MFX_FOURCC_P210:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.UV, MFX_ERR_NULL_PTR);
+            addPlane(data.Y + y * pitch + x * 2, w * 2, h, 0);
+            if (info.FourCC == MFX_FOURCC_P210)
+                addPlane(data.UV + y * pitch + x * 2, halfW * 4, h, 0);
+            else
+                addPlane(data.UV + y / 2 * pitch + x * 2, halfW * 4, halfH, 0);
+            break;
+        case MFX_FOURCC_I420:
+        case MFX_FOURCC_YV12:
+        case MFX_FOURCC_I422: {
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.U, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.V, MFX_ERR_NULL_PTR);
+            mfxU32 chromaH  = (info.FourCC == MFX_FOURCC_I422) ? h : halfH;
+            mfxU32 chromaY  = (info.FourCC == MFX_FOURCC_I422) ? y : y / 2;
+            mfxU32 chromaOf = chromaY * (pitch / 2) + x / 2;
+            addPlane(data.Y + y * pitch + x, w, h, 0);
+            addPlane(data.U + chromaOf, halfW, chromaH, pitch / 2);
+            addPlane(data.V + chromaOf, halfW, chromaH, pitch / 2);
+            break;
+        }
+        case MFX_FOURCC_I010:
+        case MFX_FOURCC_I210: {
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.U, MFX_ERR_NULL_PTR);
+            MSDK_CHECK_POINTER(data.V, MFX_ERR_NULL_PTR);
+            mfxU32 chromaH  = (info.FourCC == MFX_FOURCC_I210) ? h : halfH;
+            mfxU32 chromaY  = (info.FourCC == MFX_FOURCC_I210) ? y : y / 2;
+            mfxU32 chromaOf = chromaY * (pitch / 2) + x / 2 * 2;
+            addPlane(data.Y + y * pitch + x * 2, w * 2, h, 0);
+            addPlane(data.U + chromaOf, halfW * 2, chromaH, pitch / 2);
+            addPlane(data.V + chromaOf, halfW * 2, chromaH, pitch / 2);
+            break;
+        }
+        case MFX_FOURCC_YUY2:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            addPlane(data.Y + y * pitch + x * 2, w * 2, h, 0);
+            break;
+        case MFX_FOURCC_Y210:
+        case MFX_FOURCC_Y216:
+            MSDK_CHECK_POINTER(data.Y, MFX_ERR_NULL_PTR);
+            addPlane(data.Y + y * pitch + x * 4, w * 4, h, 0);
+            break;
+        case MFX_FOURCC_Y410:
+            MSDK_CHECK_POINTER(data.Y410, MFX_ERR_NULL_PTR);
+            addPlane((const mfxU8*)data.Y410 + y * pitch + x * 4, w * 4, h, 0);
+            break;
+#if (MFX_VERSION >= MFX_VERSION_NEXT)
+        case MFX_FOURCC_Y416:
+            MSDK_CHECK_POINTER(data.U16, MFX_ERR_NULL_PTR);
+            addPlane((const mfxU8*)data.U16 + y * pitch + x * 8, w * 8, h, 0);
+            break;
+#endif
+        case MFX_FOURCC_RGB4:
+        case MFX_FOURCC_BGR4:
+        case MFX_FOURCC_AYUV:
+        case MFX_FOURCC_A2RGB10: {
+            // packed formats, the plane starts at the lowest of component pointers
+            const mfxU8* ptr = std::min({ data.R, data.G, data.B });
+            MSDK_CHECK_POINTER(ptr, MFX_ERR_NULL_PTR);
+            addPlane(ptr + y * pitch + x * 4, w * 4, h, 0);
+            break;
+        }
+        default:
+            return MFX_ERR_UNSUPPORTED;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+CSmplHashWriter::CSmplHashWriter()
+        : m_fLog(NULL),
+          m_fGolden(NULL),
+          m_bInited(false),
+          m_bFinished(false),
+          m_nFrames(0),
+          m_Planes() {}
+
+CSmplHashWriter::~CSmplHashWriter() {
+    Close();
+}
+
+mfxStatus CSmplHashWriter::Init(const msdk_char* strLogFile, const msdk_char* strGoldenFile) {
+    Close();
+
+    if (strLogFile && msdk_strlen(strLogFile)) {
+        MSDK_FOPEN(m_fLog, strLogFile, MSDK_STRING("w"));
+        if (!m_fLog) {
+            msdk_printf(MSDK_STRING("ERROR: failed to create hash log %s\n"), strLogFile);
+            return MFX_ERR_NULL_PTR;
+        }
+        fprintf(m_fLog, "# xxh64: frame fourcc size frame_hash plane_hashes\n");
+    }
+
+    if (strGoldenFile && msdk_strlen(strGoldenFile)) {
+        MSDK_FOPEN(m_fGolden, strGoldenFile, MSDK_STRING("r"));
+        if (!m_fGolden) {
+            msdk_printf(MSDK_STRING("ERROR: failed to open golden hash log %s\n"), strGoldenFile);
+            Close();
+            return MFX_ERR_NULL_PTR;
+        }
+    }
+
+    m_bInited = true;
+    return MFX_ERR_NONE;
+}
+
+bool CSmplHashWriter::ReadGoldenLine(std::string& line) {
+    char buf[512];
+    while (fgets(buf, sizeof(buf), m_fGolden)) {
+        line = buf;
+        while (!line.empty() && isspace((unsigned char)line.back()))
+            line.pop_back();
+        // comments and empty lines are skipped
+        if (!line.empty() && line[0] != '#')
+            return true;
+    }
+    return false;
+}
+
+mfxStatus CSmplHashWriter::WriteNextFrame(mfxFrameSurface1* pSurface) {
+    MSDK_CHECK_POINTER(pSurface, MFX_ERR_NULL_PTR);
+    return WriteNextFrame(pSurface->Data, pSurface->Info);
+}
+
+mfxStatus CSmplHashWriter::WriteNextFrame(const mfxFrameData& data, const mfxFrameInfo& info) {
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+
+    mfxStatus sts = GetFramePlanes(info, data, m_Planes);
+    MSDK_CHECK_STATUS(sts, "GetFramePlanes failed");
+
+    char line[256];
+    int len = snprintf(line,
+                       sizeof(line),
+                       "%u %c%c%c%c %ux%u",
+                       m_nFrames,
+                       (char)(info.FourCC & 0xff),
+                       (char)((info.FourCC >> 8) & 0xff),
+                       (char)((info.FourCC >> 16) & 0xff),
+                       (char)((info.FourCC >> 24) & 0xff),
+                       info.CropW,
+                       info.CropH);
+
+    CXXHash64 planeHash, frameHash;
+    mfxU64 planeDigests[4] = {};
+    for (size_t i = 0; i < m_Planes.size(); i++) {
+        const sFramePlane& plane = m_Planes[i];
+        planeHash.Reset();
+        for (mfxU32 row = 0; row < plane.nRows; row++)
+            planeHash.Update(plane.pData + (size_t)row * plane.nPitch, plane.nRowBytes);
+        planeDigests[i] = planeHash.Digest();
+        frameHash.Update(&planeDigests[i], sizeof(planeDigests[i]));
+    }
+
+    len += snprintf(line + len,
+                    sizeof(line) - len,
+                    " %016llx",
+                    (unsigned long long)frameHash.Digest());
+    for (size_t i = 0; i < m_Planes.size(); i++) {
+        len += snprintf(line + len,
+                        sizeof(line) - len,
+                        " %016llx",
+                        (unsigned long long)planeDigests[i]);
+    }
+
+    if (m_fLog)
+        fprintf(m_fLog, "%s\n", line);
+
+    if (m_fGolden) {
+        std::string golden;
+        if (!ReadGoldenLine(golden)) {
+            msdk_printf(MSDK_STRING("ERROR: hash mismatch, golden log ends before frame %u\n"),
+                        m_nFrames);
+            return MFX_ERR_ABORTED;
+        }
+        if (golden != line) {
+            msdk_printf(MSDK_STRING("ERROR: hash mismatch at frame %u\n")
+                            MSDK_STRING("  expected: %s\n  actual:   %s\n"),
+                        m_nFrames,
+                        ToMsdkString(golden).c_str(),
+                        ToMsdkString(line).c_str());
+            return MFX_ERR_ABORTED;
+        }
+    }
+
+    m_nFrames++;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CSmplHashWriter::Finish() {
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+    if (m_bFinished)
+        return MFX_ERR_NONE;
+    m_bFinished = true;
+
+    if (m_fLog)
+        fflush(m_fLog);
+
+    if (m_fGolden) {
+        std::string golden;
+        if (ReadGoldenLine(golden)) {
+            msdk_printf(MSDK_STRING("ERROR: hash mismatch, golden log has more than %u frames\n"),
+                        m_nFrames);
+            return MFX_ERR_ABORTED;
+        }
+        msdk_printf(MSDK_STRING("Hash check passed: %u frames match the golden log\n"), m_nFrames);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CSmplHashWriter::Close() {
+    if (m_fLog) {
+        fclose(m_fLog);
+        m_fLog = NULL;
+    }
+    if (m_fGolden) {
+        fclose(m_fGolden);
+        m_fGolden = NULL;
+    }
+    m_bInited   = false;
+    m_bFinished = false;
+    m_nFrames   = 0;
+}
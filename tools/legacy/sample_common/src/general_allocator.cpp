@@ -50,8 +50,11 @@ mfxStatus GeneralAllocator::Init(mfxAllocatorParams* pParams) {
         MSDK_CHECK_STATUS(sts, "m_D3DAllocator.get failed");
     }
 
+    SysMemAllocatorParams sysMemParams;
+    sysMemParams.NumaNode = m_SysMemNumaNode;
+
     m_SYSAllocator.reset(new SysMemFrameAllocator());
-    sts = m_SYSAllocator->Init(0);
+    sts = m_SYSAllocator->Init(&sysMemParams);
     MSDK_CHECK_STATUS(sts, "m_SYSAllocator.get failed");
 
     return sts;
@@ -136,10 +139,12 @@ mfxStatus GeneralAllocator::AllocImpl(mfxFrameAllocRequest* request,
     return sts;
 }
 void GeneralAllocator::StoreFrameMids(bool isD3DFrames, mfxFrameAllocResponse* response) {
+    std::lock_guard<std::mutex> lock(m_MidsMutex);
     for (mfxU32 i = 0; i < response->NumFrameActual; i++)
         m_Mids.insert(std::pair<mfxHDL, bool>(response->mids[i], isD3DFrames));
 }
 bool GeneralAllocator::isD3DMid(mfxHDL mid) {
+    std::lock_guard<std::mutex> lock(m_MidsMutex);
     std::map<mfxHDL, bool>::iterator it;
     it = m_Mids.find(mid);
     if (it == m_Mids.end())
@@ -7,6 +7,7 @@
 #include "mfx_samples_config.h"
 
 #include <math.h>
+#include <stdint.h>
 #include <algorithm>
 #include <iostream>
 #include <map>
@@ -39,7 +40,9 @@
 
 #else
 
+    #include <errno.h>
     #include <link.h>
+    #include <time.h>
     #include <string>
 
     #if defined(__x86_64__)
@@ -50,8 +53,9 @@
 
 #endif // #if defined(_WIN32) || defined(_WIN64)
 
-msdk_tick CTimer::frequency              = 0;
-msdk_tick CTimeStatisticsReal::frequency = 0;
+msdk_tick CTimer::frequency = msdk_time_get_frequency();
+// TSC calibration sleeps for 10ms, done before main() it does not land in a measured region
+msdk_tick CTimeStatisticsReal::frequency = CTimeStatisticsReal::GetFrequency();
 
 mfxStatus CopyBitstream2(mfxBitstream* dest, mfxBitstream* src) {
     if (!dest || !src)
@@ -101,9 +105,56 @@ mfxStatus GetFrameLength(mfxU16 width, mfxU16 height, mfxU32 ColorFormat, mfxU32
     return MFX_ERR_NONE;
 }
 
+mfxStatus CSmplInputCache::GetFile(const msdk_string& fileName,
+                                   std::shared_ptr<const FileData>& data) {
+    static std::mutex mutex;
+    static std::map<msdk_string, std::weak_ptr<const FileData>> files;
+
+    // the lock is held while loading, so concurrent readers of a file wait for one copy
+    std::lock_guard<std::mutex> lock(mutex);
+
+    data = files[fileName].lock();
+    if (data)
+        return MFX_ERR_NONE;
+
+    FILE* f = NULL;
+    MSDK_FOPEN(f, fileName.c_str(), MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(f, MFX_ERR_NULL_PTR);
+
+    mfxI64 size = -1;
+    if (0 == MSDK_FSEEK64(f, 0, SEEK_END))
+        size = (mfxI64)MSDK_FTELL64(f);
+    if (size < 0 || 0 != MSDK_FSEEK64(f, 0, SEEK_SET) || (mfxU64)size > SIZE_MAX) {
+        fclose(f);
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    std::shared_ptr<FileData> contents;
+    try {
+        contents = std::make_shared<FileData>((size_t)size);
+    }
+    catch (...) {
+        fclose(f);
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    size_t nBytesRead = fread(contents->data(), 1, contents->size(), f);
+    fclose(f);
+    if (nBytesRead != contents->size())
+        return MFX_ERR_ABORTED;
+
+    files[fileName] = contents;
+    data            = contents;
+
+    return MFX_ERR_NONE;
+}
+
 CSmplYUVReader::CSmplYUVReader()
         : m_ColorFormat(MFX_FOURCC_YV12),
           m_files(),
+          m_bUseCache(false),
+          m_cachedFiles(),
+          m_cachePos(),
           shouldShift10BitsHigh(false),
           m_bInited(false) {}
 
@@ -134,6 +185,15 @@ mfxStatus CSmplYUVReader::Init(std::list<msdk_string> inputs,
     }
 
     for (ls_iterator it = inputs.begin(); it != inputs.end(); it++) {
+        if (m_bUseCache) {
+            std::shared_ptr<const CSmplInputCache::FileData> data;
+            mfxStatus sts = CSmplInputCache::GetFile(*it, data);
+            MSDK_CHECK_STATUS(sts, "CSmplInputCache::GetFile failed");
+            m_cachedFiles.push_back(data);
+            m_cachePos.push_back(0);
+            continue;
+        }
+
         m_files.push_back(NULL);
         auto& f = m_files.back();
         MSDK_FOPEN(f, (*it).c_str(), MSDK_STRING("rb"));
@@ -156,6 +216,8 @@ void CSmplYUVReader::Close() {
         fclose(m_files[i]);
     }
     m_files.clear();
+    m_cachedFiles.clear();
+    m_cachePos.clear();
     m_bInited = false;
 }
 
@@ -163,6 +225,8 @@ void CSmplYUVReader::Reset() {
     for (mfxU32 i = 0; i < m_files.size(); i++) {
         fseek(m_files[i], 0, SEEK_SET);
     }
+    // looping over cached input doesn't touch the disk
+    std::fill(m_cachePos.begin(), m_cachePos.end(), 0);
 }
 
 mfxStatus CSmplYUVReader::SkipNframesFromBeginning(mfxU16 w,
@@ -178,12 +242,34 @@ mfxStatus CSmplYUVReader::SkipNframesFromBeginning(mfxU16 w,
         return MFX_ERR_UNSUPPORTED;
     }
 
-    if (0 != fseek(m_files[viewId], frameLength * nframes, SEEK_SET))
+    if (m_bUseCache) {
+        mfxU64 offset = (mfxU64)frameLength * nframes;
+        if (offset > m_cachedFiles[viewId]->size())
+            return MFX_ERR_MORE_DATA;
+        m_cachePos[viewId] = (size_t)offset;
+        return MFX_ERR_NONE;
+    }
+
+    // offset may exceed 4GB for long inputs
+    if (0 != MSDK_FSEEK64(m_files[viewId], (mfxI64)frameLength * nframes, SEEK_SET))
         return MFX_ERR_MORE_DATA;
 
     return MFX_ERR_NONE;
 }
 
+size_t CSmplYUVReader::ReadItems(void* pDst, size_t size, size_t count, mfxU32 vid) {
+    if (!m_bUseCache)
+        return fread(pDst, size, count, m_files[vid]);
+
+    const CSmplInputCache::FileData& data = *m_cachedFiles[vid];
+
+    count = std::min(count, (data.size() - m_cachePos[vid]) / size);
+    memcpy(pDst, data.data() + m_cachePos[vid], size * count);
+    m_cachePos[vid] += size * count;
+
+    return count;
+}
+
 mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
     // check if reader is initialized
     MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
@@ -200,7 +286,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
 
     mfxU32 vid = pInfo.FrameId.ViewId;
 
-    if (vid > m_files.size()) {
+    if (vid > (m_bUseCache ? m_cachedFiles.size() : m_files.size())) {
         return MFX_ERR_UNSUPPORTED;
     }
 
@@ -234,7 +320,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                 ptr   = ptr + pInfo.CropX * 4 + pInfo.CropY * pData.Pitch;
 
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 4 * w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, 1, 4 * w, vid);
 
                     if ((mfxU32)4 * w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
@@ -249,7 +335,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                           : pData.U + pInfo.CropX + pInfo.CropY * pData.Pitch;
 
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 2, w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, 2, w, vid);
 
                     if ((mfxU32)w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
@@ -266,7 +352,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                       pInfo.CropX * 4 + pInfo.CropY * pData.Pitch;
 
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 4 * w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, 1, 4 * w, vid);
 
                     if ((mfxU32)4 * w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
@@ -295,7 +381,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
 
         // read luminance plane
         for (i = 0; i < h; i++) {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, nBytesPerPixel, w, m_files[vid]);
+            nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, nBytesPerPixel, w, vid);
 
             if (w != nBytesRead) {
                 return MFX_ERR_MORE_DATA;
@@ -337,7 +423,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                         try {
                             std::vector<mfxU8> buf(w);
                             for (i = 0; i < h; i++) {
-                                nBytesRead = (mfxU32)fread(&buf[0], 1, w, m_files[vid]);
+                                nBytesRead = (mfxU32)ReadItems(&buf[0], 1, w, vid);
                                 if (w != nBytesRead) {
                                     return MFX_ERR_MORE_DATA;
                                 }
@@ -348,7 +434,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
 
                             // load second chroma plane: V (input == I420) or U (input == YV12)
                             for (i = 0; i < h; i++) {
-                                nBytesRead = (mfxU32)fread(&buf[0], 1, w, m_files[vid]);
+                                nBytesRead = (mfxU32)ReadItems(&buf[0], 1, w, vid);
 
                                 if (w != nBytesRead) {
                                     return MFX_ERR_MORE_DATA;
@@ -378,14 +464,14 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                         }
 
                         for (i = 0; i < h; i++) {
-                            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_files[vid]);
+                            nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, 1, w, vid);
 
                             if (w != nBytesRead) {
                                 return MFX_ERR_MORE_DATA;
                             }
                         }
                         for (i = 0; i < h; i++) {
-                            nBytesRead = (mfxU32)fread(ptr2 + i * pitch, 1, w, m_files[vid]);
+                            nBytesRead = (mfxU32)ReadItems(ptr2 + i * pitch, 1, w, vid);
 
                             if (w != nBytesRead) {
                                 return MFX_ERR_MORE_DATA;
@@ -405,14 +491,14 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                 ptr2 = pData.V + (pInfo.CropX / 2) + (pInfo.CropY / 2) * pitch;
 
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, 1, w, vid);
 
                     if (w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
                     }
                 }
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr2 + i * pitch, 1, w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr2 + i * pitch, 1, w, vid);
 
                     if (w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
@@ -428,7 +514,7 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface) {
                 }
                 ptr = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
                 for (i = 0; i < h; i++) {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, nBytesPerPixel, w, m_files[vid]);
+                    nBytesRead = (mfxU32)ReadItems(ptr + i * pitch, nBytesPerPixel, w, vid);
 
                     if (w != nBytesRead) {
                         return MFX_ERR_MORE_DATA;
@@ -2248,6 +2334,38 @@ mfxStatus msdk_opt_read(const msdk_char* string, mfxPriority& value) {
 
 mfxStatus msdk_opt_read(msdk_char* string, mfxPriority& value);
 
+// Reads CPU list in the Linux cpulist format, e.g. "0-3,8,10-11"
+template <>
+mfxStatus msdk_opt_read(const msdk_char* string, std::vector<mfxU32>& value) {
+    value.clear();
+    const msdk_char* ptr = string;
+    while (*ptr) {
+        msdk_char* stopCharacter;
+        mfxU32 first = (mfxU32)msdk_strtol(ptr, &stopCharacter, 10);
+        if (stopCharacter == ptr)
+            return MFX_ERR_UNKNOWN;
+        mfxU32 last = first;
+        ptr         = stopCharacter;
+        if (*ptr == MSDK_CHAR('-')) {
+            ++ptr;
+            last = (mfxU32)msdk_strtol(ptr, &stopCharacter, 10);
+            if (stopCharacter == ptr || last < first)
+                return MFX_ERR_UNKNOWN;
+            ptr = stopCharacter;
+        }
+        for (mfxU32 cpu = first; cpu <= last; ++cpu)
+            value.push_back(cpu);
+
+        if (*ptr == MSDK_CHAR(','))
+            ++ptr;
+        else if (*ptr && *ptr != MSDK_CHAR('\n'))
+            return MFX_ERR_UNKNOWN;
+        else
+            break;
+    }
+    return value.empty() ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
 bool IsDecodeCodecSupported(mfxU32 codecFormat) {
     switch (codecFormat) {
         case MFX_CODEC_MPEG2:
@@ -2644,6 +2762,145 @@ mfxU16 FourCCToChroma(mfxU32 fourCC) {
     return MFX_CHROMAFORMAT_YUV420;
 }
 
+mfxStatus StrToFPSLimiterPolicy(const msdk_char* str, FPSLimiterPolicy& policy) {
+    if (0 == msdk_strcmp(str, MSDK_STRING("catchup"))) {
+        policy = FPS_POLICY_CATCHUP;
+    }
+    else if (0 == msdk_strcmp(str, MSDK_STRING("drop"))) {
+        policy = FPS_POLICY_DROP;
+    }
+    else if (0 == msdk_strcmp(str, MSDK_STRING("rebase"))) {
+        policy = FPS_POLICY_REBASE;
+    }
+    else {
+        return MFX_ERR_UNSUPPORTED;
+    }
+    return MFX_ERR_NONE;
+}
+
+// the last microseconds before a deadline are spent spinning, sleep wake-up is not that precise
+#define FPS_LIMITER_SPIN_NS 200000
+
+static mfxI64 GetPacingTimeNs() {
+#if defined(_WIN32) || defined(_WIN64)
+    static const mfxF64 nsPerTick = 1e9 / msdk_time_get_frequency();
+    return (mfxI64)(msdk_time_get_tick() * nsPerTick);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mfxI64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void SleepUntilNs(mfxI64 deadlineNs) {
+    mfxI64 wakeNs = deadlineNs - FPS_LIMITER_SPIN_NS;
+#if defined(_WIN32) || defined(_WIN64)
+    // Sleep() has a millisecond granularity, leave one more millisecond to the spin
+    mfxI64 leftNs = wakeNs - GetPacingTimeNs();
+    while (leftNs > 1000000) {
+        MSDK_SLEEP((mfxU32)(leftNs / 1000000) - 1);
+        leftNs = wakeNs - GetPacingTimeNs();
+    }
+#else
+    if (wakeNs > GetPacingTimeNs()) {
+        struct timespec ts;
+        ts.tv_sec  = (time_t)(wakeNs / 1000000000);
+        ts.tv_nsec = (long)(wakeNs % 1000000000);
+        // absolute deadline, so interruption by a signal just resumes the same sleep
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+            ;
+    }
+#endif
+    while (GetPacingTimeNs() < deadlineNs)
+        ;
+}
+
+void FPSLimiter::Reset(mfxF64 fps, FPSLimiterPolicy policy) {
+    *this      = FPSLimiter();
+    m_fps      = fps > 0 ? fps : 0;
+    m_periodNs = m_fps ? (mfxI64)(1e9 / m_fps) : 0;
+    m_policy   = policy;
+}
+
+void FPSLimiter::Work() {
+    if (!m_periodNs)
+        return;
+
+    mfxI64 nowNs = GetPacingTimeNs();
+    if (!m_bStarted) {
+        m_bStarted  = true;
+        m_startNs   = nowNs;
+        m_nextFrame = 0;
+    }
+
+    // deadline is computed from the frame index every time, so rounding does not accumulate
+    mfxI64 deadlineNs = m_startNs + (mfxI64)(m_nextFrame * 1e9 / m_fps);
+    if (nowNs < deadlineNs) {
+        SleepUntilNs(deadlineNs);
+        nowNs = GetPacingTimeNs();
+    }
+
+    mfxI64 latenessNs = nowNs - deadlineNs;
+    mfxU32 bucket     = 0;
+    while (bucket < HISTOGRAM_SIZE - 1 && latenessNs >= ((mfxI64)16000 << bucket))
+        bucket++;
+    m_histogram[bucket]++;
+    m_sumLatenessNs += (mfxF64)latenessNs;
+    m_maxLatenessNs = std::max(m_maxLatenessNs, latenessNs);
+    m_nFrames++;
+    m_nextFrame++;
+
+    if (latenessNs > m_periodNs) {
+        m_nLate++;
+        if (FPS_POLICY_DROP == m_policy) {
+            // the next frame goes to the first slot which is not missed yet
+            mfxU64 dropped = (mfxU64)(latenessNs / m_periodNs);
+            m_nextFrame += dropped;
+            m_nDropped += dropped;
+        }
+        else if (FPS_POLICY_REBASE == m_policy) {
+            m_startNs   = nowNs;
+            m_nextFrame = 1;
+            m_nRebased++;
+        }
+    }
+}
+
+void FPSLimiter::PrintStatistics() const {
+    if (!m_periodNs || !m_nFrames)
+        return;
+
+    static const msdk_char* policyNames[] = { MSDK_STRING("catchup"),
+                                              MSDK_STRING("drop"),
+                                              MSDK_STRING("rebase") };
+
+    msdk_printf(MSDK_STRING("\nFrame pacing: %.3f fps, policy %s, %llu frames\n"),
+                m_fps,
+                policyNames[m_policy],
+                (unsigned long long)m_nFrames);
+    msdk_printf(MSDK_STRING("  lateness avg %.3f ms, max %.3f ms, %llu frames late by more ")
+                    MSDK_STRING("than a period, %llu slots dropped, %u rebases\n"),
+                m_sumLatenessNs / m_nFrames / 1e6,
+                m_maxLatenessNs / 1e6,
+                (unsigned long long)m_nLate,
+                (unsigned long long)m_nDropped,
+                m_nRebased);
+    for (mfxU32 i = 0; i < HISTOGRAM_SIZE; i++) {
+        if (!m_histogram[i])
+            continue;
+        if (i < HISTOGRAM_SIZE - 1) {
+            msdk_printf(MSDK_STRING("  < %8u us: %llu\n"),
+                        16u << i,
+                        (unsigned long long)m_histogram[i]);
+        }
+        else {
+            msdk_printf(MSDK_STRING(" >= %8u us: %llu\n"),
+                        16u << (i - 1),
+                        (unsigned long long)m_histogram[i]);
+        }
+    }
+}
+
 #if defined(_WIN32) || defined(_WIN64)
 
 mfxStatus PrintLoadedModules() {
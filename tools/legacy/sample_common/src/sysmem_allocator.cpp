@@ -21,6 +21,8 @@ SysMemFrameAllocator::~SysMemFrameAllocator() {
 }
 
 mfxStatus SysMemFrameAllocator::Init(mfxAllocatorParams* pParams) {
+    mfxI32 numaNode = -1;
+
     // check if any params passed from application
     if (pParams) {
         SysMemAllocatorParams* pSysMemParams = 0;
@@ -30,11 +32,12 @@ mfxStatus SysMemFrameAllocator::Init(mfxAllocatorParams* pParams) {
 
         m_pBufferAllocator    = pSysMemParams->pBufferAllocator;
         m_bOwnBufferAllocator = false;
+        numaNode              = pSysMemParams->NumaNode;
     }
 
     // if buffer allocator wasn't passed from application create own
     if (!m_pBufferAllocator) {
-        m_pBufferAllocator = new SysMemBufferAllocator;
+        m_pBufferAllocator = new SysMemBufferAllocator(numaNode);
         if (!m_pBufferAllocator)
             return MFX_ERR_MEMORY_ALLOC;
 
@@ -462,7 +465,7 @@ mfxStatus SysMemFrameAllocator::ReleaseResponse(mfxFrameAllocResponse* response)
     return sts;
 }
 
-SysMemBufferAllocator::SysMemBufferAllocator() {}
+SysMemBufferAllocator::SysMemBufferAllocator(mfxI32 numaNode) : m_NumaNode(numaNode) {}
 
 SysMemBufferAllocator::~SysMemBufferAllocator() {}
 
@@ -479,6 +482,10 @@ mfxStatus SysMemBufferAllocator::AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemI
     if (!buffer_ptr)
         return MFX_ERR_MEMORY_ALLOC;
 
+    // best effort: large buffers are not touched by calloc yet, so they are placed on the node
+    if (m_NumaNode >= 0)
+        msdk_numa_bind_memory(buffer_ptr, header_size + nbytes + 32, m_NumaNode);
+
     sBuffer* bs = (sBuffer*)buffer_ptr;
     bs->id      = ID_BUFFER;
     bs->type    = type;
@@ -6,8 +6,11 @@
 
 #if !defined(_WIN32) && !defined(_WIN64)
 
+    #include <ctype.h>
+    #include <dirent.h>
     #include <sched.h>
     #include <stdio.h> // setrlimit
+    #include <string.h>
     #include <sys/syscall.h>
     #include <unistd.h>
     #include <new> // std::bad_alloc
@@ -327,4 +330,116 @@ mfxU32 msdk_get_current_pid() {
     return syscall(SYS_getpid);
 }
 
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32>& cpus) {
+    if (cpus.empty())
+        return MFX_ERR_NONE;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (mfxU32 cpu : cpus) {
+        if (cpu >= CPU_SETSIZE)
+            return MFX_ERR_INVALID_VIDEO_PARAM;
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxU32 msdk_numa_get_node_count() {
+    mfxU32 count = 0;
+    DIR* dir     = opendir("/sys/devices/system/node");
+    if (!dir)
+        return 1;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!strncmp(entry->d_name, "node", 4) && isdigit(entry->d_name[4]))
+            ++count;
+    }
+    closedir(dir);
+    return count ? count : 1;
+}
+
+mfxStatus msdk_numa_get_node_cpus(mfxU32 node, std::vector<mfxU32>& cpus) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        // no NUMA support: node 0 spans all online CPUs
+        if (node)
+            return MFX_ERR_NOT_FOUND;
+        file = fopen("/sys/devices/system/cpu/online", "r");
+        if (!file)
+            return MFX_ERR_NOT_FOUND;
+    }
+
+    char buf[1024] = {};
+    bool read      = fgets(buf, sizeof(buf), file) != NULL;
+    fclose(file);
+    if (!read)
+        return MFX_ERR_NOT_FOUND;
+
+    return msdk_opt_read(buf, cpus) == MFX_ERR_NONE ? MFX_ERR_NONE : MFX_ERR_NOT_FOUND;
+}
+
+    #if defined(SYS_set_mempolicy) && defined(SYS_mbind)
+// Values from linux/mempolicy.h, defined here to avoid dependency on libnuma
+enum { MSDK_MPOL_DEFAULT = 0, MSDK_MPOL_PREFERRED = 1 };
+enum { MSDK_MPOL_MF_MOVE = 1 << 1 };
+enum { MSDK_NUMA_MAX_NODES = 1024 };
+
+typedef unsigned long msdk_nodemask[MSDK_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+
+static bool msdk_fill_nodemask(mfxU32 node, msdk_nodemask& mask) {
+    if (node >= MSDK_NUMA_MAX_NODES)
+        return false;
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    return true;
+}
+
+mfxStatus msdk_numa_set_preferred_node(mfxI32 node) {
+    if (node < 0)
+        return syscall(SYS_set_mempolicy, MSDK_MPOL_DEFAULT, NULL, 0) ? MFX_ERR_UNKNOWN
+                                                                       : MFX_ERR_NONE;
+
+    msdk_nodemask mask;
+    if (!msdk_fill_nodemask((mfxU32)node, mask))
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+    return syscall(SYS_set_mempolicy, MSDK_MPOL_PREFERRED, mask, MSDK_NUMA_MAX_NODES + 1)
+               ? MFX_ERR_UNKNOWN
+               : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_bind_memory(void* ptr, size_t size, mfxU32 node) {
+    msdk_nodemask mask;
+    if (!ptr || !msdk_fill_nodemask(node, mask))
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+
+    size_t page  = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = ((size_t)ptr + page - 1) & ~(page - 1);
+    size_t end   = ((size_t)ptr + size) & ~(page - 1);
+    if (end <= begin)
+        return MFX_ERR_NONE;
+
+    return syscall(SYS_mbind,
+                   begin,
+                   end - begin,
+                   MSDK_MPOL_PREFERRED,
+                   mask,
+                   MSDK_NUMA_MAX_NODES + 1,
+                   MSDK_MPOL_MF_MOVE)
+               ? MFX_ERR_UNKNOWN
+               : MFX_ERR_NONE;
+}
+    #else
+mfxStatus msdk_numa_set_preferred_node(mfxI32) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
+mfxStatus msdk_numa_bind_memory(void*, size_t, mfxU32) {
+    return MFX_ERR_UNSUPPORTED;
+}
+    #endif
+
 #endif // #if !defined(_WIN32) && !defined(_WIN64)
@@ -127,4 +127,44 @@ mfxU32 msdk_get_current_pid() {
     return GetCurrentProcessId();
 }
 
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32>& cpus) {
+    if (cpus.empty())
+        return MFX_ERR_NONE;
+
+    DWORD_PTR mask = 0;
+    for (mfxU32 cpu : cpus) {
+        if (cpu >= sizeof(mask) * 8)
+            return MFX_ERR_INVALID_VIDEO_PARAM;
+        mask |= (DWORD_PTR)1 << cpu;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+}
+
+mfxU32 msdk_numa_get_node_count() {
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? highest + 1 : 1;
+}
+
+mfxStatus msdk_numa_get_node_cpus(mfxU32 node, std::vector<mfxU32>& cpus) {
+    ULONGLONG mask = 0;
+    if (node > 0xFF || !GetNumaNodeProcessorMask((UCHAR)node, &mask))
+        return MFX_ERR_NOT_FOUND;
+
+    cpus.clear();
+    for (mfxU32 cpu = 0; cpu < sizeof(mask) * 8; ++cpu) {
+        if (mask & (1ull << cpu))
+            cpus.push_back(cpu);
+    }
+    return cpus.empty() ? MFX_ERR_NOT_FOUND : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_set_preferred_node(mfxI32) {
+    // Windows allocates memory from the node of the ideal processor of the calling thread
+    return MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_bind_memory(void*, size_t, mfxU32) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
 #endif // #if defined(_WIN32) || defined(_WIN64)
@@ -8,6 +8,7 @@
 
 #if defined(_WIN32) || defined(_WIN64)
 
+    #include <intrin.h>
     #include "vm/time_defs.h"
 
 msdk_tick msdk_time_get_tick(void) {
@@ -28,4 +29,29 @@ mfxU64 rdtsc() {
     return __rdtsc();
 }
 
+static msdk_tick calibrate_tsc_frequency() {
+    int regs[4] = {};
+    // CPUID.80000007H:EDX[8] - invariant TSC
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000007)
+        return 0;
+    __cpuid(regs, 0x80000007);
+    if (!(regs[3] & (1 << 8)))
+        return 0;
+
+    msdk_tick startTick = msdk_time_get_tick();
+    mfxU64 startTsc     = rdtsc();
+    Sleep(10);
+    msdk_tick elapsedTick = msdk_time_get_tick() - startTick;
+    mfxU64 elapsedTsc     = rdtsc() - startTsc;
+
+    return elapsedTick ? (msdk_tick)((double)elapsedTsc * msdk_time_get_frequency() / elapsedTick)
+                       : 0;
+}
+
+msdk_tick msdk_time_get_tsc_frequency() {
+    static const msdk_tick frequency = calibrate_tsc_frequency();
+    return frequency;
+}
+
 #endif // #if defined(_WIN32) || defined(_WIN64)
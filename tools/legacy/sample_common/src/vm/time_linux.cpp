@@ -6,7 +6,10 @@
 
 #if !defined(_WIN32) && !defined(_WIN64)
 
+    #include <cpuid.h>
     #include <sys/time.h>
+    #include <time.h>
+    #include <unistd.h>
     #include "vm/time_defs.h"
 
     #define MSDK_TIME_MHZ 1000000
@@ -28,4 +31,31 @@ mfxU64 rdtsc(void) {
     return ((mfxU64)hi << 32) | lo;
 }
 
+static mfxU64 get_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mfxU64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static msdk_tick calibrate_tsc_frequency(void) {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    // CPUID.80000007H:EDX[8] - invariant TSC
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007 ||
+        !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8)))
+        return 0;
+
+    mfxU64 startNs  = get_monotonic_ns();
+    mfxU64 startTsc = rdtsc();
+    usleep(10000);
+    mfxU64 elapsedNs  = get_monotonic_ns() - startNs;
+    mfxU64 elapsedTsc = rdtsc() - startTsc;
+
+    return elapsedNs ? (msdk_tick)((double)elapsedTsc * 1e9 / elapsedNs) : 0;
+}
+
+msdk_tick msdk_time_get_tsc_frequency(void) {
+    static const msdk_tick frequency = calibrate_tsc_frequency();
+    return frequency;
+}
+
 #endif // #if !defined(_WIN32) && !defined(_WIN64)
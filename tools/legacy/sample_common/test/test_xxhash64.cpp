@@ -0,0 +1,103 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+// Checks CXXHash64 against the xxHash64 reference vectors. Frame hashes of
+// sample_decode and decvpp_tool are compared with the ones of other tools, so
+// the digest must match the reference implementation bit for bit.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xxhash64.h"
+
+#define CHECK(cond)                                            \
+    if (!(cond)) {                                             \
+        printf("\n   Error! %s (line %d)\n", #cond, __LINE__); \
+        return false;                                          \
+    }
+
+static const uint64_t SEED = 2654435761ULL;
+
+struct Vector {
+    const char* data;
+    uint64_t hash;
+    uint64_t seededHash;
+};
+
+// Digests of the reference implementation with seed 0 and SEED
+static const Vector vectors[] = {
+    { "", 0xef46db3751d8e999ULL, 0xac75fda2929b17efULL },
+    { "a", 0xd24ec4f1a98c6e5bULL, 0x393da8b78992279bULL },
+    { "abc", 0x44bc2cf5ad770999ULL, 0x1318df30094a85fdULL },
+    { "hello, world", 0xb33a384e6d1b1242ULL, 0x157b8a6ca3fcc14dULL },
+    { "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789$",
+      0x1032d841e824f998ULL,
+      0x677d1c47d9d5cb26ULL },
+};
+
+static uint64_t Hash(const void* data, size_t size, uint64_t seed) {
+    CXXHash64 hash(seed);
+    hash.Update(data, size);
+    return hash.Digest();
+}
+
+static bool TestReferenceVectors() {
+    for (const Vector& v : vectors) {
+        CHECK(Hash(v.data, strlen(v.data), 0) == v.hash);
+        CHECK(Hash(v.data, strlen(v.data), SEED) == v.seededHash);
+    }
+    return true;
+}
+
+// Reset reuses the object for the next frame
+static bool TestReset() {
+    CXXHash64 hash;
+    hash.Update("garbage", 7);
+    hash.Reset(SEED);
+    hash.Update("abc", 3);
+    CHECK(hash.Digest() == 0x1318df30094a85fdULL);
+    return true;
+}
+
+// Planes are hashed row by row, any split of the data gives the same digest
+static bool TestStreaming() {
+    uint8_t buf[1000];
+    for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = (uint8_t)(i * 7 + 3);
+
+    const uint64_t reference = 0x5f235fa033f1a3fbULL;
+    CHECK(Hash(buf, sizeof(buf), 0) == reference);
+
+    for (size_t chunk = 1; chunk <= 65; chunk++) {
+        CXXHash64 hash;
+        for (size_t pos = 0; pos < sizeof(buf); pos += chunk) {
+            size_t size = sizeof(buf) - pos < chunk ? sizeof(buf) - pos : chunk;
+            hash.Update(buf + pos, size);
+        }
+        CHECK(hash.Digest() == reference);
+    }
+
+    // Digest doesn't change the state
+    CXXHash64 hash;
+    hash.Update(buf, 500);
+    hash.Digest();
+    hash.Update(buf + 500, 500);
+    CHECK(hash.Digest() == reference);
+    return true;
+}
+
+#define RUN_TEST(test)        \
+    printf("Test %s", #test); \
+    if (!test())              \
+        return -1;            \
+    printf(" passed\n");
+
+int main() {
+    RUN_TEST(TestReferenceVectors);
+    RUN_TEST(TestReset);
+    RUN_TEST(TestStreaming);
+    return 0;
+}
@@ -18,11 +18,13 @@
 #include <memory>
 #include <vector>
 #include "decode_render.h"
+#include "frame_hash.h"
 #include "hw_device.h"
 #include "mfx_buffering.h"
 
 #include "base_allocator.h"
 #include "sample_utils.h"
+#include "time_statistics.h"
 #include "vpl_implementation_loader.h"
 
 #include "mfxplugin.h"
@@ -63,7 +65,8 @@ struct sInputParams {
     bool bLowLat; // low latency mode
     bool bCalLat; // latency calculation
     bool bUseFullColorRange; //whether to use full color range
-    mfxU16 nMaxFPS; // limits overall fps
+    mfxF64 nMaxFPS; // limits overall fps
+    FPSLimiterPolicy fpsPolicy; // what to do with frames which are late for the -fps schedule
     mfxU32 nWallCell;
     mfxU32 nWallW; //number of windows located in each row
     mfxU32 nWallH; //number of windows located in each column
@@ -124,8 +127,13 @@ struct sInputParams {
 
     msdk_char strSrcFile[MSDK_MAX_FILENAME_LEN];
     msdk_char strDstFile[MSDK_MAX_FILENAME_LEN];
+    msdk_char strHashFile[MSDK_MAX_FILENAME_LEN]; // per-frame hash log written instead of YUV
+    msdk_char strGoldenHashFile[MSDK_MAX_FILENAME_LEN]; // hash log to compare output with
 
     bool bDisableFilmGrain;
+
+    std::vector<msdk_string> InputFiles; // inputs of the multi-stream mode
+    mfxU32 nMaxThreads; // cap of library worker threads over all streams
 };
 
 struct CPipelineStatistics {
@@ -166,6 +174,12 @@ public:
     virtual mfxStatus ResetDevice();
 
     void SetMultiView();
+    // Makes the pipeline use loader, device and allocator of the owner instead of its own,
+    // must be called before Init. The owner must be closed after this pipeline.
+    void ShareResources(CDecodingPipeline* pOwner, mfxU32 allocId);
+    const CLatencyHistogram& GetLatencyHistogram() const {
+        return m_latencyHistogram;
+    }
     virtual void PrintInfo();
     mfxU64 GetTotalBytesProcessed() {
         return totalBytesProcessed + m_mfxBS.DataOffset;
@@ -222,11 +236,12 @@ protected: // functions
 
 protected: // variables
     CSmplYUVWriter m_FileWriter;
+    CSmplHashWriter m_HashWriter;
     std::unique_ptr<CSmplBitstreamReader> m_FileReader;
     mfxBitstreamWrapper m_mfxBS; // contains encoded data
     mfxU64 totalBytesProcessed;
 
-    std::unique_ptr<VPLImplementationLoader> m_pLoader;
+    std::shared_ptr<VPLImplementationLoader> m_pLoader;
     MainVideoSession m_mfxSession;
     mfxIMPL m_impl;
     MFXVideoDECODE* m_pmfxDEC;
@@ -265,14 +280,15 @@ protected: // variables
     mfxU16 m_vppOutHeight;
 
     mfxU32 m_nTimeout; // enables timeout for video playback, measured in seconds
-    mfxU16 m_nMaxFps; // limit of fps, if isn't specified equal 0.
+    mfxF64 m_nMaxFps; // limit of fps, if isn't specified equal 0.
     mfxU32 m_nFrames; //limit number of output frames
 
     mfxU16 m_diMode;
     bool m_bVppIsUsed;
     bool m_bVppFullColorRange;
     bool m_bSoftRobustFlag;
-    std::vector<msdk_tick> m_vLatency;
+    std::vector<msdk_tick> m_vLatency; // per-frame latencies printed at the end of decoding
+    CLatencyHistogram m_latencyHistogram;
 
     FPSLimiter m_fpsLimiter;
 
@@ -303,6 +319,9 @@ protected: // variables
     bool m_bResetFileWriter;
     bool m_bResetFileReader;
 
+    CDecodingPipeline* m_pResourceOwner; // shares loader, device and allocator if set
+    mfxU32 m_nAllocId; // separates frames of the sessions sharing one allocator
+
 private:
     CDecodingPipeline(const CDecodingPipeline&);
     void operator=(const CDecodingPipeline&);
@@ -0,0 +1,45 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __PIPELINE_MULTI_DECODE_H__
+#define __PIPELINE_MULTI_DECODE_H__
+
+#include <memory>
+#include <vector>
+
+#include "pipeline_decode.h"
+
+/* This class decodes several streams in one process: a CDecodingPipeline per stream, each
+   running in its own thread. The first pipeline owns loader, device and allocator, the
+   others share them. */
+class CMultiStreamDecoder {
+public:
+    CMultiStreamDecoder();
+    virtual ~CMultiStreamDecoder();
+
+    virtual mfxStatus Init(sInputParams* pParams);
+    virtual mfxStatus Run();
+    virtual void Close();
+    virtual void PrintInfo();
+
+protected:
+    struct sStream {
+        sInputParams Params;
+        std::unique_ptr<CDecodingPipeline> pPipeline;
+        mfxStatus Status;
+    };
+
+    void RunStream(sStream& stream);
+    void PrintStatistics(mfxF64 wallTime);
+
+    std::vector<std::unique_ptr<sStream>> m_Streams;
+
+private:
+    CMultiStreamDecoder(const CMultiStreamDecoder&)            = delete;
+    CMultiStreamDecoder& operator=(const CMultiStreamDecoder&) = delete;
+};
+
+#endif // __PIPELINE_MULTI_DECODE_H__
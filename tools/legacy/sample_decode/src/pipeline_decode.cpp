@@ -14,6 +14,7 @@
 #endif
 
 #include <assert.h>
+#include <math.h>
 #include <algorithm>
 #include <ctime>
 #include <thread>
@@ -90,6 +91,7 @@ CDecodingPipeline::CDecodingPipeline()
           m_bVppFullColorRange(false),
           m_bSoftRobustFlag(false),
           m_vLatency(),
+          m_latencyHistogram(),
           m_fpsLimiter(),
           m_VppVideoSignalInfo({}),
           m_VppSurfaceExtParams(),
@@ -116,7 +118,9 @@ CDecodingPipeline::CDecodingPipeline()
           m_bPerfMode(false),
 #endif
           m_bResetFileWriter(false),
-          m_bResetFileReader(false) {
+          m_bResetFileReader(false),
+          m_pResourceOwner(NULL),
+          m_nAllocId(0) {
     // reserve some space to reduce dynamic reallocation impact on pipeline execution
     m_vLatency.reserve(1000);
     m_VppVideoSignalInfo.Header.BufferId = MFX_EXTBUFF_VPP_VIDEO_SIGNAL_INFO;
@@ -269,45 +273,59 @@ mfxStatus CDecodingPipeline::Init(sInputParams* pParams) {
 
     initPar.Implementation = pParams->bUseHWLib ? MFX_IMPL_HARDWARE : MFX_IMPL_SOFTWARE;
 
-    m_pLoader.reset(new VPLImplementationLoader);
+    if (!pParams->accelerationMode && pParams->bUseHWLib) {
+#if D3D_SURFACES_SUPPORT
+        pParams->accelerationMode = MFX_ACCEL_MODE_VIA_D3D11;
+#elif defined(LIBVA_SUPPORT)
+        pParams->accelerationMode = MFX_ACCEL_MODE_VIA_VAAPI;
+#endif
+    }
 
-    if (pParams->dGfxIdx >= 0)
-        m_pLoader->SetDiscreteAdapterIndex(pParams->dGfxIdx);
-    else
-        m_pLoader->SetAdapterType(pParams->adapterType);
+    if (m_pResourceOwner) {
+        // loader is already configured by the owner of shared resources
+        m_pLoader = m_pResourceOwner->m_pLoader;
+    }
+    else {
+        m_pLoader.reset(new VPLImplementationLoader);
+
+        if (pParams->dGfxIdx >= 0)
+            m_pLoader->SetDiscreteAdapterIndex(pParams->dGfxIdx);
+        else
+            m_pLoader->SetAdapterType(pParams->adapterType);
 
-    if (pParams->adapterNum >= 0)
-        m_pLoader->SetAdapterNum(pParams->adapterNum);
+        if (pParams->adapterNum >= 0)
+            m_pLoader->SetAdapterNum(pParams->adapterNum);
 
 #ifdef ONEVPL_EXPERIMENTAL
-    if (pParams->PCIDeviceSetup)
-        m_pLoader->SetPCIDevice(pParams->PCIDomain,
-                                pParams->PCIBus,
-                                pParams->PCIDevice,
-                                pParams->PCIFunction);
+        if (pParams->PCIDeviceSetup)
+            m_pLoader->SetPCIDevice(pParams->PCIDomain,
+                                    pParams->PCIBus,
+                                    pParams->PCIDevice,
+                                    pParams->PCIFunction);
 
     #if (defined(_WIN64) || defined(_WIN32))
-    if (pParams->luid.HighPart > 0 || pParams->luid.LowPart)
-        m_pLoader->SetupLUID(pParams->luid);
+        if (pParams->luid.HighPart > 0 || pParams->luid.LowPart)
+            m_pLoader->SetupLUID(pParams->luid);
     #else
-    m_pLoader->SetupDRMRenderNodeNum(pParams->DRMRenderNodeNum);
+        m_pLoader->SetupDRMRenderNodeNum(pParams->DRMRenderNodeNum);
     #endif
 #endif
 
-    if (!pParams->accelerationMode && pParams->bUseHWLib) {
-#if D3D_SURFACES_SUPPORT
-        pParams->accelerationMode = MFX_ACCEL_MODE_VIA_D3D11;
-#elif defined(LIBVA_SUPPORT)
-        pParams->accelerationMode = MFX_ACCEL_MODE_VIA_VAAPI;
-#endif
-    }
+        if (pParams->nMaxThreads) {
+            // the cap is split evenly between all sessions created from this loader
+            mfxU32 nSessions = std::max<mfxU32>((mfxU32)pParams->InputFiles.size(), 1);
+            mfxU32 nThreads  = std::max<mfxU32>(pParams->nMaxThreads / nSessions, 1);
+            sts              = m_pLoader->CreateConfig(nThreads, "NumThread");
+            MSDK_CHECK_STATUS(sts, "m_pLoader->CreateConfig failed");
+        }
 
-    bool bLowLatencyMode = !pParams->dispFullSearch;
+        bool bLowLatencyMode = !pParams->dispFullSearch;
 
-    sts = m_pLoader->ConfigureAndEnumImplementations(initPar.Implementation,
-                                                     pParams->accelerationMode,
-                                                     bLowLatencyMode);
-    MSDK_CHECK_STATUS(sts, "m_mfxSession.EnumImplementations failed");
+        sts = m_pLoader->ConfigureAndEnumImplementations(initPar.Implementation,
+                                                         pParams->accelerationMode,
+                                                         bLowLatencyMode);
+        MSDK_CHECK_STATUS(sts, "m_mfxSession.EnumImplementations failed");
+    }
 
     sts = m_mfxSession.CreateSession(m_pLoader.get());
     MSDK_CHECK_STATUS(sts, "m_mfxSession.CreateSession failed");
@@ -342,8 +360,13 @@ mfxStatus CDecodingPipeline::Init(sInputParams* pParams) {
     }
 #endif
     if (isDeviceRequired) {
-        sts = CreateHWDevice();
-        MSDK_CHECK_STATUS(sts, "CreateHWDevice failed");
+        if (m_pResourceOwner && m_pResourceOwner->m_hwdev) {
+            m_hwdev = m_pResourceOwner->m_hwdev;
+        }
+        else {
+            sts = CreateHWDevice();
+            MSDK_CHECK_STATUS(sts, "CreateHWDevice failed");
+        }
         if (pParams->bUseHWLib) {
             mfxHDL hdl = NULL;
             sts        = m_hwdev->GetHandle(hdl_t, &hdl);
@@ -390,7 +413,7 @@ mfxStatus CDecodingPipeline::Init(sInputParams* pParams) {
 #endif
     }
 
-    m_fpsLimiter.Reset(pParams->nMaxFPS);
+    m_fpsLimiter.Reset(pParams->nMaxFPS, pParams->fpsPolicy);
 
     // create decoder
     m_pmfxDEC = new MFXVideoDECODE(m_mfxSession);
@@ -411,7 +434,13 @@ mfxStatus CDecodingPipeline::Init(sInputParams* pParams) {
             return MFX_ERR_MEMORY_ALLOC;
     }
 
-    if (m_eWorkMode == MODE_FILE_DUMP) {
+    if (m_eWorkMode == MODE_FILE_DUMP &&
+        (msdk_strlen(pParams->strHashFile) || msdk_strlen(pParams->strGoldenHashFile))) {
+        // frames are hashed instead of writing them to the file
+        sts = m_HashWriter.Init(pParams->strHashFile, pParams->strGoldenHashFile);
+        MSDK_CHECK_STATUS(sts, "m_HashWriter.Init failed");
+    }
+    else if (m_eWorkMode == MODE_FILE_DUMP) {
         // prepare YUV file writer
         sts = m_FileWriter.Init(pParams->strDstFile, pParams->numViews);
         MSDK_CHECK_STATUS(sts, "m_FileWriter.Init failed");
@@ -511,6 +540,7 @@ void CDecodingPipeline::Close() {
 
     m_mfxSession.Close();
     m_FileWriter.Close();
+    m_HashWriter.Close();
     if (m_FileReader.get())
         m_FileReader->Close();
 
@@ -1002,6 +1032,10 @@ mfxStatus CDecodingPipeline::CreateHWDevice() {
 }
 
 mfxStatus CDecodingPipeline::ResetDevice() {
+    // shared device is reset by its owner
+    if (m_pResourceOwner)
+        return MFX_ERR_NONE;
+
     if (m_hwdev)
         return m_hwdev->Reset();
 
@@ -1026,9 +1060,12 @@ mfxStatus CDecodingPipeline::AllocFrames() {
     MSDK_ZERO_MEMORY(VppRequest[0]);
     MSDK_ZERO_MEMORY(VppRequest[1]);
 
+    m_mfxVideoParams.AllocId = m_nAllocId;
+
     sts = m_pmfxDEC->Query(&m_mfxVideoParams, &m_mfxVideoParams);
     MSDK_IGNORE_MFX_STS(sts, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
     MSDK_CHECK_STATUS(sts, "m_pmfxDEC->Query failed");
+    m_mfxVideoParams.AllocId = m_nAllocId;
 
     // calculate number of surfaces required for decoder
     sts = m_pmfxDEC->QueryIOSurf(&m_mfxVideoParams, &Request);
@@ -1040,8 +1077,8 @@ mfxStatus CDecodingPipeline::AllocFrames() {
     MSDK_CHECK_STATUS(sts, "m_pmfxDEC->QueryIOSurf failed");
 
     if (m_eWorkMode == MODE_RENDERING) {
-        // Add surfaces for rendering smoothness
-        Request.NumFrameSuggested += m_nMaxFps / 3;
+        // Add surfaces for rendering smoothness, a fractional rate is rounded up
+        Request.NumFrameSuggested += (mfxU16)ceil(m_nMaxFps / 3);
     }
 
     if (m_bVppIsUsed) {
@@ -1105,6 +1142,7 @@ mfxStatus CDecodingPipeline::AllocFrames() {
 #endif
 
     // alloc frames for decoder
+    Request.AllocId = m_nAllocId;
     sts = m_pGeneralAllocator->Alloc(m_pGeneralAllocator->pthis, &Request, &m_mfxResponse);
     MSDK_CHECK_STATUS(sts, "m_pGeneralAllocator->Alloc failed");
 
@@ -1196,6 +1234,19 @@ mfxStatus CDecodingPipeline::ReallocCurrentSurface(const mfxFrameInfo& info) {
 mfxStatus CDecodingPipeline::CreateAllocator() {
     mfxStatus sts = MFX_ERR_NONE;
 
+    if (m_pResourceOwner) {
+        // frames of the sessions are told apart by AllocId in the shared allocator
+        m_pGeneralAllocator = m_pResourceOwner->m_pGeneralAllocator;
+        m_export_mode       = m_pResourceOwner->m_export_mode;
+        MSDK_CHECK_POINTER(m_pGeneralAllocator, MFX_ERR_NOT_INITIALIZED);
+
+        sts = m_mfxSession.SetFrameAllocator(m_pGeneralAllocator);
+        MSDK_CHECK_STATUS(sts, "m_mfxSession.SetFrameAllocator failed");
+        m_bExternalAlloc = true;
+
+        return MFX_ERR_NONE;
+    }
+
     m_pGeneralAllocator = new GeneralAllocator();
     if (m_memType != SYSTEM_MEMORY || !m_bDecOutSysmem) {
 #if D3D_SURFACES_SUPPORT
@@ -1299,12 +1350,24 @@ void CDecodingPipeline::DeleteFrames() {
 }
 
 void CDecodingPipeline::DeleteAllocator() {
+    if (m_pResourceOwner) {
+        // shared objects are deleted by their owner
+        m_pGeneralAllocator = NULL;
+        m_hwdev             = NULL;
+        return;
+    }
+
     // delete allocator
     MSDK_SAFE_DELETE(m_pGeneralAllocator);
     MSDK_SAFE_DELETE(m_pmfxAllocatorParams);
     MSDK_SAFE_DELETE(m_hwdev);
 }
 
+void CDecodingPipeline::ShareResources(CDecodingPipeline* pOwner, mfxU32 allocId) {
+    m_pResourceOwner = pOwner;
+    m_nAllocId       = allocId;
+}
+
 void CDecodingPipeline::SetMultiView() {
     m_FileWriter.SetMultiView();
     m_bIsMVC = true;
@@ -1413,8 +1476,11 @@ mfxStatus CDecodingPipeline::DeliverOutput(mfxFrameSurface1* frame) {
     }
 
     if (m_bResetFileWriter) {
-        sts = m_FileWriter.Reset();
-        MSDK_CHECK_STATUS(sts, "");
+        // the hash log just goes on, frame numbers keep growing
+        if (!m_HashWriter.IsInited()) {
+            sts = m_FileWriter.Reset();
+            MSDK_CHECK_STATUS(sts, "");
+        }
         m_bResetFileWriter = false;
     }
 
@@ -1424,8 +1490,11 @@ mfxStatus CDecodingPipeline::DeliverOutput(mfxFrameSurface1* frame) {
                                             frame->Data.MemId,
                                             &(frame->Data));
             if (MFX_ERR_NONE == res) {
-                res = m_bOutI420 ? m_FileWriter.WriteNextFrameI420(frame)
-                                 : m_FileWriter.WriteNextFrame(frame);
+                if (m_HashWriter.IsInited())
+                    res = m_HashWriter.WriteNextFrame(frame);
+                else
+                    res = m_bOutI420 ? m_FileWriter.WriteNextFrameI420(frame)
+                                     : m_FileWriter.WriteNextFrame(frame);
                 sts = m_pGeneralAllocator->Unlock(m_pGeneralAllocator->pthis,
                                                   frame->Data.MemId,
                                                   &(frame->Data));
@@ -1442,6 +1511,9 @@ mfxStatus CDecodingPipeline::DeliverOutput(mfxFrameSurface1* frame) {
 #endif
         }
     }
+    else if (m_HashWriter.IsInited()) {
+        res = m_HashWriter.WriteNextFrame(frame);
+    }
     else {
         res = m_bOutI420 ? m_FileWriter.WriteNextFrameI420(frame)
                          : m_FileWriter.WriteNextFrame(frame);
@@ -1531,7 +1603,9 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait) {
         // we got completely decoded frame - pushing it to the delivering thread...
         ++m_synced_count;
         if (m_bPrintLatency) {
-            m_vLatency.push_back(m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit);
+            msdk_tick latency = m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit;
+            m_vLatency.push_back(latency);
+            m_latencyHistogram.Record((mfxU64)(CTimer::ConvertToSeconds(latency) * 1e9));
         }
         else {
             PrintPerFrameStat();
@@ -1887,27 +1961,28 @@ mfxStatus CDecodingPipeline::RunDecoding() {
     }
 
     PrintPerFrameStat(true);
+    m_fpsLimiter.PrintStatistics();
 
     if (m_bPrintLatency && m_vLatency.size() > 0) {
         unsigned int frame_idx = 0;
-        msdk_tick sum          = 0;
         for (std::vector<msdk_tick>::iterator it = m_vLatency.begin(); it != m_vLatency.end();
              ++it) {
-            sum += *it;
             msdk_printf(MSDK_STRING("Frame %4d, latency=%5.5f ms\n"),
                         ++frame_idx,
                         (double)(CTimer::ConvertToSeconds(*it) * 1000));
         }
         msdk_printf(MSDK_STRING("\nLatency summary:\n"));
-        msdk_printf(
-            MSDK_STRING("\nAVG=%5.5f ms, MAX=%5.5f ms, MIN=%5.5f ms"),
-            (double)CTimer::ConvertToSeconds((msdk_tick)((mfxF64)sum / m_vLatency.size())) * 1000,
-            (double)CTimer::ConvertToSeconds(
-                *std::max_element(m_vLatency.begin(), m_vLatency.end())) *
-                1000,
-            (double)CTimer::ConvertToSeconds(
-                *std::min_element(m_vLatency.begin(), m_vLatency.end())) *
-                1000);
+        msdk_printf(MSDK_STRING("\nAVG=%5.5f ms, MAX=%5.5f ms, MIN=%5.5f ms"),
+                    m_latencyHistogram.GetAverage() / 1e6,
+                    m_latencyHistogram.GetMax() / 1e6,
+                    (double)CTimer::ConvertToSeconds(
+                        *std::min_element(m_vLatency.begin(), m_vLatency.end())) *
+                        1000);
+        msdk_printf(MSDK_STRING("\nP50=%5.5f ms, P90=%5.5f ms, P99=%5.5f ms, P99.9=%5.5f ms"),
+                    m_latencyHistogram.GetPercentile(50) / 1e6,
+                    m_latencyHistogram.GetPercentile(90) / 1e6,
+                    m_latencyHistogram.GetPercentile(99) / 1e6,
+                    m_latencyHistogram.GetPercentile(99.9) / 1e6);
     }
 
     if (m_eWorkMode == MODE_RENDERING) {
@@ -1924,6 +1999,12 @@ mfxStatus CDecodingPipeline::RunDecoding() {
     // exit in case of other errors
     MSDK_CHECK_STATUS(sts, "Unexpected error!!");
 
+    // the whole stream is delivered, the golden log mustn't have more frames
+    if (!bErrIncompatibleVideoParams && m_HashWriter.IsInited()) {
+        sts = m_HashWriter.Finish();
+        MSDK_CHECK_STATUS(sts, "m_HashWriter.Finish failed");
+    }
+
     // if we exited main decoding loop with ERR_INCOMPATIBLE_PARAM we need to send this status to caller
     if (bErrIncompatibleVideoParams) {
         sts = MFX_ERR_INCOMPATIBLE_VIDEO_PARAM;
@@ -0,0 +1,177 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "mfx_samples_config.h"
+
+#include "pipeline_multi_decode.h"
+
+#include <string>
+#include <thread>
+
+#ifndef MFX_VERSION
+    #error MFX_VERSION not defined
+#endif
+
+static mfxStatus AddStreamSuffix(const msdk_char* name,
+                                 size_t idx,
+                                 msdk_char (&result)[MSDK_MAX_FILENAME_LEN]) {
+    if (!msdk_strlen(name))
+        return MFX_ERR_NONE;
+
+    std::string suffix = "." + std::to_string(idx);
+    return msdk_opt_read(msdk_string(name) + msdk_string(suffix.begin(), suffix.end()), result);
+}
+
+CMultiStreamDecoder::CMultiStreamDecoder() : m_Streams() {}
+
+CMultiStreamDecoder::~CMultiStreamDecoder() {
+    Close();
+}
+
+mfxStatus CMultiStreamDecoder::Init(sInputParams* pParams) {
+    MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
+
+    if (pParams->mode == MODE_RENDERING || pParams->bIsMVC) {
+        msdk_printf(MSDK_STRING("error: rendering and MVC are not supported for several inputs\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    for (size_t i = 0; i < pParams->InputFiles.size(); i++) {
+        std::unique_ptr<sStream> stream(new sStream);
+        stream->Params = *pParams;
+        stream->Status = MFX_ERR_NONE;
+
+        mfxStatus sts = msdk_opt_read(pParams->InputFiles[i], stream->Params.strSrcFile);
+        MSDK_CHECK_STATUS(sts, "msdk_opt_read failed");
+
+        if (pParams->mode == MODE_FILE_DUMP) {
+            // every stream is dumped into <output>.<stream number>, same for hash logs
+            sts = AddStreamSuffix(pParams->strDstFile, i, stream->Params.strDstFile);
+            MSDK_CHECK_STATUS(sts, "AddStreamSuffix failed");
+            sts = AddStreamSuffix(pParams->strHashFile, i, stream->Params.strHashFile);
+            MSDK_CHECK_STATUS(sts, "AddStreamSuffix failed");
+            sts = AddStreamSuffix(pParams->strGoldenHashFile, i, stream->Params.strGoldenHashFile);
+            MSDK_CHECK_STATUS(sts, "AddStreamSuffix failed");
+        }
+
+        stream->pPipeline.reset(new CDecodingPipeline);
+        MSDK_CHECK_POINTER(stream->pPipeline.get(), MFX_ERR_MEMORY_ALLOC);
+        if (i)
+            stream->pPipeline->ShareResources(m_Streams[0]->pPipeline.get(), (mfxU32)i);
+
+        sts = stream->pPipeline->Init(&stream->Params);
+        if (MFX_ERR_NONE != sts) {
+            msdk_printf(MSDK_STRING("error: failed to initialize stream %u: %s\n"),
+                        (mfxU32)i,
+                        pParams->InputFiles[i].c_str());
+            return sts;
+        }
+
+        m_Streams.push_back(std::move(stream));
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CMultiStreamDecoder::PrintInfo() {
+    msdk_printf(MSDK_STRING("Multi-stream decoding: %u streams, ")
+                    MSDK_STRING("shared loader, device and allocator\n"),
+                (mfxU32)m_Streams.size());
+    if (!m_Streams.empty() && m_Streams[0]->Params.nMaxThreads) {
+        msdk_printf(MSDK_STRING("Library threads are capped at %u in total\n"),
+                    m_Streams[0]->Params.nMaxThreads);
+    }
+    for (auto& stream : m_Streams) {
+        msdk_printf(MSDK_STRING("\nStream %s\n"), stream->Params.strSrcFile);
+        stream->pPipeline->PrintInfo();
+    }
+}
+
+void CMultiStreamDecoder::RunStream(sStream& stream) {
+    mfxStatus sts = stream.pPipeline->RunDecoding();
+
+    if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts || MFX_ERR_DEVICE_LOST == sts ||
+        MFX_ERR_DEVICE_FAILED == sts) {
+        // Decoder reset reallocates frames of the shared allocator and device reset recreates
+        // the shared device, while the other streams keep decoding with them. So only this
+        // stream is stopped.
+        msdk_printf(MSDK_STRING("\nERROR: %s needs a reset which is not supported for ")
+                        MSDK_STRING("several inputs, stopping the stream.\n"),
+                    stream.Params.strSrcFile);
+    }
+
+    stream.Status = sts;
+}
+
+mfxStatus CMultiStreamDecoder::Run() {
+    CTimer timer;
+    timer.Start();
+
+    std::vector<std::thread> threads;
+    for (auto& stream : m_Streams)
+        threads.emplace_back(&CMultiStreamDecoder::RunStream, this, std::ref(*stream));
+    for (auto& thread : threads)
+        thread.join();
+
+    PrintStatistics(timer.GetTime());
+
+    for (auto& stream : m_Streams) {
+        if (MFX_ERR_NONE != stream->Status) {
+            msdk_printf(MSDK_STRING("error: decoding of %s failed with status %d\n"),
+                        stream->Params.strSrcFile,
+                        (int)stream->Status);
+            return stream->Status;
+        }
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CMultiStreamDecoder::PrintStatistics(mfxF64 wallTime) {
+    mfxU64 totalFrames = 0;
+    CLatencyHistogram allLatencies;
+
+    msdk_printf(MSDK_STRING("\n\nStream  frames  time, sec      fps  latency avg/max, ms  input\n"));
+    for (size_t i = 0; i < m_Streams.size(); i++) {
+        CDecodingPipeline& pipeline = *m_Streams[i]->pPipeline;
+
+        mfxF64 time = CTimer::ConvertToSeconds(pipeline.m_tick_overall);
+        mfxF64 fps  = time > 0 ? pipeline.m_output_count / time : 0.0;
+
+        const CLatencyHistogram& latencies = pipeline.GetLatencyHistogram();
+        allLatencies.Merge(latencies);
+
+        msdk_printf(MSDK_STRING("%6u  %6u  %9.3f  %7.2f  %8.2f/%-10.2f  %s\n"),
+                    (mfxU32)i,
+                    (mfxU32)pipeline.m_output_count,
+                    time,
+                    fps,
+                    latencies.GetAverage() / 1e6,
+                    latencies.GetMax() / 1e6,
+                    m_Streams[i]->Params.strSrcFile);
+        totalFrames += pipeline.m_output_count;
+    }
+
+    msdk_printf(MSDK_STRING("Aggregate: %llu frames in %.3f sec, %.2f fps\n"),
+                (unsigned long long)totalFrames,
+                wallTime,
+                wallTime > 0 ? totalFrames / wallTime : 0.0);
+
+    if (allLatencies.GetCount()) {
+        msdk_printf(MSDK_STRING("Aggregate latency, ms: p50 %.2f, p99 %.2f, max %.2f\n"),
+                    allLatencies.GetPercentile(50) / 1e6,
+                    allLatencies.GetPercentile(99) / 1e6,
+                    allLatencies.GetMax() / 1e6);
+    }
+}
+
+void CMultiStreamDecoder::Close() {
+    // the first pipeline owns shared resources and is closed last
+    while (!m_Streams.empty()) {
+        m_Streams.back()->pPipeline->Close();
+        m_Streams.pop_back();
+    }
+}
@@ -6,9 +6,11 @@
 
 #include "mfx_samples_config.h"
 
+#include <fstream>
 #include <regex>
 #include <sstream>
 #include "pipeline_decode.h"
+#include "pipeline_multi_decode.h"
 #include "version.h"
 
 #ifndef MFX_VERSION
@@ -51,6 +53,10 @@ void PrintHelp(msdk_char* strAppName, const msdk_char* strErrorMessage) {
     msdk_printf(MSDK_STRING(
         "   [-p plugin]               - DEPRECATED: decoder plugin. Supported values: hevcd_sw, hevcd_hw, vp8d_hw, vp9d_hw, camera_hw, capture_hw\n"));
     msdk_printf(MSDK_STRING("   [-fps]                    - limits overall fps of pipeline\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-fps_policy catchup|drop|rebase] - what to do with frames which are late for the -fps schedule:\n"));
+    msdk_printf(MSDK_STRING(
+        "                               release them at once until the schedule is caught up (default), skip the missed slots or restart the schedule\n"));
     msdk_printf(MSDK_STRING("   [-w]                      - output width\n"));
     msdk_printf(MSDK_STRING("   [-h]                      - output height\n"));
     msdk_printf(MSDK_STRING("   [-di bob/adi]             - enable deinterlacing BOB/ADI\n"));
@@ -87,6 +93,14 @@ void PrintHelp(msdk_char* strAppName, const msdk_char* strErrorMessage) {
 #endif
     msdk_printf(MSDK_STRING(
         "   [-disable_film_grain] - disable film grain application(valid only for av1)\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-hash file]              - write xxh64 hashes of output frames and planes to the file\n"));
+    msdk_printf(MSDK_STRING(
+        "                               instead of dumping YUV, -o is not required\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-hash_golden file]       - compare hashes of output frames with the golden hash log,\n"));
+    msdk_printf(MSDK_STRING(
+        "                               decoding fails on the first mismatch\n"));
     msdk_printf(MSDK_STRING("\n"));
     msdk_printf(MSDK_STRING("JPEG Chroma Type:\n"));
     msdk_printf(MSDK_STRING("   [-jpeg_rgb] - RGB Chroma Type\n"));
@@ -168,6 +182,14 @@ void PrintHelp(msdk_char* strAppName, const msdk_char* strErrorMessage) {
     msdk_printf(MSDK_STRING(
         "                        or perform VPP operation through separate pipeline component for unsupported streams\n"));
 
+    msdk_printf(MSDK_STRING(
+        "   [-i_list file]            - text file with one input stream per line; several inputs\n"));
+    msdk_printf(MSDK_STRING(
+        "                               (also given by repeated -i) are decoded concurrently\n"));
+    msdk_printf(MSDK_STRING(
+        "                               sharing one device, output is dumped to <-o file>.<N>\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-max_threads N]          - cap of library worker threads over all input streams\n"));
 #if !defined(_WIN32) && !defined(_WIN64)
     msdk_printf(MSDK_STRING("   [-threads_num]            - number of mediasdk task threads\n"));
     msdk_printf(
@@ -643,6 +665,16 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 return MFX_ERR_UNSUPPORTED;
             }
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-fps_policy"))) {
+            if (i + 1 >= nArgNum) {
+                PrintHelp(strInput[0], MSDK_STRING("Not enough parameters for -fps_policy key"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            if (MFX_ERR_NONE != StrToFPSLimiterPolicy(strInput[++i], pParams->fpsPolicy)) {
+                PrintHelp(strInput[0], MSDK_STRING("fps_policy is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-w"))) {
             if (i + 1 >= nArgNum) {
                 PrintHelp(strInput[0], MSDK_STRING("Not enough parameters for -w key"));
@@ -728,6 +760,55 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-disable_film_grain"))) {
             pParams->bDisableFilmGrain = true;
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-hash")) ||
+                 0 == msdk_strcmp(strInput[i], MSDK_STRING("-hash_golden"))) {
+            if (i + 1 >= nArgNum) {
+                PrintHelp(strInput[0], MSDK_STRING("Not enough parameters for -hash key"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            bool bGolden = (0 == msdk_strcmp(strInput[i], MSDK_STRING("-hash_golden")));
+            if (MFX_ERR_NONE !=
+                msdk_opt_read(strInput[++i],
+                              bGolden ? pParams->strGoldenHashFile : pParams->strHashFile)) {
+                PrintHelp(strInput[0], MSDK_STRING("hash file name is too long"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            // frames have to be mapped like in the dump mode
+            pParams->mode = MODE_FILE_DUMP;
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-i_list"))) {
+            if (i + 1 >= nArgNum) {
+                PrintHelp(strInput[0], MSDK_STRING("Not enough parameters for -i_list key"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            std::basic_ifstream<msdk_char> list(strInput[++i]);
+            if (!list) {
+                msdk_printf(MSDK_STRING("error: can't open input list %s\n"), strInput[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+            msdk_string line;
+            while (std::getline(list, line)) {
+                if (!line.empty() && line.back() == MSDK_CHAR('\r'))
+                    line.pop_back();
+                if (!line.empty())
+                    pParams->InputFiles.push_back(line);
+            }
+            if (pParams->InputFiles.empty()) {
+                msdk_printf(MSDK_STRING("error: input list %s is empty\n"), strInput[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+            msdk_opt_read(pParams->InputFiles[0], pParams->strSrcFile);
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-max_threads"))) {
+            if (i + 1 >= nArgNum) {
+                PrintHelp(strInput[0], MSDK_STRING("Not enough parameters for -max_threads key"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nMaxThreads)) {
+                PrintHelp(strInput[0], MSDK_STRING("max_threads is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         else // 1-character options
         {
             switch (strInput[i][1]) {
@@ -739,6 +820,7 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 case MSDK_CHAR('i'):
                     if (++i < nArgNum) {
                         msdk_opt_read(strInput[i], pParams->strSrcFile);
+                        pParams->InputFiles.push_back(strInput[i]);
                     }
                     else {
                         msdk_printf(MSDK_STRING("error: option '-i' expects an argument\n"));
@@ -771,7 +853,9 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         return MFX_ERR_UNSUPPORTED;
     }
 
-    if ((pParams->mode == MODE_FILE_DUMP) && (0 == msdk_strlen(pParams->strDstFile))) {
+    if ((pParams->mode == MODE_FILE_DUMP) && (0 == msdk_strlen(pParams->strDstFile)) &&
+        (0 == msdk_strlen(pParams->strHashFile)) &&
+        (0 == msdk_strlen(pParams->strGoldenHashFile))) {
         msdk_printf(MSDK_STRING("error: destination file name not found"));
         return MFX_ERR_UNSUPPORTED;
     }
@@ -821,6 +905,24 @@ int main(int argc, char* argv[])
         Params.fourcc  = MFX_FOURCC_I420;
         Params.outI420 = false;
     }
+
+    if (Params.InputFiles.size() > 1) {
+        CMultiStreamDecoder MultiDecoder;
+
+        sts = MultiDecoder.Init(&Params);
+        MSDK_CHECK_STATUS(sts, "MultiDecoder.Init failed");
+
+        MultiDecoder.PrintInfo();
+
+        msdk_printf(MSDK_STRING("Decoding started\n"));
+        sts = MultiDecoder.Run();
+        MultiDecoder.Close();
+        MSDK_CHECK_STATUS(sts, "MultiDecoder.Run failed");
+
+        msdk_printf(MSDK_STRING("\nDecoding finished\n"));
+        return 0;
+    }
+
     sts = Pipeline.Init(&Params);
     MSDK_CHECK_STATUS(sts, "Pipeline.Init failed");
 
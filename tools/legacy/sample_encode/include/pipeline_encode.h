@@ -27,7 +27,11 @@
 
 #include "plugin_utils.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "preset_manager.h"
@@ -179,9 +183,17 @@ struct sInputParams {
 
     mfxU32 nTimeout;
     mfxU16 nPerfOpt; // size of pre-load buffer which used for loop encode
-    mfxU16 nMaxFPS; // limits overall fps
+    mfxF64 nMaxFPS; // limits overall fps
+    FPSLimiterPolicy fpsPolicy; // what to do with frames which are late for the -fps schedule
+    bool bInputCache; // input is read from CSmplInputCache shared by all pipelines
 
     mfxU32 nSyncOpTimeout; // SyncOperation timeout in msec
+    bool bPipelinedOutput; // sync and write bitstreams in a separate thread
+
+    mfxU16 nSegmentSessions; // number of concurrent sessions in the segment encoding mode
+    mfxU32 nSegmentFrames; // number of frames in a segment, 0 - split input evenly
+    bool bSegmentBaseline; // measure single-session encoding for the speedup report
+    mfxU32 nFirstFrame; // index of the first input frame to encode
 
     mfxU16 nNumSlice;
     bool UseRegionEncode;
@@ -280,6 +292,42 @@ struct sTask {
     mfxStatus Close();
 };
 
+// Lock-free single-producer single-consumer queue of task indices
+class CTaskIndexQueue {
+public:
+    CTaskIndexQueue() : m_items(), m_head(0), m_tail(0) {}
+
+    void Init(mfxU32 capacity) {
+        m_items.assign(capacity + 1, 0);
+        m_head = m_tail = 0;
+    }
+    bool Push(mfxU32 index) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % m_items.size();
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+        m_items[tail] = index;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+    bool Pop(mfxU32& index) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        index = m_items[head];
+        m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+        return true;
+    }
+    bool Empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+protected:
+    std::vector<mfxU32> m_items;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+};
+
 class CEncTaskPool {
 public:
     CEncTaskPool();
@@ -295,12 +343,33 @@ public:
     virtual mfxStatus GetFreeTask(sTask** ppTask);
     virtual mfxStatus SynchronizeFirstTask(mfxU32 syncOpTimeout);
 
+    // Pipelined mode: tasks are synchronized and written by the completion thread in
+    // submission order, the caller only waits when all tasks of the pool are busy
+    virtual mfxStatus StartCompletionThread(mfxU32 syncOpTimeout);
+    bool IsPipelined() const {
+        return m_bPipelined;
+    }
+
     virtual CTimeStatistics& GetOverallStatistics() {
         return m_statOverall;
     }
     virtual CTimeStatistics& GetFileStatistics() {
         return m_statFile;
     }
+    // pipelined mode: time the caller waited for a free task, time the completion thread
+    // spent in sync points, writing bitstreams and waiting for new tasks
+    virtual CTimeStatisticsReal& GetWaitStatistics() {
+        return m_statWait;
+    }
+    virtual CTimeStatisticsReal& GetSyncStatistics() {
+        return m_statSync;
+    }
+    virtual CTimeStatisticsReal& GetWriteStatistics() {
+        return m_statWrite;
+    }
+    virtual CTimeStatisticsReal& GetIdleStatistics() {
+        return m_statIdle;
+    }
     virtual void Close();
     virtual void SetGpuHangRecoveryFlag();
     virtual void ClearTasks();
@@ -321,7 +390,35 @@ protected:
 
     CTimeStatistics m_statOverall;
     CTimeStatistics m_statFile;
+    // -pipelined_output only: the caller waiting for a completed task, and the completion thread
+    // in SyncOperation, writing bitstreams and waiting for submitted tasks
+    CTimeStatisticsReal m_statWait;
+    CTimeStatisticsReal m_statSync;
+    CTimeStatisticsReal m_statWrite;
+    CTimeStatisticsReal m_statIdle;
     virtual mfxU32 GetFreeTaskIndex();
+
+    // pipelined mode
+    void CompletionRoutine();
+    mfxStatus CompleteTask(sTask& task);
+    void SubmitPendingTask();
+    void StopCompletionThread();
+    void Notify(std::condition_variable& cv);
+
+    bool m_bPipelined;
+    mfxU32 m_nSyncOpTimeout;
+    // task handed out by GetFreeTask, submitted on the next call if it got a sync point
+    sTask* m_pPendingTask;
+    CTaskIndexQueue m_FreeTasks; // completion thread -> caller
+    CTaskIndexQueue m_SubmittedTasks; // caller -> completion thread
+    std::atomic<mfxU32> m_nTasksInFlight;
+    std::atomic<bool> m_bStopCompletion;
+    std::atomic<int> m_CompletionSts;
+    // used only to sleep while a queue is empty, queues themselves are lock-free
+    std::mutex m_WakeMutex;
+    std::condition_variable m_WakeCompletion;
+    std::condition_variable m_WakeCaller;
+    std::thread m_CompletionThread;
 };
 
 /* This class implements a pipeline with 2 mfx components: vpp (video preprocessing) and encode */
@@ -339,6 +436,13 @@ public:
     void SetNumView(mfxU32 numViews) {
         m_nNumView = numViews;
     }
+    // a loader set before Init is used as is, so several pipelines can share one
+    void SetLoader(const std::shared_ptr<VPLImplementationLoader>& pLoader) {
+        m_pLoader = pLoader;
+    }
+    std::shared_ptr<VPLImplementationLoader> GetLoader() {
+        return m_pLoader;
+    }
     virtual void PrintInfo();
 
     void InitV4L2Pipeline(sInputParams* pParams);
@@ -361,7 +465,7 @@ protected:
     CEncTaskPool m_TaskPool;
     QPFile::Reader m_QPFileReader;
 
-    std::unique_ptr<VPLImplementationLoader> m_pLoader;
+    std::shared_ptr<VPLImplementationLoader> m_pLoader;
     MainVideoSession m_mfxSession;
     MFXVideoENCODE* m_pmfxENC;
     MFXVideoVPP* m_pmfxVPP;
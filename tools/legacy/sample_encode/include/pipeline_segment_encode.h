@@ -0,0 +1,82 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __PIPELINE_SEGMENT_ENCODE_H__
+#define __PIPELINE_SEGMENT_ENCODE_H__
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "pipeline_encode.h"
+
+/* This class splits the input file into closed-GOP segments, encodes them in concurrent
+   sessions created from one loader and concatenates segment bitstreams into the output */
+class CSegmentEncoder {
+public:
+    CSegmentEncoder();
+    virtual ~CSegmentEncoder();
+
+    virtual mfxStatus Init(sInputParams* pParams);
+    virtual mfxStatus Run();
+    virtual void Close();
+    virtual void PrintInfo();
+
+protected:
+    struct sSegment {
+        mfxU32 nFirstFrame;
+        mfxU32 nFrames;
+        msdk_string strOutput; // temporary bitstream of the segment
+        mfxU32 nTargetKbps; // in the units of -b, i.e. divided by the bitrate multiplier
+        mfxU64 nBytes; // size of the encoded segment
+        mfxF64 dEncodeTime; // in seconds
+        bool bDone;
+
+        sSegment()
+                : nFirstFrame(0),
+                  nFrames(0),
+                  strOutput(),
+                  nTargetKbps(0),
+                  nBytes(0),
+                  dEncodeTime(0),
+                  bDone(false) {}
+    };
+
+    void WorkerRoutine();
+    mfxStatus EncodeSegment(sInputParams& params, sSegment& segment);
+    mfxU32 GetSegmentBitrate(size_t idx);
+    mfxStatus MergeSegments();
+    void RemoveSegmentFiles();
+
+    sInputParams m_Params;
+    std::vector<sSegment> m_Segments;
+    mfxU32 m_nTotalFrames;
+    mfxU32 m_nSessions;
+    bool m_bOutput;
+    bool m_bCarryBitrate; // adjust bitrate of next segments by the size of encoded ones
+    mfxF64 m_dFrameRate;
+    mfxF64 m_dWallTime;
+    mfxF64 m_dBaselineTime;
+    mfxU64 m_nBaselineBytes;
+
+    // segment workers initialize their pipelines under this mutex: the first one creates
+    // m_pLoader, the next ones create their sessions from it
+    std::mutex m_InitMutex;
+    std::shared_ptr<VPLImplementationLoader> m_pLoader;
+
+    // keeps cached input loaded while segment pipelines come and go
+    std::shared_ptr<const CSmplInputCache::FileData> m_pInputCache;
+
+    std::mutex m_Mutex;
+    size_t m_nNextSegment;
+    mfxStatus m_Status; // first error of any segment
+
+private:
+    CSegmentEncoder(const CSegmentEncoder&)            = delete;
+    CSegmentEncoder& operator=(const CSegmentEncoder&) = delete;
+};
+
+#endif // __PIPELINE_SEGMENT_ENCODE_H__
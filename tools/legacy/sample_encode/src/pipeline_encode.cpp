@@ -84,6 +84,12 @@ CEncTaskPool::CEncTaskPool()
     m_nTaskBufferStart = 0;
     m_nPoolSize        = 0;
     m_bGpuHangRecovery = false;
+    m_bPipelined       = false;
+    m_nSyncOpTimeout   = MSDK_WAIT_INTERVAL;
+    m_pPendingTask     = NULL;
+    m_nTasksInFlight   = 0;
+    m_bStopCompletion  = false;
+    m_CompletionSts    = MFX_ERR_NONE;
 }
 
 CEncTaskPool::~CEncTaskPool() {
@@ -141,11 +147,153 @@ mfxStatus CEncTaskPool::Init(MFXVideoSession* pmfxSession,
     return MFX_ERR_NONE;
 }
 
+mfxStatus CEncTaskPool::StartCompletionThread(mfxU32 syncOpTimeout) {
+    MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_NOT_INITIALIZED);
+    if (m_bPipelined)
+        return MFX_ERR_NONE;
+
+    m_FreeTasks.Init(m_nPoolSize);
+    m_SubmittedTasks.Init(m_nPoolSize);
+    // tasks have to go out in the same order as in the synchronous mode (MVC view output
+    // alternates writers between neighbour tasks)
+    for (mfxU32 i = 0; i < m_nPoolSize; i++)
+        m_FreeTasks.Push((m_nTaskBufferStart + i) % m_nPoolSize);
+
+    m_nSyncOpTimeout  = syncOpTimeout;
+    m_pPendingTask    = NULL;
+    m_nTasksInFlight  = 0;
+    m_bStopCompletion = false;
+    m_CompletionSts   = MFX_ERR_NONE;
+    m_bPipelined      = true;
+
+    m_CompletionThread = std::thread([this]() {
+        CompletionRoutine();
+    });
+
+    return MFX_ERR_NONE;
+}
+
+void CEncTaskPool::StopCompletionThread() {
+    if (!m_bPipelined)
+        return;
+
+    m_bStopCompletion = true;
+    Notify(m_WakeCompletion);
+    if (m_CompletionThread.joinable())
+        m_CompletionThread.join();
+
+    m_bPipelined   = false;
+    m_pPendingTask = NULL;
+}
+
+void CEncTaskPool::SubmitPendingTask() {
+    // a task without sync point wasn't used by the encoder and stays with the caller
+    if (!m_pPendingTask || !m_pPendingTask->EncSyncP)
+        return;
+
+    m_nTasksInFlight++;
+    m_SubmittedTasks.Push((mfxU32)(m_pPendingTask - m_pTasks));
+    m_pPendingTask = NULL;
+    Notify(m_WakeCompletion);
+}
+
+void CEncTaskPool::Notify(std::condition_variable& cv) {
+    // a waiter checks its condition under the mutex, so taking it here makes sure the
+    // waiter either sees the new state or is already waiting and gets the notification
+    {
+        std::lock_guard<std::mutex> lock(m_WakeMutex);
+    }
+    cv.notify_one();
+}
+
+mfxStatus CEncTaskPool::CompleteTask(sTask& task) {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    do {
+        m_statSync.StartTimeMeasurement();
+        sts = m_pmfxSession->SyncOperation(task.EncSyncP, m_nSyncOpTimeout);
+        m_statSync.StopTimeMeasurement();
+
+        if (MFX_ERR_NONE == sts || MFX_ERR_NONE_PARTIAL_OUTPUT == sts) {
+            m_statWrite.StartTimeMeasurement();
+            mfxStatus stsWrite = task.WriteBitstream(MFX_ERR_NONE == sts);
+            m_statWrite.StopTimeMeasurement();
+            MSDK_CHECK_STATUS(stsWrite, "task.WriteBitstream failed");
+        }
+        else if (MFX_ERR_ABORTED == sts) {
+            // check whether the error came from a VPP task to report it
+            for (auto syncp : task.DependentVppTasks) {
+                mfxStatus stsVpp = m_pmfxSession->SyncOperation(syncp, 0);
+                if (stsVpp < MFX_ERR_NONE) {
+                    sts = stsVpp;
+                    break;
+                }
+            }
+        }
+        // the thread has nothing else to do, so keep waiting after a timeout
+    } while (MFX_ERR_NONE_PARTIAL_OUTPUT == sts || MFX_WRN_IN_EXECUTION == sts);
+
+    MSDK_CHECK_STATUS(sts, "SyncOperation failed");
+    return task.Reset();
+}
+
+void CEncTaskPool::CompletionRoutine() {
+    for (;;) {
+        mfxU32 index = 0;
+
+        m_statIdle.StartTimeMeasurement();
+        while (!m_bStopCompletion && !m_SubmittedTasks.Pop(index)) {
+            std::unique_lock<std::mutex> lock(m_WakeMutex);
+            m_WakeCompletion.wait(lock, [this]() {
+                return m_bStopCompletion || !m_SubmittedTasks.Empty();
+            });
+        }
+        m_statIdle.StopTimeMeasurement();
+
+        if (m_bStopCompletion)
+            break;
+
+        mfxStatus sts = MFX_ERR_NONE;
+        if (MFX_ERR_NONE == m_CompletionSts) {
+            sts = CompleteTask(m_pTasks[index]);
+        }
+        else {
+            // after an error tasks are returned without output, the caller stops anyway
+            m_pTasks[index].Reset();
+        }
+        if (sts < MFX_ERR_NONE)
+            m_CompletionSts = sts;
+
+        m_FreeTasks.Push(index);
+        m_nTasksInFlight--;
+        Notify(m_WakeCaller);
+    }
+}
+
 mfxStatus CEncTaskPool::SynchronizeFirstTask(mfxU32 syncOpTimeout) {
-    m_statOverall.StartTimeMeasurement();
     MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_NOT_INITIALIZED);
     MSDK_CHECK_POINTER(m_pmfxSession, MFX_ERR_NOT_INITIALIZED);
 
+    if (m_bPipelined) {
+        m_statWait.StartTimeMeasurement();
+        SubmitPendingTask();
+
+        // wait for one more task to complete, or report that nothing is left
+        mfxU32 inFlight = m_nTasksInFlight;
+        if (inFlight) {
+            std::unique_lock<std::mutex> lock(m_WakeMutex);
+            m_WakeCaller.wait(lock, [this, inFlight]() {
+                return m_nTasksInFlight < inFlight || MFX_ERR_NONE != m_CompletionSts;
+            });
+        }
+        m_statWait.StopTimeMeasurement();
+
+        if (MFX_ERR_NONE != m_CompletionSts)
+            return (mfxStatus)m_CompletionSts.load();
+        return inFlight ? MFX_ERR_NONE : MFX_ERR_NOT_FOUND;
+    }
+
+    m_statOverall.StartTimeMeasurement();
     mfxStatus sts = MFX_ERR_NONE;
     bool bGpuHang = false;
 
@@ -257,6 +405,20 @@ mfxStatus CEncTaskPool::GetFreeTask(sTask** ppTask) {
     MSDK_CHECK_POINTER(ppTask, MFX_ERR_NULL_PTR);
     MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_NOT_INITIALIZED);
 
+    if (m_bPipelined) {
+        SubmitPendingTask();
+
+        if (!m_pPendingTask) {
+            mfxU32 index = 0;
+            if (!m_FreeTasks.Pop(index))
+                return MFX_ERR_NOT_FOUND;
+            m_pPendingTask = &m_pTasks[index];
+        }
+
+        *ppTask = m_pPendingTask;
+        return MFX_ERR_NONE;
+    }
+
     mfxU32 index = GetFreeTaskIndex();
 
     if (index >= m_nPoolSize) {
@@ -270,6 +432,8 @@ mfxStatus CEncTaskPool::GetFreeTask(sTask** ppTask) {
 }
 
 void CEncTaskPool::Close() {
+    StopCompletionThread();
+
     if (m_pTasks) {
         for (mfxU32 i = 0; i < m_nPoolSize; i++) {
             m_pTasks[i].Close();
@@ -288,10 +452,16 @@ void CEncTaskPool::SetGpuHangRecoveryFlag() {
 }
 
 void CEncTaskPool::ClearTasks() {
+    bool bPipelined = m_bPipelined;
+    StopCompletionThread();
+
     for (size_t i = 0; i < m_nPoolSize; i++) {
         m_pTasks[i].Reset();
     }
     m_nTaskBufferStart = 0;
+
+    if (bPipelined)
+        StartCompletionThread(m_nSyncOpTimeout);
 }
 
 mfxStatus sTask::Init(mfxU32 nBufferSize, mfxU32 nCodecID, void* pwriter, bool bHWLib) {
@@ -1386,7 +1556,11 @@ mfxStatus CEncodingPipeline::InitFileWriters(sInputParams* pParams) {
 
 mfxStatus CEncodingPipeline::Init(sInputParams* pParams) {
     MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
-    m_pLoader.reset(new VPLImplementationLoader);
+
+    // shared loader is already configured by the pipeline which created it
+    bool bSharedLoader = !!m_pLoader;
+    if (!bSharedLoader)
+        m_pLoader.reset(new VPLImplementationLoader);
 
 #if defined ENABLE_V4L2_SUPPORT
     isV4L2InputEnabled = pParams->isV4L2InputEnabled;
@@ -1420,28 +1594,30 @@ mfxStatus CEncodingPipeline::Init(sInputParams* pParams) {
 
     initPar.Implementation = pParams->bUseHWLib ? MFX_IMPL_HARDWARE : MFX_IMPL_SOFTWARE;
 
-    if (pParams->dGfxIdx >= 0)
-        m_pLoader->SetDiscreteAdapterIndex(pParams->dGfxIdx);
-    else
-        m_pLoader->SetAdapterType(pParams->adapterType);
+    if (!bSharedLoader) {
+        if (pParams->dGfxIdx >= 0)
+            m_pLoader->SetDiscreteAdapterIndex(pParams->dGfxIdx);
+        else
+            m_pLoader->SetAdapterType(pParams->adapterType);
 
-    if (pParams->adapterNum >= 0)
-        m_pLoader->SetAdapterNum(pParams->adapterNum);
+        if (pParams->adapterNum >= 0)
+            m_pLoader->SetAdapterNum(pParams->adapterNum);
 
 #ifdef ONEVPL_EXPERIMENTAL
-    if (pParams->PCIDeviceSetup)
-        m_pLoader->SetPCIDevice(pParams->PCIDomain,
-                                pParams->PCIBus,
-                                pParams->PCIDevice,
-                                pParams->PCIFunction);
+        if (pParams->PCIDeviceSetup)
+            m_pLoader->SetPCIDevice(pParams->PCIDomain,
+                                    pParams->PCIBus,
+                                    pParams->PCIDevice,
+                                    pParams->PCIFunction);
 
     #if (defined(_WIN64) || defined(_WIN32))
-    if (pParams->luid.HighPart > 0 || pParams->luid.LowPart > 0)
-        m_pLoader->SetupLUID(pParams->luid);
+        if (pParams->luid.HighPart > 0 || pParams->luid.LowPart > 0)
+            m_pLoader->SetupLUID(pParams->luid);
     #else
-    m_pLoader->SetupDRMRenderNodeNum(pParams->DRMRenderNodeNum);
+        m_pLoader->SetupDRMRenderNodeNum(pParams->DRMRenderNodeNum);
     #endif
 #endif
+    }
 
     if (!pParams->accelerationMode && pParams->bUseHWLib) {
 #if D3D_SURFACES_SUPPORT
@@ -1453,10 +1629,13 @@ mfxStatus CEncodingPipeline::Init(sInputParams* pParams) {
 
     bool bLowLatencyMode = !pParams->dispFullSearch;
 
-    mfxStatus sts = m_pLoader->ConfigureAndEnumImplementations(initPar.Implementation,
-                                                               pParams->accelerationMode,
-                                                               bLowLatencyMode);
-    MSDK_CHECK_STATUS(sts, "m_mfxSession.EnumImplementations failed");
+    mfxStatus sts = MFX_ERR_NONE;
+    if (!bSharedLoader) {
+        sts = m_pLoader->ConfigureAndEnumImplementations(initPar.Implementation,
+                                                         pParams->accelerationMode,
+                                                         bLowLatencyMode);
+        MSDK_CHECK_STATUS(sts, "m_mfxSession.EnumImplementations failed");
+    }
 
     sts = m_mfxSession.CreateSession(m_pLoader.get());
     MSDK_CHECK_STATUS(sts, "m_mfxSession.CreateSession failed");
@@ -1560,8 +1739,17 @@ mfxStatus CEncodingPipeline::Init(sInputParams* pParams) {
     // Preparing readers and writers
     if (!isV4L2InputEnabled) {
         // prepare input file reader
+        m_FileReader.SetUseInputCache(pParams->bInputCache);
         sts = m_FileReader.Init(pParams->InputFiles, pParams->FileInputFourCC, readerShift);
         MSDK_CHECK_STATUS(sts, "m_FileReader.Init failed");
+
+        if (pParams->nFirstFrame) {
+            sts = m_FileReader.SkipNframesFromBeginning(pParams->nWidth,
+                                                        pParams->nHeight,
+                                                        0,
+                                                        pParams->nFirstFrame);
+            MSDK_CHECK_STATUS(sts, "m_FileReader.SkipNframesFromBeginning failed");
+        }
     }
 
     sts = InitFileWriters(pParams);
@@ -1570,7 +1758,7 @@ mfxStatus CEncodingPipeline::Init(sInputParams* pParams) {
     // set memory type
     m_memType  = pParams->memType;
     m_nPerfOpt = pParams->nPerfOpt;
-    m_fpsLimiter.Reset(pParams->nMaxFPS);
+    m_fpsLimiter.Reset(pParams->nMaxFPS, pParams->fpsPolicy);
 
     m_bSoftRobustFlag = pParams->bSoftRobustFlag;
 
@@ -1710,6 +1898,18 @@ void CEncodingPipeline::Close() {
         msdk_printf(MSDK_STRING("Encoding fps: %.0f\n"),
                     m_FileWriters.first->m_nProcessedFramesNum / ProcDeltaTime);
 
+        if (m_TaskPool.IsPipelined()) {
+            msdk_printf(MSDK_STRING("Completion thread: sync %.3f sec, write %.3f sec, ")
+                            MSDK_STRING("idle %.3f sec; main thread waited %.3f sec\n"),
+                        m_TaskPool.GetSyncStatistics().GetTotalTime(),
+                        m_TaskPool.GetWriteStatistics().GetTotalTime(),
+                        m_TaskPool.GetIdleStatistics().GetTotalTime(),
+                        m_TaskPool.GetWaitStatistics().GetTotalTime());
+            m_TaskPool.GetSyncStatistics().PrintPercentiles(MSDK_STRING("SyncOperation time:"));
+            m_TaskPool.GetWaitStatistics().PrintPercentiles(MSDK_STRING("Task wait time:"));
+            m_TaskPool.GetWriteStatistics().PrintPercentiles(MSDK_STRING("Bitstream write time:"));
+        }
+
         if (m_bPartialOutput) {
             const msdk_tick freq = time_get_frequency();
 
@@ -1720,6 +1920,8 @@ void CEncodingPipeline::Close() {
                         (1000.0 * m_TaskPool.lastOut_total) /
                             (freq * m_FileWriters.first->m_nProcessedFramesNum));
         }
+
+        m_fpsLimiter.PrintStatistics();
     }
 
     std::for_each(m_UserDataUnregSEI.begin(), m_UserDataUnregSEI.end(), [](mfxPayload* payload) {
@@ -1868,6 +2070,11 @@ mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams) {
     if (m_bSoftRobustFlag)
         m_TaskPool.SetGpuHangRecoveryFlag();
 
+    if (pParams->bPipelinedOutput) {
+        sts = m_TaskPool.StartCompletionThread(m_nSyncOpTimeout);
+        MSDK_CHECK_STATUS(sts, "m_TaskPool.StartCompletionThread failed");
+    }
+
     sts = FillBuffers();
     MSDK_CHECK_STATUS(sts, "FillBuffers failed");
 
@@ -1941,6 +2148,13 @@ mfxStatus CEncodingPipeline::GetFreeTask(sTask** ppTask) {
     mfxStatus sts = MFX_ERR_NONE;
 
     if (m_bFileWriterReset) {
+        // writers are used by the completion thread, finish the previous loop first
+        while (m_TaskPool.IsPipelined() && MFX_ERR_NONE == sts) {
+            sts = m_TaskPool.SynchronizeFirstTask(m_nSyncOpTimeout);
+        }
+        MSDK_IGNORE_MFX_STS(sts, MFX_ERR_NOT_FOUND);
+        MSDK_CHECK_STATUS(sts, "m_TaskPool.SynchronizeFirstTask failed");
+
         if (m_FileWriters.first) {
             sts = m_FileWriters.first->Reset();
             MSDK_CHECK_STATUS(sts, "m_FileWriters.first->Reset failed");
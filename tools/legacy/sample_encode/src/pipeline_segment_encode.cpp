@@ -0,0 +1,468 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "mfx_samples_config.h"
+
+#include "pipeline_segment_encode.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <thread>
+
+#ifndef MFX_VERSION
+    #error MFX_VERSION not defined
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+    #define MSDK_REMOVE_FILE _tremove
+#else
+    #define MSDK_REMOVE_FILE remove
+#endif
+
+// IVF file and frame headers, see CIVFFrameWriter
+static const mfxU32 IVFFileHeaderSize    = 32;
+static const mfxU32 IVFFrameHeaderSize   = 12;
+static const mfxU32 IVFFrameCountOffset  = 24;
+static const size_t SegmentCopyChunkSize = 1 << 20;
+
+static mfxU32 ReadLE32(const mfxU8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((mfxU32)p[3] << 24);
+}
+
+static void WriteLE32(mfxU8* p, mfxU32 val) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (mfxU8)(val >> (8 * i));
+}
+
+static mfxU64 GetStreamFileSize(const msdk_char* strFileName) {
+    FILE* f = NULL;
+    MSDK_FOPEN(f, strFileName, MSDK_STRING("rb"));
+    if (!f)
+        return 0;
+
+    mfxI64 size = 0;
+    if (0 == MSDK_FSEEK64(f, 0, SEEK_END))
+        size = MSDK_FTELL64(f);
+    fclose(f);
+
+    return size > 0 ? (mfxU64)size : 0;
+}
+
+static bool CopyFileData(FILE* dst, FILE* src, mfxU64 size, std::vector<mfxU8>& buf) {
+    while (size) {
+        size_t chunk = (size_t)std::min<mfxU64>(size, buf.size());
+        if (fread(buf.data(), 1, chunk, src) != chunk || fwrite(buf.data(), 1, chunk, dst) != chunk)
+            return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+CSegmentEncoder::CSegmentEncoder()
+        : m_Params(),
+          m_Segments(),
+          m_nTotalFrames(0),
+          m_nSessions(0),
+          m_bOutput(false),
+          m_bCarryBitrate(false),
+          m_dFrameRate(0),
+          m_dWallTime(0),
+          m_dBaselineTime(0),
+          m_nBaselineBytes(0),
+          m_InitMutex(),
+          m_pLoader(),
+          m_pInputCache(),
+          m_Mutex(),
+          m_nNextSegment(0),
+          m_Status(MFX_ERR_NONE) {}
+
+CSegmentEncoder::~CSegmentEncoder() {
+    Close();
+}
+
+mfxStatus CSegmentEncoder::Init(sInputParams* pParams) {
+    MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
+
+    if (pParams->MVC_flags || pParams->InputFiles.size() != 1 || pParams->nPerfOpt ||
+        pParams->nTimeout || pParams->QPFileMode || pParams->isV4L2InputEnabled ||
+        pParams->UseRegionEncode || pParams->nRotationAngle) {
+        msdk_printf(MSDK_STRING(
+            "error: segment encoding supports a single input file without MVC, -perf_opt, -timeout, -qpfile, V4L2, region encoding and rotation\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    mfxU32 frameLength = 0;
+    mfxStatus sts =
+        GetFrameLength(pParams->nWidth, pParams->nHeight, pParams->FileInputFourCC, frameLength);
+    if (MFX_ERR_NONE != sts || !frameLength) {
+        msdk_printf(MSDK_STRING("error: input color format %s is unsupported in segment mode\n"),
+                    ColorFormatToStr(pParams->FileInputFourCC));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    m_nTotalFrames =
+        (mfxU32)(GetStreamFileSize(pParams->InputFiles.front().c_str()) / (mfxU64)frameLength);
+    if (pParams->nNumFrames && pParams->nNumFrames < m_nTotalFrames)
+        m_nTotalFrames = pParams->nNumFrames;
+    if (!m_nTotalFrames) {
+        msdk_printf(MSDK_STRING("error: input file is empty or can't be opened\n"));
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    m_dFrameRate = pParams->dFrameRate > 0 ? pParams->dFrameRate : 30.0;
+
+    /* segment borders are aligned to GOPs, so every segment starts with a closed GOP. Without
+       -g the encoder picks its own GOP size, so one second of frames is set explicitly */
+    mfxU32 gopSize = pParams->nGopPicSize;
+    if (!gopSize)
+        gopSize = std::min<mfxU32>(std::max<mfxU32>((mfxU32)(m_dFrameRate + 0.5), 1), 0xFFFF);
+    mfxU32 nSessions = pParams->nSegmentSessions;
+    mfxU32 segFrames = pParams->nSegmentFrames ? pParams->nSegmentFrames
+                                               : (m_nTotalFrames + nSessions - 1) / nSessions;
+    segFrames        = (segFrames + gopSize - 1) / gopSize * gopSize;
+
+    m_Params                  = *pParams;
+    m_Params.nSegmentSessions = 0;
+    m_Params.nGopPicSize      = (mfxU16)gopSize;
+
+    m_Params.GopOptFlag |= MFX_GOP_CLOSED;
+
+    m_bOutput = !pParams->dstFileBuff.empty();
+
+    // constant bitrate modes keep their HRD buffer, so only average targets are carried
+    m_bCarryBitrate = m_bOutput && pParams->nBitRate &&
+                      (pParams->nRateControlMethod == MFX_RATECONTROL_VBR ||
+                       pParams->nRateControlMethod == MFX_RATECONTROL_AVBR ||
+                       pParams->nRateControlMethod == MFX_RATECONTROL_QVBR ||
+                       pParams->nRateControlMethod == MFX_RATECONTROL_LA);
+
+    m_Segments.clear();
+    for (mfxU32 first = 0; first < m_nTotalFrames; first += segFrames) {
+        sSegment segment;
+        segment.nFirstFrame = first;
+        segment.nFrames     = std::min(segFrames, m_nTotalFrames - first);
+        if (m_bOutput) {
+            std::string idx = std::to_string(m_Segments.size());
+            segment.strOutput =
+                msdk_string(pParams->dstFileBuff[0]) + MSDK_STRING(".seg") +
+                msdk_string(idx.begin(), idx.end());
+        }
+        m_Segments.push_back(segment);
+    }
+    m_nSessions = std::min<mfxU32>(nSessions, (mfxU32)m_Segments.size());
+
+    if (pParams->bInputCache) {
+        sts = CSmplInputCache::GetFile(pParams->InputFiles.front(), m_pInputCache);
+        MSDK_CHECK_STATUS(sts, "CSmplInputCache::GetFile failed");
+    }
+
+    m_nNextSegment = 0;
+    m_Status       = MFX_ERR_NONE;
+
+    return MFX_ERR_NONE;
+}
+
+void CSegmentEncoder::PrintInfo() {
+    msdk_printf(MSDK_STRING("Segment encoding: %u frames in %u segments of up to %u frames, ")
+                    MSDK_STRING("GOP size %u, %u concurrent sessions\n"),
+                m_nTotalFrames,
+                (mfxU32)m_Segments.size(),
+                m_Segments.empty() ? 0 : m_Segments[0].nFrames,
+                (mfxU32)m_Params.nGopPicSize,
+                m_nSessions);
+    if (m_bCarryBitrate)
+        msdk_printf(MSDK_STRING("Segment bitrate is corrected by the size of encoded segments\n"));
+}
+
+mfxU32 CSegmentEncoder::GetSegmentBitrate(size_t idx) {
+    mfxU32 baseKbps = m_Params.nBitRate;
+    if (!m_bCarryBitrate)
+        return baseKbps;
+
+    // bits spent over the target by finished segments are taken from the segments which
+    // haven't started yet, running segments are expected to hit their own target
+    mfxF64 multiplier  = 1000.0 * std::max<mfxU16>(m_Params.nBitRateMultiplier, 1);
+    mfxF64 overspent   = 0;
+    mfxU32 nFramesLeft = 0;
+    for (size_t i = 0; i < m_Segments.size(); i++) {
+        const sSegment& seg = m_Segments[i];
+        if (seg.bDone) {
+            mfxF64 targetBits = seg.nTargetKbps * multiplier * seg.nFrames / m_dFrameRate;
+            overspent += seg.nBytes * 8.0 - targetBits;
+        }
+        else if (i >= idx) {
+            nFramesLeft += seg.nFrames;
+        }
+    }
+    if (!nFramesLeft)
+        return baseKbps;
+
+    mfxF64 kbps = baseKbps - overspent * m_dFrameRate / nFramesLeft / multiplier;
+
+    // keep the correction moderate, a single segment can't fix the whole stream
+    kbps = std::max(kbps, baseKbps * 0.5);
+    kbps = std::min(kbps, baseKbps * 1.5);
+    if (m_Params.MaxKbps && m_Params.nRateControlMethod == MFX_RATECONTROL_VBR)
+        kbps = std::min<mfxF64>(kbps, m_Params.MaxKbps);
+    kbps = std::min<mfxF64>(kbps, std::numeric_limits<mfxU16>::max());
+
+    return (mfxU32)(kbps + 0.5);
+}
+
+mfxStatus CSegmentEncoder::EncodeSegment(sInputParams& params, sSegment& segment) {
+    std::unique_ptr<CEncodingPipeline> pPipeline(new CEncodingPipeline);
+    MSDK_CHECK_POINTER(pPipeline.get(), MFX_ERR_MEMORY_ALLOC);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    {
+        std::lock_guard<std::mutex> lock(m_InitMutex);
+        if (m_pLoader)
+            pPipeline->SetLoader(m_pLoader);
+
+        sts = pPipeline->Init(&params);
+        if (!m_pLoader)
+            m_pLoader = pPipeline->GetLoader();
+    }
+    MSDK_CHECK_STATUS(sts, "pPipeline->Init failed");
+
+    msdk_tick startTick = time_get_tick();
+    for (;;) {
+        sts = pPipeline->Run();
+
+        if (MFX_ERR_DEVICE_LOST == sts || MFX_ERR_DEVICE_FAILED == sts) {
+            msdk_printf(MSDK_STRING(
+                "\nERROR: Hardware device was lost or returned an unexpected error. Recovering...\n"));
+            sts = pPipeline->ResetDevice();
+            MSDK_CHECK_STATUS(sts, "pPipeline->ResetDevice failed");
+
+            sts = pPipeline->ResetMFXComponents(&params);
+            MSDK_CHECK_STATUS(sts, "pPipeline->ResetMFXComponents failed");
+            continue;
+        }
+        break;
+    }
+    MSDK_CHECK_STATUS(sts, "pPipeline->Run failed");
+
+    // closing flushes the writer, the size of the segment is known after that
+    pPipeline->Close();
+    segment.dEncodeTime = (mfxF64)(time_get_tick() - startTick) / time_get_frequency();
+    if (!segment.strOutput.empty())
+        segment.nBytes = GetStreamFileSize(segment.strOutput.c_str());
+
+    return MFX_ERR_NONE;
+}
+
+void CSegmentEncoder::WorkerRoutine() {
+    for (;;) {
+        sInputParams params;
+        size_t idx = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (MFX_ERR_NONE != m_Status || m_nNextSegment == m_Segments.size())
+                return;
+
+            idx               = m_nNextSegment++;
+            sSegment& segment = m_Segments[idx];
+
+            segment.nTargetKbps = GetSegmentBitrate(idx);
+
+            params             = m_Params;
+            params.nFirstFrame = segment.nFirstFrame;
+            params.nNumFrames  = segment.nFrames;
+            params.nBitRate    = segment.nTargetKbps;
+            params.dstFileBuff.clear();
+            if (m_bOutput)
+                params.dstFileBuff.push_back((msdk_char*)segment.strOutput.c_str());
+        }
+
+        // the segment is encoded without the lock, results are stored when it finishes
+        sSegment result = m_Segments[idx];
+        mfxStatus sts   = EncodeSegment(params, result);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Segments[idx].nBytes      = result.nBytes;
+        m_Segments[idx].dEncodeTime = result.dEncodeTime;
+        m_Segments[idx].bDone       = true;
+        if (MFX_ERR_NONE != sts && MFX_ERR_NONE == m_Status) {
+            msdk_printf(MSDK_STRING("error: segment %u failed with status %d\n"),
+                        (mfxU32)idx,
+                        (int)sts);
+            m_Status = sts;
+        }
+    }
+}
+
+mfxStatus CSegmentEncoder::Run() {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    if (m_Params.bSegmentBaseline) {
+        // the whole input in a single session, written to its own file like the segments are
+        msdk_printf(MSDK_STRING("Encoding the single-session baseline\n"));
+        sInputParams params = m_Params;
+        params.nNumFrames   = m_nTotalFrames;
+        params.dstFileBuff.clear();
+
+        sSegment baseline;
+        if (m_bOutput) {
+            baseline.strOutput = msdk_string(m_Params.dstFileBuff[0]) + MSDK_STRING(".baseline");
+            params.dstFileBuff.push_back((msdk_char*)baseline.strOutput.c_str());
+        }
+        sts = EncodeSegment(params, baseline);
+        MSDK_CHECK_STATUS(sts, "EncodeSegment failed for the baseline");
+        m_dBaselineTime  = baseline.dEncodeTime;
+        m_nBaselineBytes = baseline.nBytes;
+        if (m_bOutput) {
+            msdk_printf(MSDK_STRING("Single-session output is kept in %s\n"),
+                        baseline.strOutput.c_str());
+        }
+    }
+
+    msdk_tick startTick = time_get_tick();
+
+    std::vector<std::thread> workers;
+    for (mfxU32 i = 0; i < m_nSessions; i++)
+        workers.emplace_back(&CSegmentEncoder::WorkerRoutine, this);
+    for (auto& worker : workers)
+        worker.join();
+
+    sts = m_Status;
+    if (MFX_ERR_NONE == sts && m_bOutput)
+        sts = MergeSegments();
+    // segment bitstreams are temporary whatever the result is
+    RemoveSegmentFiles();
+    MSDK_CHECK_STATUS(sts, "Segment encoding failed");
+
+    m_dWallTime = (mfxF64)(time_get_tick() - startTick) / time_get_frequency();
+
+    mfxF64 sessionTime = 0;
+    msdk_printf(MSDK_STRING("\nSegment  first frame  frames  target kbps  bytes  time, sec\n"));
+    for (size_t i = 0; i < m_Segments.size(); i++) {
+        const sSegment& seg = m_Segments[i];
+        msdk_printf(MSDK_STRING("%7u  %11u  %6u  %11u  %5llu  %9.3f\n"),
+                    (mfxU32)i,
+                    seg.nFirstFrame,
+                    seg.nFrames,
+                    seg.nTargetKbps,
+                    (unsigned long long)seg.nBytes,
+                    seg.dEncodeTime);
+        sessionTime += seg.dEncodeTime;
+    }
+
+    msdk_printf(MSDK_STRING("Segment encoding: %.3f sec, %.2f fps\n"),
+                m_dWallTime,
+                m_dWallTime > 0 ? m_nTotalFrames / m_dWallTime : 0.0);
+    if (m_dBaselineTime > 0 && m_dWallTime > 0) {
+        msdk_printf(MSDK_STRING("Single session: %.3f sec, %.2f fps, speedup %.2fx\n"),
+                    m_dBaselineTime,
+                    m_nTotalFrames / m_dBaselineTime,
+                    m_dBaselineTime / m_dWallTime);
+        if (m_bOutput) {
+            mfxU64 segmentBytes = 0;
+            for (const auto& seg : m_Segments)
+                segmentBytes += seg.nBytes;
+            msdk_printf(MSDK_STRING("Output size: %llu bytes in segments, ")
+                            MSDK_STRING("%llu in single session\n"),
+                        (unsigned long long)segmentBytes,
+                        (unsigned long long)m_nBaselineBytes);
+        }
+    }
+    else if (m_dWallTime > 0) {
+        // sessions slow each other down, so this is an upper estimate
+        msdk_printf(MSDK_STRING("Sum of segment times: %.3f sec, estimated speedup %.2fx ")
+                        MSDK_STRING("(use -segments_baseline to measure)\n"),
+                    sessionTime,
+                    sessionTime / m_dWallTime);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CSegmentEncoder::MergeSegments() {
+    FILE* dst = NULL;
+    MSDK_FOPEN(dst, m_Params.dstFileBuff[0], MSDK_STRING("wb"));
+    MSDK_CHECK_POINTER(dst, MFX_ERR_NULL_PTR);
+
+    std::vector<mfxU8> buf(SegmentCopyChunkSize);
+    mfxU8 ivfHeader[IVFFileHeaderSize] = {};
+    mfxU8 frameHeader[IVFFrameHeaderSize];
+    bool bIVF         = false;
+    mfxU64 nIVFFrames = 0;
+    mfxStatus sts     = MFX_ERR_NONE;
+
+    for (size_t i = 0; i < m_Segments.size() && MFX_ERR_NONE == sts; i++) {
+        FILE* src = NULL;
+        MSDK_FOPEN(src, m_Segments[i].strOutput.c_str(), MSDK_STRING("rb"));
+        if (!src) {
+            sts = MFX_ERR_NOT_FOUND;
+            break;
+        }
+
+        mfxU64 size = m_Segments[i].nBytes;
+        if (0 == i) {
+            // AV1 and VP9 encoders write IVF headers into the bitstream themselves
+            bIVF = size >= IVFFileHeaderSize &&
+                   fread(ivfHeader, 1, IVFFileHeaderSize, src) == IVFFileHeaderSize &&
+                   ReadLE32(ivfHeader) == MFX_MAKEFOURCC('D', 'K', 'I', 'F');
+            fseek(src, 0, SEEK_SET);
+            if (bIVF && fwrite(ivfHeader, 1, IVFFileHeaderSize, dst) != IVFFileHeaderSize)
+                sts = MFX_ERR_UNDEFINED_BEHAVIOR;
+        }
+
+        if (!bIVF) {
+            // Annex-B streams of closed GOPs starting with IDR are simply concatenated
+            if (!CopyFileData(dst, src, size, buf))
+                sts = MFX_ERR_UNDEFINED_BEHAVIOR;
+        }
+        else {
+            // drop the file header of every segment and renumber frame timestamps
+            mfxU8 header[IVFFileHeaderSize];
+            mfxU32 headerLen = IVFFileHeaderSize;
+            if (fread(header, 1, IVFFileHeaderSize, src) == IVFFileHeaderSize)
+                headerLen = std::max<mfxU32>(header[6] | (header[7] << 8), IVFFileHeaderSize);
+            MSDK_FSEEK64(src, headerLen, SEEK_SET);
+
+            while (MFX_ERR_NONE == sts &&
+                   fread(frameHeader, 1, IVFFrameHeaderSize, src) == IVFFrameHeaderSize) {
+                mfxU32 frameSize = ReadLE32(frameHeader);
+                WriteLE32(frameHeader + 4, (mfxU32)(nIVFFrames & 0xFFFFFFFF));
+                WriteLE32(frameHeader + 8, (mfxU32)(nIVFFrames >> 32));
+                nIVFFrames++;
+
+                if (fwrite(frameHeader, 1, IVFFrameHeaderSize, dst) != IVFFrameHeaderSize ||
+                    !CopyFileData(dst, src, frameSize, buf))
+                    sts = MFX_ERR_UNDEFINED_BEHAVIOR;
+            }
+        }
+        fclose(src);
+    }
+
+    if (MFX_ERR_NONE == sts && bIVF) {
+        mfxU8 frameCount[4];
+        WriteLE32(frameCount, (mfxU32)nIVFFrames);
+        fseek(dst, IVFFrameCountOffset, SEEK_SET);
+        fwrite(frameCount, 1, sizeof(frameCount), dst);
+    }
+    fclose(dst);
+    MSDK_CHECK_STATUS(sts, "Failed to concatenate segment bitstreams");
+
+    return MFX_ERR_NONE;
+}
+
+void CSegmentEncoder::RemoveSegmentFiles() {
+    for (auto& segment : m_Segments) {
+        if (!segment.strOutput.empty())
+            MSDK_REMOVE_FILE(segment.strOutput.c_str());
+    }
+}
+
+void CSegmentEncoder::Close() {
+    // nothing is left behind if Run failed or wasn't called
+    RemoveSegmentFiles();
+    m_Segments.clear();
+    m_pLoader.reset();
+    m_pInputCache.reset();
+}
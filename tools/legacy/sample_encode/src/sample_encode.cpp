@@ -13,6 +13,7 @@
 #include <string>
 #include "pipeline_encode.h"
 #include "pipeline_region_encode.h"
+#include "pipeline_segment_encode.h"
 #include "pipeline_user.h"
 #include "version.h"
 
@@ -158,6 +159,18 @@ void PrintHelp(msdk_char* strAppName, const msdk_char* strErrorMessage, ...) {
     msdk_printf(MSDK_STRING("   [-gpucopy::<on,off>] Enable or disable GPU copy mode\n"));
     msdk_printf(
         MSDK_STRING("   [-robust:soft]           - Recovery from GPU hang by inserting an IDR\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-pipelined_output]      - sync and write bitstreams in a separate thread to keep the async depth full\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-segments N]            - split input into closed-GOP segments encoded in N concurrent sessions\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-segment_len N]         - frames per segment, rounded up to GOP size. default is input length / N\n"));
+    msdk_printf(MSDK_STRING(
+        "                              GOP size is -g, or one second of frames if it isn't set\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-segments_baseline]     - encode in a single session first to report the measured speedup\n"));
+    msdk_printf(MSDK_STRING(
+        "                              its output is written to <output>.baseline\n"));
     msdk_printf(MSDK_STRING("   [-vbr]                   - variable bitrate control\n"));
     msdk_printf(MSDK_STRING("   [-cbr]                   - constant bitrate control\n"));
     msdk_printf(MSDK_STRING(
@@ -271,7 +284,13 @@ void PrintHelp(msdk_char* strAppName, const msdk_char* strErrorMessage, ...) {
         MSDK_STRING("   [-syncop_timeout]        - SyncOperation timeout in milliseconds\n"));
     msdk_printf(MSDK_STRING(
         "   [-perf_opt n]            - sets number of prefetched frames. In performance mode app preallocates buffer and loads first n frames\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-input_cache]           - load input files into memory once and share them between all encoding sessions of the process\n"));
     msdk_printf(MSDK_STRING("   [-fps]                   - limits overall fps of pipeline\n"));
+    msdk_printf(MSDK_STRING(
+        "   [-fps_policy catchup|drop|rebase] - what to do with frames which are late for the -fps schedule:\n"));
+    msdk_printf(MSDK_STRING(
+        "                              release them at once until the schedule is caught up (default), skip the missed slots or restart the schedule\n"));
     msdk_printf(MSDK_STRING(
         "   [-uncut]                 - do not cut output file in looped mode (in case of -timeout option)\n"));
     msdk_printf(MSDK_STRING(
@@ -579,6 +598,14 @@ mfxStatus ParseAdditionalParams(msdk_char* strInput[],
             return MFX_ERR_UNSUPPORTED;
         }
     }
+    else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-fps_policy"))) {
+        VAL_CHECK(i + 1 >= nArgNum, i, strInput[i]);
+
+        if (MFX_ERR_NONE != StrToFPSLimiterPolicy(strInput[++i], pParams->fpsPolicy)) {
+            PrintHelp(strInput[0], MSDK_STRING("fps_policy is invalid"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+    }
     else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-TargetBitDepthLuma"))) {
         VAL_CHECK(i + 1 >= nArgNum, i, strInput[i]);
 
@@ -1207,6 +1234,9 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 return MFX_ERR_UNSUPPORTED;
             }
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-input_cache"))) {
+            pParams->bInputCache = true;
+        }
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-WeightedPred:default"))) {
             pParams->WeightedPred = MFX_WEIGHTED_PRED_DEFAULT;
         }
@@ -1351,6 +1381,27 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-robust:soft"))) {
             pParams->bSoftRobustFlag = true;
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-pipelined_output"))) {
+            pParams->bPipelinedOutput = true;
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-segments"))) {
+            VAL_CHECK(i + 1 >= nArgNum, i, strInput[i]);
+            if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nSegmentSessions) ||
+                !pParams->nSegmentSessions) {
+                PrintHelp(strInput[0], MSDK_STRING("Number of segment sessions is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-segment_len"))) {
+            VAL_CHECK(i + 1 >= nArgNum, i, strInput[i]);
+            if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nSegmentFrames)) {
+                PrintHelp(strInput[0], MSDK_STRING("Segment length is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-segments_baseline"))) {
+            pParams->bSegmentBaseline = true;
+        }
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-num_slice"))) {
             VAL_CHECK(i + 1 >= nArgNum, i, strInput[i]);
             if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nNumSlice)) {
@@ -1686,6 +1737,12 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         PrintHelp(strInput[0], MSDK_STRING("-mss and -num_slice options are not compatible!"));
         return MFX_ERR_UNSUPPORTED;
     }
+    // GPU hang recovery resets all the tasks from the main thread
+    if (pParams->bPipelinedOutput && pParams->bSoftRobustFlag) {
+        PrintHelp(strInput[0],
+                  MSDK_STRING("-pipelined_output and -robust:soft options are not compatible!"));
+        return MFX_ERR_UNSUPPORTED;
+    }
     if ((pParams->nMaxSliceSize) && (pParams->CodecId != MFX_CODEC_AVC) &&
         (pParams->CodecId != MFX_CODEC_HEVC)) {
         PrintHelp(strInput[0],
@@ -1878,6 +1935,23 @@ int main(int argc, char* argv[])
 
     MSDK_CHECK_PARSE_RESULT(sts, MFX_ERR_NONE, 1);
 
+    if (Params.nSegmentSessions) {
+        CSegmentEncoder segmentEncoder;
+        sts = segmentEncoder.Init(&Params);
+        MSDK_CHECK_STATUS(sts, "segmentEncoder.Init failed");
+
+        segmentEncoder.PrintInfo();
+
+        msdk_printf(MSDK_STRING("Processing started\n"));
+        sts = segmentEncoder.Run();
+        MSDK_CHECK_STATUS(sts, "segmentEncoder.Run failed");
+
+        segmentEncoder.Close();
+
+        msdk_printf(MSDK_STRING("\nProcessing finished\n"));
+        return 0;
+    }
+
     // Choosing which pipeline to use
     pPipeline.reset(CreatePipeline(Params));
 
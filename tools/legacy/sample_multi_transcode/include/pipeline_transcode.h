@@ -9,6 +9,7 @@
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <ctime>
@@ -27,6 +28,7 @@
 #include "sysmem_allocator.h"
 
 #include "brc_routines.h"
+#include "frame_hash.h"
 #include "hw_device.h"
 #include "mfxdeprecated.h"
 #include "mfxjpeg.h"
@@ -36,12 +38,13 @@
 #include "plugin_utils.h"
 #include "preset_manager.h"
 #include "sample_defs.h"
-#include "smt_tracer.h"
 #include "vpl/mfxdispatcher.h"
 #include "vpl/mfxvideo++.h"
 #include "vpl/mfxvideo.h"
 
 #define TIME_STATS 1 // Enable statistics processing
+#include "smt_metrics.h"
+#include "smt_tracer.h"
 #include "time_statistics.h"
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -147,9 +150,10 @@ enum MemoryModel {
 };
 
 struct __sInputParams {
-    mfxU32 TargetID    = 0;
-    bool CascadeScaler = false;
-    bool EnableTracing = false;
+    mfxU32 TargetID      = 0;
+    bool CascadeScaler   = false;
+    bool EnableTracing   = false;
+    bool CompressTracing = false;
 
     // session parameters
     bool bIsJoin;
@@ -195,6 +199,8 @@ struct __sInputParams {
     msdk_char strSrcFile[MSDK_MAX_FILENAME_LEN]; // source bitstream file
     msdk_char strDstFile[MSDK_MAX_FILENAME_LEN]; // destination bitstream file
     msdk_char strDumpVppCompFile[MSDK_MAX_FILENAME_LEN]; // VPP composition output dump file
+    msdk_char strHashFile[MSDK_MAX_FILENAME_LEN]; // hash log of raw output frames
+    msdk_char strGoldenHashFile[MSDK_MAX_FILENAME_LEN]; // hash log to compare raw output with
     msdk_char strMfxParamsDumpFile[MSDK_MAX_FILENAME_LEN];
 
     // specific encode parameters
@@ -320,6 +326,7 @@ struct __sInputParams {
     sVppCompDstRect* pVppCompDstRects;
 
     bool bForceSysMem;
+    bool bInputCache; // raw input is read from CSmplInputCache shared by all sessions
     mfxU16 DecOutPattern;
     mfxU16 VppOutPattern;
     mfxU16 nGpuCopyMode;
@@ -380,6 +387,16 @@ struct __sInputParams {
     mfxU16 nIVFHeader;
 
     bool IsSourceMSB = false;
+
+    // Session placement: CPUs to pin session thread to and NUMA node for system memory
+    std::vector<mfxU32> CpuAffinity;
+    mfxI32 NumaNode = -1;
+    bool bNumaAuto  = false;
+
+    // Surface pool right-sizing: warm-up window in surface requests per pool, 0 - no shrinking
+    mfxU32 nPoolWarmup = 0;
+    // Pool sizes loaded from a tuning file, by pool name
+    std::map<msdk_string, mfxU32> TunedPoolSizes;
 };
 
 struct sInputParams : public __sInputParams {
@@ -425,7 +442,9 @@ public:
         mfxU32 TargetID      = 0; //ID of the target channel
         mfxU16 SurfaceWidth  = 0; //not aligned
         mfxU16 SurfaceHeight = 0;
-        mfxU16 Size          = 20;
+        mfxU16 FanOut        = 0; //number of consumers: cascade VPPs and encoders
+        double FrameRate     = 0.; //output frame rate after FRC, 0 means source frame rate
+        bool Deinterlaced    = false; //DI was done by this pool or one of its parents
 
         mfxFrameAllocRequest AllocReq{};
         mfxFrameAllocResponse AllocResp{};
@@ -434,12 +453,14 @@ public:
     TargetDescriptor GetDesc(mfxU32 id);
     void PropagateCascadeParameters();
     void CreatePoolList();
+    void PrintPlan();
 
     bool ParFileImported       = false;
     bool CascadeScalerRequired = false;
 
     std::vector<TargetDescriptor> Targets;
-    std::map<mfxU32, PoolDescritpor> Pools; //key is pool ID
+    std::map<mfxU32, PoolDescritpor> Pools; //key is pool ID, parent pool has lower ID than child
+    std::vector<mfxU32> CascadeOrder; //cascade target IDs in processing order, parents first
     std::map<mfxU32, sInputParams>
         InParams; //key is target ID, copy of par file for cascade VPP initialization
 
@@ -449,6 +470,7 @@ public:
               CascadeScalerRequired(false),
               Targets(),
               Pools(),
+              CascadeOrder(),
               InParams(),
               Tracer(nullptr) {}
 };
@@ -467,6 +489,7 @@ struct ExtendedSurface {
     PreEncAuxBuffer* pAuxCtrl;
     mfxEncodeCtrl* pEncCtrl;
     mfxSyncPoint Syncp;
+    msdk_tick InputTick; // when the frame entered the pipeline, 0 if unknown
 };
 
 struct ExtendedBS {
@@ -474,6 +497,7 @@ struct ExtendedBS {
     mfxBitstreamWrapper Bitstream;
     mfxSyncPoint Syncp     = nullptr;
     PreEncAuxBuffer* pCtrl = nullptr;
+    msdk_tick InputTick    = 0;
 };
 
 class CIOStat : public CTimeStatistics {
@@ -517,7 +541,7 @@ public:
         msdk_fprintf(
             ofile,
             MSDK_STRING(
-                "stat[%u.%llu]: %s=%d;Framerate=%.3f;Total=%.3lf;Samples=%lld;StdDev=%.3lf;Min=%.3lf;Max=%.3lf;Avg=%.3lf\n"),
+                "stat[%u.%llu]: %s=%d;Framerate=%.3f;Total=%.3lf;Samples=%lld;StdDev=%.3lf;Min=%.3lf;Max=%.3lf;Avg=%.3lf;P50=%.3lf;P90=%.3lf;P99=%.3lf;P99.9=%.3lf\n"),
             msdk_get_current_pid(),
             (unsigned long long int)rdtsc(),
             bufDir,
@@ -528,9 +552,16 @@ public:
             (double)GetTimeStdDev(false),
             (double)GetMinTime(false),
             (double)GetMaxTime(false),
-            (double)GetAvgTime(false));
+            (double)GetAvgTime(false),
+            (double)GetPercentile(50, false),
+            (double)GetPercentile(90, false),
+            (double)GetPercentile(99, false),
+            (double)GetPercentile(99.9, false));
         fflush(ofile);
 
+        // statistics are reset after every window, the whole run is kept here
+        m_RunStatistics.Merge(*this);
+
         if (!DumpLogFileName.empty()) {
             msdk_char buf[MSDK_MAX_FILENAME_LEN];
             msdk_sprintf(buf, MSDK_STRING("%s_ID_%d.log"), DumpLogFileName.c_str(), numPipelineid);
@@ -557,10 +588,15 @@ public:
         }
     }
 
+    inline CTimeStatistics& GetRunStatistics() {
+        return m_RunStatistics;
+    }
+
 protected:
     msdk_tstring DumpLogFileName;
     FILE* ofile;
     msdk_char bufDir[MAX_PREF_LEN];
+    CTimeStatistics m_RunStatistics;
 };
 
 class ExtendedBSStore {
@@ -628,6 +664,8 @@ public:
     virtual ~SafetySurfaceBuffer();
 
     mfxU32 GetLength();
+    // lock-free length for monitoring, may be stale by the time it is used
+    mfxU32 GetDepth();
     mfxStatus WaitForSurfaceRelease(mfxU32 msec);
     mfxStatus WaitForSurfaceInsertion(mfxU32 msec);
     void AddSurface(ExtendedSurface Surf);
@@ -642,6 +680,7 @@ protected:
     std::mutex m_mutex;
     std::list<SurfaceDescriptor> m_SList;
     bool m_IsBufferingAllowed;
+    std::atomic<mfxU32> m_Depth;
     MSDKEvent* pRelEvent;
     MSDKEvent* pInsEvent;
 
@@ -675,6 +714,29 @@ private:
 };
 
 typedef std::vector<mfxFrameSurface1*> SurfPointersArray;
+
+// Lock statistics of a surface pool, used to right-size the pool
+struct SurfacePoolUsage {
+    // number of surfaces the pool would have without tuning
+    mfxU32 Requested = 0;
+    // number of allocated surfaces
+    mfxU32 Allocated = 0;
+    // number of surfaces handed out, less than Allocated once the pool is shrunk
+    mfxU32 Active = 0;
+    // max number of simultaneously locked surfaces
+    mfxU32 Peak = 0;
+    // number of surface requests
+    mfxU32 Acquired = 0;
+    // number of times the shrunk pool had to be extended
+    mfxU32 Grown = 0;
+    // size of one surface in bytes
+    mfxU32 FrameSize = 0;
+
+    // pool size a later run needs: observed peak plus one surface of headroom
+    mfxU32 GetTunedSize() const {
+        return std::max<mfxU32>(Peak + 1, 2);
+    }
+};
 typedef std::vector<PreEncAuxBuffer> PreEncAuxArray;
 typedef std::list<ExtendedBS*> BSList;
 
@@ -707,6 +769,22 @@ public:
         return m_nProcessedFramesNum;
     }
 
+    const std::map<msdk_string, SurfacePoolUsage>& GetSurfacePoolUsage() {
+        return m_PoolUsage;
+    }
+
+    CIOStat& GetOutputStatistics() {
+        return outputStatistics;
+    }
+
+    const SMTSessionMetrics& GetMetrics() {
+        return m_Metrics;
+    }
+
+    mfxI32 GetBufferDepth() {
+        return m_pBuffer ? (mfxI32)m_pBuffer->GetDepth() : -1;
+    }
+
     bool GetJoiningFlag() {
         return m_bIsJoinSession;
     }
@@ -799,6 +877,14 @@ protected:
 
     mfxFrameSurface1* GetFreeSurface(bool isDec, mfxU64 timeout);
     mfxFrameSurface1* GetFreeSurfaceForCS(bool isDec, mfxU64 timeout, mfxU32 ID);
+    mfxFrameSurface1* AcquireSurface(const msdk_string& pool,
+                                     SurfPointersArray& workArray,
+                                     mfxU32 available);
+    mfxU16 GetTunedPoolSize(const msdk_string& pool, mfxU16 requested, mfxU16 minimum);
+    void RegisterSurfacePool(const msdk_string& pool,
+                             mfxU16 requested,
+                             mfxU16 allocated,
+                             const mfxFrameInfo& info);
     mfxU32 GetFreeSurfacesCount(bool isDec);
     PreEncAuxBuffer* GetFreePreEncAuxBuffer();
     void SetEncCtrlRT(ExtendedSurface& extSurface, bool bInsertIDR);
@@ -868,6 +954,8 @@ protected:
     mfxU32 m_encoderFourCC;
 
     CSmplYUVWriter m_dumpVppCompFileWriter;
+    // hashes raw output frames instead of writing them, set with -hash options and -o::raw
+    std::unique_ptr<CSmplHashWriter> m_pHashWriter;
     mfxU32 m_vppCompDumpRenderMode;
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -884,6 +972,11 @@ protected:
 
     std::map<mfxU32, SurfPointersArray> m_CSSurfacePools;
 
+    // surface pools right-sizing
+    std::map<msdk_string, SurfacePoolUsage> m_PoolUsage;
+    std::map<msdk_string, mfxU32> m_TunedPoolSizes;
+    mfxU32 m_nPoolWarmup;
+
     mfxU16 m_EncSurfaceType; // actual type of encoder surface pool
     mfxU16 m_DecSurfaceType; // actual type of decoder surface pool
 
@@ -948,6 +1041,7 @@ protected:
     mfxSyncPoint m_LastDecSyncPoint;
 
     SafetySurfaceBuffer* m_pBuffer;
+    SMTSessionMetrics m_Metrics;
     CTranscodingPipeline* m_pParentPipeline;
 
     mfxFrameAllocRequest m_Request;
@@ -1046,12 +1140,27 @@ struct ThreadTranscodeContext {
 
     // Thread handle
     std::future<void> handle;
+    // Time the session thread was launched at
+    msdk_tick launchTick = 0;
+
+    // CPUs the session thread is pinned to
+    std::vector<mfxU32> cpuAffinity;
+    // NUMA node preferred for session memory, -1 if not set
+    mfxI32 numaNode = -1;
 
     void TranscodeRoutine() {
         using namespace std::chrono;
         MSDK_CHECK_POINTER_NO_RET(pPipeline);
         transcodingSts = MFX_ERR_NONE;
 
+        if (MFX_ERR_NONE != msdk_thread_set_affinity(cpuAffinity))
+            msdk_printf(MSDK_STRING("WARNING: failed to set CPU affinity for session [%s]\n"),
+                        pPipeline->GetSessionText().c_str());
+        // memory first touched by the session thread goes to its node
+        if (numaNode >= 0 && MFX_ERR_NONE != msdk_numa_set_preferred_node(numaNode))
+            msdk_printf(MSDK_STRING("WARNING: failed to set NUMA memory policy for session [%s]\n"),
+                        pPipeline->GetSessionText().c_str());
+
         auto start_time = system_clock::now();
         while (MFX_ERR_NONE == transcodingSts) {
             transcodingSts = pPipeline->Run();
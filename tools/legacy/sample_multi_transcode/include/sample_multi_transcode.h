@@ -14,6 +14,8 @@
 
 #include "pipeline_transcode.h"
 #include "sample_utils.h"
+#include "smt_control.h"
+#include "smt_metrics.h"
 #include "transcode_utils.h"
 #include "vpl_implementation_loader.h"
 
@@ -51,7 +53,21 @@ protected:
                                            CTranscodingPipeline* pParentPipeline);
     virtual mfxStatus VerifyCrossSessionsOptions();
     virtual mfxStatus CreateSafetyBuffers();
+    mfxStatus ResolveSessionPlacement();
+    // resolves -numa/-numa_auto of one session into its NUMA node and CPU affinity
+    mfxStatus ResolveSessionPlacement(sInputParams& params, mfxU32 id, mfxU32& autoIdx);
+    // surface pool tuning file, see -pool_import/-pool_export
+    mfxStatus LoadPoolTuning(const msdk_string& fileName);
+    mfxStatus SavePoolTuning(const msdk_string& fileName);
+    static msdk_string FormatPoolUsage(const std::map<msdk_string, SurfacePoolUsage>& pools);
     CascadeScalerConfig& CreateCascadeScalerConfig();
+    mfxStatus InitBitstreamProcessor(sInputParams& params, FileBitstreamProcessor* pBSProcessor);
+    // runtime session management through the control socket
+    mfxStatus StartSession(const msdk_string& line, mfxU32& id);
+    std::string GetSessionStats(mfxU32 id);
+    std::string ExecuteControlCommand(const std::string& line);
+    // publishes -metrics when the interval is over, or at once if force is set
+    void UpdateMetrics(bool force);
     virtual void DoTranscoding();
     virtual void DoRobustTranscoding();
 
@@ -83,6 +99,12 @@ protected:
     CascadeScalerConfig m_CSConfig;
     SMTTracer m_Tracer;
 
+    // device handle of each session, runtime sessions share the first one
+    std::vector<mfxHDL> m_hdls;
+    std::unique_ptr<SMTControlServer> m_pControl;
+    bool m_bControlQuit;
+    std::unique_ptr<SMTMetricsWriter> m_pMetrics;
+
 private:
     DISALLOW_COPY_AND_ASSIGN(Launcher);
 };
@@ -0,0 +1,62 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __SMT_CONTROL_H__
+#define __SMT_CONTROL_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "vpl/mfxdefs.h"
+
+namespace TranscodingSample {
+//Local control channel of the application: accepts line based commands on a Unix-domain
+//socket. Commands are received by the listener thread but executed by the thread which calls
+//ProcessCommands(), so the handler may safely create and stop sessions.
+class SMTControlServer {
+public:
+    typedef std::function<std::string(const std::string&)> CommandHandler;
+
+    SMTControlServer();
+    ~SMTControlServer();
+
+    // Creates the socket at path, a stale socket there is replaced, any other file fails
+    mfxStatus Start(const std::string& path);
+    void Stop();
+
+    //Executes queued commands, reply of the handler is sent back to the client
+    void ProcessCommands(const CommandHandler& handler);
+
+private:
+    struct Command {
+        std::string line;
+        std::promise<std::string> reply;
+    };
+
+    void ListenRoutine();
+    void ServeClient(int fd);
+    std::string Execute(const std::string& line);
+
+    std::string Path;
+    int ListenFD;
+    std::atomic<bool> StopRequested;
+    std::thread Listener;
+
+    std::mutex QueueMutex;
+    std::deque<std::shared_ptr<Command>> Queue;
+
+    SMTControlServer(const SMTControlServer&)            = delete;
+    SMTControlServer& operator=(const SMTControlServer&) = delete;
+};
+} // namespace TranscodingSample
+
+#endif //__SMT_CONTROL_H__
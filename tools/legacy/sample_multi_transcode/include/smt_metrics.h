@@ -0,0 +1,69 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __SMT_METRICS_H__
+#define __SMT_METRICS_H__
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "sample_defs.h"
+#include "time_statistics.h"
+
+namespace TranscodingSample {
+//Live counters of one session. Pipeline threads update them with relaxed atomic operations
+//only, the metrics writer reads them at any time without stopping the pipeline.
+struct SMTSessionMetrics {
+    std::atomic<mfxU64> FramesOut{ 0 };
+    std::atomic<mfxU32> FramesInFlight{ 0 }; // bitstreams submitted to encoder, not written yet
+    std::atomic<mfxU64> DeviceBusyWaits{ 0 }; // waits on MFX_WRN_DEVICE_BUSY
+    std::atomic<mfxU64> SurfaceWaits{ 0 }; // waits for a free surface
+    // locked surfaces of the decoder and encoder pools at the last surface request
+    std::atomic<mfxU32> DecPoolUsed{ 0 };
+    std::atomic<mfxU32> DecPoolSize{ 0 };
+    std::atomic<mfxU32> EncPoolUsed{ 0 };
+    std::atomic<mfxU32> EncPoolSize{ 0 };
+    // from the decode call which returned a frame to the write of its bitstream
+    CLatencyHistogram Latency;
+};
+
+struct SMTMetricsSample {
+    mfxU32 SessionID;
+    const SMTSessionMetrics* pMetrics;
+    mfxI32 BufferDepth; // surfaces in SafetySurfaceBuffer of the session, -1 if there is none
+};
+
+//Publishes metrics of all sessions in Prometheus text format. The file is written next to
+//the target and renamed over it, so a reader (e.g. node_exporter textfile collector) never
+//sees a partial file.
+class SMTMetricsWriter {
+public:
+    SMTMetricsWriter(const msdk_string& fileName, mfxU32 intervalMs);
+
+    //true if the interval since the last write has elapsed
+    bool IsDue();
+    mfxStatus Write(const std::vector<SMTMetricsSample>& samples);
+
+private:
+    struct RateState {
+        mfxU64 Frames;
+        msdk_tick Tick;
+        mfxF64 FPS;
+    };
+
+    msdk_string FileName;
+    msdk_tick Interval; // in ticks
+    msdk_tick LastWrite;
+    // fps of a session is computed over the interval between two writes
+    std::map<mfxU32, RateState> Rates;
+
+    SMTMetricsWriter(const SMTMetricsWriter&)            = delete;
+    SMTMetricsWriter& operator=(const SMTMetricsWriter&) = delete;
+};
+} // namespace TranscodingSample
+
+#endif //__SMT_METRICS_H__
@@ -8,13 +8,20 @@
 #define __SMT_TRACER_H__
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include "time_statistics.h"
 #include "vpl/mfxdefs.h"
 
 namespace TranscodingSample {
@@ -37,12 +44,12 @@ public:
         mfxU64 OutID;
         mfxU64 TS; //time stamp
     };
-    using EventIt = std::vector<Event>::iterator;
 
     SMTTracer();
     ~SMTTracer();
 
-    void Init();
+    //compress enables gzip output if the sample is built with zlib
+    void Init(bool compress = false);
     void BeginEvent(const ThreadType thType,
                     const mfxU32 thID,
                     const EventName name,
@@ -59,6 +66,28 @@ public:
                          const mfxU64 counter);
 
 private:
+    //single producer (pipeline thread) single consumer (flusher thread) ring buffer
+    class ThreadBuffer {
+    public:
+        bool Push(const Event& ev);
+        void Pop(std::vector<Event>& out);
+
+    private:
+        const static size_t Capacity = 1 << 15;
+
+        std::vector<Event> Ring = std::vector<Event>(Capacity);
+        std::atomic<size_t> Head{ 0 };
+        std::atomic<size_t> Tail{ 0 };
+    };
+
+    //state of the last duration event which produced given OutID
+    struct Link {
+        Event End;
+        Event Begin;
+        bool OriginKnown = false;
+        Event Origin; //beginning of the dependency chain
+    };
+
     //runtime functions
     void AddEvent(const EventType evType,
                   const ThreadType thType,
@@ -67,51 +96,72 @@ private:
                   const void* inID,
                   const void* outID);
     mfxU64 GetCurrentTS();
-
-    //log generation functions
-    void SaveTrace(mfxU32 FileID);
-
-    void AddFlowEvents();
-    void AddFlowEvent(const Event a, const Event b);
-
-    void ComputeE2ELatency();
-    void PrintE2ELatency();
-
-    void ComputeEncLatency();
-    void PrintEncLatency();
-
-    EventIt FindBeginningOfDependencyChain(EventIt it);
-    EventIt FindBeginningOfDurationEvent(EventIt it);
-    EventIt FindEndOfPreviosDurationEvent(EventIt it);
-
-    void WriteEvent(std::ofstream& trace_file, const Event ev);
-    void WriteDurationEvent(std::ofstream& trace_file, const Event ev);
-    void WriteFlowEvent(std::ofstream& trace_file, const Event ev);
-    void WriteCounterEvent(std::ofstream& trace_file, const Event ev);
-
-    void WriteEventPID(std::ofstream& trace_file);
-    void WriteEventTID(std::ofstream& trace_file, const Event ev);
-    void WriteEventTS(std::ofstream& trace_file, const Event ev);
-    void WriteEventPhase(std::ofstream& trace_file, const Event ev);
-    void WriteEventName(std::ofstream& trace_file, const Event ev);
-    void WriteBindingPoint(std::ofstream& trace_file, const Event ev);
-    void WriteEventInOutIDs(std::ofstream& trace_file, const Event ev);
-    void WriteEventCounter(std::ofstream& trace_file, const Event ev);
-    void WriteEventCategory(std::ofstream& trace_file);
-    void WriteEvID(std::ofstream& trace_file, const Event ev);
-    void WriteComma(std::ofstream& trace_file);
-
-    const static mfxU32 TraceBufferSizeInMBytes = 7;
-
-    bool Enabled = false;
-    mfxU32 EvID  = 0;
-    std::vector<Event> Log;
-    std::vector<Event> AddonLog;
-    std::map<mfxU32, std::vector<mfxU64>> E2ELatency;
-    std::map<mfxU32, std::vector<mfxU64>> EncLatency;
-    mfxU32 NumOfErrors = 0;
+    ThreadBuffer* GetThreadBuffer();
+
+    //flusher thread functions
+    void FlushRoutine();
+    void Flush(bool final);
+    void ProcessEvent(const Event& ev, std::ostream& trace);
+    void OpenTraceFile(bool compress);
+    void WriteTraceChunk(const std::string& chunk);
+    void CloseTraceFile();
+
+    void AddFlowEvent(const Event a, const Event b, std::ostream& trace);
+
+    void PrintLatency(const char* title,
+                      mfxU32 numOfErrors,
+                      const std::map<mfxU32, CLatencyHistogram>& latency);
+
+    void WriteEvent(std::ostream& trace_file, const Event ev);
+    void WriteDurationEvent(std::ostream& trace_file, const Event ev);
+    void WriteFlowEvent(std::ostream& trace_file, const Event ev);
+    void WriteCounterEvent(std::ostream& trace_file, const Event ev);
+
+    void WriteEventPID(std::ostream& trace_file);
+    void WriteEventTID(std::ostream& trace_file, const Event ev);
+    void WriteEventTS(std::ostream& trace_file, const Event ev);
+    void WriteEventPhase(std::ostream& trace_file, const Event ev);
+    void WriteEventName(std::ostream& trace_file, const Event ev);
+    void WriteBindingPoint(std::ostream& trace_file, const Event ev);
+    void WriteEventInOutIDs(std::ostream& trace_file, const Event ev);
+    void WriteEventCounter(std::ostream& trace_file, const Event ev);
+    void WriteEventCategory(std::ostream& trace_file);
+    void WriteEvID(std::ostream& trace_file, const Event ev);
+    void WriteComma(std::ostream& trace_file);
+
+    //events younger than this are kept for the next flush, so that events from
+    //other threads with earlier time stamps have a chance to arrive
+    const static mfxU64 FlushHoldBackInUs  = 50000;
+    const static mfxU32 FlushPeriodInMs    = 100;
+
+    std::atomic<bool> Enabled{ false };
+    const mfxU64 TracerID;
     std::chrono::steady_clock::time_point TimeBase;
-    std::mutex TracerFileMutex;
+
+    //producer side, registration of a new thread is the only locked operation
+    std::vector<std::unique_ptr<ThreadBuffer>> Buffers;
+    std::mutex BuffersMutex;
+    std::atomic<mfxU64> DroppedEvents{ 0 };
+
+    //flusher side
+    std::thread Flusher;
+    std::mutex FlusherMutex;
+    std::condition_variable FlusherCV;
+    bool StopFlusher = false;
+
+    std::vector<Event> Pending;
+    std::map<mfxU64, Link> Links; //by OutID
+    std::map<std::tuple<ThreadType, mfxU32, EventName>, Event> OpenDurations;
+    std::map<mfxU32, CLatencyHistogram> E2ELatency;
+    std::map<mfxU32, CLatencyHistogram> EncLatency;
+    mfxU32 NumOfE2EErrors = 0;
+    mfxU32 NumOfEncErrors = 0;
+    mfxU32 EvID           = 0;
+    mfxU64 WrittenEvents  = 0;
+
+    std::string FileName;
+    std::ofstream TraceFile;
+    void* GzTraceFile = nullptr;
 };
 
 } // namespace TranscodingSample
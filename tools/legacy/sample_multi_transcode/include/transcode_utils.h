@@ -60,6 +60,25 @@ public:
     };
     void PrintParFileName();
     msdk_string GetLine(mfxU32 n);
+    void AddLine(const msdk_string& line);
+    const msdk_string& GetControlSocketPath() {
+        return m_ControlSocketPath;
+    };
+    const msdk_string& GetPoolImportFile() {
+        return m_PoolImportFile;
+    };
+    const msdk_string& GetPoolExportFile() {
+        return m_PoolExportFile;
+    };
+    const msdk_string& GetMetricsFile() {
+        return m_MetricsFile;
+    };
+    mfxU32 GetMetricsInterval() {
+        return m_nMetricsInterval;
+    };
+    // parses a single par file line without adding a session to the queue
+    mfxStatus ParseSessionLine(const msdk_string& line,
+                               TranscodingSample::sInputParams& InputParams);
 
 protected:
     mfxStatus ParseParFile(FILE* file);
@@ -87,6 +106,13 @@ protected:
     bool bRobustFlag;
     bool bSoftRobustFlag;
     bool shouldUseGreedyFormula;
+    bool bNumaAuto;
+    msdk_string m_ControlSocketPath;
+    mfxU32 m_nPoolWarmup;
+    msdk_string m_PoolImportFile;
+    msdk_string m_PoolExportFile;
+    msdk_string m_MetricsFile;
+    mfxU32 m_nMetricsInterval;
     std::vector<msdk_string> m_lines;
 
 private:
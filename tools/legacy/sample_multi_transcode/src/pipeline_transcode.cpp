@@ -135,6 +135,7 @@ CTranscodingPipeline::CTranscodingPipeline()
           m_numEncoders(0),
           m_encoderFourCC(0),
           m_dumpVppCompFileWriter(),
+          m_pHashWriter(),
           m_vppCompDumpRenderMode(0),
           m_hwdev4Rendering(NULL),
           m_pSurfaceDecPool(),
@@ -142,6 +143,9 @@ CTranscodingPipeline::CTranscodingPipeline()
           m_DecOutAllocReques({ 0 }),
           m_VPPOutAllocReques({ 0 }),
           m_CSSurfacePools(),
+          m_PoolUsage(),
+          m_TunedPoolSizes(),
+          m_nPoolWarmup(0),
           m_EncSurfaceType(0),
           m_DecSurfaceType(0),
           m_pPreEncAuxPool(),
@@ -509,6 +513,7 @@ mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface* pExtSurface) {
     mfxStatus sts                 = MFX_ERR_MORE_SURFACE;
     mfxFrameSurface1* pmfxSurface = NULL;
     pExtSurface->pSurface         = NULL;
+    pExtSurface->InputTick        = msdk_time_get_tick();
 
     //--- Time measurements
     if (statisticsWindowSize) {
@@ -554,6 +559,7 @@ mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface* pExtSurface) {
                                               nullptr,
                                               nullptr);
             WaitForDeviceToBecomeFree(*m_pmfxSession, m_LastDecSyncPoint, sts);
+            m_Metrics.DeviceBusyWaits.fetch_add(1, std::memory_order_relaxed);
             m_ScalerConfig.Tracer->EndEvent(SMTTracer::ThreadType::DEC,
                                             0,
                                             SMTTracer::EventName::BUSY,
@@ -658,6 +664,7 @@ mfxStatus CTranscodingPipeline::DecodeLastFrame(ExtendedSurface* pExtSurface) {
     MFX_ITT_TASK("DecodeLastFrame");
     mfxFrameSurface1* pmfxSurface = NULL;
     mfxStatus sts                 = MFX_ERR_MORE_SURFACE;
+    pExtSurface->InputTick        = msdk_time_get_tick();
 
     //--- Time measurements
     if (statisticsWindowSize) {
@@ -675,6 +682,7 @@ mfxStatus CTranscodingPipeline::DecodeLastFrame(ExtendedSurface* pExtSurface) {
         }
         else if (MFX_WRN_DEVICE_BUSY == sts) {
             WaitForDeviceToBecomeFree(*m_pmfxSession, m_LastDecSyncPoint, sts);
+            m_Metrics.DeviceBusyWaits.fetch_add(1, std::memory_order_relaxed);
         }
 
         if (!m_rawInput) {
@@ -743,6 +751,8 @@ mfxStatus CTranscodingPipeline::VPPOneFrame(ExtendedSurface* pSurfaceIn,
     mfxFrameSurface1* out_surface = NULL;
     mfxStatus sts                 = MFX_ERR_NONE;
 
+    pExtSurface->InputTick = pSurfaceIn ? pSurfaceIn->InputTick : 0;
+
     if (m_MemoryModel == GENERAL_ALLOC || m_MemoryModel == VISIBLE_INT_ALLOC) {
         if (m_MemoryModel == GENERAL_ALLOC) {
             // find/wait for a free working surface
@@ -858,6 +868,7 @@ mfxStatus CTranscodingPipeline::VPPOneFrame(ExtendedSurface* pSurfaceIn,
                     }
 
                     MSDK_SLEEP(1); // wait if device is busy
+                    m_Metrics.DeviceBusyWaits.fetch_add(1, std::memory_order_relaxed);
 
                     if (TargetID == DecoderTargetID && desc.CascadeScaler) {
                         m_ScalerConfig.Tracer->EndEvent(SMTTracer::ThreadType::CSVPP,
@@ -923,6 +934,7 @@ mfxStatus CTranscodingPipeline::EncodeOneFrame(ExtendedSurface* pExtSurface,
                                                   nullptr,
                                                   nullptr);
                 MSDK_SLEEP(TIME_TO_SLEEP); // wait if device is busy
+                m_Metrics.DeviceBusyWaits.fetch_add(1, std::memory_order_relaxed);
                 m_ScalerConfig.Tracer->EndEvent(SMTTracer::ThreadType::ENC,
                                                 TargetID,
                                                 SMTTracer::EventName::BUSY,
@@ -1116,9 +1128,10 @@ mfxStatus CTranscodingPipeline::Decode() {
                             sts = VPPOneFrame(&DecExtSurface, &VppExtSurface);
                         }
                         else {
-                            VppExtSurface.pSurface = DecExtSurface.pSurface;
-                            VppExtSurface.pAuxCtrl = DecExtSurface.pAuxCtrl;
-                            VppExtSurface.Syncp    = DecExtSurface.Syncp;
+                            VppExtSurface.pSurface  = DecExtSurface.pSurface;
+                            VppExtSurface.pAuxCtrl  = DecExtSurface.pAuxCtrl;
+                            VppExtSurface.Syncp     = DecExtSurface.Syncp;
+                            VppExtSurface.InputTick = DecExtSurface.InputTick;
                         }
                     }
                     else {
@@ -1127,29 +1140,44 @@ mfxStatus CTranscodingPipeline::Decode() {
                 }
                 else {
                     if (m_ScalerConfig.CascadeScalerRequired) {
-                        ExtendedSurface InSurface = DecExtSurface;
-                        for (auto desc : m_ScalerConfig.Targets) {
-                            if (desc.CascadeScaler) {
-                                sts = VPPOneFrame(&InSurface, &VppExtSurface, desc.TargetID);
-                                if (sts == MFX_ERR_NONE) {
-                                    IncreaseReference(*VppExtSurface.pSurface);
-                                    InSurface = VppExtSurface;
-                                }
-                                else if (sts == MFX_ERR_MORE_DATA && !bEndOfFile) {
-                                    sts = MFX_ERR_NONE; //important to continue processing
-                                    break;
-                                }
-                                else if (sts == MFX_ERR_MORE_DATA && bEndOfFile) {
-                                    VppExtSurface = InSurface;
-                                }
-                                else {
-                                    return MFX_ERR_UNKNOWN;
-                                }
+                        //run cascade VPPs in planned order, parent pools go first,
+                        //every cascade takes output of its parent pool as input
+                        std::map<mfxU32, ExtendedSurface> PoolSurfaces;
+                        PoolSurfaces[DecoderPoolID] = DecExtSurface;
+                        for (mfxU32 id : m_ScalerConfig.CascadeOrder) {
+                            auto desc     = m_ScalerConfig.GetDesc(id);
+                            mfxU32 PrevID = m_ScalerConfig.Pools[desc.PoolID].PrevID;
+                            auto parent   = PoolSurfaces.find(PrevID);
+                            if (parent == PoolSurfaces.end()) {
+                                continue; //parent has no output for this frame
+                            }
+
+                            ExtendedSurface InSurface = parent->second;
+                            sts = VPPOneFrame(&InSurface, &VppExtSurface, desc.TargetID);
+                            if (sts == MFX_ERR_NONE) {
+                                IncreaseReference(*VppExtSurface.pSurface);
+                                PoolSurfaces[desc.PoolID] = VppExtSurface;
+                            }
+                            else if (sts == MFX_ERR_MORE_DATA && !bEndOfFile) {
+                                sts = MFX_ERR_NONE; //important to continue processing
+                            }
+                            else if (sts == MFX_ERR_MORE_DATA && bEndOfFile) {
+                                PoolSurfaces[desc.PoolID] = InSurface;
                             }
                             else {
-                                VppExtSurface = InSurface;
+                                return MFX_ERR_UNKNOWN;
                             }
+                        }
 
+                        //outputs go in par file order
+                        MSDK_ZERO_MEMORY(VppExtSurface);
+                        for (const auto& desc : m_ScalerConfig.Targets) {
+                            auto out = PoolSurfaces.find(desc.PoolID);
+                            if (out == PoolSurfaces.end()) {
+                                continue;
+                            }
+
+                            VppExtSurface = out->second;
                             VppExtSurface.TargetID =
                                 desc.TargetID; //we can't remove it, it is used for pass thorugh case
                             OutSurfaces.push_back(VppExtSurface);
@@ -1171,8 +1199,9 @@ mfxStatus CTranscodingPipeline::Decode() {
         }
         else // no VPP - just copy pointers
         {
-            VppExtSurface.pSurface = DecExtSurface.pSurface;
-            VppExtSurface.Syncp    = DecExtSurface.Syncp;
+            VppExtSurface.pSurface  = DecExtSurface.pSurface;
+            VppExtSurface.Syncp     = DecExtSurface.Syncp;
+            VppExtSurface.InputTick = DecExtSurface.InputTick;
         }
 
         //--- Sometimes VPP may return 2 surfaces on output, for the first one it'll return status MFX_ERR_MORE_SURFACE - we have to call VPPOneFrame again in this case
@@ -1254,12 +1283,17 @@ mfxStatus CTranscodingPipeline::Decode() {
             std::reverse(buf.begin(), buf.end());
             pNextBuffer = buf[0];
 
-            for (mfxU32 i = 0; i < OutSurfaces.size(); i++) {
+            for (const auto& s : OutSurfaces) {
+                //some targets may have no output for this frame, e.g. after FRC
+                auto it =
+                    std::find_if(buf.begin(), buf.end(), [&s](const SafetySurfaceBuffer* b) {
+                        return b->TargetID == s.TargetID;
+                    });
                 //sanity check
-                if (buf[i]->TargetID != OutSurfaces[i].TargetID) {
+                if (it == buf.end()) {
                     return MFX_ERR_UNKNOWN;
                 }
-                buf[i]->AddSurface(OutSurfaces[i]);
+                (*it)->AddSurface(s);
             }
 
             OutSurfaces.clear();
@@ -1415,9 +1449,10 @@ mfxStatus CTranscodingPipeline::Encode() {
         }
         else // no VPP - just copy pointers
         {
-            VppExtSurface.pSurface = DecExtSurface.pSurface;
-            VppExtSurface.pAuxCtrl = DecExtSurface.pAuxCtrl;
-            VppExtSurface.Syncp    = DecExtSurface.Syncp;
+            VppExtSurface.pSurface  = DecExtSurface.pSurface;
+            VppExtSurface.pAuxCtrl  = DecExtSurface.pAuxCtrl;
+            VppExtSurface.Syncp     = DecExtSurface.Syncp;
+            VppExtSurface.InputTick = DecExtSurface.InputTick;
         }
 
         if (MFX_ERR_MORE_SURFACE == sts) {
@@ -1490,6 +1525,7 @@ mfxStatus CTranscodingPipeline::Encode() {
             return MFX_ERR_NOT_FOUND;
 
         m_BSPool.push_back(pBS);
+        m_Metrics.FramesInFlight.store((mfxU32)m_BSPool.size(), std::memory_order_relaxed);
 
         mfxU32 NumFramesForReset =
             m_pParentPipeline ? m_pParentPipeline->GetNumFramesForReset() : 0;
@@ -1540,6 +1576,7 @@ mfxStatus CTranscodingPipeline::Encode() {
             // the task in not in Encode queue
             m_BSPool.pop_back();
             m_pBSStore->Release(pBS);
+            m_Metrics.FramesInFlight.store((mfxU32)m_BSPool.size(), std::memory_order_relaxed);
 
             if (NULL == VppExtSurface.pSurface) // there are no more buffered frames in encoder
             {
@@ -1566,7 +1603,8 @@ mfxStatus CTranscodingPipeline::Encode() {
             outputStatistics.ResetStatistics();
         }
 
-        m_BSPool.back()->Syncp = VppExtSurface.Syncp;
+        m_BSPool.back()->Syncp     = VppExtSurface.Syncp;
+        m_BSPool.back()->InputTick = VppExtSurface.InputTick;
         m_BSPool.back()->pCtrl = VppExtSurface.pAuxCtrl;
 
         /* Actually rendering... if enabled
@@ -1924,9 +1962,10 @@ mfxStatus CTranscodingPipeline::Transcode() {
                             sts = VPPOneFrame(&DecExtSurface, &VppExtSurface);
                         }
                         else {
-                            VppExtSurface.pSurface = DecExtSurface.pSurface;
-                            VppExtSurface.pAuxCtrl = DecExtSurface.pAuxCtrl;
-                            VppExtSurface.Syncp    = DecExtSurface.Syncp;
+                            VppExtSurface.pSurface  = DecExtSurface.pSurface;
+                            VppExtSurface.pAuxCtrl  = DecExtSurface.pAuxCtrl;
+                            VppExtSurface.Syncp     = DecExtSurface.Syncp;
+                            VppExtSurface.InputTick = DecExtSurface.InputTick;
                         }
                     }
                     else {
@@ -1947,9 +1986,10 @@ mfxStatus CTranscodingPipeline::Transcode() {
         }
         else // no VPP - just copy pointers
         {
-            VppExtSurface.pSurface = DecExtSurface.pSurface;
-            VppExtSurface.pAuxCtrl = DecExtSurface.pAuxCtrl;
-            VppExtSurface.Syncp    = DecExtSurface.Syncp;
+            VppExtSurface.pSurface  = DecExtSurface.pSurface;
+            VppExtSurface.pAuxCtrl  = DecExtSurface.pAuxCtrl;
+            VppExtSurface.Syncp     = DecExtSurface.Syncp;
+            VppExtSurface.InputTick = DecExtSurface.InputTick;
         }
 
         if (MFX_ERR_MORE_SURFACE == sts) {
@@ -1979,6 +2019,7 @@ mfxStatus CTranscodingPipeline::Transcode() {
             return MFX_ERR_NOT_FOUND;
 
         m_BSPool.push_back(pBS);
+        m_Metrics.FramesInFlight.store((mfxU32)m_BSPool.size(), std::memory_order_relaxed);
 
         // Set Encoding control if it is required.
 
@@ -2006,6 +2047,7 @@ mfxStatus CTranscodingPipeline::Transcode() {
             // the task in not in Encode queue
             m_BSPool.pop_back();
             m_pBSStore->Release(pBS);
+            m_Metrics.FramesInFlight.store((mfxU32)m_BSPool.size(), std::memory_order_relaxed);
 
             if (NULL == VppExtSurface.pSurface) // there are no more buffered frames in encoder
             {
@@ -2037,7 +2079,8 @@ mfxStatus CTranscodingPipeline::Transcode() {
             msdk_printf(MSDK_STRING("."));
         }
 
-        m_BSPool.back()->Syncp = VppExtSurface.Syncp;
+        m_BSPool.back()->Syncp     = VppExtSurface.Syncp;
+        m_BSPool.back()->InputTick = VppExtSurface.InputTick;
 
         if (m_BSPool.size() == m_AsyncDepth) {
             sts = PutBS();
@@ -2101,6 +2144,13 @@ mfxStatus CTranscodingPipeline::PutBS() {
     sts = m_pBSProcessor->ProcessOutputBitstream(&pBitstreamEx->Bitstream);
     MSDK_CHECK_STATUS(sts, "m_pBSProcessor->ProcessOutputBitstream failed");
 
+    m_Metrics.FramesOut.fetch_add(1, std::memory_order_relaxed);
+    if (pBitstreamEx->InputTick) {
+        m_Metrics.Latency.Record((mfxU64)((msdk_time_get_tick() - pBitstreamEx->InputTick) * 1e9 /
+                                          msdk_time_get_frequency()));
+        pBitstreamEx->InputTick = 0;
+    }
+
     UnPreEncAuxBuffer(pBitstreamEx->pCtrl);
 
     pBitstreamEx->Bitstream.DataLength = 0;
@@ -2109,6 +2159,7 @@ mfxStatus CTranscodingPipeline::PutBS() {
     if (m_BSPool.size())
         m_BSPool.pop_front();
     m_pBSStore->Release(pBitstreamEx);
+    m_Metrics.FramesInFlight.store((mfxU32)m_BSPool.size(), std::memory_order_relaxed);
 
     return sts;
 } //mfxStatus CTranscodingPipeline::PutBS()
@@ -2155,7 +2206,7 @@ mfxStatus CTranscodingPipeline::Surface2BS(ExtendedSurface* pSurf,
         MSDK_CHECK_ERR_NONE_STATUS(sts, MFX_ERR_ABORTED, "SyncOperation failed");
         pSurf->Syncp = 0;
 
-        if (!m_pBSProcessor->IsNulOutput()) {
+        if (m_pHashWriter || !m_pBSProcessor->IsNulOutput()) {
             //--- Copying data from surface to bitstream
             if (m_MemoryModel == GENERAL_ALLOC) {
                 sts = m_pMFXAllocator->Lock(m_pMFXAllocator->pthis,
@@ -2168,27 +2219,34 @@ mfxStatus CTranscodingPipeline::Surface2BS(ExtendedSurface* pSurf,
                 MSDK_CHECK_STATUS(sts, "FrameInterface->Map failed");
             }
 
-            switch (fourCC) {
-                case 0: // Default value is MFX_FOURCC_I420
-                case MFX_FOURCC_I420:
+            if (m_pHashWriter) {
+                // the frame is hashed as is, the output bitstream stays empty
+                sts = m_pHashWriter->WriteNextFrame(pSurf->pSurface);
+                MSDK_CHECK_STATUS(sts, "m_pHashWriter->WriteNextFrame failed");
+            }
+            else {
+                switch (fourCC) {
+                    case 0: // Default value is MFX_FOURCC_I420
+                    case MFX_FOURCC_I420:
 #if (MFX_VERSION >= 2000)
-                    if (m_initPar.Implementation == MFX_IMPL_SOFTWARE)
-                        sts = I420toBS(pSurf->pSurface, pBS);
-                    else
+                        if (m_initPar.Implementation == MFX_IMPL_SOFTWARE)
+                            sts = I420toBS(pSurf->pSurface, pBS);
+                        else
 #endif
-                        sts = NV12asI420toBS(pSurf->pSurface, pBS);
-                    break;
-                case MFX_FOURCC_NV12:
-                    sts = NV12toBS(pSurf->pSurface, pBS);
-                    break;
-                case MFX_FOURCC_RGB4:
-                    sts = RGB4toBS(pSurf->pSurface, pBS);
-                    break;
-                case MFX_FOURCC_YUY2:
-                    sts = YUY2toBS(pSurf->pSurface, pBS);
-                    break;
+                            sts = NV12asI420toBS(pSurf->pSurface, pBS);
+                        break;
+                    case MFX_FOURCC_NV12:
+                        sts = NV12toBS(pSurf->pSurface, pBS);
+                        break;
+                    case MFX_FOURCC_RGB4:
+                        sts = RGB4toBS(pSurf->pSurface, pBS);
+                        break;
+                    case MFX_FOURCC_YUY2:
+                        sts = YUY2toBS(pSurf->pSurface, pBS);
+                        break;
+                }
+                MSDK_CHECK_STATUS(sts, "<FourCC>toBS failed");
             }
-            MSDK_CHECK_STATUS(sts, "<FourCC>toBS failed");
 
             if (m_MemoryModel == GENERAL_ALLOC) {
                 sts = m_pMFXAllocator->Unlock(m_pMFXAllocator->pthis,
@@ -3208,7 +3266,11 @@ mfxStatus CTranscodingPipeline::AllocFrames(mfxFrameAllocRequest* pRequest, bool
     mfxU16 nSurfNum = 0; // number of surfaces
     mfxU16 i;
 
-    nSurfNum = pRequest->NumFrameMin = pRequest->NumFrameSuggested;
+    msdk_string poolName        = isDecAlloc ? MSDK_STRING("dec") : MSDK_STRING("enc");
+    mfxU16 requested            = pRequest->NumFrameSuggested;
+    pRequest->NumFrameSuggested = GetTunedPoolSize(poolName, requested, pRequest->NumFrameMin);
+
+    nSurfNum = pRequest->NumFrameSuggested;
     msdk_printf(MSDK_STRING("Pipeline surfaces number (%s): %d\n"),
                 isDecAlloc ? MSDK_STRING("DecPool") : MSDK_STRING("EncPool"),
                 (int)nSurfNum);
@@ -3239,6 +3301,8 @@ mfxStatus CTranscodingPipeline::AllocFrames(mfxFrameAllocRequest* pRequest, bool
 
     (isDecAlloc) ? m_DecSurfaceType = pRequest->Type : m_EncSurfaceType = pRequest->Type;
 
+    RegisterSurfacePool(poolName, requested, nSurfNum, pRequest->Info);
+
     return MFX_ERR_NONE;
 
 } // mfxStatus CTranscodingPipeline::AllocFrames(Component* pComp, mfxFrameAllocResponse* pMfxResponse, mfxVideoParam* pMfxVideoParam)
@@ -3255,6 +3319,12 @@ mfxStatus CTranscodingPipeline::AllocFramesForCS() {
             continue;
         }
 
+        msdk_stringstream poolName;
+        poolName << MSDK_STRING("cs") << PoolDesc.ID;
+        mfxU16 requested = PoolDesc.AllocReq.NumFrameSuggested;
+        PoolDesc.AllocReq.NumFrameSuggested =
+            GetTunedPoolSize(poolName.str(), requested, PoolDesc.AllocReq.NumFrameMin);
+
         mfxStatus sts = MFX_ERR_NONE;
         sts =
             m_pMFXAllocator->Alloc(m_pMFXAllocator->pthis, &PoolDesc.AllocReq, &PoolDesc.AllocResp);
@@ -3270,6 +3340,10 @@ mfxStatus CTranscodingPipeline::AllocFramesForCS() {
             m_EncSurfaceType = PoolDesc.AllocReq.Type;
         }
         m_CSSurfacePools[PoolDesc.ID] = pool;
+        RegisterSurfacePool(poolName.str(),
+                            requested,
+                            PoolDesc.AllocResp.NumFrameActual,
+                            PoolDesc.AllocReq.Info);
     }
 
     return MFX_ERR_NONE;
@@ -3690,6 +3764,9 @@ mfxStatus CTranscodingPipeline::Init(sInputParams* pParams,
 
     m_forceSyncAllSession = pParams->forceSyncAllSession == MFX_CODINGOPTION_ON;
 
+    m_TunedPoolSizes = pParams->TunedPoolSizes;
+    m_nPoolWarmup    = pParams->nPoolWarmup;
+
     statisticsWindowSize = pParams->statisticsWindowSize;
     if (statisticsWindowSize > m_MaxFramesForTranscode)
         statisticsWindowSize = m_MaxFramesForTranscode;
@@ -3880,6 +3957,9 @@ mfxStatus CTranscodingPipeline::Init(sInputParams* pParams,
                 m_mfxDecParams.mfx.FrameInfo.FrameRateExtD;
             CSConfig.Targets[0].SrcPicStruct = m_mfxDecParams.mfx.FrameInfo.PicStruct;
             CSConfig.PropagateCascadeParameters();
+            if (CSConfig.CascadeScalerRequired) {
+                CSConfig.PrintPlan();
+            }
             m_ScalerConfig = CSConfig;
         }
     }
@@ -3920,6 +4000,16 @@ mfxStatus CTranscodingPipeline::Init(sInputParams* pParams,
         MSDK_CHECK_STATUS(sts, "EncodePreInit failed");
     }
 
+    if (msdk_strlen(pParams->strHashFile) || msdk_strlen(pParams->strGoldenHashFile)) {
+        if (pParams->EncodeId != MFX_CODEC_DUMP) {
+            msdk_printf(MSDK_STRING("error: -hash options require raw output (-o::raw)\n"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+        m_pHashWriter.reset(new CSmplHashWriter);
+        sts = m_pHashWriter->Init(pParams->strHashFile, pParams->strGoldenHashFile);
+        MSDK_CHECK_STATUS(sts, "m_pHashWriter->Init failed");
+    }
+
     if ((pParams->eMode == Source) &&
         ((m_nVPPCompEnable == VppCompOnly) || (m_nVPPCompEnable == VppCompOnlyEncode) ||
          (m_nVPPCompEnable == VppComp))) {
@@ -4148,18 +4238,20 @@ mfxFrameSurface1* CTranscodingPipeline::GetFreeSurface(bool isDec, mfxU64 timeou
             TargetID,
             SMTTracer::EventName::UNDEF,
             available);
-
-        for (mfxU32 i = 0; i < workArray.size(); i++) {
-            if (!workArray[i]->Data.Locked) {
-                pSurf = workArray[i];
-                break;
-            }
-        }
+        (isDec ? m_Metrics.DecPoolUsed : m_Metrics.EncPoolUsed)
+            .store((mfxU32)workArray.size() - available, std::memory_order_relaxed);
+        (isDec ? m_Metrics.DecPoolSize : m_Metrics.EncPoolSize)
+            .store((mfxU32)workArray.size(), std::memory_order_relaxed);
+
+        pSurf = AcquireSurface(isDec ? MSDK_STRING("dec") : MSDK_STRING("enc"),
+                               workArray,
+                               available);
         if (pSurf) {
             break;
         }
         else {
             MSDK_SLEEP(TIME_TO_SLEEP);
+            m_Metrics.SurfaceWaits.fetch_add(1, std::memory_order_relaxed);
         }
     } while (t.GetTime() < timeout / 1000);
 
@@ -4197,23 +4289,91 @@ mfxFrameSurface1* CTranscodingPipeline::GetFreeSurfaceForCS(bool isDec, mfxU64 t
                                                SMTTracer::EventName::UNDEF,
                                                available);
 
-        for (mfxU32 i = 0; i < workArray.size(); i++) {
-            if (!workArray[i]->Data.Locked) {
-                pSurf = workArray[i];
-                break;
-            }
-        }
+        msdk_stringstream poolName;
+        poolName << MSDK_STRING("cs") << desc.PoolID;
+        pSurf = AcquireSurface(poolName.str(), workArray, available);
         if (pSurf) {
             break;
         }
         else {
             MSDK_SLEEP(TIME_TO_SLEEP);
+            m_Metrics.SurfaceWaits.fetch_add(1, std::memory_order_relaxed);
         }
     } while (t.GetTime() < timeout / 1000);
 
     return pSurf;
 }
 
+mfxFrameSurface1* CTranscodingPipeline::AcquireSurface(const msdk_string& pool,
+                                                      SurfPointersArray& workArray,
+                                                      mfxU32 available) {
+    auto it = m_PoolUsage.find(pool);
+    if (it == m_PoolUsage.end()) {
+        for (auto s : workArray) {
+            if (!s->Data.Locked)
+                return s;
+        }
+        return NULL;
+    }
+    SurfacePoolUsage& usage = it->second;
+
+    // surfaces beyond the active part of a shrunk pool are used only if the active part is busy
+    mfxFrameSurface1* pSurf = NULL;
+    for (mfxU32 i = 0; i < workArray.size() && !pSurf; i++) {
+        if (workArray[i]->Data.Locked)
+            continue;
+        pSurf = workArray[i];
+        if (i >= usage.Active) {
+            usage.Active = i + 1;
+            usage.Grown++;
+        }
+    }
+    if (!pSurf)
+        return NULL;
+
+    usage.Acquired++;
+    usage.Peak = std::max(usage.Peak, (mfxU32)workArray.size() - available + 1);
+
+    if (m_nPoolWarmup && usage.Acquired == m_nPoolWarmup &&
+        usage.GetTunedSize() < usage.Active) {
+        usage.Active = usage.GetTunedSize();
+        msdk_printf(MSDK_STRING("[%s] pool %s: peak %u of %u surfaces after %u requests, ")
+                        MSDK_STRING("shrinking to %u\n"),
+                    GetSessionText().c_str(),
+                    pool.c_str(),
+                    usage.Peak,
+                    usage.Allocated,
+                    usage.Acquired,
+                    usage.Active);
+    }
+
+    return pSurf;
+}
+
+mfxU16 CTranscodingPipeline::GetTunedPoolSize(const msdk_string& pool,
+                                              mfxU16 requested,
+                                              mfxU16 minimum) {
+    auto it = m_TunedPoolSizes.find(pool);
+    // tuning only shrinks pools, QueryIOSurf and AsyncDepth define the upper limit. Tuning file
+    // may come from a run with other parameters, so pool never goes below NumFrameMin of the
+    // component.
+    if (it == m_TunedPoolSizes.end() || it->second >= requested)
+        return requested;
+    return (mfxU16)std::min<mfxU32>(std::max<mfxU32>({ it->second, minimum, 2 }), requested);
+}
+
+void CTranscodingPipeline::RegisterSurfacePool(const msdk_string& pool,
+                                               mfxU16 requested,
+                                               mfxU16 allocated,
+                                               const mfxFrameInfo& info) {
+    SurfacePoolUsage& usage = m_PoolUsage[pool];
+    usage.Requested         = requested;
+    usage.Allocated         = allocated;
+    usage.Active            = allocated;
+    usage.FrameSize         = 0;
+    GetFrameLength(info.Width, info.Height, info.FourCC, usage.FrameSize);
+}
+
 mfxU32 CTranscodingPipeline::GetFreeSurfacesCount(bool isDec) {
     SurfPointersArray& workArray = isDec ? m_pSurfaceDecPool : m_pSurfaceEncPool;
     mfxU32 count                 = 0;
@@ -4550,6 +4710,11 @@ mfxStatus CTranscodingPipeline::Run() {
     else
         return MFX_ERR_UNSUPPORTED;
 
+    if (m_pHashWriter) {
+        sts = m_pHashWriter->Finish();
+        MSDK_CHECK_STATUS(sts, "m_pHashWriter->Finish failed");
+    }
+
     return sts;
 }
 
@@ -4570,6 +4735,7 @@ void DecreaseReference(mfxFrameSurface1& surf) {
 SafetySurfaceBuffer::SafetySurfaceBuffer(SafetySurfaceBuffer* pNext)
         : m_pNext(pNext),
           m_IsBufferingAllowed(true),
+          m_Depth(0),
           pInsEvent(nullptr) {
     mfxStatus sts = MFX_ERR_NONE;
     pRelEvent     = new MSDKEvent(sts, false, false);
@@ -4590,6 +4756,10 @@ mfxU32 SafetySurfaceBuffer::GetLength() {
     return (mfxU32)m_SList.size();
 }
 
+mfxU32 SafetySurfaceBuffer::GetDepth() {
+    return m_Depth;
+}
+
 mfxStatus SafetySurfaceBuffer::WaitForSurfaceRelease(mfxU32 msec) {
     return pRelEvent->TimedWait(msec);
 }
@@ -4616,6 +4786,7 @@ void SafetySurfaceBuffer::AddSurface(ExtendedSurface Surf) {
             }
 
             m_SList.push_back(sDescriptor);
+            m_Depth = (mfxU32)m_SList.size();
         }
     }
 
@@ -4653,6 +4824,7 @@ mfxStatus SafetySurfaceBuffer::ReleaseSurface(mfxFrameSurface1* pSurf) {
                 DecreaseReference(*it->ExtSurface.pSurface);
             if (0 == it->Locked) {
                 m_SList.erase(it);
+                m_Depth = (mfxU32)m_SList.size();
                 lock.unlock();
 
                 // event operation should be out of synced context
@@ -4670,6 +4842,7 @@ mfxStatus SafetySurfaceBuffer::ReleaseSurfaceAll() {
     std::lock_guard<std::mutex> guard(m_mutex);
 
     m_SList.clear();
+    m_Depth              = 0;
     m_IsBufferingAllowed = true;
     return MFX_ERR_NONE;
 
@@ -19,13 +19,43 @@
     #error MFX_VERSION not defined
 #endif
 
+#include <fstream>
 #include <future>
 #include <iomanip>
+#include <limits>
 #include <memory>
+#include <sstream>
 
 using namespace std;
 using namespace TranscodingSample;
 
+// Formats CPU list in the Linux cpulist format, e.g. "0-3,8"
+static msdk_string FormatCpuList(const std::vector<mfxU32>& cpus) {
+    msdk_stringstream ss;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        if (i)
+            ss << MSDK_STRING(",");
+        ss << cpus[i];
+        if (j > i)
+            ss << MSDK_STRING("-") << cpus[j];
+        i = j + 1;
+    }
+    return ss.str();
+}
+
+// Formats percentiles of per-frame times in ms, e.g. "p50 1.234 p90 2.345 ..."
+static msdk_string FormatPercentiles(CTimeStatistics& stat) {
+    msdk_stringstream ss;
+    ss << std::fixed << std::setprecision(3) << MSDK_STRING("p50 ") << stat.GetPercentile(50, false)
+       << MSDK_STRING(" p90 ") << stat.GetPercentile(90, false) << MSDK_STRING(" p99 ")
+       << stat.GetPercentile(99, false) << MSDK_STRING(" p99.9 ")
+       << stat.GetPercentile(99.9, false) << MSDK_STRING(" ms");
+    return ss.str();
+}
+
 Launcher::Launcher()
         : m_parser(),
           m_pThreadContextArray(),
@@ -41,7 +71,11 @@ Launcher::Launcher()
           m_pLoader(),
           m_VppDstRects(),
           m_CSConfig(),
-          m_Tracer() {} // Launcher::Launcher()
+          m_Tracer(),
+          m_hdls(),
+          m_pControl(),
+          m_bControlQuit(false),
+          m_pMetrics() {} // Launcher::Launcher()
 
 Launcher::~Launcher() {
     Close();
@@ -59,7 +93,6 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
     SafetySurfaceBuffer* pBuffer = NULL;
     mfxU32 BufCounter            = 0;
     mfxHDL hdl                   = NULL;
-    std::vector<mfxHDL> hdls;
     sInputParams InputParams;
     bool bNeedToCreateDevice = true;
     bool lowLatencyMode      = true;
@@ -90,6 +123,14 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
     sts = VerifyCrossSessionsOptions();
     MSDK_CHECK_STATUS(sts, "VerifyCrossSessionsOptions failed");
 
+    sts = ResolveSessionPlacement();
+    MSDK_CHECK_STATUS(sts, "ResolveSessionPlacement failed");
+
+    if (!m_parser.GetPoolImportFile().empty()) {
+        sts = LoadPoolTuning(m_parser.GetPoolImportFile());
+        MSDK_CHECK_STATUS(sts, "LoadPoolTuning failed");
+    }
+
     m_pLoader.reset(new VPLImplementationLoader);
 
     if (m_InputParamsArray[0].dispFullSearch == true)
@@ -167,12 +208,12 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
 
                 m_pAllocParams.push_back(pAllocParam);
                 m_hwdevs.push_back(std::move(hwdev));
-                hdls.push_back(hdl);
+                m_hdls.push_back(hdl);
             }
             else {
-                if (!m_pAllocParams.empty() && !hdls.empty()) {
+                if (!m_pAllocParams.empty() && !m_hdls.empty()) {
                     m_pAllocParams.push_back(m_pAllocParams.back());
-                    hdls.push_back(hdls.back());
+                    m_hdls.push_back(m_hdls.back());
                 }
                 else {
                     msdk_printf(MSDK_STRING("error: failed to initialize alloc parameters\n"));
@@ -209,12 +250,12 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
 
                 m_pAllocParams.push_back(pAllocParam);
                 m_hwdevs.push_back(std::move(hwdev));
-                hdls.push_back(hdl);
+                m_hdls.push_back(hdl);
             }
             else {
-                if (!m_pAllocParams.empty() && !hdls.empty()) {
+                if (!m_pAllocParams.empty() && !m_hdls.empty()) {
                     m_pAllocParams.push_back(m_pAllocParams.back());
-                    hdls.push_back(hdls.back());
+                    m_hdls.push_back(m_hdls.back());
                 }
                 else {
                     msdk_printf(MSDK_STRING("error: failed to initialize alloc parameters\n"));
@@ -305,12 +346,12 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
 
                 m_pAllocParams.push_back(std::shared_ptr<mfxAllocatorParams>(pAllocParam));
                 m_hwdevs.push_back(std::move(hwdev));
-                hdls.push_back(hdl);
+                m_hdls.push_back(hdl);
             }
             else {
-                if (!m_pAllocParams.empty() && !hdls.empty()) {
+                if (!m_pAllocParams.empty() && !m_hdls.empty()) {
                     m_pAllocParams.push_back(m_pAllocParams.back());
-                    hdls.push_back(hdls.back());
+                    m_hdls.push_back(m_hdls.back());
                 }
                 else {
                     msdk_printf(MSDK_STRING("error: failed to initialize alloc parameters\n"));
@@ -322,11 +363,11 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
     }
     if (m_pAllocParams.empty()) {
         m_pAllocParams.push_back(std::make_shared<mfxAllocatorParams>());
-        hdls.push_back(NULL);
+        m_hdls.push_back(NULL);
 
         for (i = 1; i < m_InputParamsArray.size(); i++) {
             m_pAllocParams.push_back(m_pAllocParams.back());
-            hdls.push_back(NULL);
+            m_hdls.push_back(NULL);
         }
     }
 
@@ -355,7 +396,8 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
     for (i = 0; i < m_InputParamsArray.size(); i++) {
         msdk_printf(MSDK_STRING("Session %d:\n"), (int)i);
         auto pAllocator = std::make_unique<GeneralAllocator>();
-        sts             = pAllocator->Init(m_pAllocParams[i].get());
+        pAllocator->SetSystemMemoryNumaNode(m_InputParamsArray[i].NumaNode);
+        sts = pAllocator->Init(m_pAllocParams[i].get());
         MSDK_CHECK_STATUS(sts, "pAllocator->Init failed");
 
         m_pAllocArray.push_back(std::move(pAllocator));
@@ -372,52 +414,8 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
 
         pThreadPipeline->pBSProcessor = m_pExtBSProcArray.back().get();
 
-        std::unique_ptr<CSmplBitstreamReader> reader;
-        std::unique_ptr<CSmplYUVReader> yuvreader;
-        if (m_InputParamsArray[i].DecodeId == MFX_CODEC_VP9 ||
-            m_InputParamsArray[i].DecodeId == MFX_CODEC_VP8 ||
-            m_InputParamsArray[i].DecodeId == MFX_CODEC_AV1) {
-            reader.reset(new CIVFFrameReader());
-        }
-        else if (m_InputParamsArray[i].DecodeId == MFX_CODEC_RGB4 ||
-                 m_InputParamsArray[i].DecodeId == MFX_CODEC_I420 ||
-                 m_InputParamsArray[i].DecodeId == MFX_CODEC_NV12 ||
-                 m_InputParamsArray[i].DecodeId == MFX_CODEC_P010) {
-            // YUV reader for RGB4 overlay and raw input
-            yuvreader.reset(new CSmplYUVReader());
-        }
-        else {
-            reader.reset(new CSmplBitstreamReader());
-        }
-
-        if (reader.get()) {
-            sts = reader->Init(m_InputParamsArray[i].strSrcFile);
-            if (sts == MFX_ERR_UNSUPPORTED && m_InputParamsArray[i].DecodeId == MFX_CODEC_AV1) {
-                reader.reset(new CSmplBitstreamReader());
-                msdk_printf(MSDK_STRING("WARNING: Stream is not IVF, default reader\n"));
-            }
-            MSDK_CHECK_STATUS(sts, "reader->Init failed");
-            sts = m_pExtBSProcArray.back()->SetReader(reader);
-            MSDK_CHECK_STATUS(sts, "m_pExtBSProcArray.back()->SetReader failed");
-        }
-        else if (yuvreader.get()) {
-            std::list<msdk_string> input;
-            input.push_back(m_InputParamsArray[i].strSrcFile);
-            sts = yuvreader->Init(input, m_InputParamsArray[i].DecodeId);
-            MSDK_CHECK_STATUS(sts, "m_YUVReader->Init failed");
-            sts = m_pExtBSProcArray.back()->SetReader(yuvreader);
-            MSDK_CHECK_STATUS(sts, "m_pExtBSProcArray.back()->SetReader failed");
-        }
-
-        if (msdk_strncmp(MSDK_STRING("null"),
-                         m_InputParamsArray[i].strDstFile,
-                         msdk_strlen(MSDK_STRING("null")))) {
-            auto writer = std::make_unique<CSmplBitstreamWriter>();
-            sts         = writer->Init(m_InputParamsArray[i].strDstFile);
-
-            sts = m_pExtBSProcArray.back()->SetWriter(writer);
-            MSDK_CHECK_STATUS(sts, "m_pExtBSProcArray.back()->SetWriter failed");
-        }
+        sts = InitBitstreamProcessor(m_InputParamsArray[i], m_pExtBSProcArray.back().get());
+        MSDK_CHECK_STATUS(sts, "InitBitstreamProcessor failed");
 
         if (Sink == m_InputParamsArray[i].eMode) {
             /* N_to_1 mode */
@@ -479,7 +477,7 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
         }
         sts = pThreadPipeline->pPipeline->Init(&m_InputParamsArray[i],
                                                m_pAllocArray[i].get(),
-                                               hdls[i],
+                                               m_hdls[i],
                                                pipeline,
                                                pBuffer,
                                                m_pExtBSProcArray.back().get(),
@@ -494,7 +492,9 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
         // set the session's start status (like it is waiting)
         pThreadPipeline->startStatus = MFX_WRN_DEVICE_BUSY;
         // set other session's parameters
-        pThreadPipeline->implType = m_InputParamsArray[i].libType;
+        pThreadPipeline->implType    = m_InputParamsArray[i].libType;
+        pThreadPipeline->cpuAffinity = m_InputParamsArray[i].CpuAffinity;
+        pThreadPipeline->numaNode    = m_InputParamsArray[i].NumaNode;
         m_pThreadContextArray.push_back(std::move(pThreadPipeline));
 
         mfxVersion ver = { { 0, 0 } };
@@ -535,10 +535,81 @@ mfxStatus Launcher::Init(int argc, msdk_char* argv[]) {
 
     msdk_printf(MSDK_STRING("\n"));
 
+    if (!m_parser.GetControlSocketPath().empty()) {
+#if defined(_WIN32) || defined(_WIN64)
+        msdk_printf(MSDK_STRING("error: -ctrl_socket is supported on Linux only\n"));
+        return MFX_ERR_UNSUPPORTED;
+#else
+        m_pControl = std::make_unique<SMTControlServer>();
+        sts        = m_pControl->Start(m_parser.GetControlSocketPath());
+        MSDK_CHECK_STATUS(sts, "m_pControl->Start failed");
+        msdk_printf(MSDK_STRING("Control socket: %s\n\n"), m_parser.GetControlSocketPath().c_str());
+#endif
+    }
+
+    if (!m_parser.GetMetricsFile().empty()) {
+        m_pMetrics = std::make_unique<SMTMetricsWriter>(m_parser.GetMetricsFile(),
+                                                        m_parser.GetMetricsInterval());
+    }
+
     return sts;
 
 } // mfxStatus Launcher::Init()
 
+mfxStatus Launcher::InitBitstreamProcessor(sInputParams& params,
+                                           FileBitstreamProcessor* pBSProcessor) {
+    mfxStatus sts = MFX_ERR_NONE;
+    MSDK_CHECK_POINTER(pBSProcessor, MFX_ERR_NULL_PTR);
+
+    std::unique_ptr<CSmplBitstreamReader> reader;
+    std::unique_ptr<CSmplYUVReader> yuvreader;
+    if (params.DecodeId == MFX_CODEC_VP9 || params.DecodeId == MFX_CODEC_VP8 ||
+        params.DecodeId == MFX_CODEC_AV1) {
+        reader.reset(new CIVFFrameReader());
+    }
+    else if (params.DecodeId == MFX_CODEC_RGB4 || params.DecodeId == MFX_CODEC_I420 ||
+             params.DecodeId == MFX_CODEC_NV12 || params.DecodeId == MFX_CODEC_P010) {
+        // YUV reader for RGB4 overlay and raw input
+        yuvreader.reset(new CSmplYUVReader());
+    }
+    else {
+        reader.reset(new CSmplBitstreamReader());
+    }
+
+    if (reader.get()) {
+        sts = reader->Init(params.strSrcFile);
+        if (sts == MFX_ERR_UNSUPPORTED && params.DecodeId == MFX_CODEC_AV1) {
+            reader.reset(new CSmplBitstreamReader());
+            msdk_printf(MSDK_STRING("WARNING: Stream is not IVF, default reader\n"));
+        }
+        MSDK_CHECK_STATUS(sts, "reader->Init failed");
+        sts = pBSProcessor->SetReader(reader);
+        MSDK_CHECK_STATUS(sts, "pBSProcessor->SetReader failed");
+    }
+    else if (yuvreader.get()) {
+        std::list<msdk_string> input;
+        input.push_back(params.strSrcFile);
+        yuvreader->SetUseInputCache(params.bInputCache);
+        sts = yuvreader->Init(input, params.DecodeId);
+        MSDK_CHECK_STATUS(sts, "m_YUVReader->Init failed");
+        sts = pBSProcessor->SetReader(yuvreader);
+        MSDK_CHECK_STATUS(sts, "pBSProcessor->SetReader failed");
+    }
+
+    // raw frames are hashed by the pipeline, nothing is written
+    bool bHashOutput = msdk_strlen(params.strHashFile) || msdk_strlen(params.strGoldenHashFile);
+    if (!bHashOutput &&
+        msdk_strncmp(MSDK_STRING("null"), params.strDstFile, msdk_strlen(MSDK_STRING("null")))) {
+        auto writer = std::make_unique<CSmplBitstreamWriter>();
+        sts         = writer->Init(params.strDstFile);
+
+        sts = pBSProcessor->SetWriter(writer);
+        MSDK_CHECK_STATUS(sts, "pBSProcessor->SetWriter failed");
+    }
+
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::InitBitstreamProcessor()
+
 void Launcher::Run() {
     msdk_printf(MSDK_STRING("Transcoding started\n"));
 
@@ -553,17 +624,21 @@ void Launcher::Run() {
         DoTranscoding();
     }
 
+    // the final values stay in the file after the run
+    UpdateMetrics(true);
+
     msdk_printf(MSDK_STRING("\nTranscoding finished\n"));
 
 } // mfxStatus Launcher::Init()
 
-void Launcher::DoTranscoding() {
-    auto RunTranscodeRoutine = [](ThreadTranscodeContext* context) {
-        context->handle = std::async(std::launch::async, [context]() {
-            context->TranscodeRoutine();
-        });
-    };
+static void RunTranscodeRoutine(ThreadTranscodeContext* context) {
+    context->launchTick = GetTick();
+    context->handle     = std::async(std::launch::async, [context]() {
+        context->TranscodeRoutine();
+    });
+}
 
+void Launcher::DoTranscoding() {
     bool isOverlayUsed = false;
     for (const auto& context : m_pThreadContextArray) {
         MSDK_CHECK_POINTER_NO_RET(context);
@@ -574,13 +649,16 @@ void Launcher::DoTranscoding() {
     }
 
     // Transcoding threads waiting cycle
+    // With a control socket the application lives until 'quit' even without running sessions
     bool aliveNonOverlaySessions = true;
-    while (aliveNonOverlaySessions) {
+    while (aliveNonOverlaySessions || (m_pControl && !m_bControlQuit)) {
         aliveNonOverlaySessions = false;
+        bool waited             = false;
 
         for (size_t i = 0; i < m_pThreadContextArray.size(); ++i) {
             if (!m_pThreadContextArray[i]->handle.valid())
                 continue;
+            waited = true;
 
             //Payslip interval to check the state of working threads:
             //such interval is usually a realtime, i.e. for 30 fps this would be 33ms,
@@ -595,8 +673,10 @@ void Launcher::DoTranscoding() {
                 if (m_pThreadContextArray[i]->transcodingSts < MFX_ERR_NONE) {
                     // Stop all the sessions if an error happened in one
                     // But do not stop in robust mode when gpu hang's happened
-                    if (m_pThreadContextArray[i]->transcodingSts != MFX_ERR_GPU_HANG ||
-                        !m_pThreadContextArray[i]->pPipeline->GetRobustFlag()) {
+                    // Sessions managed through the control socket fail independently
+                    if (!m_pControl &&
+                        (m_pThreadContextArray[i]->transcodingSts != MFX_ERR_GPU_HANG ||
+                         !m_pThreadContextArray[i]->pPipeline->GetRobustFlag())) {
                         msdk_stringstream ss;
                         ss << MSDK_STRING("\n\n session ") << i << MSDK_STRING(" [")
                            << m_pThreadContextArray[i]->pPipeline->GetSessionText()
@@ -625,6 +705,8 @@ void Launcher::DoTranscoding() {
                 aliveNonOverlaySessions = aliveNonOverlaySessions ||
                                           !m_pThreadContextArray[i]->pPipeline->IsOverlayUsed();
             }
+
+            UpdateMetrics(false);
         }
 
         // Stop overlay sessions
@@ -646,9 +728,179 @@ void Launcher::DoTranscoding() {
                 context->handle.wait();
             }
         }
+
+        if (m_pControl) {
+            if (!waited) {
+                MSDK_SLEEP(66);
+                UpdateMetrics(false);
+            }
+            m_pControl->ProcessCommands([this](const std::string& line) {
+                return ExecuteControlCommand(line);
+            });
+        }
     }
 }
 
+void Launcher::UpdateMetrics(bool force) {
+    if (!m_pMetrics || (!force && !m_pMetrics->IsDue()))
+        return;
+
+    std::vector<SMTMetricsSample> samples;
+    for (mfxU32 i = 0; i < m_pThreadContextArray.size(); i++) {
+        CTranscodingPipeline* pPipeline = m_pThreadContextArray[i]->pPipeline.get();
+        samples.push_back({ i, &pPipeline->GetMetrics(), pPipeline->GetBufferDepth() });
+    }
+
+    mfxStatus sts = m_pMetrics->Write(samples);
+    if (sts != MFX_ERR_NONE) {
+        msdk_printf(MSDK_STRING("WARNING: failed to write metrics file %s, metrics disabled\n"),
+                    m_parser.GetMetricsFile().c_str());
+        m_pMetrics.reset();
+    }
+}
+
+std::string Launcher::ExecuteControlCommand(const std::string& line) {
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+
+    std::ostringstream reply;
+    if (cmd == "start") {
+        std::string parLine;
+        std::getline(in, parLine);
+
+        mfxU32 id     = 0;
+        mfxStatus sts = StartSession(msdk_string(parLine.begin(), parLine.end()), id);
+        if (sts == MFX_ERR_NONE)
+            reply << "OK " << id << "\n";
+        else
+            reply << "ERR failed to start session, status " << sts << "\n";
+    }
+    else if (cmd == "stop") {
+        mfxU32 id = 0;
+        if (!(in >> id) || id >= m_pThreadContextArray.size()) {
+            reply << "ERR invalid session id\n";
+        }
+        else {
+            m_pThreadContextArray[id]->pPipeline->StopSession();
+            reply << "OK\n";
+        }
+    }
+    else if (cmd == "stats") {
+        mfxU32 id = 0;
+        if (in >> id) {
+            if (id < m_pThreadContextArray.size())
+                reply << GetSessionStats(id) << "OK\n";
+            else
+                reply << "ERR invalid session id\n";
+        }
+        else {
+            for (mfxU32 i = 0; i < m_pThreadContextArray.size(); i++)
+                reply << GetSessionStats(i);
+            reply << "OK\n";
+        }
+    }
+    else if (cmd == "quit") {
+        m_bControlQuit = true;
+        reply << "OK\n";
+    }
+    else {
+        reply << "ERR unknown command, expected start|stop|stats|quit\n";
+    }
+
+    return reply.str();
+} // std::string Launcher::ExecuteControlCommand()
+
+std::string Launcher::GetSessionStats(mfxU32 id) {
+    const auto& context = m_pThreadContextArray[id];
+    bool running        = context->handle.valid();
+
+    // frame counter of a running session is read without synchronization, it's approximate
+    mfxU32 frames = running ? context->pPipeline->GetProcessFrames() : context->numTransFrames;
+    mfxF64 time   = running ? GetTime(context->launchTick) : context->working_time;
+
+    std::ostringstream ss;
+    ss << id << " " << (running ? "running" : "finished") << " frames=" << frames
+       << " time=" << std::fixed << std::setprecision(3) << time
+       << " fps=" << std::setprecision(2) << (time > 0 ? frames / time : 0.);
+    if (!running) {
+        msdk_string sts = StatusToString(context->transcodingSts);
+        ss << " status=" << std::string(sts.begin(), sts.end());
+    }
+    msdk_string text = context->pPipeline->GetSessionText();
+    ss << " [" << std::string(text.begin(), text.end()) << "]\n";
+
+    return ss.str();
+} // std::string Launcher::GetSessionStats()
+
+mfxStatus Launcher::StartSession(const msdk_string& line, mfxU32& id) {
+    sInputParams params;
+    mfxStatus sts = m_parser.ParseSessionLine(line, params);
+    MSDK_CHECK_STATUS(sts, "m_parser.ParseSessionLine failed");
+
+    // shared buffers and joining are set up for the whole session set at start
+    if (params.eMode != Native || params.bIsJoin || params.eModeExt != Native) {
+        msdk_printf(MSDK_STRING(
+            "error: only independent sessions (no -o::sink/-i::source/-join) can be added\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    id              = (mfxU32)m_pThreadContextArray.size();
+    params.TargetID = DecoderTargetID + id;
+
+    // the session continues the round-robin of -numa_auto after the ones started at launch
+    mfxU32 autoIdx = id;
+    sts            = ResolveSessionPlacement(params, id, autoIdx);
+    MSDK_CHECK_STATUS(sts, "ResolveSessionPlacement failed");
+
+    // loader, device and allocator parameters are the ones of the first session
+    auto pAllocator = std::make_unique<GeneralAllocator>();
+    pAllocator->SetSystemMemoryNumaNode(params.NumaNode);
+    sts = pAllocator->Init(m_pAllocParams[0].get());
+    MSDK_CHECK_STATUS(sts, "pAllocator->Init failed");
+
+    auto pBSProcessor = std::make_unique<FileBitstreamProcessor>();
+    sts               = InitBitstreamProcessor(params, pBSProcessor.get());
+    MSDK_CHECK_STATUS(sts, "InitBitstreamProcessor failed");
+
+    auto pThreadPipeline = std::make_unique<ThreadTranscodeContext>();
+    pThreadPipeline->pPipeline.reset(CreatePipeline());
+    pThreadPipeline->pPipeline->SetAdapterType(m_pLoader->GetAdapterType());
+    pThreadPipeline->pPipeline->SetPrefferdGfx(params.dGfxIdx);
+    pThreadPipeline->pPipeline->SetAdapterNum(m_pLoader->GetDeviceIDAndAdapter().second);
+    pThreadPipeline->pBSProcessor = pBSProcessor.get();
+
+    sts = pThreadPipeline->pPipeline->Init(&params,
+                                           pAllocator.get(),
+                                           m_hdls[0],
+                                           NULL,
+                                           NULL,
+                                           pBSProcessor.get(),
+                                           m_pLoader.get(),
+                                           CreateCascadeScalerConfig());
+    MSDK_CHECK_STATUS(sts, "pThreadPipeline->pPipeline->Init failed");
+
+    sts = pThreadPipeline->pPipeline->CompleteInit();
+    MSDK_CHECK_STATUS(sts, "pThreadPipeline->pPipeline->CompleteInit failed");
+    pThreadPipeline->pPipeline->SetPipelineID(id);
+
+    pThreadPipeline->startStatus = MFX_WRN_DEVICE_BUSY;
+    pThreadPipeline->implType    = params.libType;
+    pThreadPipeline->cpuAffinity = params.CpuAffinity;
+    pThreadPipeline->numaNode    = params.NumaNode;
+
+    m_pAllocArray.push_back(std::move(pAllocator));
+    m_pExtBSProcArray.push_back(std::move(pBSProcessor));
+    m_InputParamsArray.push_back(params);
+    m_pThreadContextArray.push_back(std::move(pThreadPipeline));
+    m_parser.AddLine(line);
+
+    msdk_printf(MSDK_STRING("Session %d was added through the control socket\n"), (int)id);
+    RunTranscodeRoutine(m_pThreadContextArray.back().get());
+
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::StartSession()
+
 void Launcher::DoRobustTranscoding() {
     mfxStatus sts = MFX_ERR_NONE;
 
@@ -698,9 +950,15 @@ mfxStatus Launcher::ProcessResult() {
     }
 
     mfxStatus FinalSts = MFX_ERR_NONE;
+
+    bool poolTuning = m_InputParamsArray[0].nPoolWarmup || !m_parser.GetPoolImportFile().empty() ||
+                      !m_parser.GetPoolExportFile().empty();
     msdk_printf(MSDK_STRING(
         "-------------------------------------------------------------------------------\n"));
 
+    // output statistics of all sessions, they are collected with -stat only
+    CTimeStatistics outputStatistics;
+
     for (mfxU32 i = 0; i < m_pThreadContextArray.size(); i++) {
         mfxStatus transcodingSts = m_pThreadContextArray[i]->transcodingSts;
         mfxF64 workTime          = m_pThreadContextArray[i]->working_time;
@@ -718,9 +976,26 @@ mfxStatus Launcher::ProcessResult() {
            << SessionStsStr << MSDK_STRING(" (") << StatusToString(transcodingSts)
            << MSDK_STRING(") ") << workTime << MSDK_STRING(" sec, ") << framesNum
            << MSDK_STRING(" frames, ") << std::fixed << std::setprecision(3) << framesNum / workTime
-           << MSDK_STRING(" fps") << std::endl
-           << m_parser.GetLine(i) << std::endl
-           << std::endl;
+           << MSDK_STRING(" fps") << std::endl;
+        if (!m_pThreadContextArray[i]->cpuAffinity.empty()) {
+            ss << MSDK_STRING("    placement: numa node ");
+            if (m_pThreadContextArray[i]->numaNode >= 0)
+                ss << m_pThreadContextArray[i]->numaNode;
+            else
+                ss << MSDK_STRING("any");
+            ss << MSDK_STRING(", cpus ") << FormatCpuList(m_pThreadContextArray[i]->cpuAffinity)
+               << std::endl;
+        }
+        if (poolTuning)
+            ss << FormatPoolUsage(m_pThreadContextArray[i]->pPipeline->GetSurfacePoolUsage());
+        CTimeStatistics& sessionStatistics =
+            m_pThreadContextArray[i]->pPipeline->GetOutputStatistics().GetRunStatistics();
+        if (sessionStatistics.GetNumMeasurements()) {
+            ss << MSDK_STRING("    output frame time: ") << FormatPercentiles(sessionStatistics)
+               << std::endl;
+            outputStatistics.Merge(sessionStatistics);
+        }
+        ss << m_parser.GetLine(i) << std::endl << std::endl;
 
         msdk_printf(MSDK_STRING("%s"), ss.str().c_str());
         if (pPerfFile) {
@@ -730,6 +1005,16 @@ mfxStatus Launcher::ProcessResult() {
     msdk_printf(MSDK_STRING(
         "-------------------------------------------------------------------------------\n"));
 
+    if (outputStatistics.GetNumMeasurements() && m_pThreadContextArray.size() > 1) {
+        msdk_stringstream ss;
+        ss << MSDK_STRING("Output frame time of all sessions: ")
+           << FormatPercentiles(outputStatistics) << std::endl;
+        msdk_printf(MSDK_STRING("%s"), ss.str().c_str());
+        if (pPerfFile) {
+            msdk_fprintf(pPerfFile, MSDK_STRING("%s"), ss.str().c_str());
+        }
+    }
+
     msdk_stringstream ssTest;
     ssTest << std::endl
            << MSDK_STRING("The test ")
@@ -740,9 +1025,94 @@ mfxStatus Launcher::ProcessResult() {
     if (pPerfFile) {
         msdk_fprintf(pPerfFile, MSDK_STRING("%s"), ssTest.str().c_str());
     }
+
+    if (!m_parser.GetPoolExportFile().empty()) {
+        mfxStatus sts = SavePoolTuning(m_parser.GetPoolExportFile());
+        MSDK_CHECK_STATUS(sts, "SavePoolTuning failed");
+    }
     return FinalSts;
 } // mfxStatus Launcher::ProcessResult()
 
+msdk_string Launcher::FormatPoolUsage(const std::map<msdk_string, SurfacePoolUsage>& pools) {
+    mfxU64 saved = 0, reclaimable = 0;
+
+    msdk_stringstream ss;
+    ss << MSDK_STRING("    surface pools:");
+    for (const auto& pool : pools) {
+        const SurfacePoolUsage& usage = pool.second;
+        ss << MSDK_STRING(" ") << pool.first << MSDK_STRING(" peak ") << usage.Peak
+           << MSDK_STRING("/") << usage.Allocated;
+        if (usage.Grown)
+            ss << MSDK_STRING(" (grown ") << usage.Grown << MSDK_STRING(")");
+
+        if (usage.Requested > usage.Allocated)
+            saved += (mfxU64)(usage.Requested - usage.Allocated) * usage.FrameSize;
+        if (usage.Allocated > usage.GetTunedSize())
+            reclaimable += (mfxU64)(usage.Allocated - usage.GetTunedSize()) * usage.FrameSize;
+    }
+    ss << std::endl
+       << MSDK_STRING("    pool memory saved ") << saved / 1024 << MSDK_STRING(" KB")
+       << MSDK_STRING(", reclaimable with tuning ") << reclaimable / 1024 << MSDK_STRING(" KB")
+       << std::endl;
+    return ss.str();
+} // msdk_string Launcher::FormatPoolUsage()
+
+// Tuning file is a text file, one line per pool: <session> <pool> <peak> <allocated> <frame bytes>
+mfxStatus Launcher::LoadPoolTuning(const msdk_string& fileName) {
+    std::ifstream file(fileName);
+    if (!file) {
+        msdk_printf(MSDK_STRING("error: can't open pool tuning file %s\n"), fileName.c_str());
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream in(line);
+        mfxU32 session = 0, peak = 0;
+        std::string pool;
+        if (!(in >> session >> pool >> peak)) {
+            msdk_printf(MSDK_STRING("error: invalid line in pool tuning file %s\n"),
+                        fileName.c_str());
+            return MFX_ERR_UNSUPPORTED;
+        }
+        // the file may describe another par file, ignore extra sessions
+        if (session >= m_InputParamsArray.size())
+            continue;
+
+        SurfacePoolUsage usage;
+        usage.Peak = peak;
+        m_InputParamsArray[session].TunedPoolSizes[msdk_string(pool.begin(), pool.end())] =
+            usage.GetTunedSize();
+    }
+
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::LoadPoolTuning()
+
+mfxStatus Launcher::SavePoolTuning(const msdk_string& fileName) {
+    std::ofstream file(fileName);
+    if (!file) {
+        msdk_printf(MSDK_STRING("error: can't create pool tuning file %s\n"), fileName.c_str());
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    file << "# session pool peak allocated frame_bytes" << std::endl;
+    for (mfxU32 i = 0; i < m_pThreadContextArray.size(); i++) {
+        for (const auto& pool : m_pThreadContextArray[i]->pPipeline->GetSurfacePoolUsage()) {
+            // pools which were never used give no information on the required size
+            if (!pool.second.Acquired)
+                continue;
+            file << i << " " << std::string(pool.first.begin(), pool.first.end()) << " "
+                 << pool.second.Peak << " " << pool.second.Allocated << " "
+                 << pool.second.FrameSize << std::endl;
+        }
+    }
+
+    return file ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+} // mfxStatus Launcher::SavePoolTuning()
+
 mfxStatus Launcher::CheckAndFixAdapterDependency(mfxU32 idxSession,
                                                  CTranscodingPipeline* pParentPipeline) {
     if (!pParentPipeline)
@@ -1085,6 +1455,42 @@ mfxStatus Launcher::CreateSafetyBuffers() {
 
 } // mfxStatus Launcher::CreateSafetyBuffers
 
+mfxStatus Launcher::ResolveSessionPlacement() {
+    mfxU32 autoIdx = 0;
+
+    for (mfxU32 i = 0; i < m_InputParamsArray.size(); i++) {
+        mfxStatus sts = ResolveSessionPlacement(m_InputParamsArray[i], i, autoIdx);
+        MSDK_CHECK_STATUS(sts, "ResolveSessionPlacement failed");
+    }
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::ResolveSessionPlacement
+
+mfxStatus Launcher::ResolveSessionPlacement(sInputParams& params, mfxU32 id, mfxU32& autoIdx) {
+    mfxU32 numaNodes = msdk_numa_get_node_count();
+
+    // in auto mode sessions without explicit placement are spread across nodes round-robin
+    if (params.bNumaAuto && params.NumaNode < 0 && params.CpuAffinity.empty())
+        params.NumaNode = (mfxI32)(autoIdx++ % numaNodes);
+
+    if (params.NumaNode < 0)
+        return MFX_ERR_NONE;
+
+    if ((mfxU32)params.NumaNode >= numaNodes) {
+        msdk_printf(MSDK_STRING("error: session %d: NUMA node %d is not available (%d nodes)\n"),
+                    (int)id,
+                    (int)params.NumaNode,
+                    (int)numaNodes);
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // explicit CPU list has priority over the node CPUs
+    if (params.CpuAffinity.empty()) {
+        mfxStatus sts = msdk_numa_get_node_cpus(params.NumaNode, params.CpuAffinity);
+        MSDK_CHECK_STATUS(sts, "msdk_numa_get_node_cpus failed");
+    }
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::ResolveSessionPlacement
+
 CascadeScalerConfig::TargetDescriptor CascadeScalerConfig::GetDesc(mfxU32 id) {
     auto itr = std::find_if(Targets.begin(), Targets.end(), [id](TargetDescriptor& d) {
         return d.TargetID == id;
@@ -1107,7 +1513,7 @@ CascadeScalerConfig& Launcher::CreateCascadeScalerConfig() {
     for (sInputParams& par : m_InputParamsArray) {
         if (par.eMode == Sink) {
             if (par.EnableTracing) {
-                cfg.Tracer->Init();
+                cfg.Tracer->Init(par.CompressTracing);
             }
         }
         else if (par.eMode == Source) {
@@ -1143,71 +1549,127 @@ CascadeScalerConfig& Launcher::CreateCascadeScalerConfig() {
     return m_CSConfig;
 }
 
-//propagate cascade parameters, decoder parameters should be set before this call
+//propagate cascade parameters along the scaling tree,
+//decoder parameters should be set before this call
 void TranscodingSample::CascadeScalerConfig::PropagateCascadeParameters() {
     if (Targets.size() <= 1) {
         //we should have at least two enc channels to propagate something
         return;
     }
 
-    //special case for first channel output, should be incorporated into loop below, somehow
-    if (!Targets[0].FRC) {
-        Targets[0].DstFrameRate = Targets[0].SrcFrameRate;
-    }
-    if (!Targets[0].DI) {
-        Targets[0].DstPicStruct = Targets[0].SrcPicStruct;
-    }
-
-    //set current parameters equal to decoder output
-    mfxU16 Width     = Targets[0].SrcWidth;
-    mfxU16 Height    = Targets[0].SrcHeight;
-    double FrameRate = Targets[0].SrcFrameRate;
-    mfxU16 PicStruct = Targets[0].SrcPicStruct;
-
-    for (mfxU32 i = 1; i < Targets.size(); i++) {
-        //resolution
-        if (Targets[i - 1].CascadeScaler) {
-            Width = Targets[i].SrcWidth = Targets[i - 1].DstWidth;
-            Height = Targets[i].SrcHeight = Targets[i - 1].DstHeight;
+    //output parameters of every pool, decoder output is stored in the first target
+    struct PoolOutput {
+        mfxU16 Width     = 0;
+        mfxU16 Height    = 0;
+        double FrameRate = 0.;
+        mfxU16 PicStruct = MFX_PICSTRUCT_UNKNOWN;
+    };
+    std::map<mfxU32, PoolOutput> out;
+    out[DecoderPoolID] = { Targets[0].SrcWidth,
+                           Targets[0].SrcHeight,
+                           Targets[0].SrcFrameRate,
+                           Targets[0].SrcPicStruct };
+
+    auto propagate = [](TargetDescriptor& desc, const PoolOutput& src) {
+        desc.SrcWidth     = src.Width;
+        desc.SrcHeight    = src.Height;
+        desc.SrcFrameRate = src.FrameRate;
+        desc.SrcPicStruct = src.PicStruct;
+        if (!desc.FRC) {
+            desc.DstFrameRate = desc.SrcFrameRate;
         }
-        else {
-            Targets[i].SrcWidth  = Width;
-            Targets[i].SrcHeight = Height;
+        if (!desc.DI) {
+            desc.DstPicStruct = desc.SrcPicStruct;
         }
+    };
 
-        //framerate
-        if (Targets[i - 1].CascadeScaler && Targets[i - 1].FRC) {
-            FrameRate = Targets[i].SrcFrameRate = Targets[i - 1].DstFrameRate;
-        }
-        else {
-            Targets[i].SrcFrameRate = FrameRate;
-        }
-        if (!Targets[i].FRC) {
-            Targets[i].DstFrameRate = Targets[i].SrcFrameRate;
+    //pools are ordered so that parent is always processed before child
+    for (const auto& p : Pools) {
+        const PoolDescritpor& pool = p.second;
+        if (pool.ID == DecoderPoolID) {
+            continue;
         }
 
-        //PicStruct
-        if (Targets[i - 1].CascadeScaler && Targets[i - 1].DI) {
-            PicStruct = Targets[i].SrcPicStruct = Targets[i - 1].DstPicStruct;
-        }
-        else {
-            Targets[i].SrcPicStruct = PicStruct;
+        auto desc = std::find_if(Targets.begin(), Targets.end(), [&pool](TargetDescriptor& d) {
+            return d.TargetID == pool.TargetID;
+        });
+        if (desc == Targets.end()) {
+            continue;
         }
-        if (!Targets[i].DI) {
-            Targets[i].DstPicStruct = Targets[i].SrcPicStruct;
+
+        propagate(*desc, out[pool.PrevID]);
+        out[pool.ID] = { desc->DstWidth, desc->DstHeight, desc->DstFrameRate, desc->DstPicStruct };
+    }
+
+    for (TargetDescriptor& desc : Targets) {
+        if (!desc.CascadeScaler) {
+            propagate(desc, out[desc.PoolID]);
         }
     }
 
     PoolDescritpor& pool = Pools[DecoderPoolID];
-    pool.SurfaceWidth    = Targets[0].SrcWidth;
-    pool.SurfaceHeight   = Targets[0].SrcHeight;
+    pool.SurfaceWidth    = out[DecoderPoolID].Width;
+    pool.SurfaceHeight   = out[DecoderPoolID].Height;
 }
 
+//check if target can be produced from the pool output:
+//pool should be at least as large as target and FRC/DI done by the pool should be compatible
+static bool CanBeDerived(const CascadeScalerConfig::TargetDescriptor& desc,
+                         const CascadeScalerConfig::PoolDescritpor& pool) {
+    //zero size means source resolution, only decoder output can be used
+    if (!desc.DstWidth || !desc.DstHeight) {
+        return false;
+    }
+
+    if (desc.DstWidth > pool.SurfaceWidth || desc.DstHeight > pool.SurfaceHeight) {
+        return false;
+    }
+
+    //frame rate can be decreased only
+    if (pool.FrameRate != 0. && !(desc.FRC && desc.DstFrameRate <= pool.FrameRate)) {
+        return false;
+    }
+
+    //deinterlaced content is suitable for DI targets only
+    if (pool.Deinterlaced && !desc.DI) {
+        return false;
+    }
+
+    return true;
+}
+
+//find the cheapest already produced pool the target can be derived from
+static mfxU32 FindCheapestSource(
+    const CascadeScalerConfig::TargetDescriptor& desc,
+    const std::map<mfxU32, CascadeScalerConfig::PoolDescritpor>& pools) {
+    mfxU32 source = DecoderPoolID;
+    mfxU64 cost   = std::numeric_limits<mfxU64>::max();
+
+    for (const auto& p : pools) {
+        const auto& pool = p.second;
+        if (pool.ID == DecoderPoolID || !CanBeDerived(desc, pool)) {
+            continue;
+        }
+
+        mfxU64 area = (mfxU64)pool.SurfaceWidth * pool.SurfaceHeight;
+        if (area < cost) {
+            cost   = area;
+            source = pool.ID;
+        }
+    }
+    return source;
+}
+
+//build scaling tree: every cascade target is derived from the cheapest already produced
+//resolution that is at least as large, so par file order doesn't affect scaling cost
 void TranscodingSample::CascadeScalerConfig::CreatePoolList() {
     if (Targets.empty()) {
         return;
     }
 
+    Pools.clear();
+    CascadeOrder.clear();
+
     PoolDescritpor pool;
     pool.PrevID        = 0;
     pool.ID            = DecoderPoolID;
@@ -1215,20 +1677,122 @@ void TranscodingSample::CascadeScalerConfig::CreatePoolList() {
     pool.SurfaceHeight = 0; // Targets[0].SrcHeight;
     Pools[pool.ID]     = pool;
 
+    //plan from the largest target to the smallest one, so that parent is planned before child
+    std::vector<TargetDescriptor*> order;
+    for (TargetDescriptor& desc : Targets) {
+        if (desc.CascadeScaler) {
+            order.push_back(&desc);
+        }
+    }
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [](const TargetDescriptor* a, const TargetDescriptor* b) {
+                         return (mfxU32)a->DstWidth * a->DstHeight >
+                                (mfxU32)b->DstWidth * b->DstHeight;
+                     });
+
+    mfxU32 ID = DecoderPoolID;
+    for (TargetDescriptor* desc : order) {
+        const PoolDescritpor& parent = Pools[FindCheapestSource(*desc, Pools)];
+
+        pool               = PoolDescritpor();
+        pool.ID            = ++ID;
+        pool.PrevID        = parent.ID;
+        pool.TargetID      = desc->TargetID;
+        pool.SurfaceWidth  = desc->DstWidth;
+        pool.SurfaceHeight = desc->DstHeight;
+        pool.FrameRate     = desc->FRC ? desc->DstFrameRate : parent.FrameRate;
+        pool.Deinterlaced  = desc->DI || parent.Deinterlaced;
+        pool.FanOut        = 1; //encoder of this target
+
+        Pools[pool.PrevID].FanOut++;
+        Pools[pool.ID] = pool;
+
+        desc->PoolID = pool.ID;
+        CascadeOrder.push_back(desc->TargetID);
+    }
+
+    //targets without cascade scaling do their own VPP from the cheapest suitable pool
     for (TargetDescriptor& desc : Targets) {
+        if (!desc.CascadeScaler) {
+            desc.PoolID = FindCheapestSource(desc, Pools);
+            Pools[desc.PoolID].FanOut++;
+        }
+    }
+}
+
+void TranscodingSample::CascadeScalerConfig::PrintPlan() {
+    auto area = [](mfxU16 w, mfxU16 h) {
+        return (mfxU64)w * h;
+    };
+
+    const PoolDescritpor& decPool = Pools[DecoderPoolID];
+    mfxU64 decArea                = area(decPool.SurfaceWidth, decPool.SurfaceHeight);
+
+    msdk_printf(MSDK_STRING("Cascade scaler plan (decoder %dx%d, fan-out %d):\n"),
+                decPool.SurfaceWidth,
+                decPool.SurfaceHeight,
+                decPool.FanOut);
+
+    //pixels read and written by all scalers per decoded frame
+    mfxU64 pixels = 0;
+    for (const auto& p : Pools) {
+        const PoolDescritpor& pool = p.second;
+        if (pool.ID == DecoderPoolID) {
+            continue;
+        }
+
+        const PoolDescritpor& parent = Pools[pool.PrevID];
+        pixels += area(parent.SurfaceWidth, parent.SurfaceHeight) +
+                  area(pool.SurfaceWidth, pool.SurfaceHeight);
+        msdk_printf(MSDK_STRING("    pool %d %dx%d <- pool %d %dx%d, target %d, fan-out %d\n"),
+                    pool.ID,
+                    pool.SurfaceWidth,
+                    pool.SurfaceHeight,
+                    parent.ID,
+                    parent.SurfaceWidth,
+                    parent.SurfaceHeight,
+                    pool.TargetID,
+                    pool.FanOut);
+    }
+
+    //the same for the linear chain in par file order, for reference
+    mfxU64 chainPixels = 0;
+    mfxU64 chainArea   = decArea;
+    for (const TargetDescriptor& desc : Targets) {
+        mfxU64 dstArea = (desc.DstWidth && desc.DstHeight) ? area(desc.DstWidth, desc.DstHeight)
+                                                           : chainArea;
         if (desc.CascadeScaler) {
-            pool.PrevID        = pool.ID;
-            pool.ID            = DecoderPoolID + (desc.TargetID - DecoderTargetID);
-            pool.TargetID      = desc.TargetID;
-            pool.SurfaceWidth  = desc.DstWidth;
-            pool.SurfaceHeight = desc.DstHeight;
-            Pools[pool.ID]     = pool;
+            chainPixels += chainArea + dstArea;
+            chainArea = dstArea;
+            continue;
         }
-        desc.PoolID = pool.ID;
+
+        const PoolDescritpor& pool = Pools[desc.PoolID];
+        mfxU64 srcArea             = area(pool.SurfaceWidth, pool.SurfaceHeight);
+        mfxU64 dstOwnArea =
+            (desc.DstWidth && desc.DstHeight) ? area(desc.DstWidth, desc.DstHeight) : srcArea;
+        pixels += srcArea + dstOwnArea;
+        chainPixels += chainArea + dstArea;
+        msdk_printf(MSDK_STRING("    target %d %dx%d <- pool %d %dx%d\n"),
+                    desc.TargetID,
+                    desc.DstWidth,
+                    desc.DstHeight,
+                    pool.ID,
+                    pool.SurfaceWidth,
+                    pool.SurfaceHeight);
     }
+
+    msdk_printf(MSDK_STRING("    total pixels per frame %lld (par file order chain %lld)\n\n"),
+                (long long)pixels,
+                (long long)chainPixels);
 }
 
 void Launcher::Close() {
+    // no commands may arrive while sessions are being destroyed
+    m_pControl.reset();
+    m_pMetrics.reset();
+
     while (m_pThreadContextArray.size()) {
         m_pThreadContextArray[m_pThreadContextArray.size() - 1].reset();
         m_pThreadContextArray.pop_back();
@@ -0,0 +1,199 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "smt_control.h"
+
+#include <chrono>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <errno.h>
+    #include <poll.h>
+    #include <string.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+namespace TranscodingSample {
+
+// interval to check for the stop request while waiting for clients or replies
+static const int ControlPollIntervalMs = 100;
+// limit for a single command line, par file lines are much shorter in practice
+static const size_t ControlMaxLineLength = 64 * 1024;
+
+SMTControlServer::SMTControlServer() : Path(), ListenFD(-1), StopRequested(false) {}
+
+SMTControlServer::~SMTControlServer() {
+    Stop();
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+mfxStatus SMTControlServer::Start(const std::string& path) {
+    sockaddr_un addr = {};
+    if (ListenFD >= 0 || path.empty() || path.size() >= sizeof(addr.sun_path))
+        return MFX_ERR_UNSUPPORTED;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return MFX_ERR_UNKNOWN;
+
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    // a stale socket from a previous run would make bind() fail, anything else at the path
+    // is not ours to remove
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            close(fd);
+            return MFX_ERR_UNSUPPORTED;
+        }
+        unlink(path.c_str());
+    }
+    else if (errno != ENOENT) {
+        close(fd);
+        return MFX_ERR_UNKNOWN;
+    }
+
+    // sessions started through the socket read and write files as this user, so the socket is
+    // created accessible to the owner only rather than restricted after bind()
+    mode_t mask = umask(S_IRWXG | S_IRWXO);
+    int ret     = bind(fd, (sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    if (ret || listen(fd, 4)) {
+        close(fd);
+        return MFX_ERR_UNKNOWN;
+    }
+
+    Path          = path;
+    ListenFD      = fd;
+    StopRequested = false;
+    Listener      = std::thread([this]() {
+        ListenRoutine();
+    });
+
+    return MFX_ERR_NONE;
+}
+
+void SMTControlServer::Stop() {
+    StopRequested = true;
+    if (Listener.joinable())
+        Listener.join();
+
+    if (ListenFD >= 0) {
+        close(ListenFD);
+        unlink(Path.c_str());
+        ListenFD = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    Queue.clear();
+}
+
+void SMTControlServer::ListenRoutine() {
+    while (!StopRequested) {
+        pollfd pfd = { ListenFD, POLLIN, 0 };
+        if (poll(&pfd, 1, ControlPollIntervalMs) <= 0)
+            continue;
+
+        int client = accept(ListenFD, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        // clients are served one by one, commands are short
+        ServeClient(client);
+        close(client);
+    }
+}
+
+void SMTControlServer::ServeClient(int fd) {
+    std::string pending;
+    std::vector<char> buf(4096);
+
+    while (!StopRequested) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        int ret    = poll(&pfd, 1, ControlPollIntervalMs);
+        if (ret == 0)
+            continue;
+        if (ret < 0)
+            return;
+
+        ssize_t size = read(fd, buf.data(), buf.size());
+        if (size <= 0)
+            return;
+        pending.append(buf.data(), size);
+
+        size_t pos;
+        while ((pos = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, pos);
+            pending.erase(0, pos + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty())
+                continue;
+
+            std::string reply = Execute(line);
+            for (size_t sent = 0; sent < reply.size();) {
+                ssize_t n = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    return;
+                sent += n;
+            }
+        }
+
+        if (pending.size() > ControlMaxLineLength)
+            return;
+    }
+}
+
+#else // Windows
+
+mfxStatus SMTControlServer::Start(const std::string&) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
+void SMTControlServer::Stop() {
+    StopRequested = true;
+}
+
+void SMTControlServer::ListenRoutine() {}
+
+void SMTControlServer::ServeClient(int) {}
+
+#endif
+
+std::string SMTControlServer::Execute(const std::string& line) {
+    auto cmd  = std::make_shared<Command>();
+    cmd->line = line;
+    auto fut  = cmd->reply.get_future();
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Queue.push_back(cmd);
+    }
+
+    while (fut.wait_for(std::chrono::milliseconds(ControlPollIntervalMs)) !=
+           std::future_status::ready) {
+        if (StopRequested)
+            return "ERR application is shutting down\n";
+    }
+    return fut.get();
+}
+
+void SMTControlServer::ProcessCommands(const CommandHandler& handler) {
+    std::deque<std::shared_ptr<Command>> commands;
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        commands.swap(Queue);
+    }
+
+    for (auto& cmd : commands)
+        cmd->reply.set_value(handler(cmd->line));
+}
+
+} // namespace TranscodingSample
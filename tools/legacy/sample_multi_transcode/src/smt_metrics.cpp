@@ -0,0 +1,153 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "smt_metrics.h"
+
+#include <stdio.h>
+#include <sstream>
+#include <string>
+
+#include "vm/file_defs.h"
+
+namespace TranscodingSample {
+
+static const mfxF64 MetricsQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+SMTMetricsWriter::SMTMetricsWriter(const msdk_string& fileName, mfxU32 intervalMs)
+        : FileName(fileName),
+          Interval(msdk_time_get_frequency() * intervalMs / 1000),
+          LastWrite(0),
+          Rates() {}
+
+bool SMTMetricsWriter::IsDue() {
+    return !LastWrite || msdk_time_get_tick() - LastWrite >= Interval;
+}
+
+static void WriteFamily(std::ostringstream& out,
+                        const char* name,
+                        const char* type,
+                        const char* help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+mfxStatus SMTMetricsWriter::Write(const std::vector<SMTMetricsSample>& samples) {
+    msdk_tick now = msdk_time_get_tick();
+    LastWrite     = now;
+
+    for (const auto& sample : samples) {
+        mfxU64 frames = sample.pMetrics->FramesOut.load(std::memory_order_relaxed);
+        auto it       = Rates.find(sample.SessionID);
+        if (it == Rates.end()) {
+            Rates[sample.SessionID] = { frames, now, 0.0 };
+        }
+        else if (now > it->second.Tick) {
+            it->second.FPS = (mfxF64)(frames - it->second.Frames) * msdk_time_get_frequency() /
+                             (now - it->second.Tick);
+            it->second.Frames = frames;
+            it->second.Tick   = now;
+        }
+    }
+
+    // all samples of a metric family have to be grouped together
+    std::ostringstream out;
+    // latency sum keeps growing, the default 6 digits would round away the increments
+    out.precision(12);
+
+    WriteFamily(out, "smt_frames_total", "counter", "Frames written by the session.");
+    for (const auto& s : samples)
+        out << "smt_frames_total{session=\"" << s.SessionID << "\"} "
+            << s.pMetrics->FramesOut.load(std::memory_order_relaxed) << "\n";
+
+    WriteFamily(out, "smt_fps", "gauge", "Output frame rate over the last metrics interval.");
+    for (const auto& s : samples)
+        out << "smt_fps{session=\"" << s.SessionID << "\"} " << Rates[s.SessionID].FPS << "\n";
+
+    WriteFamily(out,
+                "smt_frames_in_flight",
+                "gauge",
+                "Bitstreams submitted to the encoder and not written yet.");
+    for (const auto& s : samples)
+        out << "smt_frames_in_flight{session=\"" << s.SessionID << "\"} "
+            << s.pMetrics->FramesInFlight.load(std::memory_order_relaxed) << "\n";
+
+    WriteFamily(out,
+                "smt_surface_pool_used",
+                "gauge",
+                "Locked surfaces of the pool at the last surface request.");
+    for (const auto& s : samples) {
+        out << "smt_surface_pool_used{session=\"" << s.SessionID << "\",pool=\"dec\"} "
+            << s.pMetrics->DecPoolUsed.load(std::memory_order_relaxed) << "\n";
+        out << "smt_surface_pool_used{session=\"" << s.SessionID << "\",pool=\"enc\"} "
+            << s.pMetrics->EncPoolUsed.load(std::memory_order_relaxed) << "\n";
+    }
+
+    WriteFamily(out, "smt_surface_pool_size", "gauge", "Surfaces allocated for the pool.");
+    for (const auto& s : samples) {
+        out << "smt_surface_pool_size{session=\"" << s.SessionID << "\",pool=\"dec\"} "
+            << s.pMetrics->DecPoolSize.load(std::memory_order_relaxed) << "\n";
+        out << "smt_surface_pool_size{session=\"" << s.SessionID << "\",pool=\"enc\"} "
+            << s.pMetrics->EncPoolSize.load(std::memory_order_relaxed) << "\n";
+    }
+
+    WriteFamily(out,
+                "smt_busy_waits_total",
+                "counter",
+                "Sleeps of the session waiting for a busy device or a free surface.");
+    for (const auto& s : samples) {
+        out << "smt_busy_waits_total{session=\"" << s.SessionID << "\",reason=\"device\"} "
+            << s.pMetrics->DeviceBusyWaits.load(std::memory_order_relaxed) << "\n";
+        out << "smt_busy_waits_total{session=\"" << s.SessionID << "\",reason=\"surface\"} "
+            << s.pMetrics->SurfaceWaits.load(std::memory_order_relaxed) << "\n";
+    }
+
+    WriteFamily(out,
+                "smt_safety_buffer_depth",
+                "gauge",
+                "Surfaces queued in the buffer between joined sessions.");
+    for (const auto& s : samples) {
+        if (s.BufferDepth >= 0)
+            out << "smt_safety_buffer_depth{session=\"" << s.SessionID << "\"} " << s.BufferDepth
+                << "\n";
+    }
+
+    WriteFamily(out,
+                "smt_e2e_latency_seconds",
+                "summary",
+                "Time from the decode call which returned a frame to the write of its bitstream.");
+    for (const auto& s : samples) {
+        for (mfxF64 q : MetricsQuantiles) {
+            out << "smt_e2e_latency_seconds{session=\"" << s.SessionID << "\",quantile=\"" << q
+                << "\"} " << s.pMetrics->Latency.GetPercentile(q * 100) / 1e9 << "\n";
+        }
+        out << "smt_e2e_latency_seconds_sum{session=\"" << s.SessionID << "\"} "
+            << s.pMetrics->Latency.GetSum() / 1e9 << "\n";
+        out << "smt_e2e_latency_seconds_count{session=\"" << s.SessionID << "\"} "
+            << s.pMetrics->Latency.GetCount() << "\n";
+    }
+
+    msdk_string tmpName = FileName + MSDK_STRING(".tmp");
+    FILE* file          = NULL;
+    MSDK_FOPEN(file, tmpName.c_str(), MSDK_STRING("w"));
+    if (!file)
+        return MFX_ERR_NOT_FOUND;
+
+    std::string text = out.str();
+    bool written     = fwrite(text.data(), 1, text.size(), file) == text.size();
+    written          = (0 == fclose(file)) && written;
+    if (!written)
+        return MFX_ERR_UNKNOWN;
+
+#if defined(_WIN32) || defined(_WIN64)
+    if (!MoveFileEx(tmpName.c_str(), FileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+        return MFX_ERR_UNKNOWN;
+#else
+    if (rename(tmpName.c_str(), FileName.c_str()))
+        return MFX_ERR_UNKNOWN;
+#endif
+    return MFX_ERR_NONE;
+}
+} // namespace TranscodingSample
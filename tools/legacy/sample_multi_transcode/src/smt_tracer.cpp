@@ -6,9 +6,36 @@
 
 #include "smt_tracer.h"
 
+#include <sstream>
+
+#ifdef SMT_TRACER_ZLIB_SUPPORT
+    #include <zlib.h>
+#endif
+
 namespace TranscodingSample {
 
-SMTTracer::SMTTracer() : Log(), AddonLog(), E2ELatency(), EncLatency(), TracerFileMutex() {
+bool SMTTracer::ThreadBuffer::Push(const Event& ev) {
+    size_t head = Head.load(std::memory_order_relaxed);
+    if (head - Tail.load(std::memory_order_acquire) == Capacity) {
+        return false;
+    }
+    Ring[head & (Capacity - 1)] = ev;
+    Head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void SMTTracer::ThreadBuffer::Pop(std::vector<Event>& out) {
+    size_t tail = Tail.load(std::memory_order_relaxed);
+    size_t head = Head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+        out.push_back(Ring[tail & (Capacity - 1)]);
+    }
+    Tail.store(tail, std::memory_order_release);
+}
+
+static std::atomic<mfxU64> TracerCounter{ 0 };
+
+SMTTracer::SMTTracer() : TracerID(++TracerCounter), Buffers(), Links(), E2ELatency(), EncLatency() {
     TimeBase = std::chrono::steady_clock::now();
 }
 
@@ -16,23 +43,37 @@ SMTTracer::~SMTTracer() {
     if (!Enabled)
         return;
 
-    //these functions are intentionally called from destructor to try to save traces in case of a crash
-    AddFlowEvents();
-    SaveTrace(0xffffff & GetCurrentTS());
+    {
+        std::lock_guard<std::mutex> guard(FlusherMutex);
+        StopFlusher = true;
+    }
+    FlusherCV.notify_one();
+    if (Flusher.joinable()) {
+        Flusher.join();
+    }
 
-    ComputeE2ELatency();
-    PrintE2ELatency();
+    Flush(true);
+    CloseTraceFile();
+
+    printf("\n### trace events written %llu, dropped %llu\n",
+           (unsigned long long)WrittenEvents,
+           (unsigned long long)DroppedEvents.load());
+    printf("trace file name %s\n", FileName.c_str());
 
-    ComputeEncLatency();
-    PrintEncLatency();
+    PrintLatency("End To End Latency (from decode or YUV read start to encode end)",
+                 NumOfE2EErrors,
+                 E2ELatency);
+    PrintLatency("Encode Latency (from encode start to encode end)", NumOfEncErrors, EncLatency);
 }
 
-void SMTTracer::Init() {
+void SMTTracer::Init(bool compress) {
     if (Enabled) {
         return;
     }
+
+    OpenTraceFile(compress);
     Enabled = true;
-    Log.reserve(TraceBufferSizeInMBytes * 1024 * 1024 / sizeof(Event));
+    Flusher = std::thread(&SMTTracer::FlushRoutine, this);
 }
 
 void SMTTracer::BeginEvent(const ThreadType thType,
@@ -64,31 +105,6 @@ void SMTTracer::AddCounterEvent(const ThreadType thType,
     AddEvent(EventType::Counter, thType, thID, name, reinterpret_cast<void*>(counter), nullptr);
 }
 
-void SMTTracer::SaveTrace(mfxU32 FileID) {
-    std::string FileName = "smt_trace_" + std::to_string(FileID) + ".json";
-    std::ofstream trace_file(FileName, std::ios::out);
-    if (!trace_file) {
-        return;
-    }
-
-    printf("\n### trace buffer usage [%d/%d] %.2f%%\n",
-           (int)Log.size(),
-           (int)Log.capacity(),
-           100. * Log.size() / Log.capacity());
-    printf("trace file name %s\n", FileName.c_str());
-
-    trace_file << "[" << std::endl;
-
-    for (const Event ev : Log) {
-        WriteEvent(trace_file, ev);
-    }
-    for (const Event ev : AddonLog) {
-        WriteEvent(trace_file, ev);
-    }
-
-    trace_file.close();
-}
-
 void SMTTracer::AddEvent(const EventType evType,
                          const ThreadType thType,
                          const mfxU32 thID,
@@ -100,16 +116,30 @@ void SMTTracer::AddEvent(const EventType evType,
     ev.ThType = thType;
     ev.ThID   = thID;
     ev.Name   = name;
+    ev.EvID   = 0;
     ev.InID   = reinterpret_cast<mfxU64>(inID);
     ev.OutID  = reinterpret_cast<mfxU64>(outID);
     ev.TS     = GetCurrentTS();
 
-    if (Log.size() == Log.capacity()) {
-        return;
+    if (!GetThreadBuffer()->Push(ev)) {
+        DroppedEvents++;
     }
+}
+
+SMTTracer::ThreadBuffer* SMTTracer::GetThreadBuffer() {
+    struct ThreadLocalBuffer {
+        mfxU64 TracerID      = 0;
+        ThreadBuffer* Buffer = nullptr;
+    };
+    static thread_local ThreadLocalBuffer local;
 
-    std::lock_guard<std::mutex> guard(TracerFileMutex);
-    Log.push_back(ev);
+    if (local.TracerID != TracerID) {
+        std::lock_guard<std::mutex> guard(BuffersMutex);
+        Buffers.emplace_back(new ThreadBuffer);
+        local.Buffer   = Buffers.back().get();
+        local.TracerID = TracerID;
+    }
+    return local.Buffer;
 }
 
 mfxU64 SMTTracer::GetCurrentTS() {
@@ -117,154 +147,194 @@ mfxU64 SMTTracer::GetCurrentTS() {
     return std::chrono::duration_cast<std::chrono::microseconds>(time - TimeBase).count();
 }
 
-void SMTTracer::AddFlowEvents() {
-    for (auto it = Log.begin(); it != Log.end(); ++it) {
-        if (it->EvType != EventType::DurationStart) {
-            continue;
-        }
+void SMTTracer::FlushRoutine() {
+    std::unique_lock<std::mutex> lock(FlusherMutex);
+    while (!StopFlusher) {
+        FlusherCV.wait_for(lock, std::chrono::milliseconds(FlushPeriodInMs));
+        if (StopFlusher)
+            break;
 
-        if (it->InID == 0) {
-            continue;
-        }
+        lock.unlock();
+        Flush(false);
+        lock.lock();
+    }
+}
 
-        auto itc = std::reverse_iterator<decltype(it)>(it);
+void SMTTracer::Flush(bool final) {
+    mfxU64 cutoff = GetCurrentTS();
+    cutoff        = cutoff > FlushHoldBackInUs ? cutoff - FlushHoldBackInUs : 0;
 
-        auto itp = find_if(itc, Log.rend(), [&it](Event ev) {
-            return ev.EvType == EventType::DurationEnd && it->InID == ev.OutID;
-        });
-        if (itp == Log.rend()) {
-            continue;
+    {
+        std::lock_guard<std::mutex> guard(BuffersMutex);
+        for (const auto& buffer : Buffers) {
+            buffer->Pop(Pending);
         }
+    }
+
+    std::stable_sort(Pending.begin(), Pending.end(), [](const Event& a, const Event& b) {
+        return a.TS < b.TS;
+    });
+
+    auto last = final ? Pending.end()
+                      : std::find_if(Pending.begin(), Pending.end(), [cutoff](const Event& ev) {
+                            return ev.TS >= cutoff;
+                        });
 
-        AddFlowEvent(*itp, *it);
+    std::ostringstream trace;
+    for (auto it = Pending.begin(); it != last; ++it) {
+        ProcessEvent(*it, trace);
     }
+    Pending.erase(Pending.begin(), last);
+
+    WriteTraceChunk(trace.str());
 }
 
-void SMTTracer::ComputeE2ELatency() {
-    NumOfErrors = 0;
+//Events are processed in time stamp order. Flow events and latencies are computed on the fly:
+//every duration end which produces OutID is remembered, so the next duration which consumes
+//it as InID can be linked to the producer and to the beginning of the dependency chain.
+void SMTTracer::ProcessEvent(const Event& ev, std::ostream& trace) {
+    WriteEvent(trace, ev);
+    WrittenEvents++;
 
-    for (auto it = Log.begin(); it != Log.end(); ++it) {
-        //look for end of sync operation in enc channel
-        if (it->EvType != EventType::DurationEnd || it->ThType != ThreadType::ENC ||
-            it->Name != EventName::SYNC) {
-            continue;
-        }
+    if (ev.EvType == EventType::DurationStart) {
+        OpenDurations[std::make_tuple(ev.ThType, ev.ThID, ev.Name)] = ev;
 
-        EventIt bit = FindBeginningOfDependencyChain(it);
-        if (bit == Log.end() || bit->ThType != ThreadType::DEC) {
-            NumOfErrors++;
-            continue;
+        if (ev.InID != 0) {
+            auto link = Links.find(ev.InID);
+            if (link != Links.end()) {
+                AddFlowEvent(link->second.End, ev, trace);
+            }
         }
+        return;
+    }
 
-        E2ELatency[it->ThID].push_back(it->TS - bit->TS);
+    if (ev.EvType != EventType::DurationEnd) {
+        return;
     }
-}
 
-void SMTTracer::PrintE2ELatency() {
-    printf("\nEnd To End Latency (from decode or YUV read start to encode end)\n");
-    printf("    number of frames with unknown latency: %d\n", NumOfErrors);
+    auto open = OpenDurations.find(std::make_tuple(ev.ThType, ev.ThID, ev.Name));
+    if (open == OpenDurations.end()) {
+        return;
+    }
+    const Event begin = open->second;
 
-    for (const auto& v : E2ELatency) {
-        printf("\n    enc%d number of frame %d\n", v.first, int(v.second.size()));
-        printf("        per frame latency ms : ");
-        for (mfxU64 t : v.second) {
-            printf(" %.2f,", t / 1000.);
+    //beginning of dependency chain for this duration event
+    bool originKnown = false;
+    Event origin     = begin;
+    if (begin.InID == 0) {
+        originKnown = true;
+    }
+    else {
+        auto link = Links.find(begin.InID);
+        if (link != Links.end() && link->second.OriginKnown && link->second.End.TS <= begin.TS) {
+            originKnown = true;
+            origin      = link->second.Origin;
         }
-        printf("\n");
     }
-}
-
-void SMTTracer::ComputeEncLatency() {
-    NumOfErrors = 0;
 
-    for (auto it = Log.begin(); it != Log.end(); ++it) {
-        if (it->EvType != EventType::DurationEnd || it->ThType != ThreadType::ENC ||
-            it->Name != EventName::SYNC) {
-            continue;
+    //look for end of sync operation in enc channel
+    if (ev.ThType == ThreadType::ENC && ev.Name == EventName::SYNC) {
+        if (originKnown && origin.ThType == ThreadType::DEC) {
+            E2ELatency[ev.ThID].Record((ev.TS - origin.TS) * 1000);
+        }
+        else {
+            NumOfE2EErrors++;
         }
 
-        EventIt syncEnd   = it;
-        EventIt syncBegin = FindBeginningOfDurationEvent(syncEnd);
-        EventIt encEnd    = FindEndOfPreviosDurationEvent(syncBegin);
-        EventIt encBegin  = FindBeginningOfDurationEvent(encEnd);
-
-        if (encBegin == Log.end() || encBegin->ThType != ThreadType::ENC) {
-            NumOfErrors++;
-            continue;
+        auto link = Links.find(begin.InID);
+        if (link != Links.end() && link->second.Begin.ThType == ThreadType::ENC) {
+            EncLatency[link->second.Begin.ThID].Record((ev.TS - link->second.Begin.TS) * 1000);
         }
+        else {
+            NumOfEncErrors++;
+        }
+    }
 
-        EncLatency[encBegin->ThID].push_back(syncEnd->TS - encBegin->TS);
+    if (ev.OutID != 0) {
+        Link& link       = Links[ev.OutID];
+        link.End         = ev;
+        link.Begin       = begin;
+        link.OriginKnown = originKnown;
+        link.Origin      = origin;
     }
 }
 
-void SMTTracer::PrintEncLatency() {
-    printf("\nEncode Latency (from encode start to encode end)\n");
-    printf("    number of frames with unknown latency: %d\n", NumOfErrors);
+void SMTTracer::OpenTraceFile(bool compress) {
+    mfxU32 FileID = 0xffffff & std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::system_clock::now().time_since_epoch())
+                                   .count();
+    FileName = "smt_trace_" + std::to_string(FileID) + ".json";
 
-    for (const auto& v : EncLatency) {
-        printf("\n    enc%d number of frame %d\n", v.first, int(v.second.size()));
-        printf("        per frame latency ms : ");
-        for (mfxU64 t : v.second) {
-            printf(" %.2f,", t / 1000.);
+#ifdef SMT_TRACER_ZLIB_SUPPORT
+    if (compress) {
+        FileName += ".gz";
+        GzTraceFile = gzopen(FileName.c_str(), "wb");
+        if (GzTraceFile) {
+            WriteTraceChunk("[\n");
         }
-        printf("\n");
+        return;
     }
-}
-
-SMTTracer::EventIt SMTTracer::FindBeginningOfDependencyChain(EventIt it) {
-    //"it" should point to the end of duration event
-    if (it == Log.begin() || it == Log.end() || it->EvType != EventType::DurationEnd) {
-        return Log.end();
+#else
+    if (compress) {
+        printf("warning: sample is built without zlib, trace will not be compressed\n");
     }
+#endif
 
-    for (;;) {
-        it = FindBeginningOfDurationEvent(it);
-        if (it == Log.end() || it->InID == 0)
-            break;
-
-        it = FindEndOfPreviosDurationEvent(it);
-        if (it == Log.end())
-            break;
-    }
-
-    return it;
+    TraceFile.open(FileName, std::ios::out);
+    WriteTraceChunk("[\n");
 }
 
-SMTTracer::EventIt SMTTracer::FindBeginningOfDurationEvent(EventIt it) {
-    //"it" should point to the end of duration event
-    if (it == Log.begin() || it == Log.end() || it->EvType != EventType::DurationEnd) {
-        return Log.end();
+void SMTTracer::WriteTraceChunk(const std::string& chunk) {
+    if (chunk.empty()) {
+        return;
     }
 
-    EventIt itc = it;
-    for (; itc != Log.begin();) {
-        --itc;
-        if (itc->EvType == EventType::DurationStart && itc->ThType == it->ThType &&
-            itc->ThID == it->ThID && itc->Name == it->Name) {
-            return itc;
-        }
+#ifdef SMT_TRACER_ZLIB_SUPPORT
+    if (GzTraceFile) {
+        gzwrite((gzFile)GzTraceFile, chunk.data(), (unsigned)chunk.size());
+        return;
     }
+#endif
 
-    return Log.end();
+    if (TraceFile) {
+        TraceFile.write(chunk.data(), chunk.size());
+        TraceFile.flush();
+    }
 }
 
-SMTTracer::EventIt SMTTracer::FindEndOfPreviosDurationEvent(EventIt it) {
-    //"it" should point to the beginnig of duration event
-    if (it == Log.begin() || it == Log.end() || it->EvType != EventType::DurationStart) {
-        return Log.end();
+void SMTTracer::CloseTraceFile() {
+#ifdef SMT_TRACER_ZLIB_SUPPORT
+    if (GzTraceFile) {
+        gzclose((gzFile)GzTraceFile);
+        GzTraceFile = nullptr;
+    }
+#endif
+    if (TraceFile.is_open()) {
+        TraceFile.close();
     }
+}
 
-    EventIt itc = it;
-    for (; itc != Log.begin();) {
-        --itc;
-        if (itc->EvType == EventType::DurationEnd && itc->OutID == it->InID) {
-            return itc;
-        }
+void SMTTracer::PrintLatency(const char* title,
+                             mfxU32 numOfErrors,
+                             const std::map<mfxU32, CLatencyHistogram>& latency) {
+    printf("\n%s\n", title);
+    printf("    number of frames with unknown latency: %d\n", numOfErrors);
+
+    for (const auto& v : latency) {
+        const CLatencyHistogram& h = v.second;
+        printf("\n    enc%d number of frame %d\n", v.first, int(h.GetCount()));
+        printf(
+            "        latency ms : avg %.2f, p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n",
+            h.GetAverage() / 1e6,
+            h.GetPercentile(50.) / 1e6,
+            h.GetPercentile(90.) / 1e6,
+            h.GetPercentile(99.) / 1e6,
+            h.GetPercentile(99.9) / 1e6,
+            h.GetMax() / 1e6);
     }
-    return Log.end();
 }
 
-void SMTTracer::AddFlowEvent(const Event a, const Event b) {
+void SMTTracer::AddFlowEvent(const Event a, const Event b, std::ostream& trace) {
     if (a.EvType != EventType::DurationEnd || b.EvType != EventType::DurationStart) {
         return;
     }
@@ -275,7 +345,7 @@ void SMTTracer::AddFlowEvent(const Event a, const Event b) {
     ev.ThID   = a.ThID;
     ev.EvID   = ++EvID;
     ev.TS     = a.TS;
-    AddonLog.push_back(ev);
+    WriteEvent(trace, ev);
 
     ev.EvType = EventType::FlowEnd;
     ev.ThType = b.ThType;
@@ -287,10 +357,10 @@ void SMTTracer::AddFlowEvent(const Event a, const Event b) {
         ev.TS++;
     }
 
-    AddonLog.push_back(ev);
+    WriteEvent(trace, ev);
 }
 
-void SMTTracer::WriteEvent(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEvent(std::ostream& trace_file, const Event ev) {
     switch (ev.EvType) {
         case EventType::DurationStart:
         case EventType::DurationEnd:
@@ -307,7 +377,7 @@ void SMTTracer::WriteEvent(std::ofstream& trace_file, const Event ev) {
     }
 }
 
-void SMTTracer::WriteDurationEvent(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteDurationEvent(std::ostream& trace_file, const Event ev) {
     trace_file << "{";
     WriteEventPID(trace_file);
     WriteComma(trace_file);
@@ -323,7 +393,7 @@ void SMTTracer::WriteDurationEvent(std::ofstream& trace_file, const Event ev) {
     trace_file << "}," << std::endl;
 }
 
-void SMTTracer::WriteFlowEvent(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteFlowEvent(std::ostream& trace_file, const Event ev) {
     trace_file << "{";
     WriteEventPID(trace_file);
     WriteComma(trace_file);
@@ -343,7 +413,7 @@ void SMTTracer::WriteFlowEvent(std::ofstream& trace_file, const Event ev) {
     trace_file << "}," << std::endl;
 }
 
-void SMTTracer::WriteCounterEvent(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteCounterEvent(std::ostream& trace_file, const Event ev) {
     trace_file << "{";
     WriteEventPID(trace_file);
     WriteComma(trace_file);
@@ -359,11 +429,11 @@ void SMTTracer::WriteCounterEvent(std::ofstream& trace_file, const Event ev) {
     trace_file << "}," << std::endl;
 }
 
-void SMTTracer::WriteEventPID(std::ofstream& trace_file) {
+void SMTTracer::WriteEventPID(std::ostream& trace_file) {
     trace_file << "\"pid\":\"smt\"";
 }
 
-void SMTTracer::WriteEventTID(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventTID(std::ostream& trace_file, const Event ev) {
     trace_file << "\"tid\":\"";
     switch (ev.ThType) {
         case ThreadType::DEC:
@@ -385,11 +455,11 @@ void SMTTracer::WriteEventTID(std::ofstream& trace_file, const Event ev) {
     trace_file << "\"";
 }
 
-void SMTTracer::WriteEventTS(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventTS(std::ostream& trace_file, const Event ev) {
     trace_file << "\"ts\":" << ev.TS;
 }
 
-void SMTTracer::WriteEventPhase(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventPhase(std::ostream& trace_file, const Event ev) {
     trace_file << "\"ph\":\"";
 
     switch (ev.EvType) {
@@ -415,7 +485,7 @@ void SMTTracer::WriteEventPhase(std::ofstream& trace_file, const Event ev) {
     trace_file << "\"";
 }
 
-void SMTTracer::WriteEventName(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventName(std::ostream& trace_file, const Event ev) {
     trace_file << "\"name\":\"";
     if (ev.EvType == EventType::FlowStart || ev.EvType == EventType::FlowEnd) {
         trace_file << "link";
@@ -481,30 +551,30 @@ void SMTTracer::WriteEventName(std::ofstream& trace_file, const Event ev) {
     trace_file << "\"";
 }
 
-void SMTTracer::WriteBindingPoint(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteBindingPoint(std::ostream& trace_file, const Event ev) {
     if (ev.EvType != EventType::FlowStart && ev.EvType != EventType::FlowEnd) {
         return;
     }
     trace_file << "\"bp\":\"e\"";
 }
 
-void SMTTracer::WriteEventInOutIDs(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventInOutIDs(std::ostream& trace_file, const Event ev) {
     trace_file << "\"args\":{\"InID\":" << ev.InID << ",\"OutID\":" << ev.OutID << "}";
 }
 
-void SMTTracer::WriteEventCounter(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEventCounter(std::ostream& trace_file, const Event ev) {
     trace_file << "\"args\":{\"free surfaces\":" << ev.InID << "}";
 }
 
-void SMTTracer::WriteEventCategory(std::ofstream& trace_file) {
+void SMTTracer::WriteEventCategory(std::ostream& trace_file) {
     trace_file << "\"cat\":\"link\"";
 }
 
-void SMTTracer::WriteEvID(std::ofstream& trace_file, const Event ev) {
+void SMTTracer::WriteEvID(std::ostream& trace_file, const Event ev) {
     trace_file << "\"id\":\"id_" << ev.EvID << "\"";
 }
 
-void SMTTracer::WriteComma(std::ofstream& trace_file) {
+void SMTTracer::WriteComma(std::ostream& trace_file) {
     trace_file << ",";
 }
 
@@ -118,6 +118,41 @@ void TranscodingSample::PrintHelp() {
     msdk_printf(MSDK_STRING("  -greedy \n"));
     msdk_printf(
         MSDK_STRING("                Use greedy formula to calculate number of surfaces\n"));
+    msdk_printf(MSDK_STRING("  -numa_auto\n"));
+    msdk_printf(MSDK_STRING(
+        "                Spread sessions without explicit placement across NUMA nodes (round-robin)\n"));
+    msdk_printf(MSDK_STRING("  -pool_warmup <N>\n"));
+    msdk_printf(MSDK_STRING(
+        "                Track peak number of locked surfaces of each pool over N surface requests,\n"));
+    msdk_printf(MSDK_STRING(
+        "                then stop handing out surfaces above the peak (pool grows back if needed)\n"));
+    msdk_printf(MSDK_STRING("  -pool_export <file>\n"));
+    msdk_printf(MSDK_STRING(
+        "                Write observed surface pool usage of every session to the tuning file\n"));
+    msdk_printf(MSDK_STRING("  -pool_import <file>\n"));
+    msdk_printf(MSDK_STRING(
+        "                Size surface pools from the tuning file written by -pool_export\n"));
+    msdk_printf(MSDK_STRING("  -ctrl_socket <path>\n"));
+    msdk_printf(MSDK_STRING(
+        "                Listen for control commands on a Unix-domain socket (Linux only).\n"));
+    msdk_printf(MSDK_STRING(
+        "                The application keeps running until 'quit' is received. Commands, one per line:\n"));
+    msdk_printf(MSDK_STRING(
+        "                  start <par file line>  - add a session, replies 'OK <session id>'\n"));
+    msdk_printf(MSDK_STRING("                  stop <session id>      - stop one session\n"));
+    msdk_printf(MSDK_STRING(
+        "                  stats [<session id>]   - per-session state, frames and fps\n"));
+    msdk_printf(MSDK_STRING(
+        "                  quit                   - exit once running sessions are finished\n"));
+    msdk_printf(MSDK_STRING(
+        "                Example: echo \"stats\" | socat - UNIX-CONNECT:<path>\n"));
+    msdk_printf(MSDK_STRING("  -metrics <file>\n"));
+    msdk_printf(MSDK_STRING(
+        "                Publish live per-session metrics in Prometheus text format to the file while running.\n"));
+    msdk_printf(MSDK_STRING(
+        "                The file is replaced atomically, e.g. for the node_exporter textfile collector\n"));
+    msdk_printf(MSDK_STRING("  -metrics_interval <ms>\n"));
+    msdk_printf(MSDK_STRING("                Interval of -metrics updates, 1000 ms by default\n"));
     msdk_printf(MSDK_STRING("\n"));
     msdk_printf(MSDK_STRING("Pipeline description (general options):\n"));
     msdk_printf(MSDK_STRING("  -i::h265|h264|mpeg2|vc1|mvc|jpeg|vp9|av1 <file-name>\n"));
@@ -511,6 +546,18 @@ void TranscodingSample::PrintHelp() {
         "  -vpp_comp_dump <file-name>  Dump of VPP Composition's output into file. Valid if with -vpp_comp* options\n"));
     msdk_printf(MSDK_STRING(
         "  -vpp_comp_dump null_render  Disabling rendering after VPP Composition. This is for performance measurements\n"));
+    msdk_printf(MSDK_STRING(
+        "  -hash <file-name>           Write xxh64 hashes of raw output frames and planes into the file\n"));
+    msdk_printf(MSDK_STRING(
+        "                              instead of the -o::raw output file, which isn't created\n"));
+    msdk_printf(MSDK_STRING(
+        "  -hash_golden <file-name>    Compare hashes of raw output frames with the golden hash log,\n"));
+    msdk_printf(MSDK_STRING(
+        "                              the session fails on the first mismatch. Valid with -o::raw\n"));
+    msdk_printf(MSDK_STRING(
+        "  -input_cache                Serve raw input (-i::i420/nv12/p010) from a process-wide cache: every\n"));
+    msdk_printf(MSDK_STRING(
+        "                              file is loaded into memory once and shared by all sessions reading it\n"));
     msdk_printf(MSDK_STRING(
         "  -dec_postproc               Resize after decoder using direct pipe (should be used in decoder session)\n"));
     msdk_printf(
@@ -534,6 +581,12 @@ void TranscodingSample::PrintHelp() {
         "   -dump [fileName]         - dump MSDK components configuration to the file in text form\n"));
     msdk_printf(MSDK_STRING("   -cs                      - turn on cascade scaling\n"));
     msdk_printf(MSDK_STRING("   -trace                   - turn on tracing \n"));
+    msdk_printf(
+        MSDK_STRING("   -trace::gz               - turn on tracing with gzip compressed output\n"));
+    msdk_printf(MSDK_STRING(
+        "   -affinity <cpulist>      - pin session thread to CPUs, e.g. 0-3,8 (Linux cpulist format)\n"));
+    msdk_printf(MSDK_STRING(
+        "   -numa_node <node>        - run session on NUMA node: pin to its CPUs and bind system memory surfaces\n"));
 #if defined(LIBVA_X11_SUPPORT)
     msdk_printf(MSDK_STRING("   -rx11                    - use libva X11 backend \n"));
 #endif
@@ -634,6 +687,9 @@ CmdProcessor::CmdProcessor() {
     statisticsLogFile    = NULL;
     DumpLogFileName.clear();
     shouldUseGreedyFormula = false;
+    bNumaAuto              = false;
+    m_nPoolWarmup          = 0;
+    m_nMetricsInterval     = 1000;
     bRobustFlag            = false;
     bSoftRobustFlag        = false;
 
@@ -662,6 +718,33 @@ msdk_string CmdProcessor::GetLine(mfxU32 n) {
     return msdk_string();
 }
 
+void CmdProcessor::AddLine(const msdk_string& line) {
+    m_lines.push_back(line);
+}
+
+mfxStatus CmdProcessor::ParseSessionLine(const msdk_string& line,
+                                         TranscodingSample::sInputParams& InputParams) {
+    if (line.empty())
+        return MFX_ERR_UNSUPPORTED;
+
+    size_t linesCount    = m_lines.size();
+    size_t sessionsCount = m_SessionArray.size();
+
+    std::vector<msdk_char> buf(line.begin(), line.end());
+    buf.push_back(0);
+    mfxStatus sts = TokenizeLine(buf.data(), (mfxU32)line.size());
+    if (MFX_ERR_NONE == sts && m_SessionArray.size() == sessionsCount)
+        sts = MFX_ERR_UNSUPPORTED; // "set" lines and empty lines don't describe a session
+    if (MFX_ERR_NONE == sts)
+        InputParams = m_SessionArray.back();
+
+    // leave the parser state as it was, the caller decides whether the session is kept
+    m_lines.resize(linesCount);
+    m_SessionArray.resize(sessionsCount);
+
+    return sts;
+}
+
 mfxStatus CmdProcessor::ParseCmdLine(int argc, msdk_char* argv[]) {
     FILE* parFile = NULL;
     mfxStatus sts = MFX_ERR_UNSUPPORTED;
@@ -707,6 +790,62 @@ mfxStatus CmdProcessor::ParseCmdLine(int argc, msdk_char* argv[]) {
         else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-greedy"))) {
             shouldUseGreedyFormula = true;
         }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-numa_auto"))) {
+            bNumaAuto = true;
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-ctrl_socket"))) {
+            --argc;
+            ++argv;
+            if (!argv[0]) {
+                msdk_printf(MSDK_STRING("error: no argument given for '-ctrl_socket' option\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            m_ControlSocketPath = argv[0];
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-metrics"))) {
+            --argc;
+            ++argv;
+            if (!argv[0]) {
+                msdk_printf(MSDK_STRING("error: no argument given for '-metrics' option\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            m_MetricsFile = argv[0];
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-metrics_interval"))) {
+            --argc;
+            ++argv;
+            if (!argv[0] || MFX_ERR_NONE != msdk_opt_read(argv[0], m_nMetricsInterval) ||
+                !m_nMetricsInterval) {
+                msdk_printf(MSDK_STRING("error: '-metrics_interval' requires a positive number\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-pool_warmup"))) {
+            --argc;
+            ++argv;
+            if (!argv[0] || MFX_ERR_NONE != msdk_opt_read(argv[0], m_nPoolWarmup)) {
+                msdk_printf(MSDK_STRING("error: '-pool_warmup' requires a number of requests\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-pool_import"))) {
+            --argc;
+            ++argv;
+            if (!argv[0]) {
+                msdk_printf(MSDK_STRING("error: no argument given for '-pool_import' option\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            m_PoolImportFile = argv[0];
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-pool_export"))) {
+            --argc;
+            ++argv;
+            if (!argv[0]) {
+                msdk_printf(MSDK_STRING("error: no argument given for '-pool_export' option\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            m_PoolExportFile = argv[0];
+        }
         else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-p"))) {
             if (m_PerfFILE) {
                 msdk_printf(MSDK_STRING("error: only one performance file is supported"));
@@ -1480,6 +1619,25 @@ mfxStatus ParseAdditionalParams(msdk_char* argv[],
     else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-trace"))) {
         InputParams.EnableTracing = true;
     }
+    else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-trace::gz"))) {
+        InputParams.EnableTracing   = true;
+        InputParams.CompressTracing = true;
+    }
+    else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-affinity"))) {
+        VAL_CHECK(i + 1 >= argc, i, argv[i]);
+        if (MFX_ERR_NONE != msdk_opt_read(argv[++i], InputParams.CpuAffinity)) {
+            PrintError(MSDK_STRING("-affinity \"%s\" is invalid"), argv[i]);
+            return MFX_ERR_UNSUPPORTED;
+        }
+    }
+    else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-numa_node"))) {
+        VAL_CHECK(i + 1 >= argc, i, argv[i]);
+        if (MFX_ERR_NONE != msdk_opt_read(argv[++i], InputParams.NumaNode) ||
+            InputParams.NumaNode < 0) {
+            PrintError(MSDK_STRING("-numa_node \"%s\" is invalid"), argv[i]);
+            return MFX_ERR_UNSUPPORTED;
+        }
+    }
 #if (defined(_WIN64) || defined(_WIN32))
     else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-dual_gfx::on"))) {
         InputParams.isDualMode = true;
@@ -1841,6 +1999,8 @@ mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char* argv[])
         InputParams.bSoftRobustFlag = true;
 
     InputParams.shouldUseGreedyFormula = shouldUseGreedyFormula;
+    InputParams.bNumaAuto              = bNumaAuto;
+    InputParams.nPoolWarmup            = m_nPoolWarmup;
 
     InputParams.statisticsWindowSize = statisticsWindowSize;
     InputParams.statisticsLogFile    = statisticsLogFile;
@@ -2299,6 +2459,21 @@ mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char* argv[])
             if (InputParams.eModeExt == Native)
                 InputParams.eModeExt = VppCompOnly;
         }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-hash"))) {
+            VAL_CHECK(i + 1 == argc, i, argv[i]);
+            i++;
+            SIZE_CHECK((msdk_strlen(argv[i]) + 1) > MSDK_ARRAY_LEN(InputParams.strHashFile));
+            msdk_opt_read(argv[i], InputParams.strHashFile);
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-hash_golden"))) {
+            VAL_CHECK(i + 1 == argc, i, argv[i]);
+            i++;
+            SIZE_CHECK((msdk_strlen(argv[i]) + 1) > MSDK_ARRAY_LEN(InputParams.strGoldenHashFile));
+            msdk_opt_read(argv[i], InputParams.strGoldenHashFile);
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-input_cache"))) {
+            InputParams.bInputCache = true;
+        }
         else if (0 == msdk_strncmp(MSDK_STRING("-vpp_comp_dump"),
                                    argv[i],
                                    msdk_strlen(MSDK_STRING("-vpp_comp_dump")))) {
@@ -0,0 +1,109 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __SAMPLE_VPP_PARALLEL_H
+#define __SAMPLE_VPP_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "sample_vpp_utils.h"
+
+// Returns the name of a feature which prevents frame-parallel processing, NULL if there is none
+const msdk_char* GetParallelBlocker(sInputParams* pParams);
+
+/* This class runs stateless VPP on several sessions at once. Input frames are dealt out
+   round-robin: frame k goes to session k % N. Every session has its own thread, allocator and
+   surface pools, reader and writer are shared. Processed frames go through a reorder buffer
+   keyed by frame number, so output is written in the input order. */
+class CParallelVPP {
+public:
+    CParallelVPP();
+    virtual ~CParallelVPP();
+
+    virtual mfxStatus Init(sInputParams* pParams,
+                           CRawVideoReader* pReader,
+                           GeneralWriter* pWriter,
+                           const mfxFrameInfo& frameInfoIn,
+                           const mfxFrameInfo& frameInfoOut);
+    virtual mfxStatus Run();
+    virtual void Close();
+    virtual void PrintInfo();
+
+    mfxU32 GetNumFrames() const {
+        return m_nWritten;
+    }
+    mfxF64 GetTotalTime() const {
+        return m_wallTime;
+    }
+    mfxF64 GetFPS() const {
+        return m_wallTime > 0 ? m_nWritten / m_wallTime : 0.0;
+    }
+
+protected:
+    struct sSession {
+        sInputParams Params;
+        sFrameProcessor Processor;
+        sMemoryAllocator Allocator;
+        MfxVideoParamsWrapper VppParams;
+        SurfaceVPPStore SurfStore;
+        sAppResources Resources;
+        mfxFrameInfo FrameInfoIn;
+
+        // frame numbers of the tasks in SurfStore
+        std::list<mfxU32> InFlight;
+        mfxU32 nFrames;
+        msdk_tick ActiveTime; // spent in RunFrameVPPAsync and SyncOperation
+        mfxStatus Status;
+    };
+
+    struct sPendingFrame {
+        mfxFrameSurfaceWrap* pSurface;
+        sMemoryAllocator* pAllocator;
+    };
+
+    void RunSession(sSession& session, mfxU32 idx);
+    mfxStatus ProcessFrame(sSession& session, mfxU32 frameNum);
+    mfxStatus GetOutputSurface(sSession& session, mfxFrameSurfaceWrap** ppSurface);
+    mfxStatus WaitReadTurn(sSession& session, mfxU32 frameNum);
+    mfxStatus SyncTasks(sSession& session);
+    mfxStatus PutFrame(sSession& session, mfxU32 frameNum, mfxFrameSurfaceWrap* pSurface);
+    void Abort(mfxStatus sts);
+    void PrintStatistics();
+
+    std::vector<std::unique_ptr<sSession>> m_Sessions;
+    CRawVideoReader* m_pReader;
+    GeneralWriter* m_pWriter;
+    mfxFrameInfo m_FrameInfoOut;
+    mfxU32 m_maxFrames; // 0 - until the end of input
+
+    // frames are read strictly in order, m_nextRead is the frame which is read next
+    std::mutex m_ReadMutex;
+    std::condition_variable m_ReadTurn;
+    mfxU32 m_nextRead;
+    bool m_bEndOfInput;
+    std::atomic<bool> m_bAborted;
+    mfxStatus m_Status; // the first error of any session
+
+    // frames finished out of order wait here until all preceding frames are written
+    std::mutex m_WriteMutex;
+    std::map<mfxU32, sPendingFrame> m_ReorderBuffer;
+    mfxU32 m_nWritten;
+    size_t m_maxReorderDepth;
+
+    mfxF64 m_wallTime;
+
+private:
+    CParallelVPP(const CParallelVPP&)            = delete;
+    CParallelVPP& operator=(const CParallelVPP&) = delete;
+};
+
+#endif /* __SAMPLE_VPP_PARALLEL_H */
@@ -24,6 +24,7 @@
 
     #include "hw_device.h"
 
+    #include "frame_hash.h"
     #include "sample_defs.h"
 
     #ifdef MFX_D3D11_SUPPORT
@@ -186,6 +187,7 @@ struct sInputParams {
     bool dispFullSearch;
 
     mfxU16 asyncNum;
+    mfxU16 numParallel; // number of sessions processing alternate frames
     mfxU32 vaType;
 
     std::vector<mfxU16> rotate;
@@ -233,6 +235,8 @@ struct sInputParams {
     /* ********************** */
     msdk_char strSrcFile[MSDK_MAX_FILENAME_LEN];
     std::vector<msdk_tstring> strDstFiles;
+    msdk_char strHashFile[MSDK_MAX_FILENAME_LEN]; // per-frame hash log written instead of -o
+    msdk_char strGoldenHashFile[MSDK_MAX_FILENAME_LEN]; // hash log to compare output with
 
     msdk_char strPerfFile[MSDK_MAX_FILENAME_LEN];
     mfxU32 forcedOutputFourcc;
@@ -252,6 +256,7 @@ struct sInputParams {
         ImpLib              = 0;
         accelerationMode    = MFX_ACCEL_MODE_NA;
         asyncNum            = 0;
+        numParallel         = 1;
         vaType              = 0;
         bScaling            = false;
         scalingMode         = 0;
@@ -270,6 +275,8 @@ struct sInputParams {
 
         MSDK_ZERO_MEMORY(strSrcFile);
         MSDK_ZERO_MEMORY(strPerfFile);
+        MSDK_ZERO_MEMORY(strHashFile);
+        MSDK_ZERO_MEMORY(strGoldenHashFile);
         MSDK_ZERO_MEMORY(inFrameInfo);
         MSDK_ZERO_MEMORY(compositionParam);
         MSDK_ZERO_MEMORY(roiCheckParam);
@@ -382,7 +389,8 @@ public:
 
     mfxStatus Init(const msdk_char* strFileName,
                    PTSMaker* pPTSMaker,
-                   mfxU32 forcedOutputFourcc = 0);
+                   mfxU32 forcedOutputFourcc   = 0,
+                   CSmplHashWriter* pHashWriter = NULL);
 
     mfxStatus PutNextFrame(sMemoryAllocator* pAllocator,
                            mfxFrameInfo* pInfo,
@@ -394,6 +402,8 @@ private:
     FILE* m_fDst;
     PTSMaker* m_pPTSMaker;
     mfxU32 m_forcedOutputFourcc;
+    // frames are hashed instead of writing to m_fDst
+    CSmplHashWriter* m_pHashWriter;
 };
 
 class GeneralWriter // : public CRawVideoWriter
@@ -406,8 +416,9 @@ public:
 
     mfxStatus Init(const msdk_char* strFileName,
                    PTSMaker* pPTSMaker,
-                   sSVCLayerDescr* pDesc     = NULL,
-                   mfxU32 forcedOutputFourcc = 0);
+                   sSVCLayerDescr* pDesc        = NULL,
+                   mfxU32 forcedOutputFourcc    = 0,
+                   CSmplHashWriter* pHashWriter = NULL);
 
     mfxStatus PutNextFrame(sMemoryAllocator* pAllocator,
                            mfxFrameInfo* pInfo,
@@ -475,6 +486,9 @@ mfxStatus InitResources(sAppResources* pResources, mfxVideoParam* pParams, sInpu
 void WipeResources(sAppResources* pResources);
 void WipeParams(sInputParams* pParams);
 
+void IncreaseReference(mfxFrameData* ptr);
+void DecreaseReference(mfxFrameData* ptr);
+
 mfxStatus UpdateSurfacePool(mfxFrameInfo SurfacesInfo,
                             mfxU16 nPoolSize,
                             mfxFrameSurfaceWrap* pSurface);
@@ -4,6 +4,7 @@
   # SPDX-License-Identifier: MIT
   ############################################################################*/
 
+#include "sample_vpp_parallel.h"
 #include "sample_vpp_pts.h"
 #include "sample_vpp_roi.h"
 #include "sample_vpp_utils.h"
@@ -189,7 +190,7 @@ mfxStatus OutputProcessFrame(sAppResources Resources,
 
         pProcessedSurface = Resources.pSurfStore->m_SyncPoints.front().second.pSurface;
 
-        if (!Resources.pParams->strDstFiles.empty()) {
+        if (Resources.pDstFileWriters) {
             GeneralWriter* writer = (1 == Resources.dstFileWritersN)
                                         ? &Resources.pDstFileWriters[0]
                                         : &Resources.pDstFileWriters[paramID];
@@ -243,6 +244,43 @@ void ownToMfxFrameInfo(sOwnFrameInfo* in, mfxFrameInfo* out, bool copyCropParams
     return;
 }
 
+// Stateless processing spread over several sessions, reader and writers are shared with them
+static mfxStatus RunParallelVPP(sInputParams& Params,
+                                sAppResources& Resources,
+                                CRawVideoReader& reader,
+                                const mfxFrameInfo& frameInfoIn,
+                                const mfxFrameInfo& frameInfoOut,
+                                CSmplHashWriter* pHashWriter) {
+    CParallelVPP parallelVPP;
+
+    mfxStatus sts =
+        parallelVPP.Init(&Params, &reader, Resources.pDstFileWriters, frameInfoIn, frameInfoOut);
+    MSDK_CHECK_STATUS(sts, "parallelVPP.Init failed");
+
+    parallelVPP.PrintInfo();
+    PrintDllInfo();
+
+    msdk_printf(MSDK_STRING("VPP started\n"));
+    sts = parallelVPP.Run();
+    MSDK_CHECK_STATUS(sts, "parallelVPP.Run failed");
+
+    if (pHashWriter) {
+        sts = pHashWriter->Finish();
+        MSDK_CHECK_STATUS(sts, "hashWriter.Finish failed");
+    }
+
+    msdk_printf(MSDK_STRING("\nVPP finished\n"));
+    msdk_printf(MSDK_STRING("\n"));
+
+    msdk_printf(MSDK_STRING("Total frames %d \n"), parallelVPP.GetNumFrames());
+    msdk_printf(MSDK_STRING("Total time %.2f sec \n"), parallelVPP.GetTotalTime());
+    msdk_printf(MSDK_STRING("Frames per second %.3f fps \n"), parallelVPP.GetFPS());
+
+    PutPerformanceToFile(Params, parallelVPP.GetFPS());
+
+    return MFX_ERR_NONE;
+}
+
 #if defined(_WIN32) || defined(_WIN64)
 int _tmain(int argc, TCHAR* argv[])
 #else
@@ -280,6 +318,9 @@ int main(int argc, msdk_char* argv[])
 
     unique_ptr<PTSMaker> ptsMaker;
 
+    // replaces file writers in the hash mode
+    CSmplHashWriter hashWriter;
+
     /* generators for ROI testing */
     ROIGenerator inROIGenerator;
     ROIGenerator outROIGenerator;
@@ -395,6 +436,16 @@ int main(int argc, msdk_char* argv[])
         return 1;
     }
 
+    if (Params.numParallel > 1) {
+        const msdk_char* blocker = GetParallelBlocker(&Params);
+        if (blocker) {
+            msdk_printf(MSDK_STRING(
+                            "[WARNING] %s keeps state between frames, -parallel is ignored.\n"),
+                        blocker);
+            Params.numParallel = 1;
+        }
+    }
+
     if (Params.ptsCheck) {
         ptsMaker.reset(new PTSMaker);
     }
@@ -445,17 +496,30 @@ int main(int argc, msdk_char* argv[])
     }
     ownToMfxFrameInfo(&(Params.frameInfoOut[0]), &realFrameInfoOut);
 
-    if (!Params.strDstFiles.empty()) {
-        //prepare file writers (YUV file)
-        Resources.dstFileWritersN = (mfxU32)Params.strDstFiles.size();
+    bool bHashOutput = msdk_strlen(Params.strHashFile) || msdk_strlen(Params.strGoldenHashFile);
+    if (bHashOutput) {
+        sts = hashWriter.Init(Params.strHashFile, Params.strGoldenHashFile);
+        MSDK_CHECK_STATUS_SAFE(sts, "hashWriter.Init failed", {
+            WipeResources(&Resources);
+            WipeParams(&Params);
+        });
+    }
+
+    if (!Params.strDstFiles.empty() || bHashOutput) {
+        //prepare file writers (YUV file), one writer hashes output of all parameter sets
+        Resources.dstFileWritersN = bHashOutput ? 1 : (mfxU32)Params.strDstFiles.size();
         Resources.pDstFileWriters = new GeneralWriter[Resources.dstFileWritersN];
         const msdk_char* istream;
         for (mfxU32 i = 0; i < Resources.dstFileWritersN; i++) {
-            istream = Params.isOutput ? Params.strDstFiles[i].c_str() : NULL;
-            sts     = Resources.pDstFileWriters[i].Init(istream,
+            if (bHashOutput)
+                istream = Params.strHashFile;
+            else
+                istream = Params.isOutput ? Params.strDstFiles[i].c_str() : NULL;
+            sts = Resources.pDstFileWriters[i].Init(istream,
                                                     ptsMaker.get(),
                                                     NULL,
-                                                    Params.forcedOutputFourcc);
+                                                    Params.forcedOutputFourcc,
+                                                    bHashOutput ? &hashWriter : NULL);
             MSDK_CHECK_STATUS_SAFE(sts, "Resources.pDstFileWriters[i].Init failed", {
                 WipeResources(&Resources);
                 WipeParams(&Params);
@@ -463,6 +527,18 @@ int main(int argc, msdk_char* argv[])
         }
     }
 
+    if (Params.numParallel > 1) {
+        sts = RunParallelVPP(Params,
+                             Resources,
+                             yuvReaders[VPP_IN],
+                             realFrameInfoIn[0],
+                             realFrameInfoOut,
+                             bHashOutput ? &hashWriter : NULL);
+        WipeResources(&Resources);
+        WipeParams(&Params);
+        return (MFX_ERR_NONE == sts) ? 0 : 1;
+    }
+
     //#ifdef LIBVA_SUPPORT
     //    if(!(Params.ImpLib & MFX_IMPL_SOFTWARE))
     //        allocator.libvaKeeper.reset(CreateLibVA());
@@ -872,7 +948,7 @@ int main(int argc, msdk_char* argv[])
             if (sts)
                 msdk_printf(MSDK_STRING("SyncOperation wait interval exceeded\n"));
             MSDK_BREAK_ON_ERROR(sts);
-            if (!Resources.pParams->strDstFiles.empty()) {
+            if (Resources.pDstFileWriters) {
                 GeneralWriter* writer = (1 == Resources.dstFileWritersN)
                                             ? &Resources.pDstFileWriters[0]
                                             : &Resources.pDstFileWriters[paramID];
@@ -903,6 +979,14 @@ int main(int argc, msdk_char* argv[])
         WipeParams(&Params);
     });
 
+    if (bHashOutput) {
+        sts = hashWriter.Finish();
+        MSDK_CHECK_STATUS_SAFE(sts, "hashWriter.Finish failed", {
+            WipeResources(&Resources);
+            WipeParams(&Params);
+        });
+    }
+
     msdk_printf(MSDK_STRING("\nVPP finished\n"));
     msdk_printf(MSDK_STRING("\n"));
 
@@ -0,0 +1,371 @@
+/*############################################################################
+  # Copyright (C) 2005 Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "sample_vpp_parallel.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifndef MFX_VERSION
+    #error MFX_VERSION not defined
+#endif
+
+const msdk_char* GetParallelBlocker(sInputParams* pParams) {
+    if (VPP_FILTER_DISABLED != pParams->denoiseParam[0].mode)
+        return MSDK_STRING("denoise");
+#ifdef ENABLE_MCTF
+    if (VPP_FILTER_DISABLED != pParams->mctfParam[0].mode)
+        return MSDK_STRING("MCTF");
+#endif
+    if (VPP_FILTER_DISABLED != pParams->frcParam[0].mode ||
+        pParams->frameInfoIn[0].dFrameRate != pParams->frameInfoOut[0].dFrameRate)
+        return MSDK_STRING("frame rate conversion");
+
+    // BOB and ADVANCED_NOREF look at the current frame only, other modes keep previous fields
+    if (VPP_FILTER_DISABLED != pParams->deinterlaceParam[0].mode ||
+        pParams->frameInfoIn[0].PicStruct != pParams->frameInfoOut[0].PicStruct) {
+        mfxU16 algorithm = pParams->deinterlaceParam[0].algorithm;
+        if (VPP_FILTER_ENABLED_CONFIGURED != pParams->deinterlaceParam[0].mode ||
+            (MFX_DEINTERLACING_BOB != algorithm && MFX_DEINTERLACING_ADVANCED_NOREF != algorithm))
+            return MSDK_STRING("deinterlacing with reference frames");
+    }
+
+    if (VPP_FILTER_DISABLED != pParams->istabParam[0].mode)
+        return MSDK_STRING("image stabilization");
+    if (VPP_FILTER_DISABLED != pParams->multiViewParam[0].mode)
+        return MSDK_STRING("multi-view processing");
+    if (VPP_FILTER_ENABLED_CONFIGURED == pParams->compositionParam.mode)
+        return MSDK_STRING("composition");
+    if (!pParams->resetFrmNums.empty())
+        return MSDK_STRING("VPP reset");
+    if (pParams->ptsCheck)
+        return MSDK_STRING("time stamp checking");
+    if (ROI_VAR_TO_FIX == pParams->roiCheckParam.mode ||
+        ROI_FIX_TO_VAR == pParams->roiCheckParam.mode ||
+        ROI_VAR_TO_VAR == pParams->roiCheckParam.mode)
+        return MSDK_STRING("ROI testing");
+    if (pParams->bPerf)
+        return MSDK_STRING("performance mode");
+#ifdef ENABLE_VPP_RUNTIME_HSBC
+    if (pParams->rtHue.isEnabled || pParams->rtSaturation.isEnabled ||
+        pParams->rtBrightness.isEnabled || pParams->rtContrast.isEnabled)
+        return MSDK_STRING("run-time ProcAmp");
+#endif
+
+    return NULL;
+}
+
+CParallelVPP::CParallelVPP()
+        : m_Sessions(),
+          m_pReader(NULL),
+          m_pWriter(NULL),
+          m_FrameInfoOut(),
+          m_maxFrames(0),
+          m_ReadMutex(),
+          m_ReadTurn(),
+          m_nextRead(0),
+          m_bEndOfInput(false),
+          m_bAborted(false),
+          m_Status(MFX_ERR_NONE),
+          m_WriteMutex(),
+          m_ReorderBuffer(),
+          m_nWritten(0),
+          m_maxReorderDepth(0),
+          m_wallTime(0) {}
+
+CParallelVPP::~CParallelVPP() {
+    Close();
+}
+
+mfxStatus CParallelVPP::Init(sInputParams* pParams,
+                             CRawVideoReader* pReader,
+                             GeneralWriter* pWriter,
+                             const mfxFrameInfo& frameInfoIn,
+                             const mfxFrameInfo& frameInfoOut) {
+    MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pReader, MFX_ERR_NULL_PTR);
+
+    m_pReader      = pReader;
+    m_pWriter      = pWriter;
+    m_FrameInfoOut = frameInfoOut;
+    m_maxFrames    = pParams->numFrames;
+
+    for (mfxU16 i = 0; i < pParams->numParallel; i++) {
+        m_Sessions.emplace_back(new sSession);
+        sSession& session = *m_Sessions.back();
+
+        session.Params      = *pParams;
+        session.FrameInfoIn = frameInfoIn;
+        session.nFrames     = 0;
+        session.ActiveTime  = 0;
+        session.Status      = MFX_ERR_NONE;
+
+        MSDK_ZERO_MEMORY(session.Allocator);
+        MSDK_ZERO_MEMORY(session.Resources);
+        session.Resources.pProcessor = &session.Processor;
+        session.Resources.pAllocator = &session.Allocator;
+        session.Resources.pVppParams = &session.VppParams;
+        session.Resources.pParams    = &session.Params;
+        session.Resources.pSurfStore = &session.SurfStore;
+
+        mfxStatus sts = InitParamsVPP(&session.VppParams, &session.Params, 0);
+        MSDK_CHECK_STATUS(sts, "InitParamsVPP failed");
+
+        sts = ConfigVideoEnhancementFilters(&session.Params, &session.Resources, 0);
+        MSDK_CHECK_STATUS(sts, "ConfigVideoEnhancementFilters failed");
+
+        sts = InitResources(&session.Resources, &session.VppParams, &session.Params);
+        if (MFX_WRN_FILTER_SKIPPED == sts) {
+            msdk_printf(MSDK_STRING("\nVPP_WRN: some filter(s) skipped in session %u\n"),
+                        (mfxU32)i);
+            MSDK_IGNORE_MFX_STS(sts, MFX_WRN_FILTER_SKIPPED);
+        }
+        MSDK_CHECK_STATUS(sts, "InitResources failed");
+
+        session.Params.bPartialAccel = (MFX_WRN_PARTIAL_ACCELERATION == sts);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CParallelVPP::PrintInfo() {
+    msdk_printf(MSDK_STRING("Frame-parallel VPP: %u sessions, frames are dealt out round-robin\n"),
+                (mfxU32)m_Sessions.size());
+    if (!m_Sessions.empty()) {
+        sSession& session = *m_Sessions[0];
+        ::PrintInfo(&session.Params, &session.VppParams, &session.Processor.mfxSession);
+    }
+}
+
+mfxStatus CParallelVPP::Run() {
+    CTimer timer;
+    timer.Start();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < m_Sessions.size(); i++)
+        threads.emplace_back(&CParallelVPP::RunSession, this, std::ref(*m_Sessions[i]), (mfxU32)i);
+    for (auto& thread : threads)
+        thread.join();
+
+    m_wallTime = timer.GetTime();
+
+    if (MFX_ERR_NONE != m_Status)
+        return m_Status;
+
+    PrintStatistics();
+    return MFX_ERR_NONE;
+}
+
+void CParallelVPP::RunSession(sSession& session, mfxU32 idx) {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    for (mfxU32 frameNum = idx; MFX_ERR_NONE == sts; frameNum += (mfxU32)m_Sessions.size())
+        sts = ProcessFrame(session, frameNum);
+
+    // input is over, collect tasks which are still in flight
+    if (MFX_ERR_MORE_DATA == sts)
+        sts = SyncTasks(session);
+
+    if (MFX_ERR_NONE != sts)
+        Abort(sts);
+    session.Status = sts;
+}
+
+mfxStatus CParallelVPP::GetOutputSurface(sSession& session, mfxFrameSurfaceWrap** ppSurface) {
+    mfxU16 poolSize = session.Allocator.responseOut.NumFrameActual;
+
+    // surfaces may be held by own tasks which block frames of other sessions in the reorder buffer
+    if (MSDK_INVALID_SURF_IDX == GetFreeSurfaceIndex(session.Allocator.pSurfacesOut, poolSize)) {
+        mfxStatus sts = SyncTasks(session);
+        MSDK_CHECK_STATUS(sts, "SyncTasks failed");
+    }
+
+    // the rest are released when preceding frames of other sessions are written
+    mfxU32 timeToSleep = 1; // milliseconds
+    for (mfxU32 i = 0; i <= MSDK_SURFACE_WAIT_INTERVAL / timeToSleep; i++) {
+        if (m_bAborted)
+            return MFX_ERR_ABORTED;
+
+        mfxU16 index = GetFreeSurfaceIndex(session.Allocator.pSurfacesOut, poolSize);
+        if (MSDK_INVALID_SURF_IDX != index) {
+            *ppSurface = &session.Allocator.pSurfacesOut[index];
+            return MFX_ERR_NONE;
+        }
+        MSDK_SLEEP(timeToSleep);
+    }
+
+    return MFX_ERR_NOT_ENOUGH_BUFFER;
+}
+
+mfxStatus CParallelVPP::WaitReadTurn(sSession& session, mfxU32 frameNum) {
+    std::unique_lock<std::mutex> lock(m_ReadMutex);
+
+    if (m_nextRead != frameNum && !m_bEndOfInput && !m_bAborted) {
+        // other sessions may need own tasks written to get their surfaces back
+        lock.unlock();
+        mfxStatus sts = SyncTasks(session);
+        MSDK_CHECK_STATUS(sts, "SyncTasks failed");
+        lock.lock();
+
+        m_ReadTurn.wait(lock, [&] {
+            return m_nextRead == frameNum || m_bEndOfInput || m_bAborted;
+        });
+    }
+
+    if (m_bAborted)
+        return MFX_ERR_ABORTED;
+    if (m_bEndOfInput)
+        return MFX_ERR_MORE_DATA;
+
+    if (m_maxFrames && frameNum >= m_maxFrames) {
+        m_bEndOfInput = true;
+        lock.unlock();
+        m_ReadTurn.notify_all();
+        return MFX_ERR_MORE_DATA;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CParallelVPP::ProcessFrame(sSession& session, mfxU32 frameNum) {
+    mfxFrameSurfaceWrap* pInSurf  = nullptr;
+    mfxFrameSurfaceWrap* pOutSurf = nullptr;
+    mfxSyncPoint syncPoint        = NULL;
+
+    mfxStatus sts = GetOutputSurface(session, &pOutSurf);
+    MSDK_CHECK_STATUS(sts, "GetOutputSurface failed");
+
+    sts = WaitReadTurn(session, frameNum);
+    if (MFX_ERR_NONE != sts)
+        return sts;
+
+    sts = m_pReader->GetNextInputFrame(&session.Allocator, &session.FrameInfoIn, &pInSurf, 0);
+    {
+        std::lock_guard<std::mutex> lock(m_ReadMutex);
+        if (MFX_ERR_NONE == sts)
+            m_nextRead++;
+        else
+            m_bEndOfInput = true;
+    }
+    m_ReadTurn.notify_all();
+    if (MFX_ERR_NONE != sts)
+        return sts;
+
+    // Set input timestamps according to input framerate
+    mfxFrameInfo& in        = session.VppParams.vpp.In;
+    pInSurf->Data.TimeStamp = ((mfxU64)frameNum * in.FrameRateExtD * 90000) / in.FrameRateExtN;
+
+    msdk_tick start = msdk_time_get_tick();
+
+    sts = session.Processor.pmfxVPP->RunFrameVPPAsync(pInSurf, pOutSurf, NULL, &syncPoint);
+    session.ActiveTime += msdk_time_get_tick() - start;
+
+    if (MFX_ERR_MORE_DATA == sts || MFX_ERR_MORE_SURFACE == sts) {
+        msdk_printf(MSDK_STRING(
+            "error: VPP doesn't output a frame per input frame, frames can't be processed in parallel\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+    MSDK_CHECK_STATUS(sts, "RunFrameVPPAsync failed");
+
+    IncreaseReference(&pOutSurf->Data);
+    session.SurfStore.m_SyncPoints.push_back(SurfaceVPPStore::SyncPair(syncPoint, pOutSurf));
+    session.InFlight.push_back(frameNum);
+
+    if (session.SurfStore.m_SyncPoints.size() == session.Params.asyncNum)
+        return SyncTasks(session);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CParallelVPP::SyncTasks(sSession& session) {
+    std::list<SurfaceVPPStore::SyncPair>& tasks = session.SurfStore.m_SyncPoints;
+
+    for (; !tasks.empty(); tasks.pop_front(), session.InFlight.pop_front()) {
+        msdk_tick start = msdk_time_get_tick();
+        mfxStatus sts =
+            session.Processor.mfxSession.SyncOperation(tasks.front().first, MSDK_VPP_WAIT_INTERVAL);
+        session.ActiveTime += msdk_time_get_tick() - start;
+
+        if (MFX_WRN_IN_EXECUTION == sts) {
+            msdk_printf(MSDK_STRING("SyncOperation wait interval exceeded\n"));
+        }
+        MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, sts);
+
+        sts = PutFrame(session, session.InFlight.front(), tasks.front().second.pSurface);
+        MSDK_CHECK_STATUS(sts, "PutFrame failed");
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CParallelVPP::PutFrame(sSession& session,
+                                 mfxU32 frameNum,
+                                 mfxFrameSurfaceWrap* pSurface) {
+    std::lock_guard<std::mutex> lock(m_WriteMutex);
+
+    m_ReorderBuffer[frameNum] = { pSurface, &session.Allocator };
+    m_maxReorderDepth         = std::max(m_maxReorderDepth, m_ReorderBuffer.size());
+    session.nFrames++;
+
+    // write everything which is in order now
+    while (!m_ReorderBuffer.empty() && m_ReorderBuffer.begin()->first == m_nWritten) {
+        sPendingFrame& frame = m_ReorderBuffer.begin()->second;
+
+        mfxStatus sts = MFX_ERR_NONE;
+        if (m_pWriter)
+            sts = m_pWriter->PutNextFrame(frame.pAllocator, &m_FrameInfoOut, frame.pSurface);
+        DecreaseReference(&frame.pSurface->Data);
+        m_ReorderBuffer.erase(m_ReorderBuffer.begin());
+
+        if (sts)
+            msdk_printf(MSDK_STRING("Failed to write frame to disk\n"));
+        MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, MFX_ERR_ABORTED);
+
+        m_nWritten++;
+        msdk_printf(MSDK_STRING("Frame number: %d\r"), m_nWritten);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CParallelVPP::Abort(mfxStatus sts) {
+    {
+        std::lock_guard<std::mutex> lock(m_ReadMutex);
+        // keep the first error, others are consequences
+        if (MFX_ERR_NONE == m_Status)
+            m_Status = sts;
+        m_bAborted = true;
+    }
+    m_ReadTurn.notify_all();
+}
+
+void CParallelVPP::PrintStatistics() {
+    // active time includes SyncOperation waits for the device shared with the other sessions
+    msdk_printf(MSDK_STRING("\n\nSession  frames  active, sec  active fps\n"));
+    for (size_t i = 0; i < m_Sessions.size(); i++) {
+        sSession& session = *m_Sessions[i];
+
+        mfxF64 time = CTimer::ConvertToSeconds(session.ActiveTime);
+        mfxF64 fps  = time > 0 ? session.nFrames / time : 0.0;
+
+        msdk_printf(MSDK_STRING("%7u  %6u  %11.3f  %10.2f\n"),
+                    (mfxU32)i,
+                    session.nFrames,
+                    time,
+                    fps);
+    }
+
+    msdk_printf(MSDK_STRING("Reorder buffer: up to %u frames\n"), (mfxU32)m_maxReorderDepth);
+}
+
+void CParallelVPP::Close() {
+    m_ReorderBuffer.clear();
+    for (auto& session : m_Sessions) {
+        WipeResources(&session->Resources);
+        WipeParams(&session->Params);
+    }
+    m_Sessions.clear();
+}
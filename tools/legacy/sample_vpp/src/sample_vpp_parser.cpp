@@ -376,6 +376,8 @@ void vppPrintHelp(const msdk_char* strAppName, const msdk_char* strErrorMessage)
         "   [-iopattern IN/OUT surface type] -  IN/OUT surface type: sys_to_sys, sys_to_d3d, d3d_to_sys, d3d_to_d3d    (def: sys_to_sys)\n"));
     msdk_printf(
         MSDK_STRING("   [-async n] - maximum number of asynchronious tasks. def: -async 1 \n"));
+    msdk_printf(MSDK_STRING(
+        "   [-parallel n] - process alternate frames on n VPP sessions, output order is kept. Filters with temporal state fall back to 1 session. def: -parallel 1 \n"));
     msdk_printf(MSDK_STRING(
         "   [-perf_opt n m] - n: number of prefetech frames. m : number of passes. In performance mode app preallocates bufer and load first n frames,  def: no performace 1 \n"));
     msdk_printf(MSDK_STRING("   [-pts_check] - checking of time stampls. Default is OFF \n"));
@@ -385,7 +387,11 @@ void vppPrintHelp(const msdk_char* strAppName, const msdk_char* strErrorMessage)
         "   [-pts_fr ]   - input frame rate which used for pts. Default frame_rate = sf \n"));
     msdk_printf(MSDK_STRING("   [-pts_advanced]   - enable FRC checking mode based on PTS \n"));
     msdk_printf(MSDK_STRING(
-        "   [-pf file for performance data] -  file to save performance data. Default is off \n\n\n"));
+        "   [-pf file for performance data] -  file to save performance data. Default is off \n"));
+    msdk_printf(MSDK_STRING(
+        "   [-hash file] - write xxh64 hashes of output frames and planes to the file instead of -o output \n"));
+    msdk_printf(MSDK_STRING(
+        "   [-hash_golden file] - compare hashes of output frames with the golden hash log, processing fails on the first mismatch \n\n\n"));
 
     msdk_printf(MSDK_STRING(
         "   [-roi_check mode seed1 seed2] - checking of ROI processing. Default is OFF \n"));
@@ -1738,6 +1744,22 @@ mfxStatus vppParseInputString(msdk_char* strInput[],
                 pParams->strDstFiles.push_back(strInput[i]);
                 pParams->isOutput = true;
             }
+            else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-hash"))) {
+                VAL_CHECK(1 + i == nArgNum);
+                i++;
+                if (MFX_ERR_NONE != msdk_opt_read(strInput[i], pParams->strHashFile)) {
+                    vppPrintHelp(strInput[0], MSDK_STRING("Hash file name is too long"));
+                    return MFX_ERR_UNSUPPORTED;
+                }
+            }
+            else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-hash_golden"))) {
+                VAL_CHECK(1 + i == nArgNum);
+                i++;
+                if (MFX_ERR_NONE != msdk_opt_read(strInput[i], pParams->strGoldenHashFile)) {
+                    vppPrintHelp(strInput[0], MSDK_STRING("Golden hash file name is too long"));
+                    return MFX_ERR_UNSUPPORTED;
+                }
+            }
             else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-pf"))) {
                 VAL_CHECK(1 + i == nArgNum);
                 i++;
@@ -1961,6 +1983,11 @@ mfxStatus vppParseInputString(msdk_char* strInput[],
                 i++;
                 msdk_sscanf(strInput[i], MSDK_STRING("%hu"), &pParams->asyncNum);
             }
+            else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-parallel"))) {
+                VAL_CHECK(1 + i == nArgNum);
+                i++;
+                msdk_sscanf(strInput[i], MSDK_STRING("%hu"), &pParams->numParallel);
+            }
             else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-perf_opt"))) {
                 if (pParams->numFrames)
                     return MFX_ERR_UNKNOWN;
@@ -2069,7 +2096,9 @@ mfxStatus vppParseInputString(msdk_char* strInput[],
         return MFX_ERR_UNSUPPORTED;
     };
 
-    if (1 != pParams->strDstFiles.size() &&
+    bool bHashOutput =
+        msdk_strlen(pParams->strHashFile) || msdk_strlen(pParams->strGoldenHashFile);
+    if (!bHashOutput && 1 != pParams->strDstFiles.size() &&
         (pParams->resetFrmNums.size() + 1) != pParams->strDstFiles.size()) {
         vppPrintHelp(
             strInput[0],
@@ -2132,6 +2161,12 @@ bool CheckInputParams(msdk_char* strInput[], sInputParams* pParams) {
         return false;
     }
 
+    if (0 == pParams->numParallel) {
+        vppPrintHelp(strInput[0],
+                     MSDK_STRING("Incompatible parameters: [number of sessions must exceed 0]\n"));
+        return false;
+    }
+
     for (mfxU32 i = 0; i < pParams->rotate.size(); i++) {
         if (pParams->rotate[i] != 0 && pParams->rotate[i] != 90 && pParams->rotate[i] != 180 &&
             pParams->rotate[i] != 270) {
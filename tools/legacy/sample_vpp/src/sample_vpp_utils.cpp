@@ -1392,15 +1392,22 @@ CRawVideoWriter::CRawVideoWriter() {
     m_fDst               = 0;
     m_pPTSMaker          = 0;
     m_forcedOutputFourcc = 0;
+    m_pHashWriter        = 0;
     return;
 }
 
 mfxStatus CRawVideoWriter::Init(const msdk_char* strFileName,
                                 PTSMaker* pPTSMaker,
-                                mfxU32 forcedOutputFourcc) {
+                                mfxU32 forcedOutputFourcc,
+                                CSmplHashWriter* pHashWriter) {
     Close();
 
-    m_pPTSMaker = pPTSMaker;
+    m_pPTSMaker   = pPTSMaker;
+    m_pHashWriter = pHashWriter;
+    // hash mode, frames aren't written
+    if (m_pHashWriter)
+        return MFX_ERR_NONE;
+
     // no need to generate output
     if (0 == strFileName)
         return MFX_ERR_NONE;
@@ -1433,7 +1440,7 @@ mfxStatus CRawVideoWriter::PutNextFrame(sMemoryAllocator* pAllocator,
                                         mfxFrameInfo* pInfo,
                                         mfxFrameSurfaceWrap* pSurface) {
     mfxStatus sts;
-    if (m_fDst) {
+    if (m_fDst || m_pHashWriter) {
         if (pSurface->Data.MemId) {
             // get YUV pointers
             sts = pAllocator->pMfxAllocator->Lock(pAllocator->pMfxAllocator->pthis,
@@ -1441,7 +1448,8 @@ mfxStatus CRawVideoWriter::PutNextFrame(sMemoryAllocator* pAllocator,
                                                   &(pSurface->Data));
             MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, MFX_ERR_ABORTED);
 
-            sts = WriteFrame(&(pSurface->Data), pInfo);
+            sts = m_pHashWriter ? m_pHashWriter->WriteNextFrame(pSurface->Data, *pInfo)
+                                : WriteFrame(&(pSurface->Data), pInfo);
             MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, MFX_ERR_ABORTED);
 
             sts = pAllocator->pMfxAllocator->Unlock(pAllocator->pMfxAllocator->pthis,
@@ -1450,7 +1458,8 @@ mfxStatus CRawVideoWriter::PutNextFrame(sMemoryAllocator* pAllocator,
             MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, MFX_ERR_ABORTED);
         }
         else {
-            sts = WriteFrame(&(pSurface->Data), pInfo);
+            sts = m_pHashWriter ? m_pHashWriter->WriteNextFrame(pSurface->Data, *pInfo)
+                                : WriteFrame(&(pSurface->Data), pInfo);
             MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, MFX_ERR_ABORTED);
         }
     }
@@ -1939,7 +1948,8 @@ void GeneralWriter::Close() {
 mfxStatus GeneralWriter::Init(const msdk_char* strFileName,
                               PTSMaker* pPTSMaker,
                               sSVCLayerDescr* pDesc,
-                              mfxU32 forcedOutputFourcc) {
+                              mfxU32 forcedOutputFourcc,
+                              CSmplHashWriter* pHashWriter) {
     mfxStatus sts = MFX_ERR_UNKNOWN;
 
     mfxU32 didCount = (pDesc) ? 8 : 1;
@@ -1982,7 +1992,8 @@ mfxStatus GeneralWriter::Init(const msdk_char* strFileName,
 
             sts = m_ofile[did]->Init((1 == didCount) ? strFileName : out_buf,
                                      pPTSMaker,
-                                     forcedOutputFourcc);
+                                     forcedOutputFourcc,
+                                     pHashWriter);
 
             if (sts != MFX_ERR_NONE)
                 break;